@@ -0,0 +1,546 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QThread>
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "broker.h"
+#include "brokermetrics.h"
+#include "publisher.h"
+#include "subscriber.h"
+#include "logger.h"
+
+namespace {
+
+// 负载开头的时间戳和编号，编号为 -1 的是探测消息
+const int kHeaderSize = 16;
+
+// 每个场景发布的负载总量上限，大负载时减少消息数
+const qint64 kPayloadBudget = 64 * 1024 * 1024;
+
+// 没有新消息送达超过这么久就放弃该场景（毫秒）
+const int kStallTimeoutMs = 10000;
+
+/**
+ * @brief 基准测试场景
+ */
+struct Scenario {
+    QString pattern;    ///< one_to_one、fan_out、fan_in 或 replay
+    QString transport;  ///< tcp 或 local
+    int publishers;     ///< 发布者数量
+    int subscribers;    ///< 订阅者数量（回放场景不含用于同步的订阅者）
+    int payloadSize;    ///< 负载大小（字节）
+    int messages;       ///< 发布的消息总数
+
+    QString id() const
+    {
+        return QString("%1.%2.%3x%4.%5B").arg(pattern, transport).arg(publishers).arg(subscribers).arg(payloadSize);
+    }
+};
+
+/**
+ * @brief 一个订阅者的接收状态
+ */
+struct Receiver {
+    Subscriber* subscriber = nullptr;
+    bool probed = false;        ///< 是否收到过探测消息（订阅已生效）
+    qint64 delivered = 0;       ///< 收到的数据消息数
+    qint64 bytes = 0;           ///< 收到的负载字节数
+};
+
+/**
+ * @brief 运行基准测试时的Broker：同一进程内，或者以 --serve 重新启动本程序的子进程
+ */
+class BrokerHost
+{
+public:
+    BrokerHost(bool inProcess, int port, const QString& serverName, Broker::IoBackend backend, int ioThreads)
+        : m_inProcess(inProcess)
+        , m_port(port)
+        , m_serverName(serverName)
+        , m_backend(backend)
+        , m_ioThreads(ioThreads)
+        , m_process(nullptr)
+    {
+    }
+
+    ~BrokerHost()
+    {
+        stop();
+    }
+
+    /**
+     * @brief 启动一个新的Broker
+     * @param cacheSize 消息缓存大小
+     * @return 是否启动成功
+     */
+    bool start(int cacheSize)
+    {
+        stop();
+
+        if (m_inProcess) {
+            Broker* broker = Broker::instance();
+            broker->setIoThreadCount(m_ioThreads);
+            configure(broker, cacheSize);
+            return broker->start(m_port, m_serverName, m_backend);
+        }
+
+        // 子进程启动完成后在标准输出打印 READY
+        m_process = new QProcess();
+        m_process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        m_process->start(QCoreApplication::applicationFilePath(), QStringList()
+                         << "--serve" << "--port" << QString::number(m_port) << "--server" << m_serverName
+                         << "--io-threads" << QString::number(m_ioThreads)
+                         << "--io-backend" << (m_backend == Broker::EpollBackend ? "epoll" : "qt")
+                         << "--cache-size" << QString::number(cacheSize));
+        QByteArray output;
+        QElapsedTimer timer;
+        timer.start();
+        while (!output.contains("READY") && timer.elapsed() < 5000) {
+            if (!m_process->waitForReadyRead(100) && m_process->state() == QProcess::NotRunning) {
+                break;
+            }
+            output += m_process->readAllStandardOutput();
+        }
+        return output.contains("READY");
+    }
+
+    /**
+     * @brief 停止Broker
+     */
+    void stop()
+    {
+        if (m_inProcess) {
+            Broker::forceCleanup();
+            return;
+        }
+
+        if (m_process) {
+            m_process->kill();
+            m_process->waitForFinished(5000);
+            delete m_process;
+            m_process = nullptr;
+        }
+    }
+
+    /**
+     * @brief 设置基准测试使用的Broker参数：发送队列足够大，慢速订阅者不丢消息
+     * @param broker Broker
+     * @param cacheSize 消息缓存大小
+     */
+    static void configure(Broker* broker, int cacheSize)
+    {
+        broker->setCacheSize(cacheSize);
+        broker->setOutboundQueueLimits(1000000, qint64(1) << 30);
+        broker->setStatsInterval(0);
+    }
+
+private:
+    bool m_inProcess;               ///< 是否在同一进程内运行
+    int m_port;                     ///< TCP端口
+    QString m_serverName;           ///< 本地服务器名称
+    Broker::IoBackend m_backend;    ///< I/O后端
+    int m_ioThreads;                ///< I/O线程数量
+    QProcess* m_process;            ///< Broker子进程
+};
+
+/**
+ * @brief 构造负载：开头写入发送时间和编号
+ */
+QByteArray makePayload(const QByteArray& base, qint64 index)
+{
+    QByteArray payload = base;
+    const qint64 sentAt = MetricsShard::now();
+    memcpy(payload.data(), &sentAt, sizeof(sentAt));
+    memcpy(payload.data() + sizeof(sentAt), &index, sizeof(index));
+    return payload;
+}
+
+/**
+ * @brief 运行事件循环直到条件满足，持续没有进展或超过总时限时放弃
+ */
+template <typename Done, typename Progress>
+bool waitUntil(Done done, Progress progress, int totalTimeoutMs)
+{
+    QElapsedTimer total;
+    total.start();
+    QElapsedTimer stall;
+    stall.start();
+    qint64 last = progress();
+    while (!done()) {
+        if (total.elapsed() > totalTimeoutMs || stall.elapsed() > kStallTimeoutMs) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        const qint64 current = progress();
+        if (current != last) {
+            last = current;
+            stall.restart();
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 编码纳秒直方图为微秒的百分位数
+ */
+QJsonObject latencyJson(const LatencyHistogram& histogram)
+{
+    QJsonObject object;
+    object.insert("p50", histogram.percentile(50) / 1000.0);
+    object.insert("p99", histogram.percentile(99) / 1000.0);
+    object.insert("p999", histogram.percentile(99.9) / 1000.0);
+    object.insert("max", histogram.max() / 1000.0);
+    object.insert("mean", histogram.mean() / 1000.0);
+    return object;
+}
+
+/**
+ * @brief 运行一个场景
+ *
+ * 发布者在一个线程里以最快速度发布，每发布一段运行一次事件循环让订阅者边收边读；
+ * 延迟是负载中的发送时间到订阅者收到的时间，因此是满负荷下的延迟。
+ * 回放场景先通过一个同步订阅者确认消息都已进入缓存，再计时新订阅者收完全部回放的时间，
+ * 延迟是从调用 subscribe() 到收到每条消息的时间。
+ */
+QJsonObject runScenario(const Scenario& scenario, BrokerHost& host, int port, const QString& serverName)
+{
+    const bool replay = scenario.pattern == "replay";
+    const QString topic = QString("bench/%1").arg(scenario.id());
+
+    QJsonObject result;
+    result.insert("id", scenario.id());
+    result.insert("pattern", scenario.pattern);
+    result.insert("transport", scenario.transport);
+    result.insert("publishers", scenario.publishers);
+    result.insert("subscribers", scenario.subscribers);
+    result.insert("payloadBytes", scenario.payloadSize);
+    result.insert("messages", scenario.messages);
+
+    if (!host.start(replay ? scenario.messages : 0)) {
+        result.insert("error", "broker failed to start");
+        return result;
+    }
+
+    QVector<Publisher*> publishers;
+    QVector<Receiver> receivers(scenario.subscribers + (replay ? 1 : 0));
+    LatencyHistogram latency;
+    qint64 measureStart = 0;
+    bool connected = true;
+
+    auto connectClient = [&](QObject* client) -> bool {
+        Publisher* publisher = qobject_cast<Publisher*>(client);
+        Subscriber* subscriber = qobject_cast<Subscriber*>(client);
+        if (scenario.transport == "local") {
+            return publisher ? publisher->connectToLocalBroker(serverName) : subscriber->connectToLocalBroker(serverName);
+        }
+        return publisher ? publisher->connectToBroker("127.0.0.1", port) : subscriber->connectToBroker("127.0.0.1", port);
+    };
+
+    for (int i = 0; i < scenario.publishers; ++i) {
+        publishers.append(new Publisher());
+        connected = connectClient(publishers.last()) && connected;
+    }
+
+    // 回放场景的最后一个订阅者在消息进入缓存后才订阅，其余的用于同步
+    for (int i = 0; i < receivers.size(); ++i) {
+        Receiver* receiver = &receivers[i];
+        receiver->subscriber = new Subscriber();
+        connected = connectClient(receiver->subscriber) && connected;
+        const bool measured = !replay || i == receivers.size() - 1;
+        QObject::connect(receiver->subscriber, &Subscriber::messageReceived,
+                         [receiver, measured, replay, &latency, &measureStart](const Message& message) {
+                             const QByteArray data = message.data();
+                             qint64 sentAt = 0;
+                             qint64 index = -1;
+                             if (data.size() >= kHeaderSize) {
+                                 memcpy(&sentAt, data.constData(), sizeof(sentAt));
+                                 memcpy(&index, data.constData() + sizeof(sentAt), sizeof(index));
+                             }
+                             if (index < 0) {
+                                 receiver->probed = true;
+                                 return;
+                             }
+
+                             ++receiver->delivered;
+                             receiver->bytes += data.size();
+                             if (measured) {
+                                 latency.record(quint64(qMax<qint64>(0, MetricsShard::now() - (replay ? measureStart : sentAt))));
+                             }
+                         });
+    }
+
+    auto cleanup = [&]() {
+        for (Publisher* publisher : std::as_const(publishers)) {
+            publisher->disconnectFromBroker();
+        }
+        for (const Receiver& receiver : std::as_const(receivers)) {
+            receiver.subscriber->disconnectFromBroker();
+        }
+        qDeleteAll(publishers);
+        for (const Receiver& receiver : std::as_const(receivers)) {
+            delete receiver.subscriber;
+        }
+        host.stop();
+    };
+
+    if (!connected) {
+        result.insert("error", "client failed to connect");
+        cleanup();
+        return result;
+    }
+
+    const int syncedReceivers = replay ? receivers.size() - 1 : receivers.size();
+    for (int i = 0; i < syncedReceivers; ++i) {
+        receivers[i].subscriber->subscribe(topic);
+    }
+
+    // 发送探测消息直到所有订阅都已生效，同时让每个发布者完成注册
+    const QByteArray base(qMax(kHeaderSize, scenario.payloadSize), 'x');
+    const QByteArray probe = makePayload(QByteArray(kHeaderSize, 'p'), -1);
+    QElapsedTimer probeTimer;
+    probeTimer.start();
+    bool probed = false;
+    while (!probed && probeTimer.elapsed() < 5000) {
+        for (Publisher* publisher : std::as_const(publishers)) {
+            publisher->publish(topic, probe);
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        QThread::msleep(20);
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        probed = true;
+        for (int i = 0; i < syncedReceivers; ++i) {
+            probed = probed && receivers[i].probed;
+        }
+    }
+    if (!probed) {
+        result.insert("error", "subscriptions did not take effect");
+        cleanup();
+        return result;
+    }
+
+    auto deliveredTo = [&](int first, int last) -> qint64 {
+        qint64 delivered = 0;
+        for (int i = first; i < last; ++i) {
+            delivered += receivers[i].delivered;
+        }
+        return delivered;
+    };
+
+    // 大负载每条都运行事件循环，小负载每64条一次
+    const int eventInterval = scenario.payloadSize >= 64 * 1024 ? 1 : 64;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < scenario.messages; ++i) {
+        publishers[i % publishers.size()]->publish(topic, makePayload(base, i));
+        if ((i + 1) % eventInterval == 0) {
+            QCoreApplication::processEvents();
+        }
+    }
+
+    qint64 expected = qint64(scenario.messages) * syncedReceivers;
+    bool complete = waitUntil([&]() { return deliveredTo(0, syncedReceivers) >= expected; },
+                              [&]() { return deliveredTo(0, syncedReceivers); }, 120000);
+
+    int first = 0;
+    if (replay && complete) {
+        // 同步订阅者收齐后消息都已进入缓存，计时新订阅者收完回放
+        first = syncedReceivers;
+        expected = scenario.messages;
+        measureStart = MetricsShard::now();
+        timer.restart();
+        receivers.last().subscriber->subscribe(topic);
+        complete = waitUntil([&]() { return deliveredTo(first, receivers.size()) >= expected; },
+                             [&]() { return deliveredTo(first, receivers.size()); }, 120000);
+    }
+    const double seconds = qMax<qint64>(1, timer.nsecsElapsed()) / 1e9;
+
+    qint64 delivered = 0;
+    qint64 bytes = 0;
+    for (int i = first; i < (replay ? receivers.size() : syncedReceivers); ++i) {
+        delivered += receivers[i].delivered;
+        bytes += receivers[i].bytes;
+    }
+
+    result.insert("expected", double(expected));
+    result.insert("delivered", double(delivered));
+    result.insert("complete", complete);
+    result.insert("seconds", seconds);
+    result.insert("msgsPerSec", delivered / seconds);
+    result.insert("mbPerSec", bytes / seconds / 1e6);
+    result.insert("latencyUs", latencyJson(latency));
+
+    qInfo("%-36s %10.0f msgs/s %9.1f MB/s  p50 %9.1f us  p99 %9.1f us  p999 %9.1f us%s",
+          qPrintable(scenario.id()), delivered / seconds, bytes / seconds / 1e6,
+          latency.percentile(50) / 1000.0, latency.percentile(99) / 1000.0, latency.percentile(99.9) / 1000.0,
+          complete ? "" : "  (incomplete)");
+
+    cleanup();
+    return result;
+}
+
+/**
+ * @brief 生成场景列表：1:1 负载扫描、1:N 扇出、N:1 扇入和订阅时的缓存回放，每个都覆盖两种传输
+ */
+QVector<Scenario> buildScenarios(int messages, int fanOut, const QStringList& transports)
+{
+    const int payloadSizes[] = { 16, 256, 4096, 65536, 1024 * 1024 };
+
+    QVector<Scenario> scenarios;
+    auto add = [&](const QString& pattern, const QString& transport, int publishers, int subscribers, int payloadSize) {
+        Scenario scenario;
+        scenario.pattern = pattern;
+        scenario.transport = transport;
+        scenario.publishers = publishers;
+        scenario.subscribers = subscribers;
+        scenario.payloadSize = payloadSize;
+        scenario.messages = int(qMin<qint64>(messages, qMax<qint64>(50, kPayloadBudget / payloadSize)));
+        scenarios.append(scenario);
+    };
+
+    for (const QString& transport : transports) {
+        for (int payloadSize : payloadSizes) {
+            add("one_to_one", transport, 1, 1, payloadSize);
+        }
+        add("fan_out", transport, 1, fanOut, 256);
+        add("fan_in", transport, fanOut, 1, 256);
+        add("replay", transport, 1, 1, 256);
+    }
+    return scenarios;
+}
+
+/**
+ * @brief 以子进程方式运行Broker，直到被父进程结束
+ */
+int serveBroker(QCoreApplication& app, const QCommandLineParser& parser, int port, const QString& serverName,
+                Broker::IoBackend backend, int ioThreads)
+{
+    Logger::instance()->init("pubsub_benchmark_broker.log", Logger::WARNING);
+    Logger::instance()->setConsoleOutput(false);
+
+    Broker* broker = Broker::instance();
+    broker->setIoThreadCount(ioThreads);
+    BrokerHost::configure(broker, parser.value("cache-size").toInt());
+    if (!broker->start(port, serverName, backend)) {
+        return 1;
+    }
+
+    fputs("READY\n", stdout);
+    fflush(stdout);
+    return app.exec();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("MyMQ pub/sub benchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("End-to-end MyMQ publish/subscribe benchmarks, results written as JSON");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("output", "Write the JSON results to this file instead of stdout.", "path"));
+    parser.addOption(QCommandLineOption("messages", "Messages published per scenario (fewer for large payloads).",
+                                        "count", "20000"));
+    parser.addOption(QCommandLineOption("fan", "Subscribers for fan-out and publishers for fan-in.", "count", "16"));
+    parser.addOption(QCommandLineOption("transport", "tcp, local or all.", "name", "all"));
+    parser.addOption(QCommandLineOption("scenario", "Only run scenarios whose id starts with this prefix.", "prefix"));
+    parser.addOption(QCommandLineOption("in-process", "Run the broker in this process instead of a child process."));
+    parser.addOption(QCommandLineOption("io-backend", "Broker I/O backend: qt or epoll.", "name", "qt"));
+    parser.addOption(QCommandLineOption("io-threads", "Broker I/O threads.", "count",
+                                        QString::number(qMax(1, QThread::idealThreadCount()))));
+    parser.addOption(QCommandLineOption("port", "Broker TCP port.", "port", "5563"));
+    parser.addOption(QCommandLineOption("server", "Broker local server name.", "name", "MyMQBenchmark"));
+    parser.addOption(QCommandLineOption("serve", "Internal: run only the broker (used for the child process)."));
+    parser.addOption(QCommandLineOption("cache-size", "Internal: broker cache size for --serve.", "count", "0"));
+    parser.process(app);
+
+    const int port = parser.value("port").toInt();
+    const QString serverName = parser.value("server");
+    const Broker::IoBackend backend = parser.value("io-backend") == "epoll" ? Broker::EpollBackend : Broker::QtBackend;
+    const int ioThreads = qMax(1, parser.value("io-threads").toInt());
+
+    if (parser.isSet("serve")) {
+        return serveBroker(app, parser, port, serverName, backend, ioThreads);
+    }
+
+    Logger::instance()->init("pubsub_benchmark.log", Logger::WARNING);
+    Logger::instance()->setConsoleOutput(false);
+
+    QStringList transports;
+    const QString transport = parser.value("transport");
+    if (transport == "all") {
+        transports << "tcp" << "local";
+    } else {
+        transports << transport;
+    }
+
+    const bool inProcess = parser.isSet("in-process");
+    BrokerHost host(inProcess, port, serverName, backend, ioThreads);
+
+    QJsonArray results;
+    const QVector<Scenario> scenarios = buildScenarios(qMax(1, parser.value("messages").toInt()),
+                                                       qMax(1, parser.value("fan").toInt()), transports);
+    for (const Scenario& scenario : scenarios) {
+        if (parser.isSet("scenario") && !scenario.id().startsWith(parser.value("scenario"))) {
+            continue;
+        }
+        results.append(runScenario(scenario, host, port, serverName));
+    }
+
+    // 运行环境随结果一起保存，比较两次构建的结果时可以确认条件相同
+    QJsonObject environment;
+    environment.insert("qt", QString::fromLatin1(qVersion()));
+#if defined(__clang__)
+    environment.insert("compiler", QString("clang %1").arg(__clang_version__));
+#elif defined(__GNUC__)
+    environment.insert("compiler", QString("gcc %1").arg(__VERSION__));
+#elif defined(_MSC_VER)
+    environment.insert("compiler", QString("msvc %1").arg(_MSC_VER));
+#endif
+#ifdef QT_NO_DEBUG
+    environment.insert("buildType", "release");
+#else
+    environment.insert("buildType", "debug");
+#endif
+    environment.insert("broker", inProcess ? "in-process" : "child process");
+    environment.insert("ioBackend", backend == Broker::EpollBackend ? "epoll" : "qt");
+    environment.insert("ioThreads", ioThreads);
+    environment.insert("cpus", QThread::idealThreadCount());
+
+    QJsonObject report;
+    report.insert("timestamp", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    report.insert("environment", environment);
+    report.insert("results", results);
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet("output")) {
+        QFile file(parser.value("output"));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCritical("Failed to write %s", qPrintable(parser.value("output")));
+            return 1;
+        }
+        file.write(json);
+    } else {
+        fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    }
+
+    // 有场景没有完成时返回非零，便于脚本发现
+    for (const QJsonValue& value : std::as_const(results)) {
+        if (!value.toObject().value("complete").toBool()) {
+            return 2;
+        }
+    }
+    return 0;
+}
@@ -7,38 +7,118 @@
 #include <QLocalServer>
 #include <QLocalSocket>
 #include <QMap>
+#include <QHash>
 #include <QSet>
 #include <QQueue>
+#include <QVector>
+#include <QBitArray>
 #include <QMutex>
-#include <QTimer>
+#include <QReadWriteLock>
 #include <QThread>
+#include <QTimer>
+#include <QAtomicInteger>
+
+#include <functional>
 
 #include "message.h"
 #include "topic.h"
+#include "topictrie.h"
 #include "messageframehandler.h"
+#include "subscriptionoptions.h"
+#include "outboundqueue.h"
+#include "messagelog.h"
+#include "clienttable.h"
+#include "topicregistry.h"
+#include "brokermetrics.h"
+
+class BrokerWorker;
+class SharedMemoryChannel;
+class NativeSocket;
+
+/**
+ * @brief 一个主题的订阅者：客户端句柄按所属I/O线程分组
+ */
+typedef QHash<BrokerWorker*, QSet<ClientHandle>> WorkerSubscribers;
+
+/**
+ * @brief 客户端在本连接上登记的主题别名
+ */
+struct TopicAlias {
+    TopicId topicId;    ///< 驻留的主题编号
+    QString topic;      ///< 主题
+};
+
+/**
+ * @brief 正在追赶历史消息的订阅：按页回放，追上之后才登记到订阅表
+ */
+struct PendingReplay {
+    QString topic;                      ///< 主题或通配符模式
+    SubscriptionOptions options;        ///< 订阅选项
+    QHash<QString, qint64> positions;   ///< 每个具体主题下一条要回放的序号
+};
 
 /**
- * @brief 客户端连接信息
+ * @brief 客户端连接信息，由连接所属的 BrokerWorker 独占访问
  */
 struct ClientInfo {
+    ClientHandle handle;        ///< 客户端句柄（在所属I/O线程内唯一）
     QString id;                 ///< 客户端ID
     QTcpSocket* tcpSocket;      ///< TCP套接字
     QLocalSocket* localSocket;  ///< 本地套接字
-    QSet<QString> subscriptions; ///< 订阅的主题
+    SharedMemoryChannel* shmChannel; ///< 共享内存通道，建立后发送都经过它；未使用时为 nullptr
+    NativeSocket* nativeSocket; ///< epoll 后端的TCP连接，Qt 后端为 nullptr
+    QHash<QString, SubscriptionOptions> subscriptions; ///< 订阅的主题及其选项
+    QList<PendingReplay> pendingReplays; ///< 按页回放中、尚未登记的订阅
     bool isPublisher;           ///< 是否为发布者
     bool isSubscriber;          ///< 是否为订阅者
-    QDateTime lastActiveTime;   ///< 最后活动时间
+    int protocolVersion;        ///< 协商后的线路协议版本
+    quint64 lastActiveTick;     ///< 最后收到数据时所在I/O线程的节拍（秒）
+    int idleTimeout;            ///< 空闲超时（秒），0 表示不因空闲断开
     MessageFrameHandler* frameHandler; ///< 消息帧处理器
+    OutboundQueue* outboundQueue; ///< 有界发送队列
+    bool disconnecting;         ///< 是否因发送队列溢出而等待断开
+    QHash<quint32, TopicAlias> topicAliases; ///< 客户端发布时使用的主题别名
+    bool receiveTopicAliases;   ///< 是否以主题别名接收消息（别名就是驻留的主题编号）
+    QBitArray announcedTopics;  ///< 已经通知过客户端的主题编号
+    bool confirmsEnabled;       ///< 是否向发布者确认收到的消息
+    quint64 publishedCount;     ///< 本连接收到的数据消息数（确认和拒绝都按它编号）
+    quint64 confirmedCount;     ///< 已经确认到的消息数
+    bool pongPending;           ///< 本次读事件中收到了心跳请求，读完后统一回复
+    quint64 pongToken;          ///< 最近一次心跳请求的令牌
+    MetricsShard::ClientCounters* metrics; ///< 本连接的流量计数器，属于所在I/O线程的指标
 };
 
 /**
  * @brief Broker类，负责管理连接和消息路由
+ *
+ * 监听套接字在 Broker 所在线程接受连接，连接按分配策略交给 I/O 线程池中的
+ * BrokerWorker，之后该连接的读、解码、路由和写都在所属 I/O 线程完成。
+ * 跨线程投递通过每个 I/O 线程的无锁队列完成，Broker 本身只保存订阅表和缓存。
  */
 class Broker : public QObject
 {
     Q_OBJECT
 
 public:
+    /**
+     * @brief 连接分配策略
+     */
+    enum DispatchPolicy {
+        RoundRobin,         ///< 轮询分配
+        LeastConnections    ///< 分配给连接数最少的I/O线程
+    };
+
+    /**
+     * @brief TCP连接的I/O后端
+     *
+     * 两种后端共用同一套帧解析、路由、缓存和发送队列，只是读写套接字的方式不同。
+     * 本地套接字总是使用 Qt 后端。
+     */
+    enum IoBackend {
+        QtBackend,          ///< QTcpSocket，每个连接一个套接字对象和一组信号
+        EpollBackend        ///< 每个I/O线程一个 epoll 实例，直接读写描述符（仅 Linux）
+    };
+
     /**
      * @brief 获取Broker单例实例
      * @return Broker实例
@@ -49,9 +129,11 @@ public:
      * @brief 启动Broker
      * @param tcpPort TCP端口
      * @param localServerName 本地服务器名称
+     * @param backend TCP连接的I/O后端，平台不支持 epoll 时退回 Qt 后端
      * @return 是否启动成功
      */
-    bool start(int tcpPort = 5555, const QString& localServerName = "MyMQLocalServer");
+    bool start(int tcpPort = 5555, const QString& localServerName = "MyMQLocalServer",
+               IoBackend backend = QtBackend);
 
     /**
      * @brief 停止Broker
@@ -64,6 +146,104 @@ public:
      */
     bool isRunning() const;
 
+    /**
+     * @brief 获取当前使用的I/O后端
+     * @return I/O后端
+     */
+    IoBackend ioBackend() const;
+
+    /**
+     * @brief 设置I/O线程数量，在下一次 start() 时生效
+     * @param count 线程数量（至少为1）
+     */
+    void setIoThreadCount(int count);
+
+    /**
+     * @brief 获取I/O线程数量
+     * @return 线程数量
+     */
+    int ioThreadCount() const;
+
+    /**
+     * @brief 设置连接分配策略
+     * @param policy 分配策略
+     */
+    void setDispatchPolicy(DispatchPolicy policy);
+
+    /**
+     * @brief 获取连接分配策略
+     * @return 分配策略
+     */
+    DispatchPolicy dispatchPolicy() const;
+
+    /**
+     * @brief 设置每个订阅者连接的发送队列上限，对之后建立的连接生效
+     * @param maxMessages 最大消息数
+     * @param maxBytes 最大字节数
+     */
+    void setOutboundQueueLimits(int maxMessages, qint64 maxBytes);
+
+    /**
+     * @brief 获取发送队列的最大消息数
+     * @return 最大消息数
+     */
+    int outboundQueueMaxMessages() const;
+
+    /**
+     * @brief 获取发送队列的最大字节数
+     * @return 最大字节数
+     */
+    qint64 outboundQueueMaxBytes() const;
+
+    /**
+     * @brief 设置默认的空闲超时，对之后建立的连接生效
+     *
+     * 超过这么久没有收到客户端的任何数据就断开连接，精度为1秒。
+     * 客户端可以用 $SYS/IDLETIMEOUT 为自己的连接设置不同的超时；用 $SYS/KEEPALIVE 协商了
+     * 心跳间隔的连接使用 1.5 倍的心跳间隔作为超时。
+     * @param seconds 超时（秒），0 表示不因空闲断开
+     */
+    void setIdleTimeout(int seconds);
+
+    /**
+     * @brief 获取默认的空闲超时
+     * @return 超时（秒），0 表示不因空闲断开
+     */
+    int idleTimeout() const;
+
+    /**
+     * @brief 设置最多驻留的主题数
+     *
+     * 主题编号不会回收，达到上限之后发布到新主题的消息被拒绝（开启确认时收到 $SYS/NACK），
+     * 已有主题不受影响。
+     * @param maxTopics 最大主题数，0 表示不限制
+     */
+    void setMaxTopics(int maxTopics);
+
+    /**
+     * @brief 获取最多驻留的主题数
+     * @return 最大主题数，0 表示不限制
+     */
+    int maxTopics() const;
+
+    /**
+     * @brief 设置订阅未指定溢出策略时使用的默认策略
+     * @param policy 溢出策略，不能是 DefaultPolicy
+     */
+    void setDefaultOverflowPolicy(SubscriptionOptions::OverflowPolicy policy);
+
+    /**
+     * @brief 获取默认溢出策略
+     * @return 溢出策略
+     */
+    SubscriptionOptions::OverflowPolicy defaultOverflowPolicy() const;
+
+    /**
+     * @brief 获取所有连接的发送队列统计（线程安全）
+     * @return 统计数据
+     */
+    OutboundQueueStats outboundQueueStats() const;
+
     /**
      * @brief 获取连接的客户端数量
      * @return 客户端数量
@@ -71,11 +251,34 @@ public:
     int clientCount() const;
 
     /**
-     * @brief 获取主题数量
-     * @return 主题数量
+     * @brief 获取订阅模式数量（具体主题和通配符模式）
+     * @return 订阅模式数量
      */
     int topicCount() const;
 
+    /**
+     * @brief 获取指标快照（线程安全）
+     *
+     * 各I/O线程的计数器只由本线程写入，快照直接读取，不会暂停路由。
+     * @return 统计数据，Broker未运行时计数器都为0
+     */
+    BrokerStats stats() const;
+
+    /**
+     * @brief 设置发布统计的周期
+     *
+     * 每个周期把快照编码为 JSON 发布到 $SYS/STATS/broker、$SYS/STATS/topics 和 $SYS/STATS/clients，
+     * 只发给在线的订阅者，不写入缓存或持久化日志。没有订阅者的主题不编码。
+     * @param msec 周期（毫秒），0 表示不发布
+     */
+    void setStatsInterval(int msec);
+
+    /**
+     * @brief 获取发布统计的周期
+     * @return 周期（毫秒），0 表示不发布
+     */
+    int statsInterval() const;
+
     /**
      * @brief 获取消息缓存大小
      * @return 缓存大小
@@ -89,10 +292,37 @@ public:
     void setCacheSize(int size);
 
     /**
-     * @brief 清除消息缓存
+     * @brief 清除内存中的消息缓存（不影响持久化日志）
      */
     void clearCache();
 
+    /**
+     * @brief 启用持久化：发布的消息帧追加到分段日志，新订阅者的历史消息从日志读取
+     *
+     * 必须在 start() 之前调用。启用后不再使用内存缓存，getCacheSize() 仍决定回放的条数。
+     * @param directory 日志目录，已有的日志会被恢复
+     * @param options 日志选项（分段大小、保留上限、落盘策略）
+     * @return 是否启用成功
+     */
+    bool enablePersistence(const QString& directory, const MessageLog::Options& options = MessageLog::Options());
+
+    /**
+     * @brief 关闭持久化，日志落盘后关闭（必须在Broker停止时调用）
+     */
+    void disablePersistence();
+
+    /**
+     * @brief 获取持久化日志
+     * @return 日志，未启用持久化时返回 nullptr
+     */
+    MessageLog* messageLog() const;
+
+    /**
+     * @brief 获取主题驻留表（线程安全）
+     * @return 主题驻留表
+     */
+    TopicRegistry* topicRegistry();
+
     /**
      * @brief 强制释放所有资源，用于测试
      */
@@ -100,142 +330,220 @@ public:
 
 signals:
     /**
-     * @brief 新客户端连接信号
+     * @brief 新客户端连接信号（从I/O线程发出）
      * @param clientId 客户端ID
      */
     void clientConnected(const QString& clientId);
 
     /**
-     * @brief 客户端断开连接信号
+     * @brief 客户端断开连接信号（从I/O线程发出）
      * @param clientId 客户端ID
      */
     void clientDisconnected(const QString& clientId);
 
     /**
-     * @brief 收到新消息信号
+     * @brief 收到新消息信号（从I/O线程发出）
      * @param message 消息
      */
     void messageReceived(const Message& message);
 
     /**
-     * @brief 消息发布信号
+     * @brief 消息发布信号（从I/O线程发出）
      * @param message 消息
      */
     void messagePublished(const Message& message);
 
-private slots:
-    /**
-     * @brief 处理新的TCP连接
-     */
-    void handleNewTcpConnection();
+private:
+    friend class BrokerWorker;
+
+    class TcpServer;
+    class LocalServer;
 
     /**
-     * @brief 处理新的本地连接
+     * @brief 构造函数（私有）
      */
-    void handleNewLocalConnection();
+    explicit Broker(QObject* parent = nullptr);
 
     /**
-     * @brief 处理TCP套接字读取就绪
+     * @brief 析构函数（私有）
      */
-    void handleTcpReadyRead();
+    ~Broker();
 
     /**
-     * @brief 处理本地套接字读取就绪
+     * @brief 将新连接分配给I/O线程
+     * @param socketDescriptor 套接字描述符
+     * @param isLocal 是否为本地套接字
      */
-    void handleLocalReadyRead();
+    void dispatchConnection(qintptr socketDescriptor, bool isLocal);
 
     /**
-     * @brief 处理TCP套接字断开连接
+     * @brief 按主题路由消息帧：写入缓存并投递给所有订阅者（可在任意I/O线程调用）
+     *
+     * 使用主题别名的帧在写入序号时展开为完整主题，缓存、日志和投递的都是展开后的帧。
+     * 投递入队在分配序号的主题锁内完成，每个订阅者收到的同一主题的帧按序号递增；
+     * 本线程订阅者的写出在释放锁之后进行。
+     * @param origin 收到该帧的I/O线程
+     * @param topicId 驻留的主题编号
+     * @param topic 消息主题
+     * @param frame 发布者发送的原始消息帧（可能是接收缓冲区的视图）
+     * @param receivedAt 读到该帧的时间（MetricsShard::now()），用于统计停留时间
+     * @return 是否已经保存；写入日志失败时仍然投递给在线订阅者，但返回 false
      */
-    void handleTcpDisconnected();
+    bool routeFrame(BrokerWorker* origin, TopicId topicId, const QString& topic, const QByteArray& frame,
+                    qint64 receivedAt);
 
     /**
-     * @brief 处理本地套接字断开连接
+     * @brief 把消息帧放入订阅者所在I/O线程的无锁投递队列（只能在 origin 线程调用）
+     *
+     * 其他线程的投递会唤醒该线程；本线程的投递只入队，调用方随后调用 origin->deliverQueued() 写出，
+     * 这样写套接字不必在主题锁内进行。
+     * @param origin 当前I/O线程
+     * @param topicId 驻留的主题编号
+     * @param topic 消息主题
+     * @param frame 消息帧（独立拥有的数据）
+     * @param subscribers 订阅者
+     * @param receivedAt 读到该帧的时间
+     * @return 本线程是否有订阅者，需要调用方取出投递队列
      */
-    void handleLocalDisconnected();
+    bool dispatchFrame(BrokerWorker* origin, TopicId topicId, const QString& topic, const QByteArray& frame,
+                       const WorkerSubscribers& subscribers, qint64 receivedAt);
 
     /**
-     * @brief 检查客户端活动状态
+     * @brief 定时器触发：交给第一个I/O线程发布一次统计
      */
-    void checkClientActivity();
+    void publishStats();
 
-private:
     /**
-     * @brief 构造函数（私有）
+     * @brief 在订阅前缀树中匹配具体主题的订阅者（可在任意I/O线程调用）
+     *
+     * 只有一个模式匹配时复制只增加引用计数，多个模式匹配时合并去重，保证每个客户端只出现一次。
+     * @param topic 具体主题
+     * @return 订阅者
      */
-    explicit Broker(QObject* parent = nullptr);
+    WorkerSubscribers matchSubscribers(const QString& topic) const;
 
     /**
-     * @brief 析构函数（私有）
+     * @brief 获取订阅表的版本号，每次增删订阅加一，I/O线程据此判断路由缓存是否过期
+     * @return 版本号（从1开始）
      */
-    ~Broker();
+    quint64 routingGeneration() const;
 
     /**
-     * @brief 处理收到的消息
-     * @param clientId 客户端ID
-     * @param message 消息
+     * @brief 添加订阅（调用者持有相关主题的主题锁，见 subscribe()）
+     * @param topic 主题或通配符模式
+     * @param handle 客户端句柄
+     * @param worker 客户端所属的I/O线程
      */
-    void processMessage(const QString& clientId, const Message& message);
+    void addSubscriber(const QString& topic, ClientHandle handle, BrokerWorker* worker);
 
     /**
-     * @brief 发布消息到订阅者
-     * @param message 消息
+     * @brief 读完回放剩下的消息帧并登记订阅（可在任意I/O线程调用）
+     *
+     * 订阅者先在锁外按页追赶历史消息（见 readReplay()），接近末尾时调用本方法。
+     * 读取和登记在相关主题的主题锁内完成（通配符锁住所有分组），回放的最后一条帧之后的消息
+     * 都会实时投递给该订阅者，两者之间没有缺口也没有重复。回放的帧在锁外发送：
+     * 其他线程之后投递的帧经过本线程的投递队列，总在回放的帧之后写出。
+     * @param topic 主题或通配符模式
+     * @param handle 客户端句柄
+     * @param worker 客户端所属的I/O线程
+     * @param options 订阅选项
+     * @param positions 追赶到的位置，追赶期间新出现的匹配主题按订阅选项确定起点
+     * @return 剩下的消息帧
      */
-    void publishMessage(const Message& message);
+    QList<QByteArray> subscribe(const QString& topic, ClientHandle handle, BrokerWorker* worker,
+                                const SubscriptionOptions& options, const QHash<QString, qint64>& positions);
 
     /**
-     * @brief 缓存消息
-     * @param message 消息
+     * @brief 移除订阅（可在任意I/O线程调用）
+     * @param topic 主题或通配符模式
+     * @param handle 客户端句柄
+     * @param worker 客户端所属的I/O线程
      */
-    void cacheMessage(const Message& message);
+    void removeSubscriber(const QString& topic, ClientHandle handle, BrokerWorker* worker);
 
     /**
-     * @brief 发送消息到客户端
-     * @param clientId 客户端ID
-     * @param message 消息
-     * @return 是否发送成功
+     * @brief 计算新订阅在每个匹配主题上的回放起点（可在任意I/O线程调用）
+     *
+     * 按订阅选项的起始位置（或续传位置）确定，起始序号超过主题末尾时（Broker重启后序号重新开始）
+     * 从最早保留的消息开始。请求的起点总是被遵守，回放的消息数没有上限，
+     * 只有内存缓存已经挤出的消息无法回放。
+     * @param topic 主题或通配符模式
+     * @param options 订阅选项
+     * @param locked 调用者是否已经持有相关主题的主题锁
+     * @return 每个具体主题的起始序号，不回放时为空
      */
-    bool sendMessageToClient(const QString& clientId, const Message& message);
+    QHash<QString, qint64> replayPositions(const QString& topic, const SubscriptionOptions& options,
+                                           bool locked) const;
 
     /**
-     * @brief 注册客户端
-     * @param socket 套接字
-     * @param isLocal 是否为本地套接字
-     * @return 客户端ID
+     * @brief 从内存缓存或持久化日志中读取一页回放的消息帧（可在任意I/O线程调用）
+     *
+     * 读出的帧都带有主题序号，同一主题内按序号排列。持久化日志的读取不需要主题锁，
+     * 追赶阶段不会阻塞发布。
+     * @param positions 每个具体主题下一条要读取的序号，读取后前进
+     * @param maxCount 最多读取的消息数，-1 表示读到末尾
+     * @param locked 调用者是否已经持有相关主题的主题锁
+     * @param caughtUp 输出是否已经读到所有主题的末尾（可以为空）
+     * @return 消息帧
      */
-    QString registerClient(QObject* socket, bool isLocal);
+    QList<QByteArray> readReplay(QHash<QString, qint64>* positions, int maxCount, bool locked,
+                                 bool* caughtUp) const;
 
     /**
-     * @brief 注销客户端
-     * @param clientId 客户端ID
+     * @brief 计算一个具体主题的回放起始序号
+     * @param topic 具体主题
+     * @param options 订阅选项
+     * @param firstOffset 最早保留的序号
+     * @param nextOffset 下一条消息的序号
+     * @param timeOffset 按时间查找起始序号的函数
+     * @return 起始序号，不需要回放时返回 nextOffset
      */
-    void unregisterClient(const QString& clientId);
+    qint64 replayStart(const QString& topic, const SubscriptionOptions& options, qint64 firstOffset,
+                       qint64 nextOffset, const std::function<qint64(qint64)>& timeOffset) const;
 
     /**
-     * @brief 处理订阅请求
-     * @param clientId 客户端ID
-     * @param topic 主题
+     * @brief 单个主题的内存缓存
      */
-    void handleSubscription(const QString& clientId, const QString& topic);
+    struct TopicCache {
+        QString topic;              ///< 主题
+        QQueue<QByteArray> frames;  ///< 最新的消息帧（已写入序号）
+        qint64 nextSequence = 0;    ///< 下一条消息的序号
+    };
 
     /**
-     * @brief 处理取消订阅请求
-     * @param clientId 客户端ID
-     * @param topic 主题
+     * @brief 一组主题的序号锁和内存缓存，主题按编号分组
+     *
+     * 锁从分配序号持有到投递入队，不同组的主题互不阻塞。按缓存行对齐，相邻的组不共享缓存行。
      */
-    void handleUnsubscription(const QString& clientId, const QString& topic);
+    struct alignas(64) TopicStripe {
+        QMutex lock;                        ///< 主题锁
+        QHash<TopicId, TopicCache> caches;  ///< 本组主题的消息缓存和主题序号（未启用持久化时）
+    };
+
+    static const int kTopicStripeCount = 64;        ///< 主题分组的数量
 
 private:
     static Broker* m_instance;                      ///< 单例实例
     QTcpServer* m_tcpServer;                        ///< TCP服务器
     QLocalServer* m_localServer;                    ///< 本地服务器
-    QMap<QString, ClientInfo> m_clients;            ///< 客户端信息映射
-    QMap<QString, QSet<QString>> m_topicSubscribers; ///< 主题订阅者映射
-    QMap<QString, QQueue<Message>> m_messageCache;  ///< 消息缓存
-    QMutex* m_clientsMutex;                          ///< 客户端互斥锁
-    QMutex* m_cacheMutex;                            ///< 缓存互斥锁
-    QTimer* m_activityTimer;                        ///< 活动检查定时器
-    int m_cacheSize;                                ///< 缓存大小
+    QVector<BrokerWorker*> m_workers;               ///< I/O线程上的工作对象
+    QVector<QThread*> m_workerThreads;              ///< I/O线程
+    int m_ioThreadCount;                            ///< I/O线程数量
+    DispatchPolicy m_dispatchPolicy;                ///< 连接分配策略
+    IoBackend m_ioBackend;                          ///< TCP连接的I/O后端
+    int m_nextWorker;                               ///< 轮询分配的下一个I/O线程
+    TopicTrie<WorkerSubscribers> m_topicSubscribers; ///< 订阅模式前缀树（订阅者句柄按所属I/O线程分组）
+    QAtomicInteger<quint64> m_routingGeneration;    ///< 订阅表版本号
+    TopicRegistry m_topicRegistry;                  ///< 主题驻留表
+    QReadWriteLock* m_routingLock;                  ///< 订阅表读写锁，路由时只加读锁
+    mutable TopicStripe m_topicStripes[kTopicStripeCount]; ///< 按主题编号分组的主题锁、消息缓存和主题序号
+    MessageLog* m_messageLog;                       ///< 持久化日志，未启用时为 nullptr
+    QAtomicInteger<int> m_cacheSize;                ///< 缓存大小
+    QAtomicInteger<int> m_outboundMaxMessages;      ///< 发送队列最大消息数
+    QAtomicInteger<qint64> m_outboundMaxBytes;      ///< 发送队列最大字节数
+    QAtomicInteger<int> m_idleTimeout;              ///< 默认空闲超时（秒）
+    QAtomicInteger<int> m_defaultOverflowPolicy;    ///< 默认溢出策略
+    QTimer* m_statsTimer;                           ///< 发布统计的定时器
     bool m_running;                                 ///< 是否正在运行
 };
 
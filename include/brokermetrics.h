@@ -0,0 +1,331 @@
+#ifndef BROKERMETRICS_H
+#define BROKERMETRICS_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+
+#include "clienttable.h"
+#include "outboundqueue.h"
+#include "topicregistry.h"
+
+/**
+ * @brief 对数分桶的延迟直方图（HDR 风格）
+ *
+ * 0 到 31 每个值一个桶，之后每个2的幂区间分为16个等宽的桶，任何值的相对误差不超过 1/16。
+ * 桶的数量固定，记录是 O(1) 的，两个直方图可以直接按桶相加。
+ * 超过 kMaxValue 的值记入最后一个桶。单位由调用方决定，Broker使用纳秒。
+ */
+class LatencyHistogram
+{
+public:
+    static const int kLinearBuckets = 32;                   ///< 线性区间的桶数
+    static const int kSubBuckets = 16;                      ///< 之后每个2的幂区间的桶数
+    static const int kMaxShift = 31;                        ///< 最大的桶宽为 2^kMaxShift
+    static const int kBucketCount = kLinearBuckets + kMaxShift * kSubBuckets; ///< 桶数
+    static const quint64 kMaxValue = (quint64(1) << (kMaxShift + 5)) - 1;    ///< 可以区分的最大值（约68.7秒）
+
+    /**
+     * @brief 构造函数
+     */
+    LatencyHistogram();
+
+    /**
+     * @brief 记录一个值
+     * @param value 值
+     * @param count 记录的次数
+     */
+    void record(quint64 value, quint64 count = 1);
+
+    /**
+     * @brief 合并另一个直方图
+     * @param other 直方图
+     */
+    void add(const LatencyHistogram& other);
+
+    /**
+     * @brief 获取记录的次数
+     * @return 次数
+     */
+    quint64 count() const;
+
+    /**
+     * @brief 获取最小值
+     * @return 最小值，没有记录时返回 0
+     */
+    quint64 min() const;
+
+    /**
+     * @brief 获取最大值
+     * @return 最大值
+     */
+    quint64 max() const;
+
+    /**
+     * @brief 获取平均值
+     * @return 平均值，没有记录时返回 0
+     */
+    double mean() const;
+
+    /**
+     * @brief 获取百分位数
+     * @param percentile 百分位（0 到 100）
+     * @return 该百分位所在桶的上界，不超过最大值；没有记录时返回 0
+     */
+    quint64 percentile(double percentile) const;
+
+    /**
+     * @brief 获取一个桶的次数
+     * @param index 桶下标
+     * @return 次数
+     */
+    quint64 bucketCount(int index) const;
+
+    /**
+     * @brief 计算值所在的桶
+     * @param value 值
+     * @return 桶下标
+     */
+    static int bucketIndex(quint64 value);
+
+    /**
+     * @brief 获取桶的下界（包含）
+     * @param index 桶下标
+     * @return 下界
+     */
+    static quint64 bucketLowerBound(int index);
+
+    /**
+     * @brief 获取桶的上界（包含）
+     * @param index 桶下标
+     * @return 上界
+     */
+    static quint64 bucketUpperBound(int index);
+
+private:
+    QVector<quint64> m_buckets;     ///< 每个桶的次数
+    quint64 m_count;                ///< 记录的次数
+    quint64 m_min;                  ///< 最小值
+    quint64 m_max;                  ///< 最大值
+    double m_sum;                   ///< 所有值的和
+};
+
+/**
+ * @brief 收发流量统计
+ */
+struct TrafficStats {
+    quint64 messagesIn = 0;     ///< 收到的消息数
+    quint64 bytesIn = 0;        ///< 收到的字节数
+    quint64 messagesOut = 0;    ///< 发出的消息数（每个订阅者算一次）
+    quint64 bytesOut = 0;       ///< 发出的字节数
+};
+
+/**
+ * @brief 单个客户端的统计
+ */
+struct ClientStats : TrafficStats {
+    quint64 queuedMessages = 0; ///< 发送队列中等待发送的消息数
+};
+
+/**
+ * @brief Broker统计快照
+ *
+ * 各计数器从Broker启动开始累计，停止后清零。发出的消息只统计实时投递，不含订阅时回放的历史消息。
+ */
+struct BrokerStats {
+    qint64 timestamp = 0;               ///< 快照时间（毫秒，Unix 时间）
+    int clientCount = 0;                ///< 连接的客户端数量
+    TrafficStats total;                 ///< 所有主题的收发流量
+    quint64 matchedSubscribers = 0;     ///< 路由时匹配到的订阅者总数（扇出）
+    quint64 routeCacheHits = 0;         ///< 路由缓存命中次数
+    quint64 routeCacheMisses = 0;       ///< 路由缓存未命中（重新匹配前缀树）次数
+    OutboundQueueStats outbound;        ///< 发送队列深度、丢弃和断开
+    LatencyHistogram residence;         ///< 消息在Broker中的停留时间（纳秒）：从读到消息到写给本线程的订阅者
+    QMap<QString, TrafficStats> topics; ///< 按主题的流量
+    QMap<QString, ClientStats> clients; ///< 按客户端ID的流量
+
+    /**
+     * @brief 编码汇总统计，发布到 $SYS/STATS/broker
+     * @return JSON
+     */
+    QByteArray brokerJson() const;
+
+    /**
+     * @brief 编码按主题的统计，发布到 $SYS/STATS/topics
+     * @return JSON
+     */
+    QByteArray topicsJson() const;
+
+    /**
+     * @brief 编码按客户端的统计，发布到 $SYS/STATS/clients
+     * @return JSON
+     */
+    QByteArray clientsJson() const;
+};
+
+/**
+ * @brief 一个I/O线程的指标
+ *
+ * 只有所属的I/O线程写入，计数器是单写者的原子变量：增加时用一次宽松的读和写，
+ * 不需要原子读改写，也不会在线程之间争用缓存行。其他线程随时可以读取计数器。
+ * 主题和客户端的计数器在第一次使用时创建，创建和删除时才加锁，
+ * 所属线程查找时不加锁，其他线程收集快照时加锁。
+ */
+class MetricsShard
+{
+public:
+    /**
+     * @brief 单写者计数器
+     */
+    class Counter
+    {
+    public:
+        Counter() : m_value(0) {}
+
+        void add(quint64 n)
+        {
+            m_value.store(m_value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        void set(quint64 value)
+        {
+            m_value.store(value, std::memory_order_relaxed);
+        }
+
+        quint64 value() const
+        {
+            return m_value.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<quint64> m_value;
+    };
+
+    /**
+     * @brief 一个主题或客户端的流量计数器
+     */
+    struct TrafficCounters {
+        Counter messagesIn;     ///< 收到的消息数
+        Counter bytesIn;        ///< 收到的字节数
+        Counter messagesOut;    ///< 发出的消息数
+        Counter bytesOut;       ///< 发出的字节数
+    };
+
+    /**
+     * @brief 一个客户端的计数器
+     */
+    struct ClientCounters : TrafficCounters {
+        QString id;             ///< 客户端ID，创建后不再修改
+        Counter queuedMessages; ///< 发送队列中的消息数
+    };
+
+    /**
+     * @brief 构造函数
+     */
+    MetricsShard();
+
+    /**
+     * @brief 析构函数
+     */
+    ~MetricsShard();
+
+    /**
+     * @brief 获取单调时钟的当前时间，用于计算停留时间
+     * @return 纳秒
+     */
+    static qint64 now();
+
+    /**
+     * @brief 获取主题的计数器，第一次使用时创建（只能在所属线程调用）
+     * @param topicId 驻留的主题编号
+     * @return 计数器，编号无效时返回 nullptr
+     */
+    TrafficCounters* topic(TopicId topicId)
+    {
+        if (topicId < quint32(m_topics.size())) {
+            TrafficCounters* counters = m_topics.at(int(topicId));
+            if (counters) {
+                return counters;
+            }
+        }
+        return createTopic(topicId);
+    }
+
+    /**
+     * @brief 创建客户端的计数器（只能在所属线程调用）
+     * @param handle 客户端句柄
+     * @param id 客户端ID
+     * @return 计数器，随 removeClient() 释放
+     */
+    ClientCounters* addClient(ClientHandle handle, const QString& id);
+
+    /**
+     * @brief 释放客户端的计数器（只能在所属线程调用）
+     * @param handle 客户端句柄
+     */
+    void removeClient(ClientHandle handle);
+
+    /**
+     * @brief 记录一次路由匹配到的订阅者数（只能在所属线程调用）
+     * @param subscribers 订阅者数
+     */
+    void recordRoute(int subscribers)
+    {
+        m_matchedSubscribers.add(quint64(subscribers));
+    }
+
+    /**
+     * @brief 记录一次路由缓存查找（只能在所属线程调用）
+     * @param hit 是否命中
+     */
+    void recordRouteCache(bool hit)
+    {
+        if (hit) {
+            m_routeCacheHits.add(1);
+        } else {
+            m_routeCacheMisses.add(1);
+        }
+    }
+
+    /**
+     * @brief 记录一条消息的停留时间（只能在所属线程调用）
+     * @param nanoseconds 纳秒
+     */
+    void recordResidence(qint64 nanoseconds)
+    {
+        m_residence[LatencyHistogram::bucketIndex(quint64(qMax<qint64>(nanoseconds, 0)))].add(1);
+    }
+
+    /**
+     * @brief 把本线程的指标累加到快照中（线程安全）
+     * @param stats 快照，主题按编号累加
+     * @param topics 按主题编号的流量
+     */
+    void collect(BrokerStats* stats, QHash<TopicId, TrafficStats>* topics) const;
+
+private:
+    /**
+     * @brief 创建主题的计数器
+     * @param topicId 驻留的主题编号
+     * @return 计数器
+     */
+    TrafficCounters* createTopic(TopicId topicId);
+
+    MetricsShard(const MetricsShard&) = delete;
+    MetricsShard& operator=(const MetricsShard&) = delete;
+
+    mutable QMutex m_mutex;                         ///< 保护主题和客户端表的结构，不保护计数器
+    QVector<TrafficCounters*> m_topics;             ///< 按主题编号索引的计数器
+    QHash<ClientHandle, ClientCounters*> m_clients; ///< 客户端的计数器
+    Counter m_matchedSubscribers;                   ///< 路由时匹配到的订阅者总数
+    Counter m_routeCacheHits;                       ///< 路由缓存命中次数
+    Counter m_routeCacheMisses;                     ///< 路由缓存未命中次数
+    Counter m_residence[LatencyHistogram::kBucketCount]; ///< 停留时间直方图的各个桶
+};
+
+#endif // BROKERMETRICS_H
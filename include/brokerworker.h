@@ -0,0 +1,453 @@
+#ifndef BROKERWORKER_H
+#define BROKERWORKER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QTimer>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+
+#include <atomic>
+
+#include "broker.h"
+#include "mpscqueue.h"
+#include "timerwheel.h"
+
+class EpollPoller;
+class QSocketNotifier;
+
+/**
+ * @brief Broker的I/O工作对象，每个I/O线程一个
+ *
+ * 分配给该线程的连接只在该线程上读写，ClientInfo 不需要加锁。
+ * 连接保存在按整数句柄索引的 ClientTable 中，套接字的信号直接携带句柄，
+ * 每次读写都是 O(1) 查找，与连接数无关。
+ * 其他线程的投递请求通过无锁队列传入，由本线程在事件循环中取出并写出。
+ * 每个主题的订阅者按驻留的主题编号缓存在本线程中，订阅表变化后才重新匹配前缀树。
+ *
+ * 每个I/O线程有自己的指标（MetricsShard），计数器只由本线程写入，快照随时可以读取。
+ *
+ * 空闲超时登记在本线程的时间轮中，以每秒推进一次的粗粒度节拍计时。收到数据时只把当前节拍
+ * 写入 ClientInfo，不读时钟也不改动时间轮；条目到期时再比较最后活动的节拍，期间有过活动的
+ * 按新的截止节拍重新登记，其余的断开。每秒的工作量与到期的条目数成正比，与连接数无关。
+ *
+ * 使用 epoll 后端时，本线程的TCP连接不创建 QTcpSocket：所有描述符注册到本线程的
+ * epoll 实例，事件循环只监视 epoll 描述符。就绪事件逐个按句柄处理，数据读入本线程
+ * 复用的接收缓冲区后直接交给帧处理器；写出的数据在一批事件处理完后统一发送。
+ */
+class BrokerWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief 跨线程投递请求：一个消息帧和本线程上需要接收它的客户端
+     */
+    struct Delivery {
+        TopicId topicId;            ///< 驻留的主题编号
+        QString topic;              ///< 消息主题
+        QByteArray frame;           ///< 消息帧（独立拥有的数据，不是视图）
+        QSet<ClientHandle> clients; ///< 接收该帧的客户端句柄
+        qint64 receivedAt;          ///< 源I/O线程读到该帧的时间（MetricsShard::now()）
+    };
+
+    /**
+     * @brief 构造函数
+     * @param broker 所属的Broker
+     * @param index I/O线程序号
+     */
+    BrokerWorker(Broker* broker, int index);
+
+    /**
+     * @brief 析构函数
+     */
+    ~BrokerWorker();
+
+    /**
+     * @brief 获取I/O线程序号
+     * @return 序号
+     */
+    int index() const;
+
+    /**
+     * @brief 获取当前连接数量（线程安全）
+     * @return 连接数量
+     */
+    int connectionCount() const;
+
+    /**
+     * @brief 投递消息帧给本线程上的客户端（线程安全，可在任意线程调用）
+     * @param delivery 投递请求
+     */
+    void enqueueDelivery(Delivery delivery);
+
+    /**
+     * @brief 投递消息帧给本线程上的客户端，只入队不唤醒（只能在本线程调用）
+     *
+     * 路由时在主题锁内入队，释放锁之后由调用方调用 deliverQueued() 写出。
+     * @param delivery 投递请求
+     */
+    void enqueueLocalDelivery(Delivery delivery);
+
+    /**
+     * @brief 发送队列中已经放入的投递请求，不写出 epoll 后端的待发送数据（只能在本线程调用）
+     *
+     * 本线程路由的帧也经过投递队列，其他线程先放入的帧不会被后分配序号的帧超过。
+     */
+    void deliverQueued();
+
+    /**
+     * @brief 直接发送消息帧给本线程上的客户端（只能在本线程调用）
+     * @param topicId 驻留的主题编号
+     * @param topic 消息主题
+     * @param frame 消息帧
+     * @param clients 接收该帧的客户端句柄
+     * @param receivedAt 源I/O线程读到该帧的时间，本轮事件处理完后记录停留时间
+     */
+    void deliver(TopicId topicId, const QString& topic, const QByteArray& frame, const QSet<ClientHandle>& clients,
+                 qint64 receivedAt);
+
+    /**
+     * @brief 获取具体主题的订阅者（只能在本线程调用）
+     *
+     * 按主题编号直接索引本线程的路由缓存，订阅表版本号变化后才重新匹配前缀树。
+     * @param topicId 驻留的主题编号
+     * @param topic 具体主题
+     * @return 订阅者
+     */
+    WorkerSubscribers subscribersFor(TopicId topicId, const QString& topic);
+
+    /**
+     * @brief 获取本线程所有连接的发送队列统计（线程安全）
+     * @return 统计数据
+     */
+    OutboundQueueStats outboundQueueStats() const;
+
+    /**
+     * @brief 把本线程的指标累加到快照中（线程安全）
+     * @param stats 快照
+     * @param topics 按主题编号的流量
+     */
+    void collectMetrics(BrokerStats* stats, QHash<TopicId, TrafficStats>* topics) const;
+
+public slots:
+    /**
+     * @brief 线程启动后初始化（启动活动检查定时器，epoll 后端创建 epoll 实例）
+     */
+    void initialize();
+
+    /**
+     * @brief 接管一个已接受的连接
+     * @param socketDescriptor 套接字描述符
+     * @param isLocal 是否为本地套接字
+     */
+    void addConnection(qintptr socketDescriptor, bool isLocal);
+
+    /**
+     * @brief 关闭本线程上的所有连接并停止定时器
+     */
+    void closeAllConnections();
+
+    /**
+     * @brief 取出并发送队列中的所有投递请求
+     */
+    void drainDeliveries();
+
+    /**
+     * @brief 把统计快照发布给 $SYS/STATS/ 主题的订阅者
+     */
+    void publishStats();
+
+private slots:
+    /**
+     * @brief 推进节拍，断开空闲超时的客户端
+     */
+    void checkClientActivity();
+
+    /**
+     * @brief 处理 epoll 实例中的一批就绪事件，然后发送积压的数据
+     */
+    void processNativeEvents();
+
+private:
+    /**
+     * @brief 处理套接字可读
+     * @param handle 客户端句柄
+     */
+    void handleReadyRead(ClientHandle handle);
+
+    /**
+     * @brief 处理套接字写出数据，继续发送排队的消息
+     * @param handle 客户端句柄
+     */
+    void handleBytesWritten(ClientHandle handle);
+
+    /**
+     * @brief 处理套接字断开连接
+     * @param handle 客户端句柄
+     */
+    void handleDisconnected(ClientHandle handle);
+
+    /**
+     * @brief 以 epoll 后端接管TCP连接
+     * @param socketDescriptor 套接字描述符
+     */
+    void addNativeConnection(int socketDescriptor);
+
+    /**
+     * @brief 处理 epoll 后端连接的就绪事件
+     * @param handle 客户端句柄
+     * @param flags EpollPoller::EventFlag 组合
+     */
+    void handleNativeEvent(ClientHandle handle, int flags);
+
+    /**
+     * @brief 发送 epoll 后端连接积压的数据，内核缓冲区满时关注可写
+     * @param client 客户端
+     */
+    void flushNativeSocket(ClientInfo* client);
+
+    /**
+     * @brief 发送本轮写入过数据的所有 epoll 后端连接
+     */
+    void flushNativeSockets();
+
+    /**
+     * @brief 创建客户端信息、分配句柄并创建帧处理器，尚未绑定任何套接字
+     * @return 客户端信息，连接表已满时返回 nullptr
+     */
+    ClientInfo* createClient();
+
+    /**
+     * @brief 注册客户端并把句柄绑定到套接字的信号
+     * @param socket 套接字
+     * @param isLocal 是否为本地套接字
+     * @return 客户端信息，连接表已满时返回 nullptr
+     */
+    ClientInfo* registerClient(QIODevice* socket, bool isLocal);
+
+    /**
+     * @brief 注销客户端
+     * @param handle 客户端句柄
+     */
+    void unregisterClient(ClientHandle handle);
+
+    /**
+     * @brief 处理消息帧（路由模式，帧只在本次调用期间有效）
+     * @param client 发送消息的客户端
+     * @param topic 消息主题
+     * @param frame 完整的消息帧
+     */
+    void processFrame(ClientInfo* client, const QString& topic, const QByteArray& frame);
+
+    /**
+     * @brief 记录客户端发布的一条数据消息并交给Broker路由
+     * @param client 发布者
+     * @param topicId 驻留的主题编号
+     * @param topic 消息主题
+     * @param frame 消息帧
+     * @return 是否已经保存
+     */
+    bool routeClientFrame(ClientInfo* client, TopicId topicId, const QString& topic, const QByteArray& frame);
+
+    /**
+     * @brief 记录本轮事件中投递的消息的停留时间，整批只读一次时钟
+     */
+    void recordResidence();
+
+    /**
+     * @brief 处理控制消息（$SYS/ 主题）
+     * @param client 发送消息的客户端
+     * @param message 解码后的消息
+     * @return 是否为已处理的控制消息
+     */
+    bool processControlMessage(ClientInfo* client, const Message& message);
+
+    /**
+     * @brief 处理客户端登记的主题别名
+     * @param client 客户端
+     * @param payload $SYS/ALIAS 控制消息的负载
+     */
+    void handleTopicAlias(ClientInfo* client, const QByteArray& payload);
+
+    /**
+     * @brief 判断是否以主题别名发送给客户端，第一次使用某个别名前先通知客户端
+     *
+     * 别名就是驻留的主题编号，同一条消息的别名帧可以在本线程的所有订阅者之间共享。
+     * 通知直接写入套接字而不进入发送队列，不会被溢出策略丢弃，且总是先于使用它的消息到达。
+     * @param client 客户端
+     * @param topicId 驻留的主题编号
+     * @param topic 消息主题
+     * @return 是否使用别名
+     */
+    bool useTopicAlias(ClientInfo* client, TopicId topicId, const QString& topic);
+
+    /**
+     * @brief 拒绝发布者的一条消息，开启确认时立即回复 $SYS/NACK
+     * @param client 发布者
+     * @param index 消息在本连接中的编号
+     * @param reason 拒绝原因
+     */
+    void rejectMessage(ClientInfo* client, quint64 index, const QString& reason);
+
+    /**
+     * @brief 向开启确认的发布者回复累计确认 $SYS/ACK
+     *
+     * 每个读事件（无论包含多少条消息或批量帧）最多回复一次，确认消息数
+     * 与发布速率无关，发布者不需要等待确认就能继续发送。
+     * @param handle 客户端句柄
+     */
+    void sendConfirms(ClientHandle handle);
+
+    /**
+     * @brief 处理共享内存通道请求：连接客户端创建的共享内存并回复结果
+     * @param client 客户端
+     * @param key 共享内存的键
+     */
+    void handleSharedMemoryRequest(ClientInfo* client, const QString& key);
+
+    /**
+     * @brief 处理协议协商请求
+     * @param client 客户端
+     * @param clientVersion 客户端支持的最高协议版本
+     */
+    void handleHello(ClientInfo* client, int clientVersion);
+
+    /**
+     * @brief 设置客户端的空闲超时，从最后一次活动开始重新计时
+     * @param client 客户端
+     * @param seconds 超时（秒），0 表示不因空闲断开
+     */
+    void setIdleTimeout(ClientInfo* client, int seconds);
+
+    /**
+     * @brief 处理心跳间隔协商请求，回复Broker接受的间隔
+     *
+     * 心跳帧是 V2 帧，只有协商到 V2 的连接可以启用。客户端在安静了一个间隔后发送心跳，
+     * 连接的空闲超时设为 1.5 倍的间隔。
+     * @param client 客户端
+     * @param seconds 客户端请求的间隔（秒），0 表示关闭心跳并恢复默认的空闲超时
+     */
+    void handleKeepAlive(ClientInfo* client, int seconds);
+
+    /**
+     * @brief 回复本次读事件中收到的心跳请求，多个请求只回复一次
+     * @param handle 客户端句柄
+     */
+    void sendPong(ClientHandle handle);
+
+    /**
+     * @brief 处理订阅请求
+     * @param client 客户端
+     * @param topic 主题或通配符模式
+     * @param options 订阅选项
+     */
+    void handleSubscription(ClientInfo* client, const QString& topic, const SubscriptionOptions& options);
+
+    /**
+     * @brief 处理取消订阅请求
+     * @param client 客户端
+     * @param topic 主题
+     */
+    void handleUnsubscription(ClientInfo* client, const QString& topic);
+
+    /**
+     * @brief 取消客户端对某个模式尚未完成的回放
+     * @param client 客户端
+     * @param topic 主题或通配符模式
+     */
+    void cancelReplay(ClientInfo* client, const QString& topic);
+
+    /**
+     * @brief 在发送队列为空时按页继续回放，追上之后登记订阅
+     *
+     * 回放从订阅请求的起点开始，不设上限；每页在发送队列为空时读取，页的大小不超过发送队列的容量。
+     * 写出进度（bytesWritten 或 epoll 可写）驱动下一页。
+     * @param client 客户端
+     */
+    void continueReplay(ClientInfo* client);
+
+    /**
+     * @brief 按客户端的协议版本和别名设置发送回放的消息帧
+     * @param client 客户端
+     * @param topic 订阅的主题或通配符模式
+     * @param frames 带有主题序号的消息帧
+     */
+    void sendReplayFrames(ClientInfo* client, const QString& topic, const QList<QByteArray>& frames);
+
+    /**
+     * @brief 发送订阅消息帧：写缓冲区未到高水位且没有排队消息时直接写出，否则进入有界发送队列
+     * @param client 客户端
+     * @param topic 消息主题
+     * @param frame 消息帧（可以是视图，排队时会复制）
+     * @return 是否已写出或排队
+     */
+    bool sendFrame(ClientInfo* client, const QString& topic, const QByteArray& frame);
+
+    /**
+     * @brief 在写缓冲区低于高水位时继续写出排队的消息
+     * @param client 客户端
+     */
+    void flushOutbound(ClientInfo* client);
+
+    /**
+     * @brief 获取订阅匹配该主题时使用的溢出策略
+     * @param client 客户端
+     * @param topic 消息主题
+     * @return 溢出策略（不会是 DefaultPolicy）
+     */
+    SubscriptionOptions::OverflowPolicy overflowPolicyFor(const ClientInfo* client, const QString& topic) const;
+
+    /**
+     * @brief 断开发送队列溢出的慢速订阅者（延迟到下一轮事件循环）
+     * @param client 客户端
+     */
+    void disconnectSlowConsumer(ClientInfo* client);
+
+    /**
+     * @brief 将已编码的消息帧写入客户端套接字
+     * @param clientInfo 客户端信息
+     * @param frame 消息帧
+     * @return 是否写入成功
+     */
+    bool writeFrame(const ClientInfo& clientInfo, const QByteArray& frame);
+
+private:
+    /**
+     * @brief 一个主题在本线程缓存的订阅者
+     */
+    struct RouteCacheEntry {
+        quint64 generation = 0;         ///< 计算时的订阅表版本号，0 表示尚未计算
+        WorkerSubscribers subscribers;  ///< 订阅者
+        int subscriberCount = 0;        ///< 订阅者总数
+    };
+
+    Broker* m_broker;                           ///< 所属的Broker
+    int m_index;                                ///< I/O线程序号
+    ClientTable m_clients;                      ///< 本线程上的客户端
+    QHash<TopicId, RouteCacheEntry> m_routeCache; ///< 本线程路由过的主题的路由缓存
+    QTimer* m_activityTimer;                    ///< 每秒推进一次节拍的定时器
+    QElapsedTimer m_clock;                      ///< 节拍的单调时钟
+    quint64 m_currentTick;                      ///< 当前节拍（秒），由 m_activityTimer 更新
+    TimerWheel m_idleTimers;                    ///< 按客户端句柄登记的空闲超时
+    MpscQueue<Delivery> m_deliveries;           ///< 其他线程的投递请求
+    std::atomic<bool> m_drainScheduled;         ///< 是否已安排取出投递请求
+    QAtomicInteger<int> m_connectionCount;      ///< 连接数量
+    QAtomicInteger<qint64> m_queuedMessages;    ///< 发送队列中的消息数
+    QAtomicInteger<qint64> m_queuedBytes;       ///< 发送队列中的字节数
+    QAtomicInteger<qint64> m_droppedMessages;   ///< 丢弃的消息数
+    QAtomicInteger<qint64> m_conflatedMessages; ///< 被覆盖的消息数
+    QAtomicInteger<qint64> m_slowConsumerDisconnects; ///< 断开的慢速订阅者数
+    EpollPoller* m_poller;                      ///< epoll 实例，Qt 后端为 nullptr
+    QSocketNotifier* m_pollerNotifier;          ///< 监视 epoll 描述符的通知器
+    QByteArray m_readBuffer;                    ///< epoll 后端复用的接收缓冲区
+    QVector<ClientHandle> m_dirtySockets;       ///< 本轮写入过数据、等待发送的 epoll 后端连接
+    bool m_nativeFlushScheduled;                ///< 是否已安排发送 m_dirtySockets
+    MetricsShard m_metrics;                     ///< 本线程的指标
+    qint64 m_receivedAt;                        ///< 当前读事件开始的时间
+    QVector<qint64> m_pendingResidence;         ///< 本轮投递的消息的读入时间，等待记录停留时间
+};
+
+#endif // BROKERWORKER_H
@@ -0,0 +1,96 @@
+#ifndef CLIENTTABLE_H
+#define CLIENTTABLE_H
+
+#include <QtGlobal>
+#include <QVector>
+
+struct ClientInfo;
+
+/**
+ * @brief 客户端句柄：低20位是槽位下标，高12位是槽位的代数
+ *
+ * 槽位被释放后代数加一，因此已断开客户端的旧句柄（例如仍在投递队列中的句柄）
+ * 不会误指向复用该槽位的新客户端。句柄0永远无效。
+ */
+typedef quint32 ClientHandle;
+
+/**
+ * @brief 按整数句柄索引的客户端连接表
+ *
+ * 客户端信息指针保存在连续的槽位数组中，释放的槽位进入空闲链表复用，
+ * 插入、查找和删除都是 O(1)，且与连接数无关。连接表不拥有客户端信息，
+ * 只能在所属 I/O 线程中访问。
+ */
+class ClientTable
+{
+public:
+    static const ClientHandle InvalidHandle = 0;    ///< 无效句柄
+    static const int kIndexBits = 20;               ///< 槽位下标的位数
+    static const int kMaxClients = 1 << kIndexBits; ///< 最大连接数
+
+    /**
+     * @brief 构造函数
+     */
+    ClientTable();
+
+    /**
+     * @brief 插入客户端
+     * @param client 客户端信息
+     * @return 客户端句柄，连接表已满时返回 InvalidHandle
+     */
+    ClientHandle insert(ClientInfo* client);
+
+    /**
+     * @brief 按句柄查找客户端
+     * @param handle 客户端句柄
+     * @return 客户端信息，句柄无效或已过期时返回 nullptr
+     */
+    ClientInfo* value(ClientHandle handle) const;
+
+    /**
+     * @brief 移除客户端并释放槽位
+     * @param handle 客户端句柄
+     * @return 被移除的客户端信息，句柄无效或已过期时返回 nullptr
+     */
+    ClientInfo* take(ClientHandle handle);
+
+    /**
+     * @brief 句柄是否指向一个现存的客户端
+     * @param handle 客户端句柄
+     * @return 是否存在
+     */
+    bool contains(ClientHandle handle) const;
+
+    /**
+     * @brief 获取客户端数量
+     * @return 客户端数量
+     */
+    int size() const;
+
+    /**
+     * @brief 是否为空
+     * @return 是否为空
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief 获取所有现存客户端的句柄
+     * @return 句柄列表
+     */
+    QVector<ClientHandle> handles() const;
+
+private:
+    struct Slot {
+        ClientInfo* client;     ///< 客户端信息，空闲槽位为 nullptr
+        quint32 generation;     ///< 槽位代数，从1开始
+    };
+
+    static const quint32 kIndexMask = (1u << kIndexBits) - 1;
+    static const quint32 kGenerationMask = (1u << (32 - kIndexBits)) - 1;
+
+    QVector<Slot> m_slots;          ///< 槽位数组
+    QVector<quint32> m_freeSlots;   ///< 空闲槽位下标
+    int m_size;                     ///< 客户端数量
+};
+
+#endif // CLIENTTABLE_H
@@ -0,0 +1,102 @@
+#ifndef EPOLLPOLLER_H
+#define EPOLLPOLLER_H
+
+#include <QtGlobal>
+
+/**
+ * @brief epoll 实例的薄封装（只在 Linux 上可用）
+ *
+ * Qt 的事件分发器每轮事件循环都要把所有套接字通知器交给 poll()，开销与连接数成正比。
+ * epoll 只返回就绪的描述符，I/O 线程把 epoll 描述符本身交给一个 QSocketNotifier，
+ * 一次通知取出一批就绪事件，开销只与活跃连接数有关。
+ *
+ * 读事件使用水平触发：一次没有读完的连接下一轮还会就绪，不需要读到 EAGAIN 为止，
+ * 单个连接不会独占I/O线程。写事件只在发送缓冲区有积压时关注。
+ */
+class EpollPoller
+{
+public:
+    /**
+     * @brief 就绪事件标志
+     */
+    enum EventFlag {
+        Readable = 0x1,     ///< 可读
+        Writable = 0x2,     ///< 可写
+        Closed = 0x4        ///< 对端关闭或出错
+    };
+
+    /**
+     * @brief 一个就绪事件
+     */
+    struct Event {
+        quint64 token;      ///< 注册时的标识
+        int flags;          ///< EventFlag 组合
+    };
+
+    /**
+     * @brief 当前平台是否支持 epoll
+     * @return 是否支持
+     */
+    static bool isSupported();
+
+    /**
+     * @brief 构造函数，创建 epoll 实例
+     */
+    EpollPoller();
+
+    /**
+     * @brief 析构函数，关闭 epoll 实例（不关闭注册的描述符）
+     */
+    ~EpollPoller();
+
+    /**
+     * @brief epoll 实例是否创建成功
+     * @return 是否有效
+     */
+    bool isValid() const;
+
+    /**
+     * @brief 获取 epoll 描述符，它在有事件就绪时可读
+     * @return 描述符
+     */
+    int descriptor() const;
+
+    /**
+     * @brief 注册描述符，关注可读
+     * @param fd 描述符
+     * @param token 事件中返回的标识
+     * @return 是否成功
+     */
+    bool add(int fd, quint64 token);
+
+    /**
+     * @brief 开启或关闭对可写的关注
+     * @param fd 描述符
+     * @param token 事件中返回的标识
+     * @param enabled 是否关注可写
+     * @return 是否成功
+     */
+    bool setWriteInterest(int fd, quint64 token, bool enabled);
+
+    /**
+     * @brief 注销描述符，必须在关闭描述符之前调用
+     * @param fd 描述符
+     */
+    void remove(int fd);
+
+    /**
+     * @brief 取出就绪事件，不阻塞
+     * @param events 输出数组
+     * @param maxEvents 数组容量
+     * @return 取出的事件数
+     */
+    int poll(Event* events, int maxEvents);
+
+private:
+    EpollPoller(const EpollPoller&) = delete;
+    EpollPoller& operator=(const EpollPoller&) = delete;
+
+    int m_epollFd;      ///< epoll 描述符，无效时为 -1
+};
+
+#endif // EPOLLPOLLER_H
@@ -0,0 +1,111 @@
+#ifndef KEEPALIVEMONITOR_H
+#define KEEPALIVEMONITOR_H
+
+#include <QObject>
+#include <QTimer>
+
+#include <functional>
+
+#include "message.h"
+
+/**
+ * @brief 客户端的心跳协商和检测，由 Publisher 和 Subscriber 共用
+ *
+ * 连接建立后客户端发送 requestMessage()，Broker回复的间隔交给 handleReply()。
+ * 之后每半个间隔检查一次：上次检查之后写出过数据时不需要心跳，否则通过写出函数发送 PING；
+ * 心跳发出后一个间隔内没有收到Broker的任何数据，发出 timeout 信号，持有方应断开连接。
+ * 持有方在写出数据时调用 notifySent()，收到数据时调用 notifyReceived()。
+ */
+class KeepAliveMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief 写出心跳帧的函数，返回是否写出成功
+     */
+    typedef std::function<bool(const QByteArray&)> FrameWriter;
+
+    /**
+     * @brief 构造函数
+     * @param writer 写出心跳帧的函数
+     * @param parent 父对象
+     */
+    explicit KeepAliveMonitor(const FrameWriter& writer, QObject* parent = nullptr);
+
+    /**
+     * @brief 设置请求的心跳间隔，下次协商时生效
+     * @param seconds 心跳间隔（秒），0 表示不使用心跳
+     */
+    void setKeepAlive(int seconds);
+
+    /**
+     * @brief 获取请求的心跳间隔
+     * @return 心跳间隔（秒）
+     */
+    int keepAlive() const;
+
+    /**
+     * @brief 获取Broker接受的心跳间隔
+     * @return 心跳间隔（秒），0 表示未使用心跳
+     */
+    int negotiatedKeepAlive() const;
+
+    /**
+     * @brief 构造心跳协商请求
+     * @return $SYS/KEEPALIVE 消息
+     */
+    Message requestMessage() const;
+
+    /**
+     * @brief 处理Broker接受的心跳间隔，间隔大于0时开始检查
+     * @param seconds 心跳间隔（秒），0 表示不使用心跳
+     */
+    void handleReply(int seconds);
+
+    /**
+     * @brief 写出了数据，本轮检查不需要发送心跳
+     */
+    void notifySent();
+
+    /**
+     * @brief 收到了Broker的数据，连接仍然有效
+     */
+    void notifyReceived();
+
+    /**
+     * @brief 连接断开：停止检查并清除协商结果
+     */
+    void stop();
+
+public slots:
+    /**
+     * @brief 处理收到的心跳帧，PONG 只记录往返时间
+     * @param type 心跳帧类型
+     * @param token 心跳令牌（PING 发出时的时间戳）
+     */
+    void handleHeartbeat(Message::HeartbeatType type, quint64 token);
+
+signals:
+    /**
+     * @brief 心跳没有回应，连接已经失效
+     */
+    void timeout();
+
+private slots:
+    /**
+     * @brief 每半个心跳间隔检查一次：需要时发送心跳，心跳没有回应时发出 timeout
+     */
+    void check();
+
+private:
+    FrameWriter m_writer;           ///< 写出心跳帧的函数
+    int m_keepAlive;                ///< 请求的心跳间隔（秒）
+    int m_negotiatedKeepAlive;      ///< 协商的心跳间隔（秒），0 表示不发送心跳
+    QTimer* m_timer;                ///< 每半个心跳间隔触发的定时器
+    bool m_sentSinceCheck;          ///< 上次检查之后是否写出过数据
+    bool m_pingOutstanding;         ///< 是否有心跳发出后还没收到Broker的任何数据
+    int m_missedChecks;             ///< 心跳发出后经过的检查次数
+};
+
+#endif // KEEPALIVEMONITOR_H
@@ -7,10 +7,21 @@
 #include <QTextStream>
 #include <QDateTime>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
 #include <QDebug>
 
+#include <atomic>
+
+#include "mpscring.h"
+
 /**
  * @brief 日志记录类，用于记录系统运行日志
+ *
+ * 调用线程只把日志记录（时间戳、级别、消息）放入无锁有界环形队列，
+ * 格式化、写文件和控制台输出都在后台写线程中完成。写线程每个周期取空队列，
+ * 整批写入文件后只刷新一次；警告及以上级别或队列过半时立即唤醒写线程，
+ * 致命错误在返回前等待写出。队列满时按溢出策略丢弃或等待。
  */
 class Logger : public QObject
 {
@@ -28,6 +39,16 @@ public:
         FATAL
     };
 
+    /**
+     * @brief 队列满时的处理策略
+     */
+    enum OverflowPolicy {
+        DropNewest,     ///< 丢弃新记录并计数，调用线程从不等待（默认）
+        Block           ///< 唤醒写线程并等待队列腾出空间，不丢日志
+    };
+
+    static const int kDefaultQueueCapacity = 8192;   ///< 默认队列容量（条）
+
     /**
      * @brief 获取Logger单例实例
      * @return Logger实例
@@ -38,9 +59,39 @@ public:
      * @brief 初始化日志系统
      * @param logFilePath 日志文件路径
      * @param level 日志级别
+     * @param queueCapacity 队列容量（条），向上取整为2的幂
      * @return 是否初始化成功
      */
-    bool init(const QString& logFilePath, LogLevel level = INFO);
+    bool init(const QString& logFilePath, LogLevel level = INFO, int queueCapacity = kDefaultQueueCapacity);
+
+    /**
+     * @brief 设置队列满时的处理策略
+     * @param policy 溢出策略
+     */
+    void setOverflowPolicy(OverflowPolicy policy);
+
+    /**
+     * @brief 获取队列满时的处理策略
+     * @return 溢出策略
+     */
+    OverflowPolicy overflowPolicy() const;
+
+    /**
+     * @brief 设置写线程是否同时输出到控制台（默认输出）
+     * @param enabled 是否输出
+     */
+    void setConsoleOutput(bool enabled);
+
+    /**
+     * @brief 获取因队列满而丢弃的记录数
+     * @return 记录数
+     */
+    quint64 droppedCount() const;
+
+    /**
+     * @brief 等待调用之前放入队列的记录全部写入文件
+     */
+    void flush();
 
     /**
      * @brief 记录调试级别日志
@@ -72,6 +123,25 @@ public:
      */
     void fatal(const QString& message);
 
+    /**
+     * @brief 记录日志：放入队列，必要时唤醒写线程
+     * @param level 日志级别
+     * @param message 日志消息
+     */
+    void log(LogLevel level, const QString& message);
+
+    /**
+     * @brief 该级别的日志是否会被记录
+     *
+     * MYMQ_LOG_* 宏先调用它，级别不够时不构造消息。
+     * @param level 日志级别
+     * @return 是否记录
+     */
+    bool isEnabled(LogLevel level) const
+    {
+        return level >= m_logLevel;
+    }
+
 private:
     /**
      * @brief 构造函数（私有）
@@ -84,11 +154,45 @@ private:
     ~Logger();
 
     /**
-     * @brief 记录日志
-     * @param level 日志级别
-     * @param message 日志消息
+     * @brief 一条日志记录，格式化推迟到写线程
      */
-    void log(LogLevel level, const QString& message);
+    struct LogRecord {
+        qint64 timestamp = 0;       ///< 记录时间（自纪元起的毫秒数）
+        LogLevel level = DEBUG;     ///< 日志级别
+        QString message;            ///< 日志消息
+    };
+
+    /**
+     * @brief 写线程主循环
+     */
+    void writerLoop();
+
+    /**
+     * @brief 取空队列，整批写入文件并刷新
+     */
+    void drainQueue();
+
+    /**
+     * @brief 格式化一条记录并追加到批量缓冲区，需要时输出到控制台
+     * @param batch 批量缓冲区
+     * @param record 日志记录
+     */
+    void appendRecord(QByteArray& batch, const LogRecord& record);
+
+    /**
+     * @brief 唤醒写线程（只在它等待时加锁）
+     */
+    void wakeWriter();
+
+    /**
+     * @brief 停止写线程并写出剩余的记录，之后的日志同步写入
+     */
+    void stopWriter();
+
+    /**
+     * @brief 应用程序退出时停止写线程（注册为 QCoreApplication 的退出例程）
+     */
+    static void shutdown();
 
     /**
      * @brief 获取日志级别字符串
@@ -100,10 +204,52 @@ private:
 private:
     static Logger* m_instance;      ///< 单例实例
     QFile m_logFile;                ///< 日志文件
-    QTextStream m_textStream;       ///< 文本流
     LogLevel m_logLevel;            ///< 日志级别
-    QMutex* m_mutex;                 ///< 互斥锁，保证线程安全
+    QMutex* m_mutex;                ///< 互斥锁，保护日志文件的写入
     bool m_initialized;             ///< 是否已初始化
+    MpscRing<LogRecord>* m_queue;   ///< 待写出的日志记录
+    QThread* m_writer;              ///< 后台写线程
+    std::atomic<bool> m_writerRunning; ///< 写线程是否在运行，停止后日志同步写入
+    std::atomic<bool> m_writerSleeping; ///< 写线程是否在等待唤醒
+    std::atomic<int> m_overflowPolicy; ///< 溢出策略
+    std::atomic<bool> m_consoleOutput; ///< 是否输出到控制台
+    std::atomic<quint64> m_dropped; ///< 丢弃的记录数
+    QMutex* m_wakeMutex;            ///< 保护唤醒、刷新请求和停止标志
+    QWaitCondition m_wakeCondition; ///< 唤醒写线程
+    QWaitCondition m_flushedCondition; ///< 写线程完成一轮写出
+    quint64 m_flushRequested;       ///< 请求的刷新轮次
+    quint64 m_flushCompleted;       ///< 完成的刷新轮次
+    bool m_stopping;                ///< 是否请求写线程停止
 };
 
+/**
+ * 编译期最低日志级别（Logger::LogLevel 的数值）。低于它的 MYMQ_LOG_* 语句条件恒为假，
+ * 连同消息参数一起被编译器删除。默认在发布构建（定义了 QT_NO_DEBUG）中去掉调试日志，
+ * 可以通过 CMake 变量 MYMQ_MIN_LOG_LEVEL 覆盖。
+ */
+#ifndef MYMQ_MIN_LOG_LEVEL
+#ifdef QT_NO_DEBUG
+#define MYMQ_MIN_LOG_LEVEL 1
+#else
+#define MYMQ_MIN_LOG_LEVEL 0
+#endif
+#endif
+
+/**
+ * 惰性日志宏：先检查编译期和运行期的日志级别，只有会被记录时才求值消息表达式，
+ * 被过滤的调试日志不会构造 QString，也不会分配内存。
+ */
+#define MYMQ_LOG(level, message) \
+    do { \
+        if (int(level) >= MYMQ_MIN_LOG_LEVEL && Logger::instance()->isEnabled(level)) { \
+            Logger::instance()->log(level, message); \
+        } \
+    } while (0)
+
+#define MYMQ_LOG_DEBUG(message) MYMQ_LOG(Logger::DEBUG, message)
+#define MYMQ_LOG_INFO(message) MYMQ_LOG(Logger::INFO, message)
+#define MYMQ_LOG_WARNING(message) MYMQ_LOG(Logger::WARNING, message)
+#define MYMQ_LOG_ERROR(message) MYMQ_LOG(Logger::ERROR, message)
+#define MYMQ_LOG_FATAL(message) MYMQ_LOG(Logger::FATAL, message)
+
 #endif // LOGGER_H
@@ -6,33 +6,189 @@
 #include <QByteArray>
 #include <QDataStream>
 #include <QDateTime>
-#include <QUuid>
+#include <QVariant>
 #include <QIODevice>
+#include <QAtomicInteger>
+#include <QSharedDataPointer>
+
+/**
+ * @brief 消息ID生成器
+ *
+ * 消息ID由32位前缀和32位计数器组成，生成一个ID只需要一次原子加法。
+ * 前缀由进程随机数和进程内的连接序号组成，每个连接分配一次，
+ * 因此同一进程内不同连接、不同进程之间生成的ID互不冲突。
+ */
+class MessageIdGenerator
+{
+public:
+    /**
+     * @brief 构造函数，分配一个新的前缀
+     */
+    MessageIdGenerator();
+
+    /**
+     * @brief 分配新的前缀并将计数器清零，建立新连接时调用
+     */
+    void reset();
+
+    /**
+     * @brief 生成下一个消息ID
+     * @return 消息ID
+     */
+    quint64 next();
+
+    /**
+     * @brief 获取进程默认的ID生成器
+     * @return 默认ID生成器
+     */
+    static MessageIdGenerator* processDefault();
+
+private:
+    /**
+     * @brief 分配一个进程内唯一的前缀
+     * @return 前缀
+     */
+    static quint32 allocatePrefix();
+
+private:
+    QAtomicInteger<quint64> m_next;  ///< 下一个ID（前缀在高32位）
+};
+
+class MessageData;
 
 /**
  * @brief 消息类，表示DDS系统中的消息
+ *
+ * 所有字段保存在一个隐式共享的数据块中，复制消息（放入缓存队列、经过信号槽、
+ * 放入待发送队列）只增加引用计数；只有调用 setter 修改时才会复制数据块。
  */
 class Message
 {
 public:
     /**
-     * @brief 默认构造函数
+     * @brief 线路协议版本
+     *
+     * V1 为 QDataStream 编码：大端 qint32 长度前缀 + UTF-16 的ID和主题 + QDateTime。
+     * V2 为紧凑二进制帧，固定24字节小端帧头：
+     *
+     *     偏移  长度  字段
+     *     0     1     魔数 0xB2（V1 长度前缀的首字节不可能是它）
+     *     1     1     协议版本 2
+     *     2     1     帧类型（0 = 消息，1 = 批量，2 = 心跳请求，3 = 心跳回复）
+     *     3     1     标志位（位0：帧尾带有主题序号；位1：使用主题别名；位2：带有消息头部）
+     *     4     4     帧体长度（帧头之后的字节数）
+     *     8     8     64位消息ID
+     *     16    8     时间戳（自纪元起的纳秒数）
+     *     24    2     主题长度 n
+     *     26    n     UTF-8 主题
+     *     26+n  ...   原始负载
+     *     末尾  8     主题序号（仅当标志位0置位时存在）
+     *
+     * 批量帧的帧体是若干完整的消息帧首尾相接，帧头中的ID为0、时间戳为打包时间，
+     * 一次写出、一次读出，接收方逐个处理其中的消息。
+     *
+     * 心跳帧只有24字节帧头，帧体长度为0，ID字段是发送方的令牌（通常是发送时间），
+     * 回复原样带回最近一次请求的令牌。心跳帧在分帧时就被识别，不经过消息解码。
+     *
+     * 标志位1置位时，偏移24处是4字节的主题别名，代替主题长度和主题，负载紧随其后。
+     * 别名由发送方通过 $SYS/ALIAS 控制消息在本连接上预先登记，0 不是合法的别名。
+     *
+     * 标志位2置位时，主题部分之后、负载之前是消息头部：2字节头部长度 h，之后 h 字节的条目
+     * 首尾相接。每个条目为1字节键长度、UTF-8 键、1字节类型和值：
+     *
+     *     类型  值
+     *     1     false，没有值字节
+     *     2     true，没有值字节
+     *     3     整数，ZigZag 编码的变长整数（每字节7位，小端在前）
+     *     4     双精度浮点数，8字节小端
+     *     5     UTF-8 字符串，变长整数长度 + 字节
+     *     6     字节数组，变长整数长度 + 字节
+     *
+     * 头部在负载之前且长度已知，只读取头部时不需要复制或解码负载。
+     *
+     * V1 的主题序号作为可选的 qint64 写在时间戳之后，旧版本解码时会忽略它；
+     * 带有头部时序号总是写出（没有序号时为-1），之后是 QVariantMap 形式的头部。
+     */
+    enum ProtocolVersion {
+        ProtocolV1 = 1,
+        ProtocolV2 = 2
+    };
+
+    /**
+     * @brief 心跳帧类型
+     */
+    enum HeartbeatType {
+        NoHeartbeat = 0,    ///< 不是心跳帧
+        Ping = 1,           ///< 心跳请求
+        Pong = 2            ///< 心跳回复
+    };
+
+    static const int kMaxTopicAliases = 0xFFFF;  ///< 每个连接上客户端最多登记的主题别名数
+    static const int kMaxHeaderKeySize = 0xFF;   ///< V2 头部键的最大字节数（UTF-8）
+
+    /**
+     * @brief 默认构造函数，不生成ID和时间戳，供解码使用
      */
     Message();
 
     /**
-     * @brief 构造函数
+     * @brief 构造函数，使用进程默认的ID生成器
      * @param topic 消息主题
      * @param data 消息数据
      */
     Message(const QString& topic, const QByteArray& data);
 
     /**
-     * @brief 获取消息ID
-     * @return 消息ID
+     * @brief 构造函数
+     * @param topic 消息主题
+     * @param data 消息数据
+     * @param id 消息ID，通常来自连接自己的 MessageIdGenerator
+     */
+    Message(const QString& topic, const QByteArray& data, quint64 id);
+
+    /**
+     * @brief 拷贝构造函数，只增加引用计数
+     * @param other 另一个消息
+     */
+    Message(const Message& other);
+
+    /**
+     * @brief 移动构造函数
+     * @param other 另一个消息
+     */
+    Message(Message&& other) noexcept;
+
+    /**
+     * @brief 析构函数
+     */
+    ~Message();
+
+    /**
+     * @brief 拷贝赋值运算符，只增加引用计数
+     * @param other 另一个消息
+     * @return 当前消息
+     */
+    Message& operator=(const Message& other);
+
+    /**
+     * @brief 移动赋值运算符
+     * @param other 另一个消息
+     * @return 当前消息
+     */
+    Message& operator=(Message&& other) noexcept;
+
+    /**
+     * @brief 获取消息ID的文本形式，按需格式化
+     * @return 消息ID文本
      */
     QString id() const;
 
+    /**
+     * @brief 获取64位数字消息ID，V2 协议在线路上传输的就是它
+     * @return 数字消息ID
+     */
+    quint64 numericId() const;
+
     /**
      * @brief 获取消息主题
      * @return 消息主题
@@ -57,25 +213,247 @@ public:
      */
     void setData(const QByteArray& data);
 
+    /**
+     * @brief 获取消息头部
+     * @return 键到值的映射，没有头部时为空
+     */
+    QVariantMap headers() const;
+
+    /**
+     * @brief 设置消息头部
+     *
+     * V2 可以紧凑编码布尔值、整数、浮点数、字符串和字节数组，整数统一按 qint64 传输；
+     * 含有其他类型的值或超过 kMaxHeaderKeySize 的键时退回 V1 编码。
+     * @param headers 键到值的映射
+     */
+    void setHeaders(const QVariantMap& headers);
+
+    /**
+     * @brief 获取一个头部的值
+     * @param key 键
+     * @return 值，不存在时返回无效的 QVariant
+     */
+    QVariant header(const QString& key) const;
+
+    /**
+     * @brief 设置一个头部的值
+     * @param key 键
+     * @param value 值，无效的 QVariant 表示删除该头部
+     */
+    void setHeader(const QString& key, const QVariant& value);
+
     /**
      * @brief 获取消息时间戳
      * @return 消息时间戳
      */
     QDateTime timestamp() const;
 
+    /**
+     * @brief 获取消息时间戳（自纪元起的纳秒数）
+     * @return 纳秒时间戳
+     */
+    qint64 timestampNs() const;
+
+    /**
+     * @brief 获取主题序号
+     *
+     * 序号由Broker在路由时分配，同一主题内从0开始单调递增；
+     * 启用持久化时就是消息在日志中的偏移量。
+     * @return 主题序号，未分配时返回-1
+     */
+    qint64 sequence() const;
+
+    /**
+     * @brief 设置主题序号
+     * @param sequence 主题序号，-1 表示没有序号
+     */
+    void setSequence(qint64 sequence);
+
+    /**
+     * @brief 获取当前时间戳
+     *
+     * 进程启动时记录一次墙上时间，之后只读取单调时钟，
+     * 因此比 QDateTime::currentDateTime() 便宜得多，且不会因为系统时间调整而回退。
+     *
+     * @return 自纪元起的纳秒数
+     */
+    static qint64 currentTimestampNs();
+
     /**
      * @brief 将消息序列化为字节数组
-     * @return 序列化后的字节数组
+     * @param version 线路协议版本
+     * @return 序列化后的完整消息帧
+     */
+    QByteArray serialize(ProtocolVersion version = ProtocolV1) const;
+
+    /**
+     * @brief 使用主题别名序列化为 V2 帧，帧中不携带主题字符串
+     * @param topicAlias 本连接上已登记的主题别名（非0）
+     * @return 序列化后的完整消息帧
      */
-    QByteArray serialize() const;
+    QByteArray serializeWithTopicAlias(quint32 topicAlias) const;
 
     /**
      * @brief 从字节数组反序列化消息
-     * @param data 序列化的字节数组（不包含长度前缀）
+     * @param data V1 的消息内容（不包含长度前缀），或完整的 V1/V2 帧
      * @return 是否反序列化成功
      */
     bool deserialize(const QByteArray& data);
 
+    /**
+     * @brief 从带有长度前缀的完整消息帧反序列化消息
+     * @param frame 带有长度前缀的完整消息帧
+     * @return 是否反序列化成功
+     */
+    bool deserializeFrame(const QByteArray& frame);
+
+    /**
+     * @brief 只解析消息帧中的主题，不解码负载和时间戳
+     * @param frame 带有长度前缀的完整消息帧
+     * @param topic 输出参数，消息主题
+     * @return 是否解析成功
+     */
+    static bool peekTopic(const QByteArray& frame, QString& topic);
+
+    /**
+     * @brief 只解析消息帧中的时间戳
+     * @param frame 带有长度前缀的完整消息帧
+     * @return 自纪元起的纳秒数，解析失败时返回-1
+     */
+    static qint64 peekTimestampNs(const QByteArray& frame);
+
+    /**
+     * @brief 只解析消息帧中的主题别名
+     * @param frame 带有长度前缀的完整消息帧
+     * @return 主题别名；帧不使用别名或无法解析时返回0
+     */
+    static quint32 peekTopicAlias(const QByteArray& frame);
+
+    /**
+     * @brief 只解析消息帧中的头部，不复制或解码负载
+     *
+     * V2 帧只读取负载之前的头部；V1 帧的头部在负载之后，只能完整解码。
+     * @param frame 带有长度前缀的完整消息帧（可以是视图）
+     * @param headers 输出参数，消息头部，没有头部时为空
+     * @return 是否解析成功
+     */
+    static bool peekHeaders(const QByteArray& frame, QVariantMap& headers);
+
+    /**
+     * @brief 只解析消息帧中的一个头部
+     *
+     * V2 帧逐个跳过条目，只解码键匹配的那个值，适合Broker按头部路由或过滤。
+     * @param frame 带有长度前缀的完整消息帧（可以是视图）
+     * @param key 键
+     * @return 值；不存在或无法解析时返回无效的 QVariant
+     */
+    static QVariant peekHeader(const QByteArray& frame, const QString& key);
+
+    /**
+     * @brief 是否为批量帧
+     * @param frame 带有长度前缀的完整帧
+     * @return 是否为批量帧
+     */
+    static bool isBatchFrame(const QByteArray& frame);
+
+    /**
+     * @brief 编码心跳帧（V2）
+     * @param type 心跳请求或回复
+     * @param token 令牌，回复中原样带回
+     * @return 只有帧头的心跳帧
+     */
+    static QByteArray heartbeatFrame(HeartbeatType type, quint64 token);
+
+    /**
+     * @brief 获取帧的心跳类型
+     * @param frame 带有长度前缀的完整帧
+     * @return 心跳类型，不是心跳帧时返回 NoHeartbeat
+     */
+    static HeartbeatType heartbeatType(const QByteArray& frame);
+
+    /**
+     * @brief 获取心跳帧中的令牌
+     * @param frame 完整的心跳帧
+     * @return 令牌，不是心跳帧时返回0
+     */
+    static quint64 heartbeatToken(const QByteArray& frame);
+
+    /**
+     * @brief 获取批量帧中首尾相接的消息帧
+     * @param frame 完整的批量帧
+     * @return 指向 frame 的只读视图，只在 frame 有效期间可用；不是批量帧时返回空字节数组
+     */
+    static QByteArray batchContents(const QByteArray& frame);
+
+    /**
+     * @brief 为消息帧写入主题序号
+     *
+     * V2 帧只复制一次并在帧尾追加（或覆盖）8字节序号，不需要解码；V1 帧解码后重新编码。
+     * 给出主题时，使用主题别名的 V2 帧在同一次复制中展开为完整主题。
+     * @param frame 带有长度前缀的完整消息帧（可以是视图）
+     * @param sequence 主题序号
+     * @param topic 别名对应的主题，为空时保留帧中的主题部分
+     * @return 带有序号的新消息帧；无法解析时返回原帧的拷贝；
+     *         主题超过 V2 帧的长度上限、无法展开时返回空字节数组
+     */
+    static QByteArray withSequence(const QByteArray& frame, qint64 sequence, const QString& topic = QString());
+
+    /**
+     * @brief 把使用主题别名的 V2 帧展开为携带完整主题的帧，其余字段（包括序号）不变
+     * @param frame 带有长度前缀的完整消息帧（可以是视图）
+     * @param topic 别名对应的主题
+     * @return 新消息帧；帧不使用别名时返回原帧的拷贝；主题超过 V2 帧的长度上限时返回空字节数组
+     */
+    static QByteArray withTopic(const QByteArray& frame, const QString& topic);
+
+    /**
+     * @brief 把携带完整主题的 V2 帧改为使用主题别名，只复制一次
+     * @param frame 带有长度前缀的完整 V2 消息帧
+     * @param topicAlias 接收方已知的主题别名（非0）
+     * @return 新消息帧；不是 V2 帧或无法解析时返回空字节数组
+     */
+    static QByteArray withTopicAlias(const QByteArray& frame, quint32 topicAlias);
+
+    /**
+     * @brief 主题能否放进 V2 帧（UTF-8 编码不超过 65535 字节）
+     *
+     * 超过上限的主题只能使用 V1 帧，也不能登记主题别名：别名帧展开时无法写回完整主题。
+     * @param topic 主题
+     * @return 是否不超过上限
+     */
+    static bool fitsTopicV2(const QString& topic);
+
+    /**
+     * @brief 编码 $SYS/ALIAS 控制消息的负载："别名\n主题"
+     * @param topicAlias 主题别名
+     * @param topic 主题
+     * @return 负载
+     */
+    static QByteArray topicAliasPayload(quint32 topicAlias, const QString& topic);
+
+    /**
+     * @brief 解析 $SYS/ALIAS 控制消息的负载
+     * @param payload 负载
+     * @param topicAlias 输出参数，主题别名
+     * @param topic 输出参数，主题
+     * @return 是否解析成功（别名非0且主题非空）
+     */
+    static bool parseTopicAliasPayload(const QByteArray& payload, quint32& topicAlias, QString& topic);
+
+    /**
+     * @brief 获取帧使用的协议版本
+     * @param frame 消息帧（至少包含帧的第一个字节）
+     * @return 协议版本；数据为空时返回0
+     */
+    static int frameVersion(const QByteArray& frame);
+
+    /**
+     * @brief 获取缓冲区开头第一个完整消息帧的长度
+     * @param buffer 接收缓冲区
+     * @return 完整帧的字节数（包含长度前缀）；数据不完整时返回0，帧长度非法时返回-1
+     */
+    static int frameLength(const QByteArray& buffer);
+
     /**
      * @brief 从带有长度前缀的完整消息中提取消息内容
      * @param frameData 带有长度前缀的完整消息
@@ -85,10 +463,86 @@ public:
     static QByteArray extractMessageContent(const QByteArray& frameData, int& bytesRead);
 
 private:
-    QString m_id;           ///< 消息ID
-    QString m_topic;        ///< 消息主题
-    QByteArray m_data;      ///< 消息数据
-    QDateTime m_timestamp;  ///< 消息时间戳
+    /**
+     * @brief 编码 V2 帧
+     * @param topicAlias 主题别名，0 表示携带完整主题
+     * @param headerBlock 编码后的头部条目，为空时不带头部
+     * @return V2 消息帧
+     */
+    QByteArray serializeV2(quint32 topicAlias, const QByteArray& headerBlock) const;
+
+    /**
+     * @brief 编码 V1 帧
+     * @return V1 消息帧
+     */
+    QByteArray serializeV1() const;
+
+    /**
+     * @brief 解码 V2 帧
+     * @param frame 完整的 V2 消息帧
+     * @return 是否解码成功
+     */
+    bool deserializeV2(const QByteArray& frame);
+
+private:
+    QSharedDataPointer<MessageData> m_d;  ///< 隐式共享的消息数据
+};
+
+/**
+ * @brief 批量帧构建器
+ *
+ * 消息帧首尾相接地追加到同一个缓冲区，缓冲区开头预留批量帧头，
+ * 取出时只填写帧头，不再复制消息帧。
+ */
+class MessageBatch
+{
+public:
+    /**
+     * @brief 构造函数
+     */
+    MessageBatch();
+
+    /**
+     * @brief 追加一个完整的消息帧
+     * @param frame 消息帧（任意协议版本）
+     */
+    void append(const QByteArray& frame);
+
+    /**
+     * @brief 获取消息数
+     * @return 消息数
+     */
+    int size() const;
+
+    /**
+     * @brief 获取已追加的消息帧总字节数
+     * @return 字节数
+     */
+    int bytes() const;
+
+    /**
+     * @brief 是否为空
+     * @return 是否为空
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief 取出批量数据并清空构建器
+     *
+     * V2 连接得到一个批量帧；V1 连接不认识批量帧，得到首尾相接的消息帧，同样一次写出。
+     * @param version 连接协商的协议版本
+     * @return 待写出的数据
+     */
+    QByteArray takeFrame(Message::ProtocolVersion version);
+
+    /**
+     * @brief 丢弃已追加的消息帧
+     */
+    void clear();
+
+private:
+    QByteArray m_buffer;  ///< 预留的帧头和首尾相接的消息帧
+    int m_count;          ///< 消息数
 };
 
 // 注册元类型，使其可以在信号槽中使用
@@ -3,10 +3,18 @@
 
 #include <QObject>
 #include <QByteArray>
+#include <QHash>
 #include "message.h"
 
 /**
  * @brief 消息帧处理器类，用于处理消息的分包和粘包问题
+ *
+ * 接收缓冲区使用读游标：解析出的帧以视图的形式直接指向缓冲区，
+ * 处理完一帧只移动游标，只有已消费的数据超过一半时才压缩缓冲区。
+ * 缓冲区为空时直接在收到的数据上解析，只有末尾不完整的帧才会被复制。
+ * 批量帧在这里拆开，其中的每个消息帧与单独收到时一样发出信号。
+ * 帧长度非法时无法再找到下一帧的边界，处理器发出 protocolError 信号并丢弃之后的所有数据，
+ * 使用者应当关闭连接；单个帧的内容错误只发出 error 信号，不影响后续的帧。
  */
 class MessageFrameHandler : public QObject
 {
@@ -26,10 +34,44 @@ public:
     void processIncomingData(const QByteArray& data);
 
     /**
-     * @brief 清除接收缓冲区
+     * @brief 清除接收缓冲区和分帧失败的状态，连接重新建立时调用
      */
     void clearBuffer();
 
+    /**
+     * @brief 是否因为帧长度非法而停止处理数据
+     * @return 是否已经失败
+     */
+    bool hasFailed() const;
+
+    /**
+     * @brief 设置路由模式
+     *
+     * 路由模式下只解析帧头和主题，通过 frameReceived 信号交出原始帧字节，
+     * 不再完整反序列化消息，适用于只需要按主题转发的Broker。
+     *
+     * @param enabled 是否启用路由模式
+     */
+    void setRoutingMode(bool enabled);
+
+    /**
+     * @brief 是否处于路由模式
+     * @return 是否处于路由模式
+     */
+    bool isRoutingMode() const;
+
+    /**
+     * @brief 登记对端在本连接上使用的主题别名，之后收到的别名帧解码为该主题
+     * @param topicAlias 主题别名
+     * @param topic 主题
+     */
+    void setTopicAlias(quint32 topicAlias, const QString& topic);
+
+    /**
+     * @brief 清除所有主题别名，连接断开时调用
+     */
+    void clearTopicAliases();
+
 signals:
     /**
      * @brief 收到完整消息的信号
@@ -37,14 +79,60 @@ signals:
      */
     void messageReceived(const Message& message);
 
+    /**
+     * @brief 收到完整消息帧的信号（仅路由模式）
+     *
+     * frame 是指向接收缓冲区的只读视图，只在信号处理期间有效，
+     * 因此只能使用直接连接；需要保留时请复制一份（如 QByteArray(frame.constData(), frame.size())）。
+     * 使用主题别名的帧 topic 为空，由接收方按自己的别名表解析（见 Message::peekTopicAlias）。
+     *
+     * @param topic 消息主题
+     * @param frame 原始消息帧（包含长度前缀），可以原样转发
+     */
+    void frameReceived(const QString& topic, const QByteArray& frame);
+
+    /**
+     * @brief 收到心跳帧的信号（两种模式都会发出）
+     *
+     * 心跳帧在分帧时就被识别，不会发出 messageReceived 或 frameReceived。
+     * @param type 心跳请求或回复
+     * @param token 帧中的令牌
+     */
+    void heartbeatReceived(Message::HeartbeatType type, quint64 token);
+
     /**
      * @brief 处理数据时发生错误的信号
      * @param errorMessage 错误信息
      */
     void error(const QString& errorMessage);
 
+    /**
+     * @brief 帧长度非法的信号，之后的数据不再处理，连接必须关闭
+     * @param errorMessage 错误信息
+     */
+    void protocolError(const QString& errorMessage);
+
+private:
+    /**
+     * @brief 解析数据中的所有完整帧
+     * @param data 数据起始地址
+     * @param size 数据长度
+     * @param insideBatch 是否在解析批量帧的内容
+     * @return 已消费的字节数；帧长度非法或批量帧嵌套时返回-1
+     */
+    int processFrames(const char* data, int size, bool insideBatch = false);
+
+    /**
+     * @brief 分帧失败：清空缓冲区，停止处理并发出 protocolError 信号
+     */
+    void fail();
+
 private:
     QByteArray m_buffer;  ///< 接收缓冲区
+    int m_readPos;        ///< 读游标，之前的数据已经处理
+    bool m_routingMode;   ///< 是否处于路由模式
+    bool m_failed;        ///< 是否因为帧长度非法而停止处理
+    QHash<quint32, QString> m_topicAliases; ///< 对端登记的主题别名（仅解码模式使用）
 };
 
 #endif // MESSAGEFRAMEHANDLER_H
@@ -0,0 +1,249 @@
+#ifndef MESSAGELOG_H
+#define MESSAGELOG_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QWaitCondition>
+
+#include <atomic>
+
+class QFile;
+class QThread;
+
+/**
+ * @brief 按主题分段的只追加持久化消息日志
+ *
+ * 每个主题一个目录，目录下是若干段文件，文件名是段内第一条消息的偏移量：
+ * @code
+ * <directory>/<百分号编码的主题>/00000000000000000000.log   消息帧，原样首尾相接
+ * <directory>/<百分号编码的主题>/00000000000000000000.idx   稀疏索引
+ * @endcode
+ * 消息帧自带长度，日志中不再额外加记录头。偏移量是主题内从0开始连续递增的消息序号。
+ * 稀疏索引每写入 indexIntervalBytes 字节记录一项（段内相对偏移量, 文件位置），
+ * 读取时先二分查找索引，再从索引位置向后扫描。
+ *
+ * 落盘采用组提交：追加只写入文件缓冲区，按策略把多次追加合并为一次 fdatasync，
+ * fdatasync 都在后台线程进行，追加的线程不等待落盘。
+ * 读取历史消息时通过 mmap 映射段文件。所有公有方法都是线程安全的，
+ * 不同主题之间的追加互不阻塞。
+ */
+class MessageLog
+{
+public:
+    /**
+     * @brief 落盘策略
+     */
+    enum SyncPolicy {
+        SyncNone,       ///< 不主动落盘，由操作系统决定（只有 sync() 和 close() 会落盘）
+        SyncBatch,      ///< 主题每追加 syncBatchSize 条消息唤醒后台线程落盘一次（同时落盘其他有新数据的主题）
+        SyncInterval    ///< 后台线程每 syncIntervalMs 毫秒落盘一次有新数据的主题
+    };
+
+    /**
+     * @brief 日志选项
+     */
+    struct Options {
+        Options();
+
+        qint64 segmentBytes;        ///< 单个段文件的大小上限
+        qint64 retentionBytes;      ///< 每个主题保留的字节数上限，0表示不限制（至少保留当前段）
+        int indexIntervalBytes;     ///< 稀疏索引的间隔字节数
+        SyncPolicy syncPolicy;      ///< 落盘策略
+        int syncBatchSize;          ///< SyncBatch 策略的批大小
+        int syncIntervalMs;         ///< SyncInterval 策略的间隔
+    };
+
+    /**
+     * @brief 构造函数
+     * @param directory 日志根目录
+     * @param options 日志选项
+     */
+    explicit MessageLog(const QString& directory, const Options& options = Options());
+
+    /**
+     * @brief 析构函数，落盘并关闭所有文件
+     */
+    ~MessageLog();
+
+    /**
+     * @brief 打开日志：创建目录并恢复已有的主题（截断末尾不完整的消息帧）
+     * @return 是否打开成功
+     */
+    bool open();
+
+    /**
+     * @brief 落盘并关闭日志
+     */
+    void close();
+
+    /**
+     * @brief 是否已打开
+     * @return 是否已打开
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief 获取日志根目录
+     * @return 根目录
+     */
+    QString directory() const;
+
+    /**
+     * @brief 获取日志选项
+     * @return 日志选项
+     */
+    Options options() const;
+
+    /**
+     * @brief 追加消息帧
+     * @param topic 消息主题
+     * @param frame 带有长度前缀的完整消息帧（可以是视图）
+     * @return 消息在主题内的偏移量，失败时返回-1
+     */
+    qint64 append(const QString& topic, const QByteArray& frame);
+
+    /**
+     * @brief 读取主题的消息帧
+     *
+     * 返回的帧偏移量连续，第一条的偏移量为 qMax(fromOffset, firstOffset(topic))。
+     * 保留策略可能在两次调用之间删除旧段，需要偏移量的调用方应使用 startOffset，
+     * 它和读取在同一次加锁中确定。
+     * @param topic 消息主题
+     * @param fromOffset 起始偏移量
+     * @param maxCount 最多读取的消息数
+     * @param startOffset 输出第一条帧的偏移量（可以为空）
+     * @return 消息帧（独立拥有的数据）
+     */
+    QList<QByteArray> read(const QString& topic, qint64 fromOffset, int maxCount, qint64* startOffset = nullptr);
+
+    /**
+     * @brief 读取主题最新的若干条消息帧
+     * @param topic 消息主题
+     * @param count 消息数
+     * @return 消息帧，按偏移量从小到大排列
+     */
+    QList<QByteArray> readLast(const QString& topic, int count);
+
+    /**
+     * @brief 获取主题中仍保留的第一条消息的偏移量
+     * @param topic 消息主题
+     * @return 偏移量；主题不存在时返回0
+     */
+    qint64 firstOffset(const QString& topic) const;
+
+    /**
+     * @brief 获取主题下一条消息的偏移量（即已写入的消息总数）
+     * @param topic 消息主题
+     * @return 偏移量；主题不存在时返回0
+     */
+    qint64 nextOffset(const QString& topic) const;
+
+    /**
+     * @brief 查找时间戳不早于指定时间的第一条消息
+     *
+     * 假设同一主题内消息的时间戳大致递增：先按各段第一条消息确定段，
+     * 再在段内二分查找稀疏索引，最后从索引位置向后扫描。
+     * @param topic 消息主题
+     * @param timestampNs 自纪元起的纳秒数
+     * @return 偏移量；所有消息都早于该时间时返回 nextOffset(topic)
+     */
+    qint64 offsetForTimestamp(const QString& topic, qint64 timestampNs);
+
+    /**
+     * @brief 获取日志中的所有主题
+     * @return 主题列表
+     */
+    QStringList topics() const;
+
+    /**
+     * @brief 立即把所有主题的缓冲数据写入磁盘并落盘
+     */
+    void sync();
+
+private:
+    struct IndexEntry {
+        quint32 relativeOffset;     ///< 段内相对偏移量
+        quint32 position;           ///< 文件位置
+    };
+
+    struct Segment;
+    struct TopicLog;
+
+    MessageLog(const MessageLog&) = delete;
+    MessageLog& operator=(const MessageLog&) = delete;
+
+    /**
+     * @brief 获取主题日志，不存在时返回 nullptr
+     */
+    TopicLog* findTopic(const QString& topic) const;
+
+    /**
+     * @brief 获取主题日志，不存在时创建
+     */
+    TopicLog* topicLog(const QString& topic);
+
+    /**
+     * @brief 恢复一个主题目录
+     */
+    TopicLog* recoverTopic(const QString& topic, const QString& path);
+
+    /**
+     * @brief 为主题创建新的活动段（调用者持有主题锁）
+     */
+    bool rollSegment(TopicLog* log, qint64 baseOffset);
+
+    /**
+     * @brief 删除超出保留上限的旧段（调用者持有主题锁）
+     */
+    void applyRetention(TopicLog* log);
+
+    /**
+     * @brief 扫描段文件，重建索引并返回有效数据的长度
+     */
+    qint64 scanSegment(Segment* segment, const uchar* data, qint64 size);
+
+    /**
+     * @brief 映射段文件用于读取（调用者持有主题锁）
+     */
+    const uchar* mapSegment(Segment* segment);
+
+    /**
+     * @brief 读取段内指定文件位置的消息帧的时间戳（调用者持有主题锁）
+     */
+    static qint64 timestampAt(Segment* segment, const uchar* data, qint64 position);
+
+    /**
+     * @brief 释放段文件占用的资源（调用者持有主题锁）
+     */
+    static void closeSegment(Segment* segment);
+
+    /**
+     * @brief 把主题的缓冲数据写入磁盘并落盘，fdatasync 期间不持有主题锁
+     */
+    void syncTopic(TopicLog* log);
+
+    /**
+     * @brief SyncBatch 和 SyncInterval 策略的后台落盘循环
+     */
+    void runSyncLoop();
+
+private:
+    QString m_directory;                    ///< 日志根目录
+    Options m_options;                      ///< 日志选项
+    bool m_open;                            ///< 是否已打开
+    QHash<QString, TopicLog*> m_topics;     ///< 主题日志
+    mutable QReadWriteLock m_topicsLock;    ///< 主题表读写锁
+    QThread* m_syncThread;                  ///< 后台落盘线程
+    QMutex m_syncMutex;                     ///< 后台落盘线程的等待锁
+    QWaitCondition m_syncWakeup;            ///< 唤醒后台落盘线程
+    bool m_stopSync;                        ///< 是否停止后台落盘线程
+    std::atomic<bool> m_syncRequested;      ///< SyncBatch 策略有主题攒够一批，等待后台线程落盘
+};
+
+#endif // MESSAGELOG_H
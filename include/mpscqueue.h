@@ -0,0 +1,95 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+/**
+ * @brief 无锁多生产者单消费者队列
+ *
+ * 任意线程都可以调用 push()，只有一个线程（队列所属的消费者）可以调用 tryPop()。
+ * 生产者之间只竞争一次原子交换，消费者不需要任何原子读改写操作。
+ *
+ * 生产者完成交换、尚未链接节点的短暂窗口内，消费者可能暂时看不到该元素，
+ * 因此生产者在 push() 之后需要负责唤醒消费者（见 BrokerWorker 的用法）。
+ */
+template <typename T>
+class MpscQueue
+{
+public:
+    /**
+     * @brief 构造函数
+     */
+    MpscQueue()
+        : m_head(new Node())
+        , m_tail(m_head.load(std::memory_order_relaxed))
+    {
+    }
+
+    /**
+     * @brief 析构函数，释放所有未取出的元素
+     */
+    ~MpscQueue()
+    {
+        while (m_tail) {
+            Node* next = m_tail->next.load(std::memory_order_relaxed);
+            delete m_tail;
+            m_tail = next;
+        }
+    }
+
+    /**
+     * @brief 放入元素（线程安全）
+     * @param value 元素
+     */
+    void push(T value)
+    {
+        Node* node = new Node(std::move(value));
+        Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    /**
+     * @brief 取出元素（只能由消费者线程调用）
+     * @param value 输出参数，取出的元素
+     * @return 是否取到元素
+     */
+    bool tryPop(T& value)
+    {
+        Node* tail = m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+
+        value = std::move(next->value);
+        m_tail = next;
+        delete tail;
+        return true;
+    }
+
+private:
+    struct Node {
+        Node()
+            : next(nullptr)
+        {
+        }
+
+        explicit Node(T&& v)
+            : value(std::move(v))
+            , next(nullptr)
+        {
+        }
+
+        T value;
+        std::atomic<Node*> next;
+    };
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    std::atomic<Node*> m_head;  ///< 生产者端，最后放入的节点
+    Node* m_tail;               ///< 消费者端，已取出的哨兵节点
+};
+
+#endif // MPSCQUEUE_H
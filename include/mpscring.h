@@ -0,0 +1,134 @@
+#ifndef MPSCRING_H
+#define MPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief 有界无锁多生产者单消费者环形队列
+ *
+ * 每个槽位带一个序号：序号等于写位置时槽位空闲，等于写位置加一时槽位已写好。
+ * 生产者用一次比较交换领取写位置，写完元素后发布序号；消费者只读序号，不需要原子读改写。
+ * 与 MpscQueue 不同，放入时不分配内存，队列满时 tryPush() 立即失败，由调用方决定丢弃还是等待。
+ */
+template <typename T>
+class MpscRing
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param capacity 容量，向上取整为2的幂
+     */
+    explicit MpscRing(size_t capacity)
+        : m_slots(roundUpToPowerOfTwo(capacity))
+        , m_mask(m_slots.size() - 1)
+        , m_enqueuePos(0)
+        , m_dequeuePos(0)
+    {
+        for (size_t i = 0; i < m_slots.size(); ++i) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief 获取容量
+     * @return 槽位数
+     */
+    size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    /**
+     * @brief 放入元素（线程安全）
+     * @param value 元素，只有放入成功时才被移走
+     * @return 队列满时返回 false
+     */
+    bool tryPush(T&& value)
+    {
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &m_slots[pos & m_mask];
+            const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(pos);
+            if (diff == 0) {
+                // 槽位空闲，领取写位置；失败时 pos 被更新为最新值
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // 消费者还没取走上一圈的元素
+                return false;
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->value = std::move(value);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 取出元素（只能由消费者线程调用）
+     * @param value 输出参数，取出的元素
+     * @return 是否取到元素
+     */
+    bool tryPop(T& value)
+    {
+        const size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[pos & m_mask];
+        const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (std::ptrdiff_t(sequence) - std::ptrdiff_t(pos + 1) < 0) {
+            return false;
+        }
+
+        // 槽位不再持有已取出的元素，元素的资源不必等到下一圈覆盖时才释放
+        value = std::move(slot.value);
+        slot.value = T();
+        slot.sequence.store(pos + m_mask + 1, std::memory_order_release);
+        m_dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief 估算队列中的元素数（线程安全，并发放入和取出时只是近似值）
+     * @return 元素数
+     */
+    size_t sizeApprox() const
+    {
+        const size_t enqueued = m_enqueuePos.load(std::memory_order_relaxed);
+        const size_t dequeued = m_dequeuePos.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t roundUpToPowerOfTwo(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    std::vector<Slot> m_slots;                  ///< 槽位
+    const size_t m_mask;                        ///< 容量减一
+    char m_pad0[64];                            ///< 生产者和消费者的位置放在不同缓存行
+    std::atomic<size_t> m_enqueuePos;           ///< 下一个写位置，生产者竞争
+    char m_pad1[64];
+    std::atomic<size_t> m_dequeuePos;           ///< 下一个读位置，只由消费者修改
+};
+
+#endif // MPSCRING_H
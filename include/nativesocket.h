@@ -0,0 +1,84 @@
+#ifndef NATIVESOCKET_H
+#define NATIVESOCKET_H
+
+#include <QByteArray>
+
+/**
+ * @brief epoll 后端使用的非阻塞TCP连接（只在 Linux 上可用）
+ *
+ * 不是 QObject，没有信号和内部读缓冲区：读取直接写入调用方提供的缓冲区，
+ * 写入先追加到待发送缓冲区，由I/O线程在一批事件处理完后统一 flush()，
+ * 同一轮中发给同一连接的多个帧合并成一次 send()。
+ * 内核发送缓冲区满时剩余数据留在待发送缓冲区，I/O线程关注可写后继续发送。
+ */
+class NativeSocket
+{
+public:
+    /**
+     * @brief 构造函数，接管已连接的描述符并设置为非阻塞
+     * @param descriptor 套接字描述符
+     */
+    explicit NativeSocket(int descriptor);
+
+    /**
+     * @brief 析构函数，关闭描述符
+     */
+    ~NativeSocket();
+
+    /**
+     * @brief 获取描述符
+     * @return 描述符
+     */
+    int descriptor() const;
+
+    /**
+     * @brief 读取数据，不阻塞
+     * @param data 输出缓冲区
+     * @param maxSize 缓冲区大小
+     * @return 读取的字节数；暂无数据时返回 0；对端关闭或出错时返回 -1
+     */
+    qint64 read(char* data, qint64 maxSize);
+
+    /**
+     * @brief 追加数据到待发送缓冲区，调用 flush() 后才真正发送
+     * @param data 数据
+     * @return 是否成功（连接已出错时返回 false）
+     */
+    bool write(const QByteArray& data);
+
+    /**
+     * @brief 尽可能多地发送待发送缓冲区中的数据
+     * @return 本次发送的字节数；连接出错时返回 -1
+     */
+    qint64 flush();
+
+    /**
+     * @brief 获取尚未发送的字节数
+     * @return 字节数
+     */
+    qint64 bytesToWrite() const;
+
+    /**
+     * @brief I/O线程是否在关注该连接可写
+     * @return 是否关注
+     */
+    bool writeInterest() const;
+
+    /**
+     * @brief 记录I/O线程是否在关注该连接可写
+     * @param enabled 是否关注
+     */
+    void setWriteInterest(bool enabled);
+
+private:
+    NativeSocket(const NativeSocket&) = delete;
+    NativeSocket& operator=(const NativeSocket&) = delete;
+
+    int m_descriptor;           ///< 套接字描述符
+    QByteArray m_pending;       ///< 待发送的数据
+    qint64 m_pendingOffset;     ///< 待发送数据中已发送的字节数
+    bool m_error;               ///< 连接是否已出错
+    bool m_writeInterest;       ///< 是否在关注可写
+};
+
+#endif // NATIVESOCKET_H
@@ -0,0 +1,127 @@
+#ifndef OUTBOUNDQUEUE_H
+#define OUTBOUNDQUEUE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QQueue>
+#include <QString>
+
+#include "subscriptionoptions.h"
+
+/**
+ * @brief 发送队列统计
+ */
+struct OutboundQueueStats
+{
+    qint64 queuedMessages = 0;          ///< 队列中等待发送的消息数
+    qint64 queuedBytes = 0;             ///< 队列中等待发送的字节数
+    qint64 droppedMessages = 0;         ///< 因队列已满而丢弃的消息数
+    qint64 conflatedMessages = 0;       ///< 被同主题新消息覆盖的消息数
+    qint64 slowConsumerDisconnects = 0; ///< 因队列已满而断开的订阅者数
+};
+
+/**
+ * @brief 单个订阅者连接的有界发送队列
+ *
+ * 套接字写缓冲区低于高水位时消息直接写入套接字，不经过本队列；
+ * 只有订阅者读取跟不上时消息才会排队，队列按消息数和字节数限制长度，
+ * 超出限制时按订阅的溢出策略处理。
+ */
+class OutboundQueue
+{
+public:
+    /**
+     * @brief 放入消息的结果
+     */
+    enum PushResult {
+        Queued,         ///< 已放入队列
+        Conflated,      ///< 覆盖了同主题尚未发送的消息
+        DroppedNewest,  ///< 队列已满，丢弃了新消息
+        Overflowed      ///< 队列已满且策略为断开连接，队列未修改
+    };
+
+    /**
+     * @brief 构造函数
+     * @param maxMessages 最大消息数
+     * @param maxBytes 最大字节数
+     */
+    OutboundQueue(int maxMessages, qint64 maxBytes);
+
+    /**
+     * @brief 放入消息帧
+     * @param topic 消息主题（用于按主题合并）
+     * @param frame 已编码的消息帧（必须独立拥有数据，不能是视图）
+     * @param policy 溢出策略，不能是 DefaultPolicy
+     * @param droppedOldest 输出参数，为腾出空间而丢弃的旧消息数
+     * @return 放入结果
+     */
+    PushResult push(const QString& topic, const QByteArray& frame,
+                    SubscriptionOptions::OverflowPolicy policy, int* droppedOldest);
+
+    /**
+     * @brief 获取队首的消息帧
+     * @return 消息帧
+     */
+    const QByteArray& front() const;
+
+    /**
+     * @brief 移除队首的消息帧
+     */
+    void pop();
+
+    /**
+     * @brief 是否为空
+     * @return 是否为空
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief 获取消息数
+     * @return 消息数
+     */
+    int size() const;
+
+    /**
+     * @brief 获取字节数
+     * @return 字节数
+     */
+    qint64 bytes() const;
+
+    /**
+     * @brief 获取最大消息数
+     * @return 最大消息数
+     */
+    int maxMessages() const;
+
+    /**
+     * @brief 获取最大字节数
+     * @return 最大字节数
+     */
+    qint64 maxBytes() const;
+
+private:
+    struct Entry {
+        QByteArray frame;   ///< 消息帧
+        QString topic;      ///< 需要合并时记录主题，否则为空
+        quint64 sequence;   ///< 入队序号
+    };
+
+    /**
+     * @brief 放入一个帧后是否会超出限制
+     */
+    bool wouldOverflow(qint64 frameSize) const;
+
+    /**
+     * @brief 按主题查找尚未发送的可合并消息
+     */
+    Entry* findConflatable(const QString& topic);
+
+    QQueue<Entry> m_entries;                 ///< 待发送的消息
+    QHash<QString, quint64> m_conflatable;   ///< 可合并主题最新一条消息的入队序号
+    quint64 m_nextSequence;                  ///< 下一个入队序号
+    qint64 m_bytes;                          ///< 待发送的字节数
+    int m_maxMessages;                       ///< 最大消息数
+    qint64 m_maxBytes;                       ///< 最大字节数
+};
+
+#endif // OUTBOUNDQUEUE_H
@@ -5,12 +5,16 @@
 #include <QTcpSocket>
 #include <QLocalSocket>
 #include <QQueue>
+#include <QHash>
+#include <QVector>
 #include <QMutex>
 #include <QTimer>
 
 #include "message.h"
 #include "topic.h"
 #include "messageframehandler.h"
+#include "sharedmemoryclient.h"
+#include "keepalivemonitor.h"
 
 /**
  * @brief Publisher类，用于发布消息
@@ -72,6 +76,37 @@ public:
      */
     bool publish(const Message& message);
 
+    /**
+     * @brief 批量发布消息：所有消息编码进同一个批量帧，一次写出
+     *
+     * 之前因逗留而尚未发出的消息先发出，保持发布顺序。
+     * @param messages 消息
+     * @return 是否发布成功
+     */
+    bool publishBatch(const QVector<Message>& messages);
+
+    /**
+     * @brief 设置逗留批量模式
+     *
+     * 启用后 publish() 只把消息追加到当前批次，批次达到消息数或字节数上限、
+     * 或者第一条消息逗留超过 lingerMs 毫秒时作为一个批量帧写出。
+     * @param maxMessages 每批最多消息数，小于等于1时关闭批量模式（默认）
+     * @param lingerMs 第一条消息最长的逗留时间（毫秒）
+     * @param maxBytes 每批最多字节数
+     */
+    void setBatching(int maxMessages, int lingerMs = 1, int maxBytes = 64 * 1024);
+
+    /**
+     * @brief 获取每批最多消息数
+     * @return 消息数，小于等于1表示未启用批量模式
+     */
+    int batchMaxMessages() const;
+
+    /**
+     * @brief 立即写出当前批次中逗留的消息
+     */
+    void flushBatch();
+
     /**
      * @brief 设置自动重连
      * @param enable 是否启用
@@ -79,6 +114,93 @@ public:
      */
     void setAutoReconnect(bool enable, int interval = 5000);
 
+    /**
+     * @brief 设置是否使用主题别名发布
+     *
+     * 启用后，协商到 V2 协议的连接上每个主题第一次发布时登记一个别名，
+     * 之后的消息帧只携带4字节别名而不是完整主题。别名只在本连接内有效，重连后重新登记。
+     * @param enabled 是否启用
+     */
+    void setTopicAliasesEnabled(bool enabled);
+
+    /**
+     * @brief 是否使用主题别名发布
+     * @return 是否启用
+     */
+    bool topicAliasesEnabled() const;
+
+    /**
+     * @brief 设置心跳间隔
+     *
+     * 连接建立后向Broker协商心跳间隔，Broker把连接的空闲超时设为 1.5 倍的间隔。
+     * 连接在一个间隔内没有写出任何数据时发送只有帧头的心跳帧，安静的连接不会因空闲被断开；
+     * 心跳发出后一个间隔内没有收到Broker的任何数据时认为连接已经失效，主动断开（可自动重连）。
+     * 不支持心跳的Broker不回复协商，此时不发送心跳。
+     * @param seconds 心跳间隔（秒），0 表示不使用心跳
+     */
+    void setKeepAlive(int seconds);
+
+    /**
+     * @brief 获取请求的心跳间隔
+     * @return 心跳间隔（秒）
+     */
+    int keepAlive() const;
+
+    /**
+     * @brief 获取与Broker协商的心跳间隔
+     * @return 心跳间隔（秒），未连接或Broker不支持时为0
+     */
+    int negotiatedKeepAlive() const;
+
+    /**
+     * @brief 设置连接本地Broker时是否使用共享内存通道
+     *
+     * 启用后 connectToLocalBroker() 建立连接后创建共享内存并与Broker握手，成功后消息帧
+     * 经过共享内存中的环收发，本地套接字只用于唤醒；Broker拒绝时继续使用本地套接字。
+     * 只对之后建立的连接生效。
+     * @param enabled 是否启用
+     * @param spinMicroseconds 读空后自旋等待的时间（微秒），用CPU换取更低的延迟
+     */
+    void setSharedMemoryEnabled(bool enabled, int spinMicroseconds = 0);
+
+    /**
+     * @brief 是否启用共享内存通道
+     * @return 是否启用
+     */
+    bool sharedMemoryEnabled() const;
+
+    /**
+     * @brief 当前连接是否已经切换到共享内存通道
+     * @return 是否已切换
+     */
+    bool isUsingSharedMemory() const;
+
+    /**
+     * @brief 设置是否请求Broker确认发布的消息
+     *
+     * 启用后Broker把消息写入缓存或日志后回复累计确认，每条消息发出 confirmed()
+     * 或 nacked() 信号。发布不等待确认，最多 maxInFlight 条消息处于已发送未确认状态，
+     * 窗口满时新消息在本地排队，收到确认后按顺序发出。
+     *
+     * 确认表示Broker已经接受并写入了消息，不表示已经落盘：启用持久化时，
+     * SyncInterval 和 SyncBatch 策略下确认可能先于 fdatasync 发出。
+     * @param enabled 是否启用
+     * @param maxInFlight 在途窗口大小
+     */
+    void setConfirmsEnabled(bool enabled, int maxInFlight = 1024);
+
+    /**
+     * @brief 是否请求Broker确认发布的消息
+     * @return 是否启用
+     */
+    bool confirmsEnabled() const;
+
+    /**
+     * @brief 获取已发送但尚未确认的消息数
+     * @return 消息数
+     */
+    int inFlightCount() const;
+
 signals:
     /**
      * @brief 连接成功信号
@@ -96,6 +218,22 @@ signals:
      */
     void published(const QString& messageId);
 
+    /**
+     * @brief Broker已接受消息信号（需要启用确认）
+     *
+     * 消息已经写入Broker的缓存或日志的文件缓冲区，但不保证已经落盘，
+     * Broker所在主机断电时可能丢失；落盘时机由日志的 SyncPolicy 决定。
+     * @param messageId 消息ID
+     */
+    void confirmed(const QString& messageId);
+
+    /**
+     * @brief Broker拒绝消息或连接断开时结果未知的信号（需要启用确认）
+     * @param messageId 消息ID
+     * @param reason 原因
+     */
+    void nacked(const QString& messageId, const QString& reason);
+
     /**
      * @brief 错误信号
      * @param errorMessage 错误消息
@@ -113,6 +251,16 @@ private slots:
      */
     void handleDisconnected();
 
+    /**
+     * @brief 处理TCP套接字读取就绪
+     */
+    void handleTcpReadyRead();
+
+    /**
+     * @brief 处理本地套接字读取就绪
+     */
+    void handleLocalReadyRead();
+
     /**
      * @brief 处理错误
      * @param socketError 套接字错误
@@ -130,17 +278,38 @@ private slots:
      */
     void tryReconnect();
 
+    /**
+     * @brief 帧长度非法时中断连接
+     * @param errorMessage 错误信息
+     */
+    void handleProtocolError(const QString& errorMessage);
+
+    /**
+     * @brief 心跳没有回应：报告错误并断开连接
+     */
+    void handleKeepAliveTimeout();
+
     /**
      * @brief 处理待发送消息
      */
     void processPendingMessages();
 
 private:
+    /**
+     * @brief 发送协议协商请求，收到Broker回复后切换到协商的协议版本
+     */
+    void sendHello();
+
     /**
      * @brief 注册为发布者
      */
     void registerAsPublisher();
 
+    /**
+     * @brief 向Broker协商心跳间隔
+     */
+    void sendKeepAliveRequest();
+
     /**
      * @brief 发送消息到Broker
      * @param message 消息
@@ -148,6 +317,75 @@ private:
      */
     bool sendMessage(const Message& message);
 
+    /**
+     * @brief 按连接的协议版本和主题别名编码消息
+     * @param message 消息
+     * @return 消息帧
+     */
+    QByteArray encodeMessage(const Message& message);
+
+    /**
+     * @brief 写出已编码的数据并立即发送
+     * @param data 数据
+     * @return 是否完整写出
+     */
+    bool writeData(const QByteArray& data);
+
+    /**
+     * @brief 写出一条数据消息，批量模式下追加到当前批次
+     * @param message 消息
+     * @return 是否发送成功
+     */
+    bool transmit(const Message& message);
+
+    /**
+     * @brief 记录一条已经写出的数据消息，开启确认时加入在途队列
+     *
+     * 编号与Broker按到达顺序给数据消息的编号一致。
+     * @param message 消息
+     */
+    void trackPublished(const Message& message);
+
+    /**
+     * @brief 在途窗口是否已满
+     * @return 是否已满
+     */
+    bool isWindowFull() const;
+
+    /**
+     * @brief 向Broker发送确认开关
+     */
+    void sendConfirmsRequest();
+
+    /**
+     * @brief 处理Broker的累计确认
+     * @param count 已处理的消息数，编号小于它且未被拒绝的消息都已接受
+     */
+    void handleConfirm(quint64 count);
+
+    /**
+     * @brief 处理Broker对单条消息的拒绝
+     * @param payload $SYS/NACK 的负载：编号和原因
+     */
+    void handleNack(const QByteArray& payload);
+
+    /**
+     * @brief 在途窗口有空位时发出排队的消息
+     */
+    void drainWindowQueue();
+
+    /**
+     * @brief 连接断开：在途消息的结果未知，全部发出 nacked()；窗口中排队的消息放回待发送队列
+     */
+    void failInFlight();
+
+    /**
+     * @brief 获取主题在本连接上的别名，第一次使用时先向Broker登记
+     * @param topic 主题
+     * @return 主题别名；不能使用别名时返回0
+     */
+    quint32 topicAliasFor(const QString& topic);
+
 private:
     QTcpSocket* m_tcpSocket;                ///< TCP套接字
     QLocalSocket* m_localSocket;            ///< 本地套接字
@@ -162,6 +400,28 @@ private:
     QMutex* m_pendingMessagesMutex;          ///< 待发送消息互斥锁
     bool m_registered;                      ///< 是否已注册为发布者
     MessageFrameHandler* m_frameHandler;     ///< 消息帧处理器
+    Message::ProtocolVersion m_protocolVersion; ///< 协商后的线路协议版本
+    MessageIdGenerator m_idGenerator;       ///< 消息ID生成器，每次连接分配新的前缀
+    bool m_topicAliasesEnabled;             ///< 是否使用主题别名发布
+    QHash<QString, quint32> m_topicAliases; ///< 本连接上已登记的主题别名
+    MessageBatch m_batch;                   ///< 逗留中的批次
+    QVector<Message> m_batchMessages;       ///< 批次中的消息，写出后发出 published 信号
+    int m_batchMaxMessages;                 ///< 每批最多消息数
+    int m_batchMaxBytes;                    ///< 每批最多字节数
+    QTimer* m_lingerTimer;                  ///< 逗留定时器
+    SharedMemoryClient* m_sharedMemory;     ///< 共享内存通道的客户端一侧
+
+    struct InFlightMessage {
+        quint64 index;                      ///< 消息在本连接中的编号
+        Message message;                    ///< 消息
+    };
+
+    bool m_confirmsEnabled;                 ///< 是否请求确认
+    int m_maxInFlight;                      ///< 在途窗口大小
+    quint64 m_publishIndex;                 ///< 本连接已写出的数据消息数
+    QQueue<InFlightMessage> m_inFlight;     ///< 已发送未确认的消息，按编号排列
+    QQueue<Message> m_windowQueue;          ///< 等待在途窗口空位的消息
+    KeepAliveMonitor* m_keepAliveMonitor;   ///< 心跳协商和检测
 };
 
 #endif // PUBLISHER_H
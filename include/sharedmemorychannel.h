@@ -0,0 +1,176 @@
+#ifndef SHAREDMEMORYCHANNEL_H
+#define SHAREDMEMORYCHANNEL_H
+
+#include <QIODevice>
+#include <QLocalSocket>
+#include <QSharedMemory>
+
+#include "shmring.h"
+
+/**
+ * @brief 同主机客户端与Broker之间的共享内存通道
+ *
+ * 一段共享内存中放两个 ShmRing，每个方向一个，消息帧直接写入环中，不经过内核复制。
+ * 原有的本地套接字保留用于握手和唤醒：一方读空后登记等待，另一方写入时发现登记才通过
+ * 套接字写一个字节作为门铃，持续有数据时不产生任何系统调用。
+ *
+ * 握手（全部经过本地套接字）：
+ * 1. 客户端 create() 共享内存，发送 $SYS/SHM（负载为共享内存的键）；
+ * 2. Broker attach() 后回复 $SYS/SHM "1"（失败回复 "0"），这是Broker在套接字上发送的
+ *    最后一条消息，之后Broker发送的帧都写入共享内存；
+ * 3. 客户端收到回复后发送 $SYS/SHMREADY 作为它在套接字上的最后一条消息，然后调用
+ *    startReading()，之后收发都经过共享内存；
+ * 4. Broker收到 $SYS/SHMREADY 后调用 startReading()。
+ * 一方调用 startReading() 之前不会登记等待，对方也就不会向它发送门铃，
+ * 因此套接字上的帧和门铃字节不会交错。
+ *
+ * 通道实现为顺序的 QIODevice：写入不会阻塞，环满时数据留在本地待发送缓冲区，
+ * bytesToWrite() 反映积压，对端读出数据后通过门铃通知，handleDoorbell() 继续写出并发出
+ * bytesWritten 信号，因此Broker的发送队列和溢出策略可以原样使用。
+ *
+ * 环的读写位置由对端写入，发现不一致时通道进入损坏状态：之后的读写都返回 -1，
+ * 并发出一次 broken 信号，持有方应断开这条连接。
+ */
+class SharedMemoryChannel : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    static const int kDefaultRingSize = 1 << 20;   ///< 默认每个方向的环容量（字节）
+
+    /**
+     * @brief 构造函数
+     * @param socket 握手使用的本地套接字，之后用作门铃
+     * @param parent 父对象
+     */
+    explicit SharedMemoryChannel(QLocalSocket* socket, QObject* parent = nullptr);
+
+    /**
+     * @brief 析构函数，分离共享内存
+     */
+    ~SharedMemoryChannel() override;
+
+    /**
+     * @brief 创建共享内存（客户端调用）
+     * @param ringSize 每个方向的环容量，向上取整为2的幂
+     * @return 是否创建成功
+     */
+    bool create(int ringSize = kDefaultRingSize);
+
+    /**
+     * @brief 连接到客户端创建的共享内存（Broker调用）
+     * @param key 共享内存的键
+     * @return 是否连接成功
+     */
+    bool attach(const QString& key);
+
+    /**
+     * @brief 获取共享内存的键
+     * @return 键
+     */
+    QString key() const;
+
+    /**
+     * @brief 对端已经切换到共享内存发送，之后本端从共享内存接收，套接字上只会收到门铃
+     */
+    void startReading();
+
+    /**
+     * @brief 是否已经从共享内存接收
+     * @return 是否已切换
+     */
+    bool isReading() const;
+
+    /**
+     * @brief 设置读空后登记等待之前的自旋时间
+     *
+     * 自旋期间对端写入的数据不需要门铃，延迟最低，但会占用当前线程。
+     * @param microseconds 自旋时间（微秒），0 表示不自旋（默认）
+     */
+    void setSpinTime(int microseconds);
+
+    /**
+     * @brief 是否发现对端破坏了共享内存中的环
+     * @return 是否已损坏
+     */
+    bool isBroken() const;
+
+    /**
+     * @brief 处理套接字上的门铃：丢弃门铃字节，继续写出积压的数据
+     *
+     * 之后调用方应读取通道中的数据。
+     */
+    void handleDoorbell();
+
+    /**
+     * @brief 通道是顺序设备
+     * @return true
+     */
+    bool isSequential() const override;
+
+    /**
+     * @brief 获取可读的字节数
+     * @return 字节数
+     */
+    qint64 bytesAvailable() const override;
+
+    /**
+     * @brief 获取尚未写入环的字节数
+     * @return 字节数
+     */
+    qint64 bytesToWrite() const override;
+
+    /**
+     * @brief 关闭通道并分离共享内存
+     */
+    void close() override;
+
+signals:
+    /**
+     * @brief 发现共享内存中的环被破坏，只发出一次
+     *
+     * 信号在读写调用中发出，接收方应使用排队连接再断开。
+     */
+    void broken();
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 size) override;
+
+private:
+    /**
+     * @brief 按角色映射两个方向的环
+     * @param clientSide 是否为客户端
+     * @return 是否成功
+     */
+    bool setupRings(bool clientSide);
+
+    /**
+     * @brief 把积压的数据写入环
+     * @return 本次写入的字节数
+     */
+    qint64 flushPending();
+
+    /**
+     * @brief 标记通道损坏并发出 broken 信号
+     */
+    void markBroken();
+
+    /**
+     * @brief 通过套接字唤醒对端
+     */
+    void ringDoorbell();
+
+private:
+    QLocalSocket* m_socket;     ///< 握手和门铃使用的本地套接字
+    QSharedMemory m_memory;     ///< 共享内存
+    ShmRing m_rx;               ///< 接收方向的环（本端是消费者）
+    ShmRing m_tx;               ///< 发送方向的环（本端是生产者）
+    QByteArray m_pending;       ///< 环满时积压的待写数据
+    qint64 m_pendingOffset;     ///< 积压数据中已写出的字节数
+    bool m_reading;             ///< 是否已经从共享内存接收
+    bool m_broken;              ///< 是否发现环被破坏
+    qint64 m_spinNs;            ///< 读空后的自旋时间（纳秒）
+};
+
+#endif // SHAREDMEMORYCHANNEL_H
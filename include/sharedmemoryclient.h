@@ -0,0 +1,122 @@
+#ifndef SHAREDMEMORYCLIENT_H
+#define SHAREDMEMORYCLIENT_H
+
+#include <QObject>
+#include <QLocalSocket>
+
+#include <functional>
+
+#include "message.h"
+#include "messageframehandler.h"
+#include "sharedmemorychannel.h"
+
+/**
+ * @brief 共享内存通道的客户端一侧，由 Publisher 和 Subscriber 共用
+ *
+ * 负责握手中客户端的步骤（见 SharedMemoryChannel）：连接建立后 request() 创建共享内存
+ * 并发送 $SYS/SHM，收到的回复交给 handleReply()，Broker接受时发送 $SYS/SHMREADY 并切换。
+ * 切换之后本地套接字的 readyRead 交给 readSocket()，它处理门铃并把共享内存中的帧交给
+ * 帧处理器；发送通过 write() 写入通道。
+ *
+ * Broker破坏了共享内存中的环时发出 error 信号并中断本地套接字，持有方按断开连接处理。
+ */
+class SharedMemoryClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief 发送控制消息的函数，返回是否发送成功
+     */
+    typedef std::function<bool(const Message&)> MessageSender;
+
+    /**
+     * @brief 构造函数
+     * @param frameHandler 接收共享内存中帧的帧处理器
+     * @param sender 发送握手消息的函数
+     * @param parent 父对象
+     */
+    SharedMemoryClient(MessageFrameHandler* frameHandler, const MessageSender& sender, QObject* parent = nullptr);
+
+    /**
+     * @brief 析构函数，关闭通道
+     */
+    ~SharedMemoryClient() override;
+
+    /**
+     * @brief 设置是否使用共享内存通道，只对之后建立的连接生效
+     * @param enabled 是否启用
+     * @param spinMicroseconds 读空后自旋等待的时间（微秒）
+     */
+    void setEnabled(bool enabled, int spinMicroseconds = 0);
+
+    /**
+     * @brief 是否启用共享内存通道
+     * @return 是否启用
+     */
+    bool isEnabled() const;
+
+    /**
+     * @brief 当前连接是否已经切换到共享内存通道
+     * @return 是否已切换
+     */
+    bool isActive() const;
+
+    /**
+     * @brief 创建共享内存并向Broker请求共享内存通道
+     * @param socket 已连接的本地套接字，之后用作门铃
+     */
+    void request(QLocalSocket* socket);
+
+    /**
+     * @brief 处理Broker对 $SYS/SHM 的回复
+     * @param reply 回复消息，负载 "1" 表示接受
+     */
+    void handleReply(const Message& reply);
+
+    /**
+     * @brief 处理本地套接字上的数据：切换之前按帧读取，之后处理门铃并读空共享内存
+     * @param socket 本地套接字
+     */
+    void readSocket(QLocalSocket* socket);
+
+    /**
+     * @brief 写入共享内存通道（只能在切换之后调用）
+     * @param data 数据
+     * @return 写入的字节数，失败时返回 -1
+     */
+    qint64 write(const QByteArray& data);
+
+    /**
+     * @brief 关闭共享内存通道，连接断开时调用
+     */
+    void close();
+
+signals:
+    /**
+     * @brief 错误信号
+     * @param errorMessage 错误信息
+     */
+    void error(const QString& errorMessage);
+
+private:
+    /**
+     * @brief 读取共享内存中的帧，直到读空
+     */
+    void readChannel();
+
+    /**
+     * @brief 通道损坏：报告错误并中断本地套接字
+     */
+    void handleBroken();
+
+private:
+    MessageFrameHandler* m_frameHandler;    ///< 帧处理器
+    MessageSender m_sender;                 ///< 发送握手消息的函数
+    bool m_enabled;                         ///< 是否使用共享内存通道
+    int m_spin;                             ///< 读空后的自旋时间（微秒）
+    QLocalSocket* m_socket;                 ///< 门铃使用的本地套接字，通道存在时有效
+    SharedMemoryChannel* m_channel;         ///< 共享内存通道，未使用时为 nullptr
+};
+
+#endif // SHAREDMEMORYCLIENT_H
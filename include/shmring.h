@@ -0,0 +1,126 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <QtGlobal>
+
+#include <atomic>
+
+/**
+ * @brief 位于共享内存中的单生产者单消费者字节环
+ *
+ * 环的头部（读写位置和等待标志）和数据区都在调用方提供的内存中，两个进程各自
+ * 映射同一段内存后，一方只调用生产者接口，另一方只调用消费者接口。读写位置是
+ * 单调递增的64位计数，容量是2的幂，下标取模只需要一次按位与。
+ *
+ * 环本身不负责唤醒：消费者读空后调用 setConsumerWaiting() 登记等待，生产者写入后
+ * 用 takeConsumerWaiting() 判断是否需要通知对方；生产者等待空间时的方向同理。
+ * 登记和检查之间都有一次全序栅栏，不会丢失唤醒。
+ *
+ * 读写位置都在对端可以修改的内存中，每次读写先检查已用字节数不超过容量，
+ * 不一致时环被标记为损坏，之后的读写都返回 -1，调用方应断开对端。
+ */
+class ShmRing
+{
+public:
+    /**
+     * @brief 计算指定容量的环需要的内存大小（头部加数据区）
+     * @param capacity 数据区容量，必须是2的幂
+     * @return 字节数
+     */
+    static qint64 requiredSize(quint32 capacity);
+
+    /**
+     * @brief 构造函数，调用 initialize() 或 attach() 之前环不可用
+     */
+    ShmRing();
+
+    /**
+     * @brief 在内存中初始化一个空环（由创建共享内存的一方调用一次）
+     * @param memory 内存起始地址，至少 requiredSize(capacity) 字节，按缓存行对齐
+     * @param capacity 数据区容量，必须是2的幂
+     */
+    void initialize(char* memory, quint32 capacity);
+
+    /**
+     * @brief 使用已经初始化的环
+     * @param memory 内存起始地址
+     * @param size 可用的内存大小
+     * @return 头部是否有效且数据区在内存范围内
+     */
+    bool attach(char* memory, qint64 size);
+
+    /**
+     * @brief 获取数据区容量
+     * @return 字节数
+     */
+    quint32 capacity() const;
+
+    /**
+     * @brief 是否发现对端破坏了读写位置
+     * @return 是否已损坏
+     */
+    bool isBroken() const;
+
+    /**
+     * @brief 写入数据（只能由生产者调用）
+     * @param data 数据
+     * @param size 字节数
+     * @return 实际写入的字节数，空间不足时只写入一部分；环已损坏时返回 -1
+     */
+    qint64 write(const char* data, qint64 size);
+
+    /**
+     * @brief 写入之后调用：消费者是否登记了等待，是则清除登记（只能由生产者调用）
+     * @return 是否需要唤醒消费者
+     */
+    bool takeConsumerWaiting();
+
+    /**
+     * @brief 登记等待空间，登记之后需要再尝试写一次（只能由生产者调用）
+     */
+    void setProducerWaiting();
+
+    /**
+     * @brief 读取数据（只能由消费者调用）
+     * @param data 输出缓冲区
+     * @param maxSize 最多读取的字节数
+     * @return 实际读取的字节数；环已损坏时返回 -1
+     */
+    qint64 read(char* data, qint64 maxSize);
+
+    /**
+     * @brief 获取可读的字节数（只能由消费者调用）
+     * @return 字节数，环已损坏时为0
+     */
+    qint64 bytesAvailable() const;
+
+    /**
+     * @brief 登记等待数据，登记之后需要再尝试读一次（只能由消费者调用）
+     */
+    void setConsumerWaiting();
+
+    /**
+     * @brief 读取之后调用：生产者是否登记了等待空间，是则清除登记（只能由消费者调用）
+     * @return 是否需要唤醒生产者
+     */
+    bool takeProducerWaiting();
+
+private:
+    struct Header;
+
+    /**
+     * @brief 计算已用字节数并检查是否超过容量，超过时标记损坏
+     * @param head 写位置
+     * @param tail 读位置
+     * @param used 输出已用字节数
+     * @return 位置是否一致
+     */
+    bool checkUsed(quint64 head, quint64 tail, quint64* used);
+
+    Header* m_header;   ///< 共享内存中的头部
+    char* m_data;       ///< 共享内存中的数据区
+    quint64 m_mask;     ///< 容量减一
+    bool m_broken;      ///< 是否发现读写位置被破坏
+};
+
+#endif // SHMRING_H
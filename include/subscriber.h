@@ -10,7 +10,11 @@
 
 #include "message.h"
 #include "topic.h"
+#include "topictrie.h"
+#include "subscriptionoptions.h"
 #include "messageframehandler.h"
+#include "sharedmemoryclient.h"
+#include "keepalivemonitor.h"
 
 /**
  * @brief Subscriber类，用于订阅和接收消息
@@ -59,14 +63,25 @@ public:
 
     /**
      * @brief 订阅主题
-     * @param topic 主题
+     *
+     * 支持通配符：'+' 匹配一层，'#' 匹配其后的所有层（只能位于最后一层），
+     * 例如 "sensors/+/temp" 或 "sensors/#"。
+     * @param topic 主题或通配符模式
      * @return 是否订阅成功
      */
     bool subscribe(const QString& topic);
 
+    /**
+     * @brief 使用指定选项订阅主题
+     * @param topic 主题或通配符模式
+     * @param options 订阅选项（例如读取跟不上时Broker的溢出策略）
+     * @return 是否订阅成功
+     */
+    bool subscribe(const QString& topic, const SubscriptionOptions& options);
+
     /**
      * @brief 取消订阅主题
-     * @param topic 主题
+     * @param topic 主题或通配符模式（必须与订阅时相同）
      * @return 是否取消订阅成功
      */
     bool unsubscribe(const QString& topic);
@@ -77,6 +92,15 @@ public:
      */
     QSet<QString> subscribedTopics() const;
 
+    /**
+     * @brief 获取收到的最后一条消息的主题序号
+     *
+     * 重连后重新订阅时，每个主题从该序号的下一条继续，不会重复回放已经收到的消息。
+     * @param topic 具体主题
+     * @return 主题序号，尚未收到带序号的消息时返回-1
+     */
+    qint64 lastSequence(const QString& topic) const;
+
     /**
      * @brief 设置自动重连
      * @param enable 是否启用
@@ -84,6 +108,67 @@ public:
      */
     void setAutoReconnect(bool enable, int interval = 5000);
 
+    /**
+     * @brief 设置是否以主题别名接收消息
+     *
+     * 启用后Broker在第一次向本连接发送某个主题时通知其别名，之后的消息帧只携带4字节别名，
+     * 收到的消息仍然带有完整主题。只在协商到 V2 协议的连接上生效。
+     * @param enabled 是否启用
+     */
+    void setTopicAliasesEnabled(bool enabled);
+
+    /**
+     * @brief 是否以主题别名接收消息
+     * @return 是否启用
+     */
+    bool topicAliasesEnabled() const;
+
+    /**
+     * @brief 设置心跳间隔
+     *
+     * 连接建立后向Broker协商心跳间隔，Broker把连接的空闲超时设为 1.5 倍的间隔。
+     * 连接在一个间隔内没有写出任何数据时发送只有帧头的心跳帧，安静的连接不会因空闲被断开；
+     * 心跳发出后一个间隔内没有收到Broker的任何数据时认为连接已经失效，主动断开（可自动重连）。
+     * 不支持心跳的Broker不回复协商，此时不发送心跳。
+     * @param seconds 心跳间隔（秒），0 表示不使用心跳
+     */
+    void setKeepAlive(int seconds);
+
+    /**
+     * @brief 获取请求的心跳间隔
+     * @return 心跳间隔（秒）
+     */
+    int keepAlive() const;
+
+    /**
+     * @brief 获取与Broker协商的心跳间隔
+     * @return 心跳间隔（秒），未连接或Broker不支持时为0
+     */
+    int negotiatedKeepAlive() const;
+
+    /**
+     * @brief 设置连接本地Broker时是否使用共享内存通道
+     *
+     * 启用后 connectToLocalBroker() 建立连接后创建共享内存并与Broker握手，成功后消息帧
+     * 经过共享内存中的环收发，本地套接字只用于唤醒；Broker拒绝时继续使用本地套接字。
+     * 只对之后建立的连接生效。
+     * @param enabled 是否启用
+     * @param spinMicroseconds 读空后自旋等待的时间（微秒），用CPU换取更低的延迟
+     */
+    void setSharedMemoryEnabled(bool enabled, int spinMicroseconds = 0);
+
+    /**
+     * @brief 是否启用共享内存通道
+     * @return 是否启用
+     */
+    bool sharedMemoryEnabled() const;
+
+    /**
+     * @brief 当前连接是否已经切换到共享内存通道
+     * @return 是否已切换
+     */
+    bool isUsingSharedMemory() const;
+
 signals:
     /**
      * @brief 连接成功信号
@@ -97,6 +182,8 @@ signals:
 
     /**
      * @brief 收到消息信号
+     *
+     * 同一连接上每个主题的消息按序号递增发出，序号不大于已收到序号的重复帧被丢弃。
      * @param message 消息
      */
     void messageReceived(const Message& message);
@@ -157,17 +244,43 @@ private slots:
      */
     void tryReconnect();
 
+    /**
+     * @brief 帧长度非法时中断连接
+     * @param errorMessage 错误信息
+     */
+    void handleProtocolError(const QString& errorMessage);
+
+    /**
+     * @brief 心跳没有回应：报告错误并断开连接
+     */
+    void handleKeepAliveTimeout();
+
 private:
+    /**
+     * @brief 发送协议协商请求，收到Broker回复后切换到协商的协议版本
+     */
+    void sendHello();
+
     /**
      * @brief 注册为订阅者
      */
     void registerAsSubscriber();
 
     /**
-     * @brief 重新订阅所有主题
+     * @brief 重新订阅所有主题，已收到过消息的主题从最后的序号之后续传
      */
     void resubscribeAll();
 
+    /**
+     * @brief 通知Broker是否以主题别名发送消息
+     */
+    void sendTopicAliasesRequest();
+
+    /**
+     * @brief 向Broker协商心跳间隔
+     */
+    void sendKeepAliveRequest();
+
     /**
      * @brief 发送消息到Broker
      * @param message 消息
@@ -175,6 +288,13 @@ private:
      */
     bool sendMessage(const Message& message);
 
+    /**
+     * @brief 写出已编码的数据并立即发送
+     * @param data 数据
+     * @return 是否完整写出
+     */
+    bool writeData(const QByteArray& data);
+
     // processReceivedData 方法已经被 MessageFrameHandler 替代
 
 private:
@@ -185,11 +305,19 @@ private:
     QString m_serverName;                   ///< 服务器名称
     bool m_useLocalSocket;                  ///< 是否使用本地套接字
     QSet<QString> m_subscribedTopics;       ///< 已订阅的主题
+    TopicTrie<bool> m_topicFilter;          ///< 已订阅主题的前缀树，用于过滤收到的消息
+    QHash<QString, SubscriptionOptions> m_subscriptionOptions; ///< 订阅选项，重连后重新订阅时使用
+    QHash<QString, qint64> m_lastSequences; ///< 每个具体主题收到的最后一条消息的序号
+    QHash<QString, qint64> m_receivedSequences; ///< 本次连接上每个具体主题收到的最大序号，用于丢弃重复的帧
     bool m_autoReconnect;                   ///< 是否自动重连
     int m_reconnectInterval;                ///< 重连间隔
     QTimer* m_reconnectTimer;               ///< 重连定时器
     bool m_registered;                      ///< 是否已注册为订阅者
     MessageFrameHandler* m_frameHandler;     ///< 消息帧处理器
+    Message::ProtocolVersion m_protocolVersion; ///< 协商后的线路协议版本
+    bool m_topicAliasesEnabled;             ///< 是否以主题别名接收消息
+    SharedMemoryClient* m_sharedMemory;     ///< 共享内存通道的客户端一侧
+    KeepAliveMonitor* m_keepAliveMonitor;   ///< 心跳协商和检测
 };
 
 #endif // SUBSCRIBER_H
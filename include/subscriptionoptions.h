@@ -0,0 +1,119 @@
+#ifndef SUBSCRIPTIONOPTIONS_H
+#define SUBSCRIPTIONOPTIONS_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+
+/**
+ * @brief 订阅选项，随 $SYS/SUBSCRIBE 请求一起发送
+ *
+ * 请求负载的第一行是主题，之后每行一个 "key=value" 选项：
+ * @code
+ * sensors/+/temp
+ * overflow=conflate
+ * start=last:10
+ * resume=1043:sensors/line1/temp
+ * @endcode
+ * 只有主题一行的负载与旧版本客户端的订阅请求完全相同。未知的选项会被忽略。
+ */
+struct SubscriptionOptions
+{
+    /**
+     * @brief 订阅者跟不上发布速度、发送队列已满时的处理策略
+     */
+    enum OverflowPolicy {
+        DefaultPolicy,   ///< 使用Broker的默认策略
+        DropOldest,      ///< 丢弃队列中最旧的消息
+        DropNewest,      ///< 丢弃新消息
+        ConflateLatest,  ///< 每个主题只保留最新的一条待发送消息
+        Disconnect       ///< 断开订阅者
+    };
+
+    /**
+     * @brief 订阅时回放历史消息的起始位置
+     */
+    enum StartPosition {
+        StartFromCache,     ///< 回放Broker缓存的全部消息（旧版本的行为）
+        StartNewOnly,       ///< 不回放，只接收之后发布的消息
+        StartFromOffset,    ///< 从指定的主题序号开始
+        StartFromTime,      ///< 从时间戳不早于指定时间的第一条消息开始
+        StartLastN          ///< 回放每个主题最新的N条消息
+    };
+
+    /**
+     * @brief 构造函数
+     * @param policy 溢出策略
+     */
+    explicit SubscriptionOptions(OverflowPolicy policy = DefaultPolicy);
+
+    /**
+     * @brief 只接收新消息的订阅选项
+     * @return 订阅选项
+     */
+    static SubscriptionOptions newOnly();
+
+    /**
+     * @brief 从指定主题序号开始回放的订阅选项
+     * @param offset 主题序号（包含）
+     * @return 订阅选项
+     */
+    static SubscriptionOptions fromOffset(qint64 offset);
+
+    /**
+     * @brief 从指定时间开始回放的订阅选项
+     * @param timestampNs 自纪元起的纳秒数
+     * @return 订阅选项
+     */
+    static SubscriptionOptions fromTimestamp(qint64 timestampNs);
+
+    /**
+     * @brief 回放最新N条消息的订阅选项
+     * @param count 每个主题回放的消息数
+     * @return 订阅选项
+     */
+    static SubscriptionOptions lastN(int count);
+
+    /**
+     * @brief 编码为订阅请求负载
+     * @param topic 主题或通配符模式
+     * @return 请求负载
+     */
+    QByteArray toPayload(const QString& topic) const;
+
+    /**
+     * @brief 从订阅请求负载解析主题和选项
+     * @param payload 请求负载
+     * @param topic 输出参数，主题或通配符模式
+     * @return 订阅选项
+     */
+    static SubscriptionOptions fromPayload(const QByteArray& payload, QString* topic);
+
+    /**
+     * @brief 溢出策略转换为选项值
+     * @param policy 溢出策略
+     * @return 选项值，例如 "drop-oldest"
+     */
+    static QString policyName(OverflowPolicy policy);
+
+    /**
+     * @brief 选项值转换为溢出策略
+     * @param name 选项值
+     * @return 溢出策略，无法识别时返回 DefaultPolicy
+     */
+    static OverflowPolicy policyFromName(const QString& name);
+
+    OverflowPolicy overflowPolicy;  ///< 溢出策略
+    StartPosition startPosition;    ///< 回放起始位置
+    qint64 startValue;              ///< 起始序号、纳秒时间戳或消息数，取决于 startPosition
+
+    /**
+     * @brief 续传位置：主题 -> 下一条需要的序号
+     *
+     * 重连时由 Subscriber 自动填写，列出的主题从该序号继续，优先于 startPosition；
+     * 通配符订阅的每个具体主题各有一项。
+     */
+    QHash<QString, qint64> resumeOffsets;
+};
+
+#endif // SUBSCRIPTIONOPTIONS_H
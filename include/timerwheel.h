@@ -0,0 +1,132 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QtGlobal>
+#include <QVector>
+
+#include "clienttable.h"
+
+/**
+ * @brief 按客户端句柄登记超时的分层时间轮
+ *
+ * 时间以整数节拍表示（由使用者决定节拍的长度）。共4层，每层64个槽：第0层的槽对应
+ * 未来64个节拍中的一个，第 n 层的槽对应 64^n 个节拍，最远可以登记 64^4 - 1 个节拍之后。
+ * 高层的槽到期时把其中的条目重新放入低层（级联），每个条目最多级联3次。
+ * 登记和取消都是 O(1)；推进时只访问到期的槽，工作量与到期的条目数成正比，与登记总数无关。
+ *
+ * 条目按句柄的槽位下标直接索引，每个句柄最多登记一个超时。只能在一个线程中使用。
+ */
+class TimerWheel
+{
+public:
+    static const int kLevels = 4;                   ///< 层数
+    static const int kSlotBits = 6;                 ///< 每层槽数的位数
+    static const int kSlots = 1 << kSlotBits;       ///< 每层槽数
+    static const quint64 kMaxDelay = (quint64(1) << (kSlotBits * kLevels)) - 1; ///< 最远的超时（节拍）
+
+    /**
+     * @brief 构造函数
+     * @param now 当前节拍
+     */
+    explicit TimerWheel(quint64 now = 0);
+
+    /**
+     * @brief 登记或重新登记句柄的超时
+     * @param handle 客户端句柄
+     * @param expiry 到期节拍，不晚于当前节拍的按下一个节拍处理，超过 kMaxDelay 的按 kMaxDelay 处理
+     */
+    void schedule(ClientHandle handle, quint64 expiry);
+
+    /**
+     * @brief 取消句柄的超时
+     * @param handle 客户端句柄
+     * @return 是否登记过
+     */
+    bool cancel(ClientHandle handle);
+
+    /**
+     * @brief 句柄是否登记了超时
+     * @param handle 客户端句柄
+     * @return 是否登记
+     */
+    bool contains(ClientHandle handle) const;
+
+    /**
+     * @brief 获取句柄的到期节拍
+     * @param handle 客户端句柄
+     * @return 到期节拍，没有登记时返回0
+     */
+    quint64 expiry(ClientHandle handle) const;
+
+    /**
+     * @brief 推进到指定节拍，取出期间到期的句柄
+     *
+     * 取出的句柄不再登记，使用者可以重新登记。
+     * @param now 当前节拍，早于时间轮的节拍时不做任何事
+     * @param expired 输出参数，追加到期的句柄（按到期节拍排序）
+     */
+    void advance(quint64 now, QVector<ClientHandle>* expired);
+
+    /**
+     * @brief 获取时间轮的当前节拍
+     * @return 节拍
+     */
+    quint64 now() const;
+
+    /**
+     * @brief 获取登记的句柄数量
+     * @return 数量
+     */
+    int size() const;
+
+    /**
+     * @brief 是否没有登记的句柄
+     * @return 是否为空
+     */
+    bool isEmpty() const;
+
+private:
+    struct Node {
+        ClientHandle handle;    ///< 登记的句柄，未登记时为 InvalidHandle
+        quint64 expiry;         ///< 到期节拍
+        int slot;               ///< 所在的槽（层 * kSlots + 槽号）
+        int prev;               ///< 同一槽中的前一个条目，-1 表示没有
+        int next;               ///< 同一槽中的后一个条目，-1 表示没有
+    };
+
+    static const quint64 kSlotMask = kSlots - 1;
+    static const quint32 kIndexMask = (1u << ClientTable::kIndexBits) - 1;
+
+    /**
+     * @brief 按到期节拍和当前节拍把条目放入对应的槽
+     * @param index 条目下标
+     */
+    void link(int index);
+
+    /**
+     * @brief 把条目从所在的槽中摘下
+     * @param index 条目下标
+     */
+    void unlink(int index);
+
+    /**
+     * @brief 把一个槽中的条目重新放入低层
+     * @param level 层
+     * @param slot 槽号
+     */
+    void cascade(int level, int slot);
+
+    /**
+     * @brief 查找句柄对应的已登记条目
+     * @param handle 客户端句柄
+     * @return 条目下标，没有登记时返回 -1
+     */
+    int find(ClientHandle handle) const;
+
+    QVector<Node> m_nodes;  ///< 按句柄的槽位下标索引的条目
+    QVector<int> m_slots;   ///< 每个槽的第一个条目，-1 表示空槽
+    quint64 m_now;          ///< 当前节拍
+    int m_size;             ///< 登记的句柄数量
+};
+
+#endif // TIMERWHEEL_H
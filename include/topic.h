@@ -88,6 +88,30 @@ public:
      */
     bool operator!=(const Topic& other) const;
 
+    /**
+     * @brief 判断订阅模式是否包含通配符（'+' 或 '#'）
+     * @param pattern 订阅模式
+     * @return 是否包含通配符
+     */
+    static bool isWildcard(const QString& pattern);
+
+    /**
+     * @brief 判断订阅模式是否合法
+     *
+     * 通配符必须独占一层，'#' 只能出现在最后一层。
+     * @param pattern 订阅模式
+     * @return 是否合法
+     */
+    static bool isValidPattern(const QString& pattern);
+
+    /**
+     * @brief 判断具体主题是否与订阅模式匹配，语义与 TopicTrie 相同
+     * @param pattern 订阅模式
+     * @param topicName 具体主题
+     * @return 是否匹配
+     */
+    static bool matches(const QString& pattern, const QString& topicName);
+
 private:
     QString m_name;                     ///< 主题名称
     QString m_dataType;                 ///< 数据类型
@@ -0,0 +1,78 @@
+#ifndef TOPICREGISTRY_H
+#define TOPICREGISTRY_H
+
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QReadWriteLock>
+
+/**
+ * @brief 驻留主题的编号，从1开始连续分配，0 永远无效
+ */
+typedef quint32 TopicId;
+
+/**
+ * @brief 主题驻留表：把具体主题映射为32位编号（线程安全）
+ *
+ * 同一主题在Broker的整个生命周期内只分配一次编号，编号可以直接作为数组下标，
+ * 路由缓存、消息缓存和发给订阅者的主题别名都使用它。编号不会回收，
+ * 因此驻留表的大小等于出现过的不同主题数；设置上限后，达到上限时新主题不再分配编号，
+ * 按编号索引的各种表也随之有界。
+ */
+class TopicRegistry
+{
+public:
+    static const TopicId InvalidTopic = 0;  ///< 无效编号
+
+    /**
+     * @brief 构造函数
+     */
+    TopicRegistry();
+
+    /**
+     * @brief 获取主题的编号，第一次出现的主题分配新编号
+     * @param topic 具体主题
+     * @return 主题编号；主题为空或驻留表已满时返回 InvalidTopic
+     */
+    TopicId intern(const QString& topic);
+
+    /**
+     * @brief 查找主题的编号，不分配
+     * @param topic 具体主题
+     * @return 主题编号，未驻留时返回 InvalidTopic
+     */
+    TopicId find(const QString& topic) const;
+
+    /**
+     * @brief 按编号获取主题
+     * @param id 主题编号
+     * @return 主题，编号无效时返回空字符串
+     */
+    QString name(TopicId id) const;
+
+    /**
+     * @brief 获取已驻留的主题数
+     * @return 主题数
+     */
+    int size() const;
+
+    /**
+     * @brief 设置最多驻留的主题数，已驻留的主题不受影响
+     * @param maxSize 最大主题数，0 表示不限制
+     */
+    void setMaxSize(int maxSize);
+
+    /**
+     * @brief 获取最多驻留的主题数
+     * @return 最大主题数，0 表示不限制
+     */
+    int maxSize() const;
+
+private:
+    mutable QReadWriteLock m_lock;  ///< 读写锁，已驻留的主题只加读锁
+    QHash<QString, TopicId> m_ids;  ///< 主题到编号
+    QVector<QString> m_names;       ///< 编号减一为下标的主题
+    int m_maxSize;                  ///< 最多驻留的主题数，0 表示不限制
+};
+
+#endif // TOPICREGISTRY_H
@@ -0,0 +1,303 @@
+#ifndef TOPICTRIE_H
+#define TOPICTRIE_H
+
+#include <QString>
+#include <QHash>
+
+/**
+ * @brief 按 '/' 分层的主题前缀树，支持 MQTT 风格的通配符订阅
+ *
+ * 每个订阅模式对应树上的一个节点，节点上保存类型为 T 的值（例如订阅者集合）。
+ * 模式中的 '+' 匹配恰好一层，'#' 只能出现在最后一层，匹配零层或多层。
+ * 以 '$' 开头的主题不会被首层通配符匹配（与 MQTT 一致，$SYS/ 主题需要显式订阅）。
+ *
+ * 匹配一个具体主题的开销与主题层数成正比，与模式数量无关。
+ * 本类不是线程安全的，由使用者负责加锁。
+ */
+template <typename T>
+class TopicTrie
+{
+public:
+    /**
+     * @brief 构造函数
+     */
+    TopicTrie()
+        : m_root(new Node())
+        , m_size(0)
+    {
+    }
+
+    /**
+     * @brief 析构函数
+     */
+    ~TopicTrie()
+    {
+        delete m_root;
+    }
+
+    /**
+     * @brief 获取模式对应的值，模式不存在时创建
+     * @param pattern 订阅模式
+     * @return 值的引用
+     */
+    T& insert(const QString& pattern)
+    {
+        Node* node = m_root;
+        forEachLevel(pattern, [&node](const QString& level) {
+            Node*& child = node->childSlot(level);
+            if (!child) {
+                child = new Node();
+            }
+            node = child;
+        });
+
+        if (!node->hasValue) {
+            node->hasValue = true;
+            ++m_size;
+        }
+        return node->value;
+    }
+
+    /**
+     * @brief 查找模式对应的值
+     * @param pattern 订阅模式
+     * @return 值的指针，模式不存在时返回 nullptr
+     */
+    T* find(const QString& pattern)
+    {
+        Node* node = findNode(pattern);
+        return node && node->hasValue ? &node->value : nullptr;
+    }
+
+    /**
+     * @brief 删除模式及其值，并回收不再使用的分支
+     * @param pattern 订阅模式
+     * @return 模式是否存在
+     */
+    bool remove(const QString& pattern)
+    {
+        Node* node = findNode(pattern);
+        if (!node || !node->hasValue) {
+            return false;
+        }
+
+        node->hasValue = false;
+        node->value = T();
+        --m_size;
+        prune(m_root, pattern, 0);
+        return true;
+    }
+
+    /**
+     * @brief 对所有与主题匹配的模式调用访问函数
+     * @param topic 具体主题（不含通配符）
+     * @param visit 访问函数，参数为 const T&
+     */
+    template <typename Visitor>
+    void match(const QString& topic, Visitor visit) const
+    {
+        matchLevel(m_root, topic, 0, true, visit);
+    }
+
+    /**
+     * @brief 是否有任意模式与主题匹配
+     * @param topic 具体主题
+     * @return 是否匹配
+     */
+    bool matches(const QString& topic) const
+    {
+        bool matched = false;
+        match(topic, [&matched](const T&) { matched = true; });
+        return matched;
+    }
+
+    /**
+     * @brief 获取模式数量
+     * @return 模式数量
+     */
+    int size() const
+    {
+        return m_size;
+    }
+
+    /**
+     * @brief 是否为空
+     * @return 是否为空
+     */
+    bool isEmpty() const
+    {
+        return m_size == 0;
+    }
+
+    /**
+     * @brief 清空所有模式
+     */
+    void clear()
+    {
+        delete m_root;
+        m_root = new Node();
+        m_size = 0;
+    }
+
+private:
+    struct Node {
+        Node()
+            : singleLevel(nullptr)
+            , multiLevel(nullptr)
+            , hasValue(false)
+            , value()
+        {
+        }
+
+        ~Node()
+        {
+            qDeleteAll(children);
+            delete singleLevel;
+            delete multiLevel;
+        }
+
+        Node*& childSlot(const QString& level)
+        {
+            if (level == QLatin1String("+")) {
+                return singleLevel;
+            }
+            if (level == QLatin1String("#")) {
+                return multiLevel;
+            }
+
+            // 层名可能是视图，作为键保存前复制一份
+            auto it = children.find(level);
+            if (it == children.end()) {
+                it = children.insert(QString(level.constData(), level.size()), nullptr);
+            }
+            return it.value();
+        }
+
+        Node* child(const QString& level) const
+        {
+            if (level == QLatin1String("+")) {
+                return singleLevel;
+            }
+            if (level == QLatin1String("#")) {
+                return multiLevel;
+            }
+            return children.value(level);
+        }
+
+        bool isUnused() const
+        {
+            return !hasValue && !singleLevel && !multiLevel && children.isEmpty();
+        }
+
+        QHash<QString, Node*> children; ///< 普通层级的子节点
+        Node* singleLevel;              ///< '+' 子节点
+        Node* multiLevel;               ///< '#' 子节点
+        bool hasValue;                  ///< 是否有模式终止于此节点
+        T value;                        ///< 模式对应的值
+
+        Node(const Node&) = delete;
+        Node& operator=(const Node&) = delete;
+    };
+
+    /**
+     * @brief 按层遍历主题，层名是指向原字符串的视图，不分配内存
+     */
+    template <typename Function>
+    static void forEachLevel(const QString& topic, Function function)
+    {
+        int pos = 0;
+        while (true) {
+            int end = topic.indexOf(QLatin1Char('/'), pos);
+            if (end < 0) {
+                end = topic.size();
+            }
+            function(QString::fromRawData(topic.constData() + pos, end - pos));
+            if (end == topic.size()) {
+                break;
+            }
+            pos = end + 1;
+        }
+    }
+
+    Node* findNode(const QString& pattern) const
+    {
+        Node* node = m_root;
+        forEachLevel(pattern, [&node](const QString& level) {
+            if (node) {
+                node = node->child(level);
+            }
+        });
+        return node;
+    }
+
+    /**
+     * @brief 沿模式路径回收空节点
+     * @return 节点是否可以被父节点删除
+     */
+    static bool prune(Node* node, const QString& pattern, int pos)
+    {
+        if (pos > pattern.size()) {
+            return node->isUnused();
+        }
+
+        int end = pattern.indexOf(QLatin1Char('/'), pos);
+        if (end < 0) {
+            end = pattern.size();
+        }
+
+        const QString level = QString::fromRawData(pattern.constData() + pos, end - pos);
+        Node*& child = node->childSlot(level);
+        if (child && prune(child, pattern, end + 1)) {
+            delete child;
+            child = nullptr;
+            if (level != QLatin1String("+") && level != QLatin1String("#")) {
+                node->children.remove(level);
+            }
+        }
+        return node->isUnused();
+    }
+
+    /**
+     * @brief 递归匹配，pos 超过主题长度表示所有层都已消耗
+     */
+    template <typename Visitor>
+    static void matchLevel(const Node* node, const QString& topic, int pos, bool firstLevel, Visitor& visit)
+    {
+        const bool wildcardAllowed = !(firstLevel && topic.startsWith(QLatin1Char('$')));
+
+        // '#' 匹配剩余的零层或多层
+        if (node->multiLevel && node->multiLevel->hasValue && wildcardAllowed) {
+            visit(node->multiLevel->value);
+        }
+
+        if (pos > topic.size()) {
+            if (node->hasValue) {
+                visit(node->value);
+            }
+            return;
+        }
+
+        int end = topic.indexOf(QLatin1Char('/'), pos);
+        if (end < 0) {
+            end = topic.size();
+        }
+
+        const QString level = QString::fromRawData(topic.constData() + pos, end - pos);
+        const Node* child = node->children.value(level);
+        if (child) {
+            matchLevel(child, topic, end + 1, false, visit);
+        }
+
+        if (node->singleLevel && wildcardAllowed) {
+            matchLevel(node->singleLevel, topic, end + 1, false, visit);
+        }
+    }
+
+    TopicTrie(const TopicTrie&) = delete;
+    TopicTrie& operator=(const TopicTrie&) = delete;
+
+    Node* m_root;   ///< 根节点
+    int m_size;     ///< 模式数量
+};
+
+#endif // TOPICTRIE_H
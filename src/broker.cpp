@@ -1,6 +1,57 @@
 #include "broker.h"
+#include "brokerworker.h"
+#include "epollpoller.h"
 #include "logger.h"
 
+#include <QMetaMethod>
+
+#include <climits>
+#include <utility>
+
+/**
+ * @brief 只接受连接、不创建套接字的TCP服务器，描述符交给I/O线程
+ */
+class Broker::TcpServer : public QTcpServer
+{
+public:
+    explicit TcpServer(Broker* broker)
+        : QTcpServer(broker)
+        , m_broker(broker)
+    {
+    }
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        m_broker->dispatchConnection(socketDescriptor, false);
+    }
+
+private:
+    Broker* m_broker;
+};
+
+/**
+ * @brief 只接受连接、不创建套接字的本地服务器，描述符交给I/O线程
+ */
+class Broker::LocalServer : public QLocalServer
+{
+public:
+    explicit LocalServer(Broker* broker)
+        : QLocalServer(broker)
+        , m_broker(broker)
+    {
+    }
+
+protected:
+    void incomingConnection(quintptr socketDescriptor) override
+    {
+        m_broker->dispatchConnection(socketDescriptor, true);
+    }
+
+private:
+    Broker* m_broker;
+};
+
 // 初始化静态成员变量
 Broker* Broker::m_instance = nullptr;
 
@@ -14,38 +65,45 @@ Broker* Broker::instance()
 
 Broker::Broker(QObject* parent)
     : QObject(parent)
-    , m_tcpServer(new QTcpServer(this))
-    , m_localServer(new QLocalServer(this))
-    , m_clientsMutex(new QMutex())
-    , m_cacheMutex(new QMutex())
-    , m_activityTimer(new QTimer(this))
+    , m_tcpServer(new TcpServer(this))
+    , m_localServer(new LocalServer(this))
+    , m_ioThreadCount(qMax(1, QThread::idealThreadCount()))
+    , m_dispatchPolicy(RoundRobin)
+    , m_ioBackend(QtBackend)
+    , m_nextWorker(0)
+    , m_routingGeneration(1)
+    , m_routingLock(new QReadWriteLock())
+    , m_messageLog(nullptr)
     , m_cacheSize(100)
+    , m_outboundMaxMessages(10000)
+    , m_outboundMaxBytes(16 * 1024 * 1024)
+    , m_idleTimeout(60)
+    , m_defaultOverflowPolicy(SubscriptionOptions::DropOldest)
+    , m_statsTimer(new QTimer(this))
     , m_running(false)
 {
     // 注册元类型，使其可以在信号槽中使用
     qRegisterMetaType<Message>("Message");
     qRegisterMetaType<Topic>("Topic");
 
-    // 连接信号槽
-    connect(m_tcpServer, &QTcpServer::newConnection, this, &Broker::handleNewTcpConnection);
-    connect(m_localServer, &QLocalServer::newConnection, this, &Broker::handleNewLocalConnection);
+    // 默认每10秒发布一次统计，没有订阅者时只查一次路由缓存
+    m_statsTimer->setInterval(10000);
+    connect(m_statsTimer, &QTimer::timeout, this, [this]() { publishStats(); });
 
-    // 设置活动检查定时器
-    connect(m_activityTimer, &QTimer::timeout, this, &Broker::checkClientActivity);
-    m_activityTimer->setInterval(30000); // 30秒检查一次
+    m_topicRegistry.setMaxSize(1000000);
 }
 
 Broker::~Broker()
 {
     stop();
+    disablePersistence();
 
-    delete m_clientsMutex;
-    delete m_cacheMutex;
+    delete m_routingLock;
 }
 
-bool Broker::start(int tcpPort, const QString& localServerName)
+bool Broker::start(int tcpPort, const QString& localServerName, IoBackend backend)
 {
-    Logger::instance()->info("Starting broker...");
+    MYMQ_LOG_INFO("Starting broker...");
 
     // 如果已经在运行，先停止
     if (m_running) {
@@ -54,7 +112,7 @@ bool Broker::start(int tcpPort, const QString& localServerName)
 
     // 启动TCP服务器
     if (!m_tcpServer->listen(QHostAddress::Any, tcpPort)) {
-        Logger::instance()->error(QString("Failed to start TCP server: %1").arg(m_tcpServer->errorString()));
+        MYMQ_LOG_ERROR(QString("Failed to start TCP server: %1").arg(m_tcpServer->errorString()));
         return false;
     }
 
@@ -63,16 +121,42 @@ bool Broker::start(int tcpPort, const QString& localServerName)
 
     // 启动本地服务器
     if (!m_localServer->listen(localServerName)) {
-        Logger::instance()->error(QString("Failed to start local server: %1").arg(m_localServer->errorString()));
+        MYMQ_LOG_ERROR(QString("Failed to start local server: %1").arg(m_localServer->errorString()));
         m_tcpServer->close();
         return false;
     }
 
-    // 启动活动检查定时器
-    m_activityTimer->start();
+    // I/O线程启动时按后端创建 epoll 实例，运行期间不再改变
+    m_ioBackend = backend;
+    if (m_ioBackend == EpollBackend && !EpollPoller::isSupported()) {
+        MYMQ_LOG_WARNING("epoll backend is not supported on this platform, using Qt backend");
+        m_ioBackend = QtBackend;
+    }
+
+    // 启动I/O线程，线程启动后工作对象再启动自己的定时器；
+    // 监听到的连接要回到事件循环才会分配，此时I/O线程已经就绪
+    for (int i = 0; i < m_ioThreadCount; ++i) {
+        QThread* thread = new QThread();
+        thread->setObjectName(QString("BrokerIO-%1").arg(i));
+
+        BrokerWorker* worker = new BrokerWorker(this, i);
+        worker->moveToThread(thread);
+        connect(thread, &QThread::started, worker, &BrokerWorker::initialize);
+
+        m_workers.append(worker);
+        m_workerThreads.append(thread);
+        thread->start();
+    }
+    m_nextWorker = 0;
+
+    if (m_statsTimer->interval() > 0) {
+        m_statsTimer->start();
+    }
 
     m_running = true;
-    Logger::instance()->info(QString("Broker started. TCP port: %1, Local server: %2").arg(tcpPort).arg(localServerName));
+    MYMQ_LOG_INFO(QString("Broker started. TCP port: %1, Local server: %2, I/O threads: %3, backend: %4")
+                  .arg(tcpPort).arg(localServerName).arg(m_workers.size())
+                  .arg(m_ioBackend == EpollBackend ? "epoll" : "Qt"));
 
     return true;
 }
@@ -83,29 +167,42 @@ void Broker::stop()
         return;
     }
 
-    Logger::instance()->info("Stopping broker...");
+    MYMQ_LOG_INFO("Stopping broker...");
 
-    // 停止活动检查定时器
-    m_activityTimer->stop();
+    // 先停止接受新连接
+    m_tcpServer->close();
+    m_localServer->close();
+    m_statsTimer->stop();
 
-    // 关闭所有客户端连接
-    QMutexLocker locker(m_clientsMutex);
-    QList<QString> clientIds = m_clients.keys();
-    locker.unlock();
+    // 在各自线程中关闭所有客户端连接，全部关闭后不会再有跨线程投递
+    for (BrokerWorker* worker : std::as_const(m_workers)) {
+        QMetaObject::invokeMethod(worker, &BrokerWorker::closeAllConnections, Qt::BlockingQueuedConnection);
+    }
 
-    for (const QString& clientId : clientIds) {
-        unregisterClient(clientId);
+    // 停止I/O线程并释放工作对象
+    for (QThread* thread : std::as_const(m_workerThreads)) {
+        thread->quit();
+        thread->wait();
     }
+    qDeleteAll(m_workers);
+    qDeleteAll(m_workerThreads);
+    m_workers.clear();
+    m_workerThreads.clear();
 
-    // 关闭服务器
-    m_tcpServer->close();
-    m_localServer->close();
+    {
+        QWriteLocker locker(m_routingLock);
+        m_topicSubscribers.clear();
+        m_routingGeneration.fetchAndAddRelaxed(1);
+    }
 
-    // 清除缓存
+    // 清除缓存，持久化日志保留，只需落盘
     clearCache();
+    if (m_messageLog) {
+        m_messageLog->sync();
+    }
 
     m_running = false;
-    Logger::instance()->info("Broker stopped");
+    MYMQ_LOG_INFO("Broker stopped");
 }
 
 bool Broker::isRunning() const
@@ -113,629 +210,609 @@ bool Broker::isRunning() const
     return m_running;
 }
 
-int Broker::clientCount() const
+Broker::IoBackend Broker::ioBackend() const
 {
-    QMutexLocker locker(m_clientsMutex);
-    return m_clients.size();
+    return m_ioBackend;
 }
 
-int Broker::topicCount() const
+void Broker::setIoThreadCount(int count)
 {
-    QMutexLocker locker(m_clientsMutex);
-    return m_topicSubscribers.size();
+    m_ioThreadCount = qMax(1, count);
 }
 
-int Broker::getCacheSize() const
+int Broker::ioThreadCount() const
 {
-    return m_cacheSize;
+    return m_ioThreadCount;
 }
 
-void Broker::setCacheSize(int size)
+void Broker::setDispatchPolicy(DispatchPolicy policy)
 {
-    if (size < 0) {
-        return;
-    }
-
-    m_cacheSize = size;
-
-    // 调整现有缓存大小
-    QMutexLocker locker(m_cacheMutex);
-    for (auto it = m_messageCache.begin(); it != m_messageCache.end(); ++it) {
-        while (it.value().size() > m_cacheSize) {
-            it.value().dequeue();
-        }
-    }
+    m_dispatchPolicy = policy;
 }
 
-void Broker::clearCache()
+Broker::DispatchPolicy Broker::dispatchPolicy() const
 {
-    QMutexLocker locker(m_cacheMutex);
-    m_messageCache.clear();
+    return m_dispatchPolicy;
 }
 
-void Broker::forceCleanup()
+void Broker::setOutboundQueueLimits(int maxMessages, qint64 maxBytes)
 {
-    if (m_instance) {
-        // 停止 Broker
-        m_instance->stop();
+    m_outboundMaxMessages.storeRelaxed(qMax(1, maxMessages));
+    m_outboundMaxBytes.storeRelaxed(qMax<qint64>(1, maxBytes));
+}
 
-        // 等待一段时间确保资源释放
-        QThread::msleep(200);
+int Broker::outboundQueueMaxMessages() const
+{
+    return m_outboundMaxMessages.loadRelaxed();
+}
 
-        // 删除实例
-        delete m_instance;
-        m_instance = nullptr;
-    }
+qint64 Broker::outboundQueueMaxBytes() const
+{
+    return m_outboundMaxBytes.loadRelaxed();
 }
 
-void Broker::handleNewTcpConnection()
+void Broker::setIdleTimeout(int seconds)
 {
-    QTcpSocket* socket = m_tcpServer->nextPendingConnection();
-    if (!socket) {
-        return;
-    }
+    m_idleTimeout.storeRelaxed(qMax(0, seconds));
+}
 
-    QString clientId = registerClient(socket, false);
+int Broker::idleTimeout() const
+{
+    return m_idleTimeout.loadRelaxed();
+}
 
-    // 连接信号槽
-    connect(socket, &QTcpSocket::readyRead, this, &Broker::handleTcpReadyRead);
-    connect(socket, &QTcpSocket::disconnected, this, &Broker::handleTcpDisconnected);
+void Broker::setMaxTopics(int maxTopics)
+{
+    m_topicRegistry.setMaxSize(maxTopics);
+}
 
-    Logger::instance()->info(QString("New TCP client connected: %1").arg(clientId));
-    emit clientConnected(clientId);
+int Broker::maxTopics() const
+{
+    return m_topicRegistry.maxSize();
 }
 
-void Broker::handleNewLocalConnection()
+void Broker::setDefaultOverflowPolicy(SubscriptionOptions::OverflowPolicy policy)
 {
-    QLocalSocket* socket = m_localServer->nextPendingConnection();
-    if (!socket) {
+    if (policy == SubscriptionOptions::DefaultPolicy) {
         return;
     }
+    m_defaultOverflowPolicy.storeRelaxed(policy);
+}
 
-    QString clientId = registerClient(socket, true);
-
-    // 连接信号槽
-    connect(socket, &QLocalSocket::readyRead, this, &Broker::handleLocalReadyRead);
-    connect(socket, &QLocalSocket::disconnected, this, &Broker::handleLocalDisconnected);
+SubscriptionOptions::OverflowPolicy Broker::defaultOverflowPolicy() const
+{
+    return static_cast<SubscriptionOptions::OverflowPolicy>(m_defaultOverflowPolicy.loadRelaxed());
+}
 
-    Logger::instance()->info(QString("New local client connected: %1").arg(clientId));
-    emit clientConnected(clientId);
+OutboundQueueStats Broker::outboundQueueStats() const
+{
+    OutboundQueueStats total;
+    for (BrokerWorker* worker : m_workers) {
+        const OutboundQueueStats stats = worker->outboundQueueStats();
+        total.queuedMessages += stats.queuedMessages;
+        total.queuedBytes += stats.queuedBytes;
+        total.droppedMessages += stats.droppedMessages;
+        total.conflatedMessages += stats.conflatedMessages;
+        total.slowConsumerDisconnects += stats.slowConsumerDisconnects;
+    }
+    return total;
 }
 
-void Broker::handleTcpReadyRead()
+int Broker::clientCount() const
 {
-    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket) {
-        return;
+    int count = 0;
+    for (BrokerWorker* worker : m_workers) {
+        count += worker->connectionCount();
     }
+    return count;
+}
 
-    // 查找客户端ID和帧处理器
-    QString clientId;
-    MessageFrameHandler* frameHandler = nullptr;
-    {
-        QMutexLocker locker(m_clientsMutex);
-        for (auto it = m_clients.begin(); it != m_clients.end(); ++it) {
-            if (it.value().tcpSocket == socket) {
-                clientId = it.key();
-                frameHandler = it.value().frameHandler;
-                break;
-            }
-        }
-    }
+int Broker::topicCount() const
+{
+    QReadLocker locker(m_routingLock);
+    return m_topicSubscribers.size();
+}
 
-    if (clientId.isEmpty() || !frameHandler) {
-        Logger::instance()->warning("Received data from unknown TCP client");
-        return;
-    }
+BrokerStats Broker::stats() const
+{
+    BrokerStats stats;
+    stats.timestamp = QDateTime::currentMSecsSinceEpoch();
 
-    // 更新最后活动时间
-    {
-        QMutexLocker locker(m_clientsMutex);
-        m_clients[clientId].lastActiveTime = QDateTime::currentDateTime();
+    // 同一主题的收和发可能记录在不同的I/O线程，先按编号合并再查主题
+    QHash<TopicId, TrafficStats> topics;
+    for (BrokerWorker* worker : m_workers) {
+        worker->collectMetrics(&stats, &topics);
+        stats.clientCount += worker->connectionCount();
     }
+    stats.outbound = outboundQueueStats();
 
-    // 读取数据
-    while (socket->bytesAvailable() > 0) {
-        QByteArray data = socket->readAll();
-
-        // 使用消息帧处理器处理数据
-        // 当收到完整消息时，帧处理器会发出 messageReceived 信号
-        // 该信号已在 registerClient 方法中连接到 processMessage 方法
-        frameHandler->processIncomingData(data);
+    for (auto it = topics.constBegin(); it != topics.constEnd(); ++it) {
+        stats.topics.insert(m_topicRegistry.name(it.key()), it.value());
     }
+    return stats;
 }
 
-void Broker::handleLocalReadyRead()
+void Broker::setStatsInterval(int msec)
 {
-    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
-    if (!socket) {
-        return;
+    m_statsTimer->setInterval(qMax(0, msec));
+    if (m_statsTimer->interval() == 0) {
+        m_statsTimer->stop();
+    } else if (m_running) {
+        m_statsTimer->start();
     }
+}
 
-    // 查找客户端ID和帧处理器
-    QString clientId;
-    MessageFrameHandler* frameHandler = nullptr;
-    {
-        QMutexLocker locker(m_clientsMutex);
-        for (auto it = m_clients.begin(); it != m_clients.end(); ++it) {
-            if (it.value().localSocket == socket) {
-                clientId = it.key();
-                frameHandler = it.value().frameHandler;
-                break;
-            }
-        }
-    }
+int Broker::statsInterval() const
+{
+    return m_statsTimer->interval();
+}
 
-    if (clientId.isEmpty() || !frameHandler) {
-        Logger::instance()->warning("Received data from unknown local client");
+void Broker::publishStats()
+{
+    if (m_workers.isEmpty()) {
         return;
     }
 
-    // 更新最后活动时间
-    {
-        QMutexLocker locker(m_clientsMutex);
-        m_clients[clientId].lastActiveTime = QDateTime::currentDateTime();
-    }
-
-    // 读取数据
-    while (socket->bytesAvailable() > 0) {
-        QByteArray data = socket->readAll();
+    // 路由缓存只能在所属I/O线程访问，由第一个I/O线程查找订阅者并投递
+    BrokerWorker* worker = m_workers.first();
+    QMetaObject::invokeMethod(worker, &BrokerWorker::publishStats, Qt::QueuedConnection);
+}
 
-        // 使用消息帧处理器处理数据
-        // 当收到完整消息时，帧处理器会发出 messageReceived 信号
-        // 该信号已在 registerClient 方法中连接到 processMessage 方法
-        frameHandler->processIncomingData(data);
-    }
+int Broker::getCacheSize() const
+{
+    return m_cacheSize.loadRelaxed();
 }
 
-void Broker::handleTcpDisconnected()
+void Broker::setCacheSize(int size)
 {
-    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket) {
+    if (size < 0) {
         return;
     }
 
-    // 查找客户端ID
-    QString clientId;
-    {
-        QMutexLocker locker(m_clientsMutex);
-        for (auto it = m_clients.begin(); it != m_clients.end(); ++it) {
-            if (it.value().tcpSocket == socket) {
-                clientId = it.key();
-                break;
+    m_cacheSize.storeRelaxed(size);
+
+    // 调整现有缓存大小，每次只锁一组主题
+    for (TopicStripe& stripe : m_topicStripes) {
+        QMutexLocker locker(&stripe.lock);
+        for (auto it = stripe.caches.begin(); it != stripe.caches.end(); ++it) {
+            while (it.value().frames.size() > size) {
+                it.value().frames.dequeue();
             }
         }
     }
-
-    if (!clientId.isEmpty()) {
-        unregisterClient(clientId);
-        Logger::instance()->info(QString("TCP client disconnected: %1").arg(clientId));
-        emit clientDisconnected(clientId);
-    }
 }
 
-void Broker::handleLocalDisconnected()
+void Broker::clearCache()
 {
-    QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
-    if (!socket) {
-        return;
-    }
-
-    // 查找客户端ID
-    QString clientId;
-    {
-        QMutexLocker locker(m_clientsMutex);
-        for (auto it = m_clients.begin(); it != m_clients.end(); ++it) {
-            if (it.value().localSocket == socket) {
-                clientId = it.key();
-                break;
-            }
+    // 只清除消息帧，主题序号继续递增，订阅者仍然可以按序号续传
+    for (TopicStripe& stripe : m_topicStripes) {
+        QMutexLocker locker(&stripe.lock);
+        for (auto it = stripe.caches.begin(); it != stripe.caches.end(); ++it) {
+            it.value().frames.clear();
         }
     }
-
-    if (!clientId.isEmpty()) {
-        unregisterClient(clientId);
-        Logger::instance()->info(QString("Local client disconnected: %1").arg(clientId));
-        emit clientDisconnected(clientId);
-    }
 }
 
-void Broker::checkClientActivity()
+bool Broker::enablePersistence(const QString& directory, const MessageLog::Options& options)
 {
-    QDateTime now = QDateTime::currentDateTime();
-    QList<QString> inactiveClients;
-
-    // 查找不活跃的客户端
-    {
-        QMutexLocker locker(m_clientsMutex);
-        for (auto it = m_clients.begin(); it != m_clients.end(); ++it) {
-            if (it.value().lastActiveTime.secsTo(now) > 60) { // 60秒不活跃
-                inactiveClients.append(it.key());
-            }
-        }
+    if (m_running) {
+        MYMQ_LOG_WARNING("Persistence must be enabled before the broker starts");
+        return false;
     }
 
-    // 注销不活跃的客户端
-    for (const QString& clientId : inactiveClients) {
-        Logger::instance()->info(QString("Client inactive, disconnecting: %1").arg(clientId));
-        unregisterClient(clientId);
-        emit clientDisconnected(clientId);
+    disablePersistence();
+
+    MessageLog* log = new MessageLog(directory, options);
+    if (!log->open()) {
+        delete log;
+        return false;
     }
+
+    m_messageLog = log;
+    return true;
 }
 
-void Broker::processMessage(const QString& clientId, const Message& message)
+void Broker::disablePersistence()
 {
-    Logger::instance()->debug(QString("Processing message from client %1, topic: %2").arg(clientId).arg(message.topic()));
-
-    // 特殊主题处理
-    if (message.topic() == "$SYS/SUBSCRIBE") {
-        // 订阅请求
-        QString topicToSubscribe = QString::fromUtf8(message.data());
-        handleSubscription(clientId, topicToSubscribe);
-        return;
-    } else if (message.topic() == "$SYS/UNSUBSCRIBE") {
-        // 取消订阅请求
-        QString topicToUnsubscribe = QString::fromUtf8(message.data());
-        handleUnsubscription(clientId, topicToUnsubscribe);
-        return;
-    } else if (message.topic() == "$SYS/REGISTER") {
-        // 注册为发布者或订阅者
-        QString role = QString::fromUtf8(message.data());
-        QMutexLocker locker(m_clientsMutex);
-        if (m_clients.contains(clientId)) {
-            if (role == "PUBLISHER") {
-                m_clients[clientId].isPublisher = true;
-                Logger::instance()->info(QString("Client %1 registered as publisher").arg(clientId));
-            } else if (role == "SUBSCRIBER") {
-                m_clients[clientId].isSubscriber = true;
-                Logger::instance()->info(QString("Client %1 registered as subscriber").arg(clientId));
-            }
-        }
+    if (m_running || !m_messageLog) {
         return;
     }
 
-    // 检查客户端是否为发布者
-    bool isPublisher = false;
-    {
-        QMutexLocker locker(m_clientsMutex);
-        if (m_clients.contains(clientId)) {
-            isPublisher = m_clients[clientId].isPublisher;
-        }
-    }
+    delete m_messageLog;
+    m_messageLog = nullptr;
+}
 
-    if (!isPublisher) {
-        Logger::instance()->warning(QString("Client %1 is not registered as publisher").arg(clientId));
-        return;
-    }
+MessageLog* Broker::messageLog() const
+{
+    return m_messageLog;
+}
 
-    // 缓存消息
-    {
-        QMutexLocker locker(m_cacheMutex);
-        // 如果缓存大小为0，不缓存消息
-        if (m_cacheSize > 0) {
-            // 添加消息到缓存
-            m_messageCache[message.topic()].enqueue(message);
+TopicRegistry* Broker::topicRegistry()
+{
+    return &m_topicRegistry;
+}
 
-            // 如果缓存超过大小限制，移除最旧的消息
-            while (m_messageCache[message.topic()].size() > m_cacheSize) {
-                m_messageCache[message.topic()].dequeue();
-            }
-        }
-    }
+void Broker::forceCleanup()
+{
+    if (m_instance) {
+        // 停止 Broker
+        m_instance->stop();
 
-    // 获取订阅该主题的客户端
-    QSet<QString> subscribers;
-    QMap<QString, ClientInfo> clientsCopy;
-    {
-        QMutexLocker locker(m_clientsMutex);
-        subscribers = m_topicSubscribers.value(message.topic());
+        // 等待一段时间确保资源释放
+        QThread::msleep(200);
 
-        // 复制需要的客户端信息
-        for (const QString& subId : subscribers) {
-            if (m_clients.contains(subId)) {
-                clientsCopy[subId] = m_clients[subId];
-            }
-        }
+        // 删除实例
+        delete m_instance;
+        m_instance = nullptr;
     }
+}
 
-    // 发送消息给订阅者，不需要再次获取锁
-    for (const QString& subscriberId : subscribers) {
-        if (clientsCopy.contains(subscriberId)) {
-            const ClientInfo& clientInfo = clientsCopy[subscriberId];
-
-            // 检查客户端是否为订阅者
-            if (!clientInfo.isSubscriber) {
-                continue;
-            }
-
-            // 序列化消息
-            QByteArray data = message.serialize();
-
-            // 发送消息
-            bool sent = false;
-            if (clientInfo.tcpSocket) {
-                sent = clientInfo.tcpSocket->write(data) == data.size();
-            } else if (clientInfo.localSocket) {
-                sent = clientInfo.localSocket->write(data) == data.size();
-            }
+void Broker::dispatchConnection(qintptr socketDescriptor, bool isLocal)
+{
+    if (m_workers.isEmpty()) {
+        return;
+    }
 
-            if (sent) {
-                Logger::instance()->debug(QString("Sent message to client %1: %2").arg(subscriberId).arg(message.topic()));
+    BrokerWorker* worker = nullptr;
+    if (m_dispatchPolicy == LeastConnections) {
+        for (BrokerWorker* candidate : std::as_const(m_workers)) {
+            if (!worker || candidate->connectionCount() < worker->connectionCount()) {
+                worker = candidate;
             }
         }
+    } else {
+        worker = m_workers.at(m_nextWorker);
+        m_nextWorker = (m_nextWorker + 1) % m_workers.size();
     }
 
-    emit messageReceived(message);
-    emit messagePublished(message);
+    // 套接字必须在所属I/O线程中创建
+    QMetaObject::invokeMethod(worker, [worker, socketDescriptor, isLocal]() {
+        worker->addConnection(socketDescriptor, isLocal);
+    }, Qt::QueuedConnection);
 }
 
-void Broker::publishMessage(const Message& message)
+bool Broker::routeFrame(BrokerWorker* origin, TopicId topicId, const QString& topic, const QByteArray& frame,
+                        qint64 receivedAt)
 {
-    // 注意：这个方法已经被弃用，所有的消息发布都应该通过 processMessage 方法处理
-    Logger::instance()->debug(QString("publishMessage is deprecated, use processMessage instead: %1").arg(message.topic()));
-
-    // 为了兼容性，我们仍然尝试发布消息，但使用更安全的方式
+    // 分配序号和投递入队在同一把主题锁内完成：不同I/O线程上的发布者交错时，
+    // 同一主题的帧仍按序号顺序进入各订阅者所在线程的投递队列。锁按主题编号分组，没有全局锁
+    TopicStripe& stripe = m_topicStripes[topicId % kTopicStripeCount];
+    QMutexLocker sequenceLocker(&stripe.lock);
+
+    // 订阅者在锁内确定：新订阅在同一把锁内登记并读取回放，锁之前登记的订阅者实时收到这条帧，
+    // 之后登记的从回放中读到，不会丢失也不会重复。
+    // 订阅者按主题编号缓存在本I/O线程中，订阅表没有变化时不需要匹配前缀树
+    const WorkerSubscribers subscribers = origin->subscribersFor(topicId, topic);
+
+    // 分配主题序号并写入帧中。写入序号时复制了一次接收缓冲区的视图（别名帧同时展开主题），
+    // 之后缓存、本线程和其他线程的投递共享这一份拷贝
+    QByteArray stampedFrame;
+    bool stored = true;
+
+    // 持久化模式下序号就是日志偏移量，日志中保存原始帧，读取时再写入序号
+    if (m_messageLog) {
+        const QByteArray logFrame = Message::peekTopicAlias(frame) != 0 ? Message::withTopic(frame, topic) : frame;
+        const qint64 offset = m_messageLog->append(topic, logFrame);
+        stored = offset >= 0;
+        stampedFrame = stored ? Message::withSequence(logFrame, offset)
+                              : QByteArray(logFrame.constData(), logFrame.size());
+    } else {
+        const int cacheSize = m_cacheSize.loadRelaxed();
+
+        TopicCache& topicCache = stripe.caches[topicId];
+        if (topicCache.topic.isEmpty()) {
+            topicCache.topic = topic;
+        }
+        stampedFrame = Message::withSequence(frame, topicCache.nextSequence++, topic);
 
-    // 获取订阅该主题的客户端和客户端信息
-    QSet<QString> subscribers;
-    QMap<QString, ClientInfo> clientsCopy;
-    {
-        QMutexLocker locker(m_clientsMutex);
-        subscribers = m_topicSubscribers.value(message.topic());
+        // 添加消息帧到缓存，新订阅者回放时收到的字节与实时投递完全相同
+        if (cacheSize > 0) {
+            topicCache.frames.enqueue(stampedFrame);
 
-        // 复制需要的客户端信息
-        for (const QString& subId : subscribers) {
-            if (m_clients.contains(subId)) {
-                clientsCopy[subId] = m_clients[subId];
+            // 如果缓存超过大小限制，移除最旧的消息
+            while (topicCache.frames.size() > cacheSize) {
+                topicCache.frames.dequeue();
             }
         }
     }
 
-    // 发送消息给订阅者，不需要再次获取锁
-    for (const QString& subscriberId : subscribers) {
-        if (clientsCopy.contains(subscriberId)) {
-            const ClientInfo& clientInfo = clientsCopy[subscriberId];
-
-            // 检查客户端是否为订阅者
-            if (!clientInfo.isSubscriber) {
-                continue;
-            }
-
-            // 序列化消息
-            QByteArray data = message.serialize();
+    // 锁内只入队，本线程订阅者的套接字写出在释放锁之后进行
+    const bool deliverLocally = dispatchFrame(origin, topicId, topic, stampedFrame, subscribers, receivedAt);
+    sequenceLocker.unlock();
+    if (deliverLocally) {
+        origin->deliverQueued();
+    }
 
-            // 发送消息
-            bool sent = false;
-            if (clientInfo.tcpSocket) {
-                sent = clientInfo.tcpSocket->write(data) == data.size();
-            } else if (clientInfo.localSocket) {
-                sent = clientInfo.localSocket->write(data) == data.size();
-            }
+    MYMQ_LOG_DEBUG(QString("Routed message on topic %1 to %2 I/O threads").arg(topic).arg(subscribers.size()));
 
-            if (sent) {
-                Logger::instance()->debug(QString("Sent message to client %1: %2").arg(subscriberId).arg(message.topic()));
-            }
+    // 转发路径不需要完整解码，只有在信号有接收者时才解码消息
+    static const QMetaMethod receivedSignal = QMetaMethod::fromSignal(&Broker::messageReceived);
+    static const QMetaMethod publishedSignal = QMetaMethod::fromSignal(&Broker::messagePublished);
+    if (isSignalConnected(receivedSignal) || isSignalConnected(publishedSignal)) {
+        Message message;
+        if (message.deserializeFrame(stampedFrame)) {
+            emit messageReceived(message);
+            emit messagePublished(message);
         }
     }
 
-    emit messagePublished(message);
+    return stored;
 }
 
-void Broker::cacheMessage(const Message& message)
+bool Broker::dispatchFrame(BrokerWorker* origin, TopicId topicId, const QString& topic, const QByteArray& frame,
+                           const WorkerSubscribers& subscribers, qint64 receivedAt)
 {
-    // 注意：这个方法已经被弃用，所有的消息缓存都应该通过 processMessage 方法处理
-    Logger::instance()->debug(QString("cacheMessage is deprecated, use processMessage instead: %1").arg(message.topic()));
-
-    // 为了兼容性，我们仍然尝试缓存消息
-    QMutexLocker locker(m_cacheMutex);
-
-    // 如果缓存大小为0，不缓存消息
-    if (m_cacheSize <= 0) {
-        return;
+    // 所有线程的订阅者（包括本线程）都经过投递队列，队列按入队顺序取出，同一主题的帧不会乱序。
+    // 本线程的投递只入队不唤醒，由调用方取出
+    bool deliverLocally = false;
+    for (auto it = subscribers.constBegin(); it != subscribers.constEnd(); ++it) {
+        BrokerWorker::Delivery delivery;
+        delivery.topicId = topicId;
+        delivery.topic = topic;
+        delivery.frame = frame;
+        delivery.clients = it.value();
+        delivery.receivedAt = receivedAt;
+
+        if (it.key() == origin) {
+            origin->enqueueLocalDelivery(std::move(delivery));
+            deliverLocally = true;
+        } else {
+            it.key()->enqueueDelivery(std::move(delivery));
+        }
     }
+    return deliverLocally;
+}
 
-    // 添加消息到缓存
-    m_messageCache[message.topic()].enqueue(message);
+WorkerSubscribers Broker::matchSubscribers(const QString& topic) const
+{
+    WorkerSubscribers subscribers;
+
+    QReadLocker locker(m_routingLock);
+    int matchedPatterns = 0;
+    m_topicSubscribers.match(topic, [&](const WorkerSubscribers& workers) {
+        if (matchedPatterns++ == 0) {
+            subscribers = workers;
+            return;
+        }
+        for (auto it = workers.constBegin(); it != workers.constEnd(); ++it) {
+            subscribers[it.key()].unite(it.value());
+        }
+    });
 
-    // 如果缓存超过大小限制，移除最旧的消息
-    while (m_messageCache[message.topic()].size() > m_cacheSize) {
-        m_messageCache[message.topic()].dequeue();
-    }
+    return subscribers;
 }
 
-bool Broker::sendMessageToClient(const QString& clientId, const Message& message)
+quint64 Broker::routingGeneration() const
 {
-    // 注意：这个方法已经被弃用，所有的消息发送都应该通过 processMessage 或 publishMessage 方法处理
-    Logger::instance()->debug(QString("sendMessageToClient is deprecated, use processMessage instead: %1").arg(clientId));
-
-    // 为了兼容性，我们仍然尝试发送消息，但使用更安全的方式
+    return m_routingGeneration.loadAcquire();
+}
 
-    // 获取客户端信息
-    ClientInfo clientInfo;
-    bool clientExists = false;
-    bool isSubscriber = false;
+void Broker::addSubscriber(const QString& topic, ClientHandle handle, BrokerWorker* worker)
+{
+    QWriteLocker locker(m_routingLock);
+    m_topicSubscribers.insert(topic)[worker].insert(handle);
+    m_routingGeneration.fetchAndAddRelease(1);
+}
 
-    {
-        QMutexLocker locker(m_clientsMutex);
-        if (m_clients.contains(clientId)) {
-            clientExists = true;
-            clientInfo = m_clients[clientId];
-            isSubscriber = clientInfo.isSubscriber;
+QList<QByteArray> Broker::subscribe(const QString& topic, ClientHandle handle, BrokerWorker* worker,
+                                   const SubscriptionOptions& options, const QHash<QString, qint64>& positions)
+{
+    // 具体主题只锁它所在的组；通配符可能匹配任何组的主题，按顺序锁住所有组。
+    // 路由每次只持有一把主题锁，不会与这里形成环
+    QVector<QMutex*> locks;
+    if (Topic::isWildcard(topic)) {
+        locks.reserve(kTopicStripeCount);
+        for (TopicStripe& stripe : m_topicStripes) {
+            locks.append(&stripe.lock);
+        }
+    } else {
+        const TopicId topicId = m_topicRegistry.intern(topic);
+        if (topicId != TopicRegistry::InvalidTopic) {
+            locks.append(&m_topicStripes[topicId % kTopicStripeCount].lock);
         }
     }
 
-    if (!clientExists) {
-        return false;
+    for (QMutex* lock : locks) {
+        lock->lock();
     }
 
-    // 检查客户端是否为订阅者
-    if (!isSubscriber) {
-        return false;
+    // 追赶期间新出现的匹配主题按订阅选项确定起点
+    QHash<QString, qint64> remaining = positions;
+    const QHash<QString, qint64> starts = replayPositions(topic, options, true);
+    for (auto it = starts.constBegin(); it != starts.constEnd(); ++it) {
+        if (!remaining.contains(it.key())) {
+            remaining.insert(it.key(), it.value());
+        }
     }
 
-    // 序列化消息
-    QByteArray data = message.serialize();
+    // 读完剩下的消息再登记，回放的终点和实时投递的起点是同一个序号
+    const QList<QByteArray> frames = readReplay(&remaining, -1, true, nullptr);
+    addSubscriber(topic, handle, worker);
 
-    // 发送消息
-    if (clientInfo.tcpSocket) {
-        return clientInfo.tcpSocket->write(data) == data.size();
-    } else if (clientInfo.localSocket) {
-        return clientInfo.localSocket->write(data) == data.size();
+    for (int i = locks.size() - 1; i >= 0; --i) {
+        locks.at(i)->unlock();
     }
-
-    return false;
+    return frames;
 }
 
-QString Broker::registerClient(QObject* socket, bool isLocal)
+void Broker::removeSubscriber(const QString& topic, ClientHandle handle, BrokerWorker* worker)
 {
-    // 生成客户端ID
-    QString clientId = QUuid::createUuid().toString(QUuid::WithoutBraces);
-
-    // 创建客户端信息
-    ClientInfo clientInfo;
-    clientInfo.id = clientId;
-    clientInfo.tcpSocket = isLocal ? nullptr : qobject_cast<QTcpSocket*>(socket);
-    clientInfo.localSocket = isLocal ? qobject_cast<QLocalSocket*>(socket) : nullptr;
-    clientInfo.isPublisher = false;
-    clientInfo.isSubscriber = false;
-    clientInfo.lastActiveTime = QDateTime::currentDateTime();
-
-    // 创建消息帧处理器
-    clientInfo.frameHandler = new MessageFrameHandler(this);
+    QWriteLocker locker(m_routingLock);
 
-    // 连接消息帧处理器的信号
-    connect(clientInfo.frameHandler, &MessageFrameHandler::messageReceived,
-            [this, clientId](const Message& message) {
-                // 处理收到的消息
-                processMessage(clientId, message);
-            });
-
-    connect(clientInfo.frameHandler, &MessageFrameHandler::error,
-            [this, clientId](const QString& errorMessage) {
-                // 记录错误
-                Logger::instance()->warning(QString("Client %1: %2").arg(clientId).arg(errorMessage));
-            });
-
-    // 添加客户端信息
-    QMutexLocker locker(m_clientsMutex);
-    m_clients[clientId] = clientInfo;
-
-    return clientId;
-}
-
-void Broker::unregisterClient(const QString& clientId)
-{
-    QMutexLocker locker(m_clientsMutex);
-
-    if (!m_clients.contains(clientId)) {
+    WorkerSubscribers* workers = m_topicSubscribers.find(topic);
+    if (!workers) {
         return;
     }
 
-    // 获取客户端信息
-    ClientInfo clientInfo = m_clients[clientId];
-
-    // 从所有主题的订阅者列表中移除
-    for (auto it = m_topicSubscribers.begin(); it != m_topicSubscribers.end(); ++it) {
-        it.value().remove(clientId);
+    auto it = workers->find(worker);
+    if (it != workers->end() && it.value().remove(handle) && it.value().isEmpty()) {
+        workers->erase(it);
     }
 
-    // 断开连接
-    if (clientInfo.tcpSocket) {
-        clientInfo.tcpSocket->disconnect();
-        clientInfo.tcpSocket->deleteLater();
+    // 如果没有订阅者，移除该模式
+    if (workers->isEmpty()) {
+        m_topicSubscribers.remove(topic);
     }
-
-    if (clientInfo.localSocket) {
-        clientInfo.localSocket->disconnect();
-        clientInfo.localSocket->deleteLater();
-    }
-
-    // 释放消息帧处理器
-    if (clientInfo.frameHandler) {
-        clientInfo.frameHandler->disconnect();
-        clientInfo.frameHandler->deleteLater();
-    }
-
-    // 移除客户端信息
-    m_clients.remove(clientId);
+    m_routingGeneration.fetchAndAddRelease(1);
 }
 
-void Broker::handleSubscription(const QString& clientId, const QString& topic)
+QHash<QString, qint64> Broker::replayPositions(const QString& topic, const SubscriptionOptions& options,
+                                               bool locked) const
 {
-    Logger::instance()->info(QString("Client %1 subscribing to topic: %2").arg(clientId).arg(topic));
-
-    // 首先检查客户端是否存在并获取客户端信息
-    bool clientExists = false;
-    ClientInfo clientInfo;
-    {
-        QMutexLocker locker(m_clientsMutex);
-        if (m_clients.contains(clientId)) {
-            clientExists = true;
-            clientInfo = m_clients[clientId];
-
-            // 添加到客户端的订阅列表
-            m_clients[clientId].subscriptions.insert(topic);
-
-            // 添加到主题的订阅者列表
-            m_topicSubscribers[topic].insert(clientId);
+    QHash<QString, qint64> positions;
+    if (options.startPosition == SubscriptionOptions::StartNewOnly && options.resumeOffsets.isEmpty()) {
+        return positions;
+    }
+
+    // 持久化模式按日志中的偏移量确定起点，日志有自己的锁
+    if (m_messageLog) {
+        QStringList topics;
+        if (Topic::isWildcard(topic)) {
+            const QStringList logTopics = m_messageLog->topics();
+            for (const QString& logTopic : logTopics) {
+                if (Topic::matches(topic, logTopic)) {
+                    topics.append(logTopic);
+                }
+            }
+        } else {
+            topics.append(topic);
+        }
 
-            // 标记为订阅者
-            m_clients[clientId].isSubscriber = true;
+        for (const QString& logTopic : std::as_const(topics)) {
+            positions.insert(logTopic, replayStart(logTopic, options, m_messageLog->firstOffset(logTopic),
+                                                   m_messageLog->nextOffset(logTopic),
+                                                   [this, &logTopic](qint64 timestampNs) {
+                                                       return m_messageLog->offsetForTimestamp(logTopic, timestampNs);
+                                                   }));
+        }
+        return positions;
+    }
+
+    // 内存缓存中的帧序号连续，最后一条是 nextSequence - 1
+    auto addCache = [&](const TopicCache& topicCache) {
+        const QQueue<QByteArray>& cached = topicCache.frames;
+        const qint64 next = topicCache.nextSequence;
+        const qint64 first = next - cached.size();
+        positions.insert(topicCache.topic, replayStart(topicCache.topic, options, first, next,
+                                                       [&cached, first](qint64 timestampNs) {
+                                                           for (int i = 0; i < cached.size(); ++i) {
+                                                               if (Message::peekTimestampNs(cached.at(i)) >= timestampNs) {
+                                                                   return first + i;
+                                                               }
+                                                           }
+                                                           return first + qint64(cached.size());
+                                                       }));
+    };
+
+    if (!Topic::isWildcard(topic)) {
+        const TopicId topicId = m_topicRegistry.find(topic);
+        if (topicId == TopicRegistry::InvalidTopic) {
+            return positions;
         }
-    }
 
-    if (!clientExists) {
-        return;
+        TopicStripe& stripe = m_topicStripes[topicId % kTopicStripeCount];
+        QMutexLocker locker(locked ? nullptr : &stripe.lock);
+        auto it = stripe.caches.constFind(topicId);
+        if (it != stripe.caches.constEnd()) {
+            addCache(it.value());
+        }
+        return positions;
     }
 
-    // 获取缓存的消息
-    QQueue<Message> cachedMessages;
-    {
-        QMutexLocker cacheLocker(m_cacheMutex);
-        if (m_messageCache.contains(topic)) {
-            cachedMessages = m_messageCache[topic];
+    // 通配符订阅回放所有匹配主题的缓存，未持有锁时每次只锁一组主题
+    for (TopicStripe& stripe : m_topicStripes) {
+        QMutexLocker locker(locked ? nullptr : &stripe.lock);
+        for (auto it = stripe.caches.constBegin(); it != stripe.caches.constEnd(); ++it) {
+            if (Topic::matches(topic, it.value().topic)) {
+                addCache(it.value());
+            }
         }
     }
+    return positions;
+}
 
-    // 发送缓存的消息
-    for (const Message& message : cachedMessages) {
-        // 使用客户端信息直接发送消息，避免再次获取锁
-        QByteArray data = message.serialize();
-        bool sent = false;
+QList<QByteArray> Broker::readReplay(QHash<QString, qint64>* positions, int maxCount, bool locked,
+                                     bool* caughtUp) const
+{
+    QList<QByteArray> frames;
+    bool atEnd = true;
+
+    for (auto it = positions->begin(); it != positions->end(); ++it) {
+        const int budget = maxCount < 0 ? INT_MAX : maxCount - frames.size();
+        if (budget <= 0) {
+            atEnd = false;
+            break;
+        }
 
-        if (clientInfo.tcpSocket) {
-            sent = clientInfo.tcpSocket->write(data) == data.size();
-        } else if (clientInfo.localSocket) {
-            sent = clientInfo.localSocket->write(data) == data.size();
+        int count = 0;
+        if (m_messageLog) {
+            // 读出的是原始帧，按偏移量写入序号；保留策略可能已经删除旧段，序号以读取时实际的起点为准
+            qint64 from = it.value();
+            const QList<QByteArray> logFrames = m_messageLog->read(it.key(), from, budget, &from);
+            for (int i = 0; i < logFrames.size(); ++i) {
+                frames.append(Message::withSequence(logFrames.at(i), from + i));
+            }
+            count = logFrames.size();
+            it.value() = from + count;
+        } else {
+            const TopicId topicId = m_topicRegistry.find(it.key());
+            TopicStripe& stripe = m_topicStripes[topicId % kTopicStripeCount];
+            QMutexLocker locker(locked ? nullptr : &stripe.lock);
+            auto cache = stripe.caches.constFind(topicId);
+            if (cache != stripe.caches.constEnd()) {
+                // 缓存的容量有限，追赶期间被挤出缓存的消息无法回放，从仍在缓存中的第一条继续
+                const QQueue<QByteArray>& cached = cache.value().frames;
+                const qint64 first = cache.value().nextSequence - cached.size();
+                int i = int(qBound<qint64>(0, it.value() - first, cached.size()));
+                for (; i < cached.size() && count < budget; ++i, ++count) {
+                    frames.append(cached.at(i));
+                }
+                it.value() = first + i;
+            }
         }
 
-        if (sent) {
-            Logger::instance()->debug(QString("Sent cached message to client %1: %2").arg(clientId).arg(message.topic()));
+        if (count >= budget) {
+            atEnd = false;
         }
     }
+
+    if (caughtUp) {
+        *caughtUp = atEnd;
+    }
+    return frames;
 }
 
-void Broker::handleUnsubscription(const QString& clientId, const QString& topic)
+qint64 Broker::replayStart(const QString& topic, const SubscriptionOptions& options, qint64 firstOffset,
+                           qint64 nextOffset, const std::function<qint64(qint64)>& timeOffset) const
 {
-    Logger::instance()->info(QString("Client %1 unsubscribing from topic: %2").arg(clientId).arg(topic));
-
-    QMutexLocker locker(m_clientsMutex);
-
-    if (!m_clients.contains(clientId)) {
-        return;
+    qint64 from = nextOffset;
+
+    auto resume = options.resumeOffsets.constFind(topic);
+    if (resume != options.resumeOffsets.constEnd()) {
+        from = resume.value();
+    } else {
+        switch (options.startPosition) {
+        case SubscriptionOptions::StartFromCache:
+            from = nextOffset - m_cacheSize.loadRelaxed();
+            break;
+        case SubscriptionOptions::StartNewOnly:
+            break;
+        case SubscriptionOptions::StartFromOffset:
+            from = options.startValue;
+            break;
+        case SubscriptionOptions::StartFromTime:
+            from = timeOffset(options.startValue);
+            break;
+        case SubscriptionOptions::StartLastN:
+            from = nextOffset - options.startValue;
+            break;
+        }
     }
 
-    // 从客户端的订阅列表中移除
-    m_clients[clientId].subscriptions.remove(topic);
-
-    // 从主题的订阅者列表中移除
-    if (m_topicSubscribers.contains(topic)) {
-        m_topicSubscribers[topic].remove(clientId);
-
-        // 如果没有订阅者，移除主题
-        if (m_topicSubscribers[topic].isEmpty()) {
-            m_topicSubscribers.remove(topic);
-        }
+    // 序号超过末尾说明主题的序号重新开始过（未启用持久化的Broker重启），从头回放
+    if (from > nextOffset) {
+        from = firstOffset;
     }
-}
 
+    return qBound(firstOffset, from, nextOffset);
+}
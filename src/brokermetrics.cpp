@@ -0,0 +1,299 @@
+#include "brokermetrics.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtAlgorithms>
+
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+/**
+ * @brief 编码流量统计
+ */
+QJsonObject trafficJson(const TrafficStats& traffic)
+{
+    QJsonObject object;
+    object.insert("messagesIn", double(traffic.messagesIn));
+    object.insert("bytesIn", double(traffic.bytesIn));
+    object.insert("messagesOut", double(traffic.messagesOut));
+    object.insert("bytesOut", double(traffic.bytesOut));
+    return object;
+}
+
+/**
+ * @brief 编码纳秒直方图的摘要，单位为微秒
+ */
+QJsonObject histogramJson(const LatencyHistogram& histogram)
+{
+    QJsonObject object;
+    object.insert("count", double(histogram.count()));
+    object.insert("min", histogram.min() / 1000.0);
+    object.insert("mean", histogram.mean() / 1000.0);
+    object.insert("p50", histogram.percentile(50) / 1000.0);
+    object.insert("p90", histogram.percentile(90) / 1000.0);
+    object.insert("p99", histogram.percentile(99) / 1000.0);
+    object.insert("p999", histogram.percentile(99.9) / 1000.0);
+    object.insert("max", histogram.max() / 1000.0);
+    return object;
+}
+
+/**
+ * @brief 把流量累加到另一个统计中
+ */
+void addTraffic(TrafficStats& total, const MetricsShard::TrafficCounters& counters)
+{
+    total.messagesIn += counters.messagesIn.value();
+    total.bytesIn += counters.bytesIn.value();
+    total.messagesOut += counters.messagesOut.value();
+    total.bytesOut += counters.bytesOut.value();
+}
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram()
+    : m_buckets(kBucketCount, 0)
+    , m_count(0)
+    , m_min(0)
+    , m_max(0)
+    , m_sum(0)
+{
+}
+
+int LatencyHistogram::bucketIndex(quint64 value)
+{
+    if (value < quint64(kLinearBuckets)) {
+        return int(value);
+    }
+
+    // 最高位之后保留4位：value >> shift 落在 [16, 32)
+    const int msb = 63 - qCountLeadingZeroBits(value);
+    const int shift = msb - 4;
+    if (shift > kMaxShift) {
+        return kBucketCount - 1;
+    }
+    return kLinearBuckets + (shift - 1) * kSubBuckets + int(value >> shift) - kSubBuckets;
+}
+
+quint64 LatencyHistogram::bucketLowerBound(int index)
+{
+    if (index < kLinearBuckets) {
+        return quint64(index);
+    }
+
+    const int shift = (index - kLinearBuckets) / kSubBuckets + 1;
+    const quint64 sub = quint64((index - kLinearBuckets) % kSubBuckets + kSubBuckets);
+    return sub << shift;
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < kLinearBuckets) {
+        return quint64(index);
+    }
+
+    const int shift = (index - kLinearBuckets) / kSubBuckets + 1;
+    return bucketLowerBound(index) + (quint64(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(quint64 value, quint64 count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    m_buckets[bucketIndex(value)] += count;
+    m_min = m_count == 0 ? value : qMin(m_min, value);
+    m_max = qMax(m_max, value);
+    m_count += count;
+    m_sum += double(value) * double(count);
+}
+
+void LatencyHistogram::add(const LatencyHistogram& other)
+{
+    if (other.m_count == 0) {
+        return;
+    }
+
+    for (int i = 0; i < kBucketCount; ++i) {
+        m_buckets[i] += other.m_buckets[i];
+    }
+    m_min = m_count == 0 ? other.m_min : qMin(m_min, other.m_min);
+    m_max = qMax(m_max, other.m_max);
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+}
+
+quint64 LatencyHistogram::count() const
+{
+    return m_count;
+}
+
+quint64 LatencyHistogram::min() const
+{
+    return m_min;
+}
+
+quint64 LatencyHistogram::max() const
+{
+    return m_max;
+}
+
+double LatencyHistogram::mean() const
+{
+    return m_count == 0 ? 0 : m_sum / double(m_count);
+}
+
+quint64 LatencyHistogram::percentile(double percentile) const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+
+    // 第 rank 个值（从1开始）所在的桶
+    const double clamped = qBound(0.0, percentile, 100.0);
+    const quint64 rank = qMax<quint64>(1, quint64(std::ceil(clamped / 100.0 * double(m_count))));
+    quint64 seen = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+        seen += m_buckets[i];
+        if (seen >= rank) {
+            return qMin(bucketUpperBound(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+quint64 LatencyHistogram::bucketCount(int index) const
+{
+    return index >= 0 && index < kBucketCount ? m_buckets[index] : 0;
+}
+
+QByteArray BrokerStats::brokerJson() const
+{
+    QJsonObject object = trafficJson(total);
+    object.insert("timestamp", double(timestamp));
+    object.insert("clients", clientCount);
+    object.insert("topics", topics.size());
+    object.insert("matchedSubscribers", double(matchedSubscribers));
+    object.insert("routeCacheHits", double(routeCacheHits));
+    object.insert("routeCacheMisses", double(routeCacheMisses));
+    object.insert("queuedMessages", double(outbound.queuedMessages));
+    object.insert("queuedBytes", double(outbound.queuedBytes));
+    object.insert("droppedMessages", double(outbound.droppedMessages));
+    object.insert("conflatedMessages", double(outbound.conflatedMessages));
+    object.insert("slowConsumerDisconnects", double(outbound.slowConsumerDisconnects));
+    object.insert("residenceUs", histogramJson(residence));
+    return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+QByteArray BrokerStats::topicsJson() const
+{
+    QJsonObject topicObjects;
+    for (auto it = topics.constBegin(); it != topics.constEnd(); ++it) {
+        topicObjects.insert(it.key(), trafficJson(it.value()));
+    }
+
+    QJsonObject object;
+    object.insert("timestamp", double(timestamp));
+    object.insert("topics", topicObjects);
+    return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+QByteArray BrokerStats::clientsJson() const
+{
+    QJsonObject clientObjects;
+    for (auto it = clients.constBegin(); it != clients.constEnd(); ++it) {
+        QJsonObject client = trafficJson(it.value());
+        client.insert("queuedMessages", double(it.value().queuedMessages));
+        clientObjects.insert(it.key(), client);
+    }
+
+    QJsonObject object;
+    object.insert("timestamp", double(timestamp));
+    object.insert("clients", clientObjects);
+    return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+MetricsShard::MetricsShard()
+{
+}
+
+MetricsShard::~MetricsShard()
+{
+    qDeleteAll(m_topics);
+    qDeleteAll(m_clients);
+}
+
+qint64 MetricsShard::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MetricsShard::TrafficCounters* MetricsShard::createTopic(TopicId topicId)
+{
+    if (topicId == TopicRegistry::InvalidTopic) {
+        return nullptr;
+    }
+
+    // 只有本线程修改表结构，加锁只是为了不和正在收集快照的线程冲突
+    QMutexLocker locker(&m_mutex);
+    if (int(topicId) >= m_topics.size()) {
+        m_topics.resize(qMax(int(topicId) + 1, m_topics.size() * 2));
+    }
+
+    TrafficCounters* counters = new TrafficCounters();
+    m_topics[int(topicId)] = counters;
+    return counters;
+}
+
+MetricsShard::ClientCounters* MetricsShard::addClient(ClientHandle handle, const QString& id)
+{
+    ClientCounters* counters = new ClientCounters();
+    counters->id = id;
+
+    QMutexLocker locker(&m_mutex);
+    delete m_clients.take(handle);
+    m_clients.insert(handle, counters);
+    return counters;
+}
+
+void MetricsShard::removeClient(ClientHandle handle)
+{
+    QMutexLocker locker(&m_mutex);
+    delete m_clients.take(handle);
+}
+
+void MetricsShard::collect(BrokerStats* stats, QHash<TopicId, TrafficStats>* topics) const
+{
+    stats->matchedSubscribers += m_matchedSubscribers.value();
+    stats->routeCacheHits += m_routeCacheHits.value();
+    stats->routeCacheMisses += m_routeCacheMisses.value();
+
+    // 桶内的值按桶的中点计入，误差不超过桶宽的一半
+    for (int i = 0; i < LatencyHistogram::kBucketCount; ++i) {
+        const quint64 count = m_residence[i].value();
+        if (count > 0) {
+            const quint64 lower = LatencyHistogram::bucketLowerBound(i);
+            stats->residence.record(lower + (LatencyHistogram::bucketUpperBound(i) - lower) / 2, count);
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < m_topics.size(); ++i) {
+        const TrafficCounters* counters = m_topics.at(i);
+        if (counters) {
+            TrafficStats& topic = (*topics)[TopicId(i)];
+            addTraffic(topic, *counters);
+            addTraffic(stats->total, *counters);
+        }
+    }
+
+    for (auto it = m_clients.constBegin(); it != m_clients.constEnd(); ++it) {
+        const ClientCounters* counters = it.value();
+        ClientStats& client = stats->clients[counters->id];
+        addTraffic(client, *counters);
+        client.queuedMessages = counters->queuedMessages.value();
+    }
+}
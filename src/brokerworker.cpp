@@ -0,0 +1,1354 @@
+#include "brokerworker.h"
+#include "sharedmemorychannel.h"
+#include "epollpoller.h"
+#include "nativesocket.h"
+#include "logger.h"
+
+#include <QLocalSocket>
+#include <QSocketNotifier>
+#include <QTcpSocket>
+#include <QUuid>
+
+#include <utility>
+
+namespace {
+
+/**
+ * @brief 同一条消息在不同协议版本下的编码
+ *
+ * 原始帧原样复用；只有遇到协议版本不同或使用主题别名的订阅者时才转码，
+ * 且每个I/O线程每条消息每种编码只转码一次。
+ */
+class FrameEncodings
+{
+public:
+    FrameEncodings(const QByteArray& frame, TopicId topicId)
+        : m_frame(frame)
+        , m_version(Message::frameVersion(frame))
+        , m_topicId(topicId)
+    {
+    }
+
+    QByteArray forVersion(int version)
+    {
+        if (version == m_version) {
+            return m_frame;
+        }
+
+        if (m_transcoded.isEmpty()) {
+            Message message;
+            if (message.deserializeFrame(m_frame)) {
+                m_transcoded = message.serialize(static_cast<Message::ProtocolVersion>(version));
+            }
+        }
+        return m_transcoded;
+    }
+
+    QByteArray withTopicAlias()
+    {
+        // 别名就是主题编号，同一条消息对所有使用别名的订阅者都相同
+        if (m_aliased.isEmpty()) {
+            m_aliased = Message::withTopicAlias(forVersion(Message::ProtocolV2), m_topicId);
+            if (m_aliased.isEmpty()) {
+                m_aliased = forVersion(Message::ProtocolV2);
+            }
+        }
+        return m_aliased;
+    }
+
+private:
+    QByteArray m_frame;       ///< 发布者发送的原始帧
+    int m_version;            ///< 原始帧的协议版本
+    TopicId m_topicId;        ///< 驻留的主题编号
+    QByteArray m_transcoded;  ///< 转码后的帧（协议版本只有两种，一个即可）
+    QByteArray m_aliased;     ///< 使用主题别名的 V2 帧
+};
+
+// 套接字写缓冲区的高水位，超过后新消息进入有界发送队列
+const qint64 kSocketHighWatermark = 256 * 1024;
+
+// 回放历史消息时每页读取的消息数
+const int kReplayPageSize = 256;
+
+// 一个读事件中最多从共享内存读取的次数，持续写入的客户端不会独占I/O线程
+const int kMaxSharedMemoryReads = 64;
+
+// epoll 后端复用的接收缓冲区大小，以及一个读事件中最多读取的次数（水平触发，没读完下一轮继续）
+const int kNativeReadBufferSize = 64 * 1024;
+const int kMaxNativeReads = 16;
+
+// 一轮最多处理的 epoll 事件数
+const int kMaxNativeEvents = 256;
+
+// 客户端可以协商的心跳间隔范围（秒）
+const int kMinKeepAlive = 1;
+const int kMaxKeepAlive = 3600;
+
+/**
+ * @brief 获取发送使用的设备：建立共享内存通道后写入通道，否则写入套接字
+ */
+QIODevice* outputDevice(const ClientInfo& client)
+{
+    if (client.shmChannel) {
+        return client.shmChannel;
+    }
+    return client.tcpSocket ? static_cast<QIODevice*>(client.tcpSocket)
+                            : static_cast<QIODevice*>(client.localSocket);
+}
+
+/**
+ * @brief 获取尚未写出的字节数
+ */
+qint64 pendingOutput(const ClientInfo& client)
+{
+    if (client.nativeSocket) {
+        return client.nativeSocket->bytesToWrite();
+    }
+    QIODevice* device = outputDevice(client);
+    return device ? device->bytesToWrite() : 0;
+}
+
+/**
+ * @brief 客户端是否已经通过共享内存发送
+ */
+bool readsSharedMemory(const ClientInfo& client)
+{
+    return client.shmChannel && client.shmChannel->isReading();
+}
+
+} // namespace
+
+BrokerWorker::BrokerWorker(Broker* broker, int index)
+    : QObject(nullptr)
+    , m_broker(broker)
+    , m_index(index)
+    , m_activityTimer(new QTimer(this))
+    , m_currentTick(0)
+    , m_drainScheduled(false)
+    , m_connectionCount(0)
+    , m_queuedMessages(0)
+    , m_queuedBytes(0)
+    , m_droppedMessages(0)
+    , m_conflatedMessages(0)
+    , m_slowConsumerDisconnects(0)
+    , m_poller(nullptr)
+    , m_pollerNotifier(nullptr)
+    , m_nativeFlushScheduled(false)
+    , m_receivedAt(0)
+{
+    // 定时器是子对象，随工作对象一起移动到I/O线程；节拍从0开始，与时间轮的起点一致
+    m_clock.start();
+    connect(m_activityTimer, &QTimer::timeout, this, &BrokerWorker::checkClientActivity);
+    m_activityTimer->setInterval(1000);
+}
+
+BrokerWorker::~BrokerWorker()
+{
+    const QVector<ClientHandle> handles = m_clients.handles();
+    for (ClientHandle handle : handles) {
+        delete m_clients.take(handle);
+    }
+
+    // 丢弃尚未取出的投递请求
+    Delivery delivery;
+    while (m_deliveries.tryPop(delivery)) {
+    }
+
+    delete m_poller;
+}
+
+int BrokerWorker::index() const
+{
+    return m_index;
+}
+
+int BrokerWorker::connectionCount() const
+{
+    return m_connectionCount.loadRelaxed();
+}
+
+OutboundQueueStats BrokerWorker::outboundQueueStats() const
+{
+    OutboundQueueStats stats;
+    stats.queuedMessages = m_queuedMessages.loadRelaxed();
+    stats.queuedBytes = m_queuedBytes.loadRelaxed();
+    stats.droppedMessages = m_droppedMessages.loadRelaxed();
+    stats.conflatedMessages = m_conflatedMessages.loadRelaxed();
+    stats.slowConsumerDisconnects = m_slowConsumerDisconnects.loadRelaxed();
+    return stats;
+}
+
+void BrokerWorker::collectMetrics(BrokerStats* stats, QHash<TopicId, TrafficStats>* topics) const
+{
+    m_metrics.collect(stats, topics);
+}
+
+void BrokerWorker::initialize()
+{
+    m_activityTimer->start();
+
+    if (m_broker->ioBackend() != Broker::EpollBackend) {
+        return;
+    }
+
+    // 通知器和 epoll 实例都属于本线程，只监视 epoll 描述符一个
+    m_poller = new EpollPoller();
+    if (!m_poller->isValid()) {
+        MYMQ_LOG_WARNING(QString("I/O thread %1 failed to create epoll instance, using Qt sockets").arg(m_index));
+        delete m_poller;
+        m_poller = nullptr;
+        return;
+    }
+
+    m_readBuffer.resize(kNativeReadBufferSize);
+    m_pollerNotifier = new QSocketNotifier(m_poller->descriptor(), QSocketNotifier::Read, this);
+    connect(m_pollerNotifier, &QSocketNotifier::activated, this, &BrokerWorker::processNativeEvents);
+}
+
+void BrokerWorker::enqueueDelivery(Delivery delivery)
+{
+    m_deliveries.push(std::move(delivery));
+
+    // 队列从空变为非空时才唤醒一次，同一轮事件循环内的其他投递由同一次 drain 取出
+    if (!m_drainScheduled.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(this, &BrokerWorker::drainDeliveries, Qt::QueuedConnection);
+    }
+}
+
+void BrokerWorker::enqueueLocalDelivery(Delivery delivery)
+{
+    // 其他生产者尚未链接的节点可能暂时挡住这一项，那个生产者链接之后会安排 drain
+    m_deliveries.push(std::move(delivery));
+}
+
+void BrokerWorker::drainDeliveries()
+{
+    // 先清除标志再取出，之后放入的请求会重新安排一次 drain，不会丢失唤醒
+    m_drainScheduled.exchange(false, std::memory_order_acq_rel);
+    deliverQueued();
+
+    // 一批投递发给同一连接的帧合并成一次发送
+    flushNativeSockets();
+    recordResidence();
+}
+
+void BrokerWorker::deliverQueued()
+{
+    Delivery delivery;
+    while (m_deliveries.tryPop(delivery)) {
+        deliver(delivery.topicId, delivery.topic, delivery.frame, delivery.clients, delivery.receivedAt);
+    }
+}
+
+void BrokerWorker::deliver(TopicId topicId, const QString& topic, const QByteArray& frame,
+                           const QSet<ClientHandle>& clients, qint64 receivedAt)
+{
+    FrameEncodings encodings(frame, topicId);
+    quint64 delivered = 0;
+    quint64 deliveredBytes = 0;
+    for (ClientHandle handle : clients) {
+        ClientInfo* clientInfo = m_clients.value(handle);
+
+        // 客户端可能在投递途中断开，旧句柄查不到客户端
+        if (!clientInfo || !clientInfo->isSubscriber || clientInfo->disconnecting) {
+            continue;
+        }
+
+        const QByteArray encoded = useTopicAlias(clientInfo, topicId, topic)
+                                       ? encodings.withTopicAlias()
+                                       : encodings.forVersion(clientInfo->protocolVersion);
+        if (sendFrame(clientInfo, topic, encoded)) {
+            ++delivered;
+            deliveredBytes += quint64(encoded.size());
+            clientInfo->metrics->messagesOut.add(1);
+            clientInfo->metrics->bytesOut.add(quint64(encoded.size()));
+            MYMQ_LOG_DEBUG(QString("Sent message to client %1: %2").arg(clientInfo->id).arg(topic));
+        }
+    }
+
+    if (delivered == 0) {
+        return;
+    }
+
+    MetricsShard::TrafficCounters* topicMetrics = m_metrics.topic(topicId);
+    if (topicMetrics) {
+        topicMetrics->messagesOut.add(delivered);
+        topicMetrics->bytesOut.add(deliveredBytes);
+    }
+    m_pendingResidence.append(receivedAt);
+}
+
+WorkerSubscribers BrokerWorker::subscribersFor(TopicId topicId, const QString& topic)
+{
+    // 先读取版本号再匹配：匹配期间订阅表发生变化时缓存的版本号已经过期，下一条消息会重新匹配
+    const quint64 generation = m_broker->routingGeneration();
+    RouteCacheEntry& entry = m_routeCache[topicId];
+    const bool hit = entry.generation == generation;
+    if (!hit) {
+        entry.subscribers = m_broker->matchSubscribers(topic);
+        entry.generation = generation;
+        entry.subscriberCount = 0;
+        for (auto it = entry.subscribers.constBegin(); it != entry.subscribers.constEnd(); ++it) {
+            entry.subscriberCount += it.value().size();
+        }
+    }
+
+    m_metrics.recordRouteCache(hit);
+    m_metrics.recordRoute(entry.subscriberCount);
+    return entry.subscribers;
+}
+
+void BrokerWorker::addConnection(qintptr socketDescriptor, bool isLocal)
+{
+    if (!isLocal && m_poller) {
+        addNativeConnection(int(socketDescriptor));
+        return;
+    }
+
+    QIODevice* socket = nullptr;
+
+    if (isLocal) {
+        QLocalSocket* localSocket = new QLocalSocket(this);
+        if (!localSocket->setSocketDescriptor(socketDescriptor)) {
+            MYMQ_LOG_WARNING(QString("Failed to adopt local connection: %1").arg(localSocket->errorString()));
+            delete localSocket;
+            return;
+        }
+        socket = localSocket;
+    } else {
+        QTcpSocket* tcpSocket = new QTcpSocket(this);
+        if (!tcpSocket->setSocketDescriptor(socketDescriptor)) {
+            MYMQ_LOG_WARNING(QString("Failed to adopt TCP connection: %1").arg(tcpSocket->errorString()));
+            delete tcpSocket;
+            return;
+        }
+        socket = tcpSocket;
+    }
+
+    ClientInfo* clientInfo = registerClient(socket, isLocal);
+    if (!clientInfo) {
+        MYMQ_LOG_WARNING(QString("I/O thread %1 connection table is full, rejecting connection").arg(m_index));
+        delete socket;
+        return;
+    }
+
+    MYMQ_LOG_INFO(QString("New %1 client connected on I/O thread %2: %3")
+                  .arg(isLocal ? "local" : "TCP").arg(m_index).arg(clientInfo->id));
+    emit m_broker->clientConnected(clientInfo->id);
+
+    // 连接在移交期间可能已经收到数据
+    if (socket->bytesAvailable() > 0) {
+        handleReadyRead(clientInfo->handle);
+    }
+}
+
+void BrokerWorker::addNativeConnection(int socketDescriptor)
+{
+    NativeSocket* socket = new NativeSocket(socketDescriptor);
+    ClientInfo* clientInfo = createClient();
+    if (!clientInfo) {
+        MYMQ_LOG_WARNING(QString("I/O thread %1 connection table is full, rejecting connection").arg(m_index));
+        delete socket;
+        return;
+    }
+
+    // 句柄就是 epoll 事件的标识，事件按句柄 O(1) 找到客户端
+    clientInfo->nativeSocket = socket;
+    if (!m_poller->add(socket->descriptor(), clientInfo->handle)) {
+        MYMQ_LOG_WARNING(QString("Failed to register TCP connection with epoll on I/O thread %1").arg(m_index));
+        unregisterClient(clientInfo->handle);
+        return;
+    }
+
+    MYMQ_LOG_INFO(QString("New TCP client connected on I/O thread %1 (epoll): %2")
+                  .arg(m_index).arg(clientInfo->id));
+    emit m_broker->clientConnected(clientInfo->id);
+
+    // 连接在移交期间可能已经收到数据，水平触发的 epoll 也会报告，这里先读可以少一轮
+    m_receivedAt = MetricsShard::now();
+    handleNativeEvent(clientInfo->handle, EpollPoller::Readable);
+    flushNativeSockets();
+    recordResidence();
+}
+
+void BrokerWorker::processNativeEvents()
+{
+    // 一批事件共用一个读入时间，停留时间包含同一批中排在前面的事件的处理时间
+    m_receivedAt = MetricsShard::now();
+
+    EpollPoller::Event events[kMaxNativeEvents];
+    const int count = m_poller->poll(events, kMaxNativeEvents);
+    for (int i = 0; i < count; ++i) {
+        handleNativeEvent(ClientHandle(events[i].token), events[i].flags);
+    }
+
+    // 这一批事件中写给各连接的数据统一发送
+    flushNativeSockets();
+    recordResidence();
+}
+
+void BrokerWorker::handleNativeEvent(ClientHandle handle, int flags)
+{
+    // 同一批中前面的事件可能已经注销了该连接，旧句柄查不到客户端
+    ClientInfo* clientInfo = m_clients.value(handle);
+    if (!clientInfo || !clientInfo->nativeSocket) {
+        return;
+    }
+
+    if (flags & EpollPoller::Writable) {
+        flushNativeSocket(clientInfo);
+        clientInfo = m_clients.value(handle);
+        if (!clientInfo) {
+            return;
+        }
+    }
+
+    if (!(flags & (EpollPoller::Readable | EpollPoller::Closed))) {
+        return;
+    }
+
+    clientInfo->lastActiveTick = m_currentTick;
+
+    // 读入复用的缓冲区，以视图交给帧处理器：完整的帧就地解析，只有末尾不完整的帧被复制
+    NativeSocket* socket = clientInfo->nativeSocket;
+    MessageFrameHandler* frameHandler = clientInfo->frameHandler;
+    bool closed = false;
+    for (int reads = 0; reads < kMaxNativeReads; ++reads) {
+        const qint64 count = socket->read(m_readBuffer.data(), m_readBuffer.size());
+        if (count < 0) {
+            closed = true;
+            break;
+        }
+        if (count == 0) {
+            break;
+        }
+
+        frameHandler->processIncomingData(QByteArray::fromRawData(m_readBuffer.constData(), int(count)));
+
+        // 没有读满说明内核缓冲区已经读空，省掉一次返回 EAGAIN 的系统调用
+        if (count < m_readBuffer.size()) {
+            break;
+        }
+    }
+
+    sendConfirms(handle);
+    sendPong(handle);
+
+    if (closed) {
+        handleDisconnected(handle);
+    }
+}
+
+void BrokerWorker::flushNativeSocket(ClientInfo* client)
+{
+    NativeSocket* socket = client->nativeSocket;
+    const qint64 written = socket->flush();
+    if (written < 0) {
+        // 可能正处于其他客户端帧处理器的信号中，延迟到下一轮事件循环再注销
+        client->disconnecting = true;
+        const ClientHandle handle = client->handle;
+        QMetaObject::invokeMethod(this, [this, handle]() { handleDisconnected(handle); }, Qt::QueuedConnection);
+        return;
+    }
+
+    // 内核缓冲区满时关注可写，发完后取消，空闲连接不会不断报告可写
+    const bool blocked = socket->bytesToWrite() > 0;
+    if (blocked != socket->writeInterest()) {
+        m_poller->setWriteInterest(socket->descriptor(), client->handle, blocked);
+        socket->setWriteInterest(blocked);
+    }
+
+    // 相当于 QTcpSocket 的 bytesWritten 信号，继续写出排队的消息和回放
+    if (written > 0 && !client->outboundQueue->isEmpty()) {
+        flushOutbound(client);
+    }
+    if (written > 0 && !client->pendingReplays.isEmpty()) {
+        continueReplay(client);
+    }
+}
+
+void BrokerWorker::flushNativeSockets()
+{
+    m_nativeFlushScheduled = false;
+
+    // 发送期间可能写入新的数据（例如发送队列被继续写出），它们进入新的列表
+    while (!m_dirtySockets.isEmpty()) {
+        QVector<ClientHandle> handles;
+        handles.swap(m_dirtySockets);
+        for (ClientHandle handle : std::as_const(handles)) {
+            ClientInfo* clientInfo = m_clients.value(handle);
+            if (clientInfo && clientInfo->nativeSocket) {
+                flushNativeSocket(clientInfo);
+            }
+        }
+    }
+}
+
+void BrokerWorker::closeAllConnections()
+{
+    m_activityTimer->stop();
+
+    const QVector<ClientHandle> handles = m_clients.handles();
+    for (ClientHandle handle : handles) {
+        unregisterClient(handle);
+    }
+
+    drainDeliveries();
+
+    // 通知器只能在所属线程删除，epoll 实例随之释放
+    delete m_pollerNotifier;
+    m_pollerNotifier = nullptr;
+    delete m_poller;
+    m_poller = nullptr;
+}
+
+void BrokerWorker::handleReadyRead(ClientHandle handle)
+{
+    ClientInfo* clientInfo = m_clients.value(handle);
+    if (!clientInfo) {
+        MYMQ_LOG_WARNING("Received data from unknown client");
+        return;
+    }
+
+    QIODevice* socket = clientInfo->tcpSocket ? static_cast<QIODevice*>(clientInfo->tcpSocket)
+                                              : static_cast<QIODevice*>(clientInfo->localSocket);
+
+    // 更新最后活动的节拍，空闲超时到期时才比较
+    clientInfo->lastActiveTick = m_currentTick;
+    m_receivedAt = MetricsShard::now();
+
+    // 读取数据，收到完整消息时帧处理器会发出 frameReceived 信号。
+    // 收到 $SYS/SHMREADY 之后套接字上只剩门铃，不再按帧读取
+    MessageFrameHandler* frameHandler = clientInfo->frameHandler;
+    if (readsSharedMemory(*clientInfo)) {
+        clientInfo->shmChannel->handleDoorbell();
+    } else {
+        while (socket->bytesAvailable() > 0 && !readsSharedMemory(*clientInfo)) {
+            frameHandler->processIncomingData(socket->readAll());
+        }
+    }
+
+    // 读到共享内存读空为止，读空时通道登记等待，之后写入的数据会按门铃
+    if (readsSharedMemory(*clientInfo)) {
+        int reads = 0;
+        for (QByteArray data = clientInfo->shmChannel->readAll(); !data.isEmpty();
+             data = clientInfo->shmChannel->readAll()) {
+            frameHandler->processIncomingData(data);
+            if (++reads >= kMaxSharedMemoryReads) {
+                // 没有读空就不会有门铃，自己安排下一轮
+                QMetaObject::invokeMethod(this, [this, handle]() { handleReadyRead(handle); }, Qt::QueuedConnection);
+                break;
+            }
+        }
+    }
+
+    // 一次读事件里收到的消息合并成一条累计确认
+    sendConfirms(handle);
+    sendPong(handle);
+
+    // 本线程 epoll 后端的订阅者在这里统一发送
+    flushNativeSockets();
+    recordResidence();
+}
+
+void BrokerWorker::handleBytesWritten(ClientHandle handle)
+{
+    ClientInfo* clientInfo = m_clients.value(handle);
+    if (!clientInfo) {
+        return;
+    }
+
+    if (!clientInfo->outboundQueue->isEmpty()) {
+        flushOutbound(clientInfo);
+    }
+
+    // 排队的消息写完之后继续回放
+    if (!clientInfo->pendingReplays.isEmpty()) {
+        continueReplay(clientInfo);
+    }
+}
+
+void BrokerWorker::handleDisconnected(ClientHandle handle)
+{
+    ClientInfo* clientInfo = m_clients.value(handle);
+    if (!clientInfo) {
+        return;
+    }
+
+    const QString clientId = clientInfo->id;
+    const bool isLocal = clientInfo->localSocket != nullptr;
+    unregisterClient(handle);
+
+    MYMQ_LOG_INFO(QString("%1 client disconnected: %2").arg(isLocal ? "Local" : "TCP").arg(clientId));
+    emit m_broker->clientDisconnected(clientId);
+}
+
+void BrokerWorker::checkClientActivity()
+{
+    m_currentTick = quint64(m_clock.elapsed() / 1000);
+
+    QVector<ClientHandle> expired;
+    m_idleTimers.advance(m_currentTick, &expired);
+
+    QVector<ClientHandle> inactiveClients;
+    for (ClientHandle handle : std::as_const(expired)) {
+        ClientInfo* clientInfo = m_clients.value(handle);
+        if (!clientInfo) {
+            continue;
+        }
+
+        // 登记之后有过活动的客户端按新的截止节拍重新登记
+        const quint64 deadline = clientInfo->lastActiveTick + quint64(clientInfo->idleTimeout);
+        if (deadline > m_currentTick) {
+            m_idleTimers.schedule(handle, deadline);
+        } else {
+            inactiveClients.append(handle);
+        }
+    }
+
+    // 注销不活跃的客户端
+    for (ClientHandle handle : std::as_const(inactiveClients)) {
+        const QString clientId = m_clients.value(handle)->id;
+        MYMQ_LOG_INFO(QString("Client inactive, disconnecting: %1").arg(clientId));
+        unregisterClient(handle);
+        emit m_broker->clientDisconnected(clientId);
+    }
+}
+
+void BrokerWorker::processFrame(ClientInfo* client, const QString& topic, const QByteArray& frame)
+{
+    // 使用主题别名的帧：按本连接的别名表取出主题编号，不需要解析和哈希主题字符串
+    const quint32 topicAlias = Message::peekTopicAlias(frame);
+    if (topicAlias != 0) {
+        const quint64 index = client->publishedCount++;
+        auto it = client->topicAliases.constFind(topicAlias);
+        if (it == client->topicAliases.constEnd()) {
+            MYMQ_LOG_WARNING(QString("Client %1 used unknown topic alias %2").arg(client->id).arg(topicAlias));
+            rejectMessage(client, index, QString("Unknown topic alias %1").arg(topicAlias));
+            return;
+        }
+
+        if (!client->isPublisher) {
+            MYMQ_LOG_WARNING(QString("Client %1 is not registered as publisher").arg(client->id));
+            rejectMessage(client, index, "Not registered as publisher");
+            return;
+        }
+
+        if (!routeClientFrame(client, it.value().topicId, it.value().topic, frame)) {
+            rejectMessage(client, index, "Failed to append message to the log");
+        }
+        return;
+    }
+
+    MYMQ_LOG_DEBUG(QString("Processing message from client %1, topic: %2").arg(client->id).arg(topic));
+
+    // 系统消息需要读取负载，完整解码后交给控制消息处理
+    if (topic.startsWith("$SYS/")) {
+        Message message;
+        if (!message.deserializeFrame(frame)) {
+            MYMQ_LOG_WARNING(QString("Client %1: failed to decode system message %2").arg(client->id).arg(topic));
+            return;
+        }
+
+        if (processControlMessage(client, message)) {
+            return;
+        }
+    }
+
+    // 数据消息按到达顺序编号，确认和拒绝都使用这个编号
+    const quint64 index = client->publishedCount++;
+
+    // 检查客户端是否为发布者
+    if (!client->isPublisher) {
+        MYMQ_LOG_WARNING(QString("Client %1 is not registered as publisher").arg(client->id));
+        rejectMessage(client, index, "Not registered as publisher");
+        return;
+    }
+
+    // 统计主题由Broker发布，客户端不能伪造
+    if (topic.startsWith("$SYS/STATS/")) {
+        MYMQ_LOG_WARNING(QString("Client %1 published to reserved topic %2").arg(client->id).arg(topic));
+        rejectMessage(client, index, "Reserved topic");
+        return;
+    }
+
+    // 驻留表已满时不再接受新主题
+    const TopicId topicId = m_broker->topicRegistry()->intern(topic);
+    if (topicId == TopicRegistry::InvalidTopic) {
+        MYMQ_LOG_WARNING(QString("Client %1: too many topics, rejecting %2").arg(client->id).arg(topic));
+        rejectMessage(client, index, "Too many topics");
+        return;
+    }
+
+    if (!routeClientFrame(client, topicId, topic, frame)) {
+        rejectMessage(client, index, "Failed to append message to the log");
+    }
+}
+
+bool BrokerWorker::routeClientFrame(ClientInfo* client, TopicId topicId, const QString& topic, const QByteArray& frame)
+{
+    const quint64 bytes = quint64(frame.size());
+    client->metrics->messagesIn.add(1);
+    client->metrics->bytesIn.add(bytes);
+
+    MetricsShard::TrafficCounters* topicMetrics = m_metrics.topic(topicId);
+    if (topicMetrics) {
+        topicMetrics->messagesIn.add(1);
+        topicMetrics->bytesIn.add(bytes);
+    }
+
+    return m_broker->routeFrame(this, topicId, topic, frame, m_receivedAt);
+}
+
+void BrokerWorker::recordResidence()
+{
+    if (m_pendingResidence.isEmpty()) {
+        return;
+    }
+
+    const qint64 now = MetricsShard::now();
+    for (qint64 receivedAt : std::as_const(m_pendingResidence)) {
+        m_metrics.recordResidence(now - receivedAt);
+    }
+    m_pendingResidence.clear();
+}
+
+void BrokerWorker::publishStats()
+{
+    static const char* const kStatsTopics[] = { "$SYS/STATS/broker", "$SYS/STATS/topics", "$SYS/STATS/clients" };
+
+    // 只在有订阅者时收集快照，快照对三个主题共用
+    BrokerStats stats;
+    bool collected = false;
+    const qint64 now = MetricsShard::now();
+    for (int i = 0; i < int(sizeof(kStatsTopics) / sizeof(kStatsTopics[0])); ++i) {
+        const QString topic = QString::fromLatin1(kStatsTopics[i]);
+        const TopicId topicId = m_broker->topicRegistry()->intern(topic);
+        const WorkerSubscribers subscribers = subscribersFor(topicId, topic);
+        if (subscribers.isEmpty()) {
+            continue;
+        }
+
+        if (!collected) {
+            stats = m_broker->stats();
+            collected = true;
+        }
+
+        const QByteArray payload = i == 0 ? stats.brokerJson() : i == 1 ? stats.topicsJson() : stats.clientsJson();
+        m_broker->dispatchFrame(this, topicId, topic, Message(topic, payload).serialize(Message::ProtocolV2),
+                                subscribers, now);
+    }
+
+    deliverQueued();
+
+    flushNativeSockets();
+    recordResidence();
+}
+
+bool BrokerWorker::processControlMessage(ClientInfo* client, const Message& message)
+{
+    // 特殊主题处理
+    if (message.topic() == "$SYS/SUBSCRIBE") {
+        // 订阅请求，负载中主题之后可以附带订阅选项
+        QString topic;
+        const SubscriptionOptions options = SubscriptionOptions::fromPayload(message.data(), &topic);
+        handleSubscription(client, topic, options);
+        return true;
+    } else if (message.topic() == "$SYS/UNSUBSCRIBE") {
+        // 取消订阅请求
+        QString topic;
+        SubscriptionOptions::fromPayload(message.data(), &topic);
+        handleUnsubscription(client, topic);
+        return true;
+    } else if (message.topic() == "$SYS/ALIAS") {
+        // 登记发布时使用的主题别名
+        handleTopicAlias(client, message.data());
+        return true;
+    } else if (message.topic() == "$SYS/ALIASES") {
+        // 是否以主题别名接收消息
+        client->receiveTopicAliases = message.data() != "0";
+        MYMQ_LOG_INFO(QString("Client %1 %2 topic aliases")
+                      .arg(client->id).arg(client->receiveTopicAliases ? "enabled" : "disabled"));
+        return true;
+    } else if (message.topic() == "$SYS/CONFIRMS") {
+        // 是否确认收到的消息，确认覆盖开启之后收到的消息
+        client->confirmsEnabled = message.data() != "0";
+        client->confirmedCount = client->publishedCount;
+        MYMQ_LOG_INFO(QString("Client %1 %2 publisher confirms")
+                      .arg(client->id).arg(client->confirmsEnabled ? "enabled" : "disabled"));
+        return true;
+    } else if (message.topic() == "$SYS/SHM") {
+        // 同主机客户端请求共享内存通道
+        handleSharedMemoryRequest(client, QString::fromUtf8(message.data()));
+        return true;
+    } else if (message.topic() == "$SYS/SHMREADY") {
+        // 客户端已经切换到共享内存发送，这是它在套接字上的最后一条消息
+        if (client->shmChannel) {
+            client->shmChannel->startReading();
+            MYMQ_LOG_INFO(QString("Client %1 switched to shared memory").arg(client->id));
+        }
+        return true;
+    } else if (message.topic() == "$SYS/HELLO") {
+        // 协议协商：客户端报告支持的最高版本，Broker回复双方都支持的版本
+        handleHello(client, message.data().toInt());
+        return true;
+    } else if (message.topic() == "$SYS/IDLETIMEOUT") {
+        // 客户端为自己的连接设置空闲超时（秒），0 表示使用Broker的默认值
+        const int seconds = message.data().toInt();
+        setIdleTimeout(client, seconds > 0 ? seconds : m_broker->idleTimeout());
+        MYMQ_LOG_INFO(QString("Client %1 set idle timeout to %2 s").arg(client->id).arg(client->idleTimeout));
+        return true;
+    } else if (message.topic() == "$SYS/KEEPALIVE") {
+        // 协商心跳间隔（秒），0 表示关闭
+        handleKeepAlive(client, message.data().toInt());
+        return true;
+    } else if (message.topic() == "$SYS/REGISTER") {
+        // 注册为发布者或订阅者
+        QString role = QString::fromUtf8(message.data());
+        if (role == "PUBLISHER") {
+            client->isPublisher = true;
+            MYMQ_LOG_INFO(QString("Client %1 registered as publisher").arg(client->id));
+        } else if (role == "SUBSCRIBER") {
+            client->isSubscriber = true;
+            MYMQ_LOG_INFO(QString("Client %1 registered as subscriber").arg(client->id));
+        }
+        return true;
+    }
+
+    return false;
+}
+
+void BrokerWorker::handleTopicAlias(ClientInfo* client, const QByteArray& payload)
+{
+    quint32 topicAlias = 0;
+    QString topic;
+    // 超过 V2 主题长度上限的主题无法在别名帧展开时写回，拒绝登记
+    if (!Message::parseTopicAliasPayload(payload, topicAlias, topic) || topic.startsWith("$SYS/")
+        || Topic::isWildcard(topic) || !Message::fitsTopicV2(topic)) {
+        MYMQ_LOG_WARNING(QString("Client %1: invalid topic alias registration").arg(client->id));
+        return;
+    }
+
+    // 别名可以重新绑定到其他主题，但总数有上限，防止客户端无限占用内存
+    if (!client->topicAliases.contains(topicAlias) && client->topicAliases.size() >= Message::kMaxTopicAliases) {
+        MYMQ_LOG_WARNING(QString("Client %1: too many topic aliases").arg(client->id));
+        return;
+    }
+
+    TopicAlias entry;
+    entry.topicId = m_broker->topicRegistry()->intern(topic);
+    if (entry.topicId == TopicRegistry::InvalidTopic) {
+        MYMQ_LOG_WARNING(QString("Client %1: too many topics, rejecting topic alias").arg(client->id));
+        return;
+    }
+    entry.topic = topic;
+    client->topicAliases.insert(topicAlias, entry);
+    MYMQ_LOG_DEBUG(QString("Client %1 registered topic alias %2: %3").arg(client->id).arg(topicAlias).arg(topic));
+}
+
+bool BrokerWorker::useTopicAlias(ClientInfo* client, TopicId topicId, const QString& topic)
+{
+    if (!client->receiveTopicAliases || client->protocolVersion != Message::ProtocolV2
+        || topicId == TopicRegistry::InvalidTopic) {
+        return false;
+    }
+
+    if (int(topicId) < client->announcedTopics.size() && client->announcedTopics.testBit(int(topicId))) {
+        return true;
+    }
+
+    const QByteArray announcement = Message("$SYS/ALIAS", Message::topicAliasPayload(topicId, topic))
+                                        .serialize(Message::ProtocolV2);
+    if (!writeFrame(*client, announcement)) {
+        return false;
+    }
+
+    if (int(topicId) >= client->announcedTopics.size()) {
+        client->announcedTopics.resize(qMax(int(topicId) + 1, client->announcedTopics.size() * 2));
+    }
+    client->announcedTopics.setBit(int(topicId));
+    return true;
+}
+
+void BrokerWorker::rejectMessage(ClientInfo* client, quint64 index, const QString& reason)
+{
+    if (!client->confirmsEnabled) {
+        return;
+    }
+
+    // 拒绝立即发出，先于覆盖它的累计确认到达发布者
+    writeFrame(*client, Message("$SYS/NACK", QByteArray::number(index) + '\n' + reason.toUtf8())
+                            .serialize(static_cast<Message::ProtocolVersion>(client->protocolVersion)));
+}
+
+void BrokerWorker::sendConfirms(ClientHandle handle)
+{
+    // 处理消息期间客户端可能已经断开
+    ClientInfo* client = m_clients.value(handle);
+    if (!client || !client->confirmsEnabled || client->confirmedCount == client->publishedCount) {
+        return;
+    }
+
+    // 累计确认：编号小于 publishedCount 且没有被拒绝的消息都已经写入缓存或日志。
+    // 日志的写入可能还在文件缓冲区中，确认不等待 fdatasync
+    client->confirmedCount = client->publishedCount;
+    writeFrame(*client, Message("$SYS/ACK", QByteArray::number(client->publishedCount))
+                            .serialize(static_cast<Message::ProtocolVersion>(client->protocolVersion)));
+}
+
+void BrokerWorker::sendPong(ClientHandle handle)
+{
+    // 处理消息期间客户端可能已经断开
+    ClientInfo* client = m_clients.value(handle);
+    if (!client || !client->pongPending) {
+        return;
+    }
+
+    // 一次读事件里的心跳请求只回复一次，带回最近的令牌；epoll 后端随本轮的其他数据一起写出
+    client->pongPending = false;
+    writeFrame(*client, Message::heartbeatFrame(Message::Pong, client->pongToken));
+}
+
+void BrokerWorker::handleSharedMemoryRequest(ClientInfo* client, const QString& key)
+{
+    // 只有本地套接字的客户端和Broker在同一主机
+    SharedMemoryChannel* channel = nullptr;
+    if (client->localSocket && !client->shmChannel) {
+        channel = new SharedMemoryChannel(client->localSocket, this);
+        if (!channel->attach(key)) {
+            delete channel;
+            channel = nullptr;
+        }
+    }
+
+    // 回复是Broker在套接字上发送的最后一条消息，之后的帧都写入共享内存
+    writeFrame(*client, Message("$SYS/SHM", channel ? "1" : "0")
+                            .serialize(static_cast<Message::ProtocolVersion>(client->protocolVersion)));
+    if (!channel) {
+        MYMQ_LOG_WARNING(QString("Client %1: shared memory request rejected").arg(client->id));
+        return;
+    }
+
+    // 环满时积压的数据在客户端读出后写出，和套接字的 bytesWritten 一样驱动发送队列
+    client->shmChannel = channel;
+    const ClientHandle handle = client->handle;
+    connect(channel, &QIODevice::bytesWritten, this, [this, handle]() { handleBytesWritten(handle); });
+
+    // 环的读写位置由客户端控制，被破坏时不能再信任这段内存，断开该客户端
+    connect(channel, &SharedMemoryChannel::broken, this, [this, handle]() {
+        ClientInfo* clientInfo = m_clients.value(handle);
+        if (clientInfo) {
+            MYMQ_LOG_WARNING(QString("Client %1 corrupted its shared memory ring, disconnecting").arg(clientInfo->id));
+            handleDisconnected(handle);
+        }
+    }, Qt::QueuedConnection);
+    MYMQ_LOG_INFO(QString("Client %1 attached shared memory %2").arg(client->id).arg(key));
+}
+
+void BrokerWorker::handleHello(ClientInfo* client, int clientVersion)
+{
+    int version = qBound((int)Message::ProtocolV1, clientVersion, (int)Message::ProtocolV2);
+    client->protocolVersion = version;
+
+    // 回复使用 V1 编码，客户端收到回复之后才会切换协议
+    writeFrame(*client, Message("$SYS/HELLO", QByteArray::number(version)).serialize(Message::ProtocolV1));
+    MYMQ_LOG_INFO(QString("Client %1 negotiated protocol version %2").arg(client->id).arg(version));
+}
+
+void BrokerWorker::handleKeepAlive(ClientInfo* client, int seconds)
+{
+    int keepAlive = 0;
+    if (seconds > 0 && client->protocolVersion == Message::ProtocolV2) {
+        keepAlive = qBound(kMinKeepAlive, seconds, kMaxKeepAlive);
+    }
+
+    // 客户端最迟在安静一个间隔后发送心跳，留出半个间隔给网络延迟
+    setIdleTimeout(client, keepAlive > 0 ? keepAlive + (keepAlive + 1) / 2 : m_broker->idleTimeout());
+
+    writeFrame(*client, Message("$SYS/KEEPALIVE", QByteArray::number(keepAlive))
+                            .serialize(static_cast<Message::ProtocolVersion>(client->protocolVersion)));
+    MYMQ_LOG_INFO(QString("Client %1 negotiated keepalive %2 s, idle timeout %3 s")
+                  .arg(client->id).arg(keepAlive).arg(client->idleTimeout));
+}
+
+void BrokerWorker::setIdleTimeout(ClientInfo* client, int seconds)
+{
+    // 时间轮能登记的最远超时约为194天
+    const int maxTimeout = int(TimerWheel::kMaxDelay);
+    client->idleTimeout = qBound(0, seconds, maxTimeout);
+    if (client->idleTimeout == 0) {
+        m_idleTimers.cancel(client->handle);
+        return;
+    }
+    m_idleTimers.schedule(client->handle, client->lastActiveTick + quint64(client->idleTimeout));
+}
+
+void BrokerWorker::handleSubscription(ClientInfo* client, const QString& topic, const SubscriptionOptions& options)
+{
+    if (!Topic::isValidPattern(topic)) {
+        MYMQ_LOG_WARNING(QString("Client %1: invalid subscription pattern: %2").arg(client->id).arg(topic));
+        return;
+    }
+
+    MYMQ_LOG_INFO(QString("Client %1 subscribing to topic: %2 (overflow: %3)")
+                  .arg(client->id).arg(topic).arg(SubscriptionOptions::policyName(options.overflowPolicy)));
+
+    // 重复订阅同一模式时按新的选项重新回放，追上之前不接收实时消息
+    if (client->subscriptions.contains(topic)) {
+        cancelReplay(client, topic);
+        m_broker->removeSubscriber(topic, client->handle, this);
+    }
+    client->subscriptions.insert(topic, options);
+    client->isSubscriber = true;
+
+    // 先在锁外按页追赶历史消息，追上之后才登记订阅
+    PendingReplay replay;
+    replay.topic = topic;
+    replay.options = options;
+    replay.positions = m_broker->replayPositions(topic, options, false);
+    client->pendingReplays.append(replay);
+    continueReplay(client);
+}
+
+void BrokerWorker::handleUnsubscription(ClientInfo* client, const QString& topic)
+{
+    MYMQ_LOG_INFO(QString("Client %1 unsubscribing from topic: %2").arg(client->id).arg(topic));
+
+    client->subscriptions.remove(topic);
+    cancelReplay(client, topic);
+    m_broker->removeSubscriber(topic, client->handle, this);
+}
+
+void BrokerWorker::cancelReplay(ClientInfo* client, const QString& topic)
+{
+    for (int i = client->pendingReplays.size() - 1; i >= 0; --i) {
+        if (client->pendingReplays.at(i).topic == topic) {
+            client->pendingReplays.removeAt(i);
+        }
+    }
+}
+
+void BrokerWorker::continueReplay(ClientInfo* client)
+{
+    // 发送队列为空且写缓冲区低于高水位时才读下一页，一页不超过发送队列的容量，
+    // 回放再多也不会触发溢出策略；之后由写出进度（bytesWritten 或 epoll 可写）继续
+    const int pageSize = qMin(kReplayPageSize, client->outboundQueue->maxMessages());
+    while (!client->pendingReplays.isEmpty() && !client->disconnecting && client->outboundQueue->isEmpty()
+           && pendingOutput(*client) < kSocketHighWatermark) {
+        PendingReplay& replay = client->pendingReplays.first();
+        bool caughtUp = false;
+        QList<QByteArray> frames = m_broker->readReplay(&replay.positions, pageSize, false, &caughtUp);
+        const QString topic = replay.topic;
+
+        // 读到末尾：在主题锁内读完之后追加的几条并登记订阅
+        if (caughtUp) {
+            frames += m_broker->subscribe(topic, client->handle, this, replay.options, replay.positions);
+            client->pendingReplays.removeFirst();
+        }
+        sendReplayFrames(client, topic, frames);
+    }
+}
+
+void BrokerWorker::sendReplayFrames(ClientInfo* client, const QString& topic, const QList<QByteArray>& frames)
+{
+    // 帧已经编码并写入序号，这里无需重新序列化
+    for (const QByteArray& frame : frames) {
+        // 通配符订阅回放的是多个主题的消息，按帧读取主题用于发送队列的合并
+        QString frameTopic = topic;
+        if (Topic::isWildcard(topic)) {
+            Message::peekTopic(frame, frameTopic);
+        }
+
+        const TopicId topicId = m_broker->topicRegistry()->intern(frameTopic);
+        FrameEncodings encodings(frame, topicId);
+        const QByteArray encoded = useTopicAlias(client, topicId, frameTopic)
+                                       ? encodings.withTopicAlias()
+                                       : encodings.forVersion(client->protocolVersion);
+        if (sendFrame(client, frameTopic, encoded)) {
+            MYMQ_LOG_DEBUG(QString("Replayed message to client %1: %2").arg(client->id).arg(frameTopic));
+        }
+    }
+}
+
+bool BrokerWorker::sendFrame(ClientInfo* client, const QString& topic, const QByteArray& frame)
+{
+    if (client->disconnecting) {
+        return false;
+    }
+
+    if (!client->nativeSocket && !outputDevice(*client)) {
+        return false;
+    }
+
+    // 订阅者跟得上时直接写出，套接字会复制数据，不需要额外的拷贝
+    OutboundQueue* queue = client->outboundQueue;
+    if (queue->isEmpty() && pendingOutput(*client) < kSocketHighWatermark) {
+        return writeFrame(*client, frame);
+    }
+
+    // 慢速订阅者：复制一份放入有界队列，等写缓冲区降下来再发送
+    const int messagesBefore = queue->size();
+    const qint64 bytesBefore = queue->bytes();
+    int droppedOldest = 0;
+    const OutboundQueue::PushResult result = queue->push(topic, QByteArray(frame.constData(), frame.size()),
+                                                         overflowPolicyFor(client, topic), &droppedOldest);
+
+    m_queuedMessages.fetchAndAddRelaxed(queue->size() - messagesBefore);
+    m_queuedBytes.fetchAndAddRelaxed(queue->bytes() - bytesBefore);
+    client->metrics->queuedMessages.set(quint64(queue->size()));
+    if (droppedOldest > 0) {
+        m_droppedMessages.fetchAndAddRelaxed(droppedOldest);
+    }
+
+    switch (result) {
+    case OutboundQueue::Queued:
+        return true;
+    case OutboundQueue::Conflated:
+        m_conflatedMessages.fetchAndAddRelaxed(1);
+        return true;
+    case OutboundQueue::DroppedNewest:
+        m_droppedMessages.fetchAndAddRelaxed(1);
+        return false;
+    case OutboundQueue::Overflowed:
+        disconnectSlowConsumer(client);
+        return false;
+    }
+
+    return false;
+}
+
+void BrokerWorker::flushOutbound(ClientInfo* client)
+{
+    OutboundQueue* queue = client->outboundQueue;
+    if (!client->nativeSocket && !outputDevice(*client)) {
+        return;
+    }
+
+    int messages = 0;
+    qint64 bytes = 0;
+    while (!queue->isEmpty() && pendingOutput(*client) < kSocketHighWatermark) {
+        const QByteArray& frame = queue->front();
+        writeFrame(*client, frame);
+        ++messages;
+        bytes += frame.size();
+        queue->pop();
+    }
+
+    m_queuedMessages.fetchAndAddRelaxed(-messages);
+    m_queuedBytes.fetchAndAddRelaxed(-bytes);
+    client->metrics->queuedMessages.set(quint64(queue->size()));
+}
+
+SubscriptionOptions::OverflowPolicy BrokerWorker::overflowPolicyFor(const ClientInfo* client, const QString& topic) const
+{
+    SubscriptionOptions::OverflowPolicy policy = SubscriptionOptions::DefaultPolicy;
+
+    // 精确订阅优先，否则使用第一个匹配的通配符订阅；只有慢速订阅者才会走到这里
+    auto exact = client->subscriptions.constFind(topic);
+    if (exact != client->subscriptions.constEnd()) {
+        policy = exact.value().overflowPolicy;
+    } else {
+        for (auto it = client->subscriptions.constBegin(); it != client->subscriptions.constEnd(); ++it) {
+            if (Topic::matches(it.key(), topic)) {
+                policy = it.value().overflowPolicy;
+                break;
+            }
+        }
+    }
+
+    return policy == SubscriptionOptions::DefaultPolicy ? m_broker->defaultOverflowPolicy() : policy;
+}
+
+void BrokerWorker::disconnectSlowConsumer(ClientInfo* client)
+{
+    if (client->disconnecting) {
+        return;
+    }
+
+    client->disconnecting = true;
+    m_slowConsumerDisconnects.fetchAndAddRelaxed(1);
+    MYMQ_LOG_WARNING(QString("Client %1 outbound queue overflowed (%2 messages, %3 bytes), disconnecting")
+                     .arg(client->id).arg(client->outboundQueue->size()).arg(client->outboundQueue->bytes()));
+
+    // 可能正处于该客户端帧处理器的信号中，延迟到下一轮事件循环再注销
+    const ClientHandle handle = client->handle;
+    const QString clientId = client->id;
+    QMetaObject::invokeMethod(this, [this, handle, clientId]() {
+        if (m_clients.contains(handle)) {
+            unregisterClient(handle);
+            emit m_broker->clientDisconnected(clientId);
+        }
+    }, Qt::QueuedConnection);
+}
+
+bool BrokerWorker::writeFrame(const ClientInfo& clientInfo, const QByteArray& frame)
+{
+    if (clientInfo.nativeSocket) {
+        // 待发送缓冲区原本为空说明该连接不在发送列表中，也没有等待可写
+        const bool idle = clientInfo.nativeSocket->bytesToWrite() == 0;
+        if (!clientInfo.nativeSocket->write(frame)) {
+            return false;
+        }
+        if (idle) {
+            m_dirtySockets.append(clientInfo.handle);
+            if (!m_nativeFlushScheduled) {
+                // 兜底：不在 epoll 事件或投递中写入时，下一轮事件循环发送
+                m_nativeFlushScheduled = true;
+                QMetaObject::invokeMethod(this, &BrokerWorker::flushNativeSockets, Qt::QueuedConnection);
+            }
+        }
+        return true;
+    }
+
+    QIODevice* device = outputDevice(clientInfo);
+    return device && device->write(frame) == frame.size();
+}
+
+ClientInfo* BrokerWorker::createClient()
+{
+    ClientInfo* clientInfo = new ClientInfo();
+    clientInfo->handle = m_clients.insert(clientInfo);
+    if (clientInfo->handle == ClientTable::InvalidHandle) {
+        delete clientInfo;
+        return nullptr;
+    }
+
+    clientInfo->id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    clientInfo->tcpSocket = nullptr;
+    clientInfo->localSocket = nullptr;
+    clientInfo->shmChannel = nullptr;
+    clientInfo->nativeSocket = nullptr;
+    clientInfo->isPublisher = false;
+    clientInfo->isSubscriber = false;
+    clientInfo->protocolVersion = Message::ProtocolV1;
+    clientInfo->lastActiveTick = m_currentTick;
+    clientInfo->idleTimeout = 0;
+    clientInfo->outboundQueue = new OutboundQueue(m_broker->outboundQueueMaxMessages(),
+                                                  m_broker->outboundQueueMaxBytes());
+    clientInfo->disconnecting = false;
+    clientInfo->receiveTopicAliases = false;
+    clientInfo->confirmsEnabled = false;
+    clientInfo->publishedCount = 0;
+    clientInfo->confirmedCount = 0;
+    clientInfo->pongPending = false;
+    clientInfo->pongToken = 0;
+    clientInfo->metrics = m_metrics.addClient(clientInfo->handle, clientInfo->id);
+
+    // 创建消息帧处理器，Broker只需要主题就能路由，使用路由模式避免完整解码
+    clientInfo->frameHandler = new MessageFrameHandler(this);
+    clientInfo->frameHandler->setRoutingMode(true);
+
+    // 帧处理器与客户端信息同生共死，直接捕获指针
+    connect(clientInfo->frameHandler, &MessageFrameHandler::frameReceived,
+            [this, clientInfo](const QString& topic, const QByteArray& frame) {
+                processFrame(clientInfo, topic, frame);
+            });
+
+    // 心跳请求先记下，读事件处理完后统一回复
+    connect(clientInfo->frameHandler, &MessageFrameHandler::heartbeatReceived,
+            [clientInfo](Message::HeartbeatType type, quint64 token) {
+                if (type == Message::Ping) {
+                    clientInfo->pongPending = true;
+                    clientInfo->pongToken = token;
+                }
+            });
+
+    const QString clientId = clientInfo->id;
+    connect(clientInfo->frameHandler, &MessageFrameHandler::error,
+            [clientId](const QString& errorMessage) {
+                MYMQ_LOG_WARNING(QString("Client %1: %2").arg(clientId).arg(errorMessage));
+            });
+
+    // 帧长度非法时找不到下一帧的边界，帧处理器已经停止解析，断开该客户端。
+    // 排队执行：信号在读事件中发出，不能在帧处理器处理数据时释放它
+    const ClientHandle handle = clientInfo->handle;
+    connect(clientInfo->frameHandler, &MessageFrameHandler::protocolError, this,
+            [this, handle](const QString& errorMessage) {
+                ClientInfo* client = m_clients.value(handle);
+                if (client) {
+                    MYMQ_LOG_WARNING(QString("Client %1: %2, disconnecting").arg(client->id).arg(errorMessage));
+                    handleDisconnected(handle);
+                }
+            }, Qt::QueuedConnection);
+
+    setIdleTimeout(clientInfo, m_broker->idleTimeout());
+    m_connectionCount.ref();
+
+    return clientInfo;
+}
+
+ClientInfo* BrokerWorker::registerClient(QIODevice* socket, bool isLocal)
+{
+    ClientInfo* clientInfo = createClient();
+    if (!clientInfo) {
+        return nullptr;
+    }
+
+    clientInfo->tcpSocket = isLocal ? nullptr : qobject_cast<QTcpSocket*>(socket);
+    clientInfo->localSocket = isLocal ? qobject_cast<QLocalSocket*>(socket) : nullptr;
+
+    // 套接字的信号携带句柄，不需要通过 sender() 反查客户端
+    const ClientHandle handle = clientInfo->handle;
+    connect(socket, &QIODevice::readyRead, this, [this, handle]() { handleReadyRead(handle); });
+    connect(socket, &QIODevice::bytesWritten, this, [this, handle]() { handleBytesWritten(handle); });
+    if (clientInfo->tcpSocket) {
+        connect(clientInfo->tcpSocket, &QTcpSocket::disconnected, this, [this, handle]() { handleDisconnected(handle); });
+    } else if (clientInfo->localSocket) {
+        connect(clientInfo->localSocket, &QLocalSocket::disconnected, this, [this, handle]() { handleDisconnected(handle); });
+    }
+
+    return clientInfo;
+}
+
+void BrokerWorker::unregisterClient(ClientHandle handle)
+{
+    ClientInfo* clientInfo = m_clients.take(handle);
+    if (!clientInfo) {
+        return;
+    }
+
+    // 从所有订阅的主题中移除
+    for (auto it = clientInfo->subscriptions.constBegin(); it != clientInfo->subscriptions.constEnd(); ++it) {
+        m_broker->removeSubscriber(it.key(), handle, this);
+    }
+
+    m_metrics.removeClient(handle);
+    m_idleTimers.cancel(handle);
+
+    // 丢弃尚未发送的消息
+    m_queuedMessages.fetchAndAddRelaxed(-clientInfo->outboundQueue->size());
+    m_queuedBytes.fetchAndAddRelaxed(-clientInfo->outboundQueue->bytes());
+    delete clientInfo->outboundQueue;
+
+    // 分离共享内存，门铃套接字随后删除
+    if (clientInfo->shmChannel) {
+        clientInfo->shmChannel->disconnect();
+        delete clientInfo->shmChannel;
+    }
+
+    // 断开连接
+    if (clientInfo->tcpSocket) {
+        clientInfo->tcpSocket->disconnect();
+        clientInfo->tcpSocket->deleteLater();
+    }
+
+    if (clientInfo->localSocket) {
+        clientInfo->localSocket->disconnect();
+        clientInfo->localSocket->deleteLater();
+    }
+
+    // 先从 epoll 注销再关闭描述符，描述符号可能马上被新连接复用
+    if (clientInfo->nativeSocket) {
+        m_poller->remove(clientInfo->nativeSocket->descriptor());
+        delete clientInfo->nativeSocket;
+    }
+
+    // 释放消息帧处理器，它可能正在发出信号，因此延迟删除
+    if (clientInfo->frameHandler) {
+        clientInfo->frameHandler->disconnect();
+        clientInfo->frameHandler->deleteLater();
+    }
+
+    delete clientInfo;
+    m_connectionCount.deref();
+}
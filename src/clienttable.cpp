@@ -0,0 +1,84 @@
+#include "clienttable.h"
+
+ClientTable::ClientTable()
+    : m_size(0)
+{
+}
+
+ClientHandle ClientTable::insert(ClientInfo* client)
+{
+    quint32 index;
+    if (!m_freeSlots.isEmpty()) {
+        index = m_freeSlots.takeLast();
+    } else {
+        if (m_slots.size() >= kMaxClients) {
+            return InvalidHandle;
+        }
+        index = quint32(m_slots.size());
+        Slot slot;
+        slot.client = nullptr;
+        slot.generation = 1;
+        m_slots.append(slot);
+    }
+
+    Slot& slot = m_slots[int(index)];
+    slot.client = client;
+    ++m_size;
+    return (slot.generation << kIndexBits) | index;
+}
+
+ClientInfo* ClientTable::value(ClientHandle handle) const
+{
+    const quint32 index = handle & kIndexMask;
+    if (index >= quint32(m_slots.size())) {
+        return nullptr;
+    }
+
+    const Slot& slot = m_slots.at(int(index));
+    return slot.generation == (handle >> kIndexBits) ? slot.client : nullptr;
+}
+
+ClientInfo* ClientTable::take(ClientHandle handle)
+{
+    ClientInfo* client = value(handle);
+    if (!client) {
+        return nullptr;
+    }
+
+    // 代数加一使旧句柄失效，跳过0保证句柄永远不等于 InvalidHandle
+    const quint32 index = handle & kIndexMask;
+    Slot& slot = m_slots[int(index)];
+    slot.client = nullptr;
+    slot.generation = (slot.generation & kGenerationMask) == kGenerationMask ? 1 : slot.generation + 1;
+    m_freeSlots.append(index);
+    --m_size;
+    return client;
+}
+
+bool ClientTable::contains(ClientHandle handle) const
+{
+    return value(handle) != nullptr;
+}
+
+int ClientTable::size() const
+{
+    return m_size;
+}
+
+bool ClientTable::isEmpty() const
+{
+    return m_size == 0;
+}
+
+QVector<ClientHandle> ClientTable::handles() const
+{
+    QVector<ClientHandle> result;
+    result.reserve(m_size);
+    for (int i = 0; i < m_slots.size(); ++i) {
+        const Slot& slot = m_slots.at(i);
+        if (slot.client) {
+            result.append((slot.generation << kIndexBits) | quint32(i));
+        }
+    }
+    return result;
+}
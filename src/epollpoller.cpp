@@ -0,0 +1,120 @@
+#include "epollpoller.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+bool EpollPoller::isSupported()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef Q_OS_LINUX
+
+namespace {
+
+// 一次最多取出的事件数，超过的留到下一轮，水平触发不会丢失
+const int kMaxBatch = 256;
+
+}
+
+EpollPoller::EpollPoller()
+    : m_epollFd(epoll_create1(EPOLL_CLOEXEC))
+{
+}
+
+EpollPoller::~EpollPoller()
+{
+    if (m_epollFd >= 0) {
+        ::close(m_epollFd);
+    }
+}
+
+bool EpollPoller::add(int fd, quint64 token)
+{
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.u64 = token;
+    return epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+bool EpollPoller::setWriteInterest(int fd, quint64 token, bool enabled)
+{
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | (enabled ? quint32(EPOLLOUT) : 0u);
+    event.data.u64 = token;
+    return epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void EpollPoller::remove(int fd)
+{
+    // 2.6.9 之前的内核要求 event 非空
+    epoll_event event = {};
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, &event);
+}
+
+int EpollPoller::poll(Event* events, int maxEvents)
+{
+    epoll_event ready[kMaxBatch];
+    int count;
+    do {
+        count = epoll_wait(m_epollFd, ready, qMin(maxEvents, kMaxBatch), 0);
+    } while (count < 0 && errno == EINTR);
+
+    for (int i = 0; i < count; ++i) {
+        const quint32 flags = ready[i].events;
+        events[i].token = ready[i].data.u64;
+        events[i].flags = ((flags & EPOLLIN) ? Readable : 0)
+                          | ((flags & EPOLLOUT) ? Writable : 0)
+                          | ((flags & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) ? Closed : 0);
+    }
+    return qMax(count, 0);
+}
+
+#else
+
+EpollPoller::EpollPoller()
+    : m_epollFd(-1)
+{
+}
+
+EpollPoller::~EpollPoller()
+{
+}
+
+bool EpollPoller::add(int, quint64)
+{
+    return false;
+}
+
+bool EpollPoller::setWriteInterest(int, quint64, bool)
+{
+    return false;
+}
+
+void EpollPoller::remove(int)
+{
+}
+
+int EpollPoller::poll(Event*, int)
+{
+    return 0;
+}
+
+#endif
+
+bool EpollPoller::isValid() const
+{
+    return m_epollFd >= 0;
+}
+
+int EpollPoller::descriptor() const
+{
+    return m_epollFd;
+}
@@ -0,0 +1,101 @@
+#include "keepalivemonitor.h"
+#include "logger.h"
+
+KeepAliveMonitor::KeepAliveMonitor(const FrameWriter& writer, QObject* parent)
+    : QObject(parent)
+    , m_writer(writer)
+    , m_keepAlive(30)
+    , m_negotiatedKeepAlive(0)
+    , m_timer(new QTimer(this))
+    , m_sentSinceCheck(false)
+    , m_pingOutstanding(false)
+    , m_missedChecks(0)
+{
+    // 定时器在Broker接受协商后启动
+    connect(m_timer, &QTimer::timeout, this, &KeepAliveMonitor::check);
+}
+
+void KeepAliveMonitor::setKeepAlive(int seconds)
+{
+    m_keepAlive = qMax(0, seconds);
+}
+
+int KeepAliveMonitor::keepAlive() const
+{
+    return m_keepAlive;
+}
+
+int KeepAliveMonitor::negotiatedKeepAlive() const
+{
+    return m_negotiatedKeepAlive;
+}
+
+Message KeepAliveMonitor::requestMessage() const
+{
+    return Message("$SYS/KEEPALIVE", QByteArray::number(m_keepAlive));
+}
+
+void KeepAliveMonitor::handleReply(int seconds)
+{
+    m_negotiatedKeepAlive = qMax(0, seconds);
+    m_pingOutstanding = false;
+    m_missedChecks = 0;
+    if (m_negotiatedKeepAlive == 0) {
+        m_timer->stop();
+        return;
+    }
+
+    // 每半个间隔检查一次，安静的连接大约每个间隔发送一次心跳
+    m_timer->start(m_negotiatedKeepAlive * 500);
+    MYMQ_LOG_INFO(QString("Negotiated keepalive %1 s").arg(m_negotiatedKeepAlive));
+}
+
+void KeepAliveMonitor::notifySent()
+{
+    m_sentSinceCheck = true;
+}
+
+void KeepAliveMonitor::notifyReceived()
+{
+    m_pingOutstanding = false;
+}
+
+void KeepAliveMonitor::stop()
+{
+    m_timer->stop();
+    m_negotiatedKeepAlive = 0;
+    m_pingOutstanding = false;
+    m_missedChecks = 0;
+}
+
+void KeepAliveMonitor::handleHeartbeat(Message::HeartbeatType type, quint64 token)
+{
+    // 收到数据时持有方已经清除了等待标记，这里只记录往返时间
+    if (type == Message::Pong) {
+        MYMQ_LOG_DEBUG(QString("Heartbeat round trip %1 us")
+                       .arg((Message::currentTimestampNs() - qint64(token)) / 1000));
+    }
+}
+
+void KeepAliveMonitor::check()
+{
+    // 心跳发出后一个间隔内没有收到Broker的任何数据：连接已经失效，由持有方断开后按设置重连
+    if (m_pingOutstanding && ++m_missedChecks >= 2) {
+        MYMQ_LOG_WARNING("Broker did not answer heartbeat, dropping connection");
+        m_pingOutstanding = false;
+        emit timeout();
+        return;
+    }
+
+    // 上次检查之后写出过数据（包括上一次的心跳），Broker已经知道连接仍然有效
+    if (m_sentSinceCheck) {
+        m_sentSinceCheck = false;
+        return;
+    }
+
+    if (m_writer(Message::heartbeatFrame(Message::Ping, quint64(Message::currentTimestampNs())))
+        && !m_pingOutstanding) {
+        m_pingOutstanding = true;
+        m_missedChecks = 0;
+    }
+}
@@ -1,5 +1,17 @@
 #include "logger.h"
 
+#include <QCoreApplication>
+
+namespace {
+
+// 写线程没有被唤醒时的写出周期（毫秒），最坏情况下日志在这么久之后落盘
+const unsigned long kWriteIntervalMs = 20;
+
+// 批量缓冲区超过该大小时先写出一次，避免一轮积累过多内存
+const int kMaxBatchBytes = 256 * 1024;
+
+}
+
 // 初始化静态成员变量
 Logger* Logger::m_instance = nullptr;
 
@@ -16,20 +28,34 @@ Logger::Logger(QObject* parent)
     , m_logLevel(INFO)
     , m_mutex(new QMutex())
     , m_initialized(false)
+    , m_queue(nullptr)
+    , m_writer(nullptr)
+    , m_writerRunning(false)
+    , m_writerSleeping(false)
+    , m_overflowPolicy(DropNewest)
+    , m_consoleOutput(true)
+    , m_dropped(0)
+    , m_wakeMutex(new QMutex())
+    , m_flushRequested(0)
+    , m_flushCompleted(0)
+    , m_stopping(false)
 {
 }
 
 Logger::~Logger()
 {
+    stopWriter();
+
     if (m_logFile.isOpen()) {
-        m_textStream.flush();
         m_logFile.close();
     }
 
+    delete m_queue;
+    delete m_wakeMutex;
     delete m_mutex;
 }
 
-bool Logger::init(const QString& logFilePath, LogLevel level)
+bool Logger::init(const QString& logFilePath, LogLevel level, int queueCapacity)
 {
     {
         QMutexLocker locker(m_mutex);
@@ -46,15 +72,59 @@ bool Logger::init(const QString& logFilePath, LogLevel level)
             return false;
         }
 
-        m_textStream.setDevice(&m_logFile);
+        // 写线程启动之后才标记为已初始化，之前的日志不会进入没有消费者的队列
+        m_queue = new MpscRing<LogRecord>(size_t(qMax(queueCapacity, 2)));
+        m_writer = QThread::create([this]() { writerLoop(); });
+        m_writer->setObjectName("LoggerWriter");
+        m_writer->start();
+        m_writerRunning.store(true, std::memory_order_release);
         m_initialized = true;
     }
 
+    // 应用程序退出前写出队列中剩余的日志
+    qAddPostRoutine(&Logger::shutdown);
+
     // 在锁的作用域外调用 info，避免死锁
     info("Logger initialized");
     return true;
 }
 
+void Logger::setOverflowPolicy(OverflowPolicy policy)
+{
+    m_overflowPolicy.store(policy, std::memory_order_relaxed);
+}
+
+Logger::OverflowPolicy Logger::overflowPolicy() const
+{
+    return static_cast<OverflowPolicy>(m_overflowPolicy.load(std::memory_order_relaxed));
+}
+
+void Logger::setConsoleOutput(bool enabled)
+{
+    m_consoleOutput.store(enabled, std::memory_order_relaxed);
+}
+
+quint64 Logger::droppedCount() const
+{
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+void Logger::flush()
+{
+    if (!m_writerRunning.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    // 写线程下一轮开始时读到这个请求，取空队列后才报告完成，
+    // 而本次调用之前放入的记录在那时一定已经可见
+    QMutexLocker locker(m_wakeMutex);
+    const quint64 request = ++m_flushRequested;
+    m_wakeCondition.wakeOne();
+    while (m_flushCompleted < request && !m_stopping) {
+        m_flushedCondition.wait(m_wakeMutex);
+    }
+}
+
 void Logger::debug(const QString& message)
 {
     log(DEBUG, message);
@@ -91,19 +161,152 @@ void Logger::log(LogLevel level, const QString& message)
         return;
     }
 
-    QMutexLocker locker(m_mutex);
+    LogRecord record;
+    record.timestamp = QDateTime::currentMSecsSinceEpoch();
+    record.level = level;
+    record.message = message;
+
+    // 写线程已经停止（应用程序正在退出）：直接写入文件
+    if (!m_writerRunning.load(std::memory_order_acquire)) {
+        QByteArray line;
+        appendRecord(line, record);
+        QMutexLocker locker(m_mutex);
+        m_logFile.write(line);
+        m_logFile.flush();
+        return;
+    }
+
+    // 快速路径：一次比较交换放入队列，格式化和I/O都留给写线程
+    if (!m_queue->tryPush(std::move(record))) {
+        if (m_overflowPolicy.load(std::memory_order_relaxed) == DropNewest) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            wakeWriter();
+            return;
+        }
+
+        // 等待写线程腾出空间
+        do {
+            wakeWriter();
+            QThread::yieldCurrentThread();
+        } while (!m_queue->tryPush(std::move(record)) && m_writerRunning.load(std::memory_order_acquire));
+    }
+
+    // 严重的日志和积压过半时不等写出周期
+    if (level >= WARNING || m_queue->sizeApprox() >= m_queue->capacity() / 2) {
+        wakeWriter();
+    }
+
+    // 致命错误之后进程可能马上退出，等它写入文件
+    if (level == FATAL) {
+        flush();
+    }
+}
+
+void Logger::wakeWriter()
+{
+    // 写线程正在处理时不需要加锁；错过一次唤醒最多推迟一个写出周期
+    if (m_writerSleeping.load(std::memory_order_relaxed)) {
+        QMutexLocker locker(m_wakeMutex);
+        m_wakeCondition.wakeOne();
+    }
+}
+
+void Logger::writerLoop()
+{
+    for (;;) {
+        quint64 request;
+        bool stopping;
+        {
+            QMutexLocker locker(m_wakeMutex);
+            request = m_flushRequested;
+            stopping = m_stopping;
+        }
+
+        drainQueue();
+
+        QMutexLocker locker(m_wakeMutex);
+        m_flushCompleted = request;
+        m_flushedCondition.wakeAll();
+        if (stopping) {
+            return;
+        }
+
+        // 这一轮期间没有新的刷新或停止请求时才等待
+        if (m_flushRequested == request && !m_stopping) {
+            m_writerSleeping.store(true, std::memory_order_relaxed);
+            m_wakeCondition.wait(m_wakeMutex, kWriteIntervalMs);
+            m_writerSleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+}
 
-    QString timestamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz");
-    QString logEntry = QString("[%1] [%2] %3")
-                           .arg(timestamp)
-                           .arg(levelToString(level))
-                           .arg(message);
+void Logger::drainQueue()
+{
+    QByteArray batch;
+    LogRecord record;
+    bool written = false;
 
-    m_textStream << logEntry << Qt::endl;
-    m_textStream.flush();
+    while (m_queue->tryPop(record)) {
+        appendRecord(batch, record);
+        if (batch.size() >= kMaxBatchBytes) {
+            QMutexLocker locker(m_mutex);
+            m_logFile.write(batch);
+            batch.clear();
+            written = true;
+        }
+    }
+
+    // 一轮只刷新一次文件
+    if (!batch.isEmpty() || written) {
+        QMutexLocker locker(m_mutex);
+        m_logFile.write(batch);
+        m_logFile.flush();
+    }
+}
+
+void Logger::appendRecord(QByteArray& batch, const LogRecord& record)
+{
+    const QString timestamp = QDateTime::fromMSecsSinceEpoch(record.timestamp).toString("yyyy-MM-dd hh:mm:ss.zzz");
+    const QString logEntry = QString("[%1] [%2] %3")
+                                 .arg(timestamp)
+                                 .arg(levelToString(record.level))
+                                 .arg(record.message);
+
+    batch.append(logEntry.toUtf8());
+    batch.append('\n');
 
     // 同时输出到控制台
-    qDebug().noquote() << logEntry;
+    if (m_consoleOutput.load(std::memory_order_relaxed)) {
+        qDebug().noquote() << logEntry;
+    }
+}
+
+void Logger::stopWriter()
+{
+    if (!m_writer) {
+        return;
+    }
+
+    // 先切换到同步写入，再让写线程取空队列后退出
+    m_writerRunning.store(false, std::memory_order_release);
+    {
+        QMutexLocker locker(m_wakeMutex);
+        m_stopping = true;
+        m_wakeCondition.wakeOne();
+    }
+    m_writer->wait();
+    delete m_writer;
+    m_writer = nullptr;
+
+    // 切换期间放入队列的记录
+    drainQueue();
+}
+
+void Logger::shutdown()
+{
+    if (m_instance) {
+        m_instance->stopWriter();
+    }
 }
 
 QString Logger::levelToString(LogLevel level)
@@ -1,50 +1,518 @@
 #include "message.h"
 
+#include <QtEndian>
+#include <QAtomicInteger>
+#include <QRandomGenerator>
+#include <QElapsedTimer>
+
+#include <climits>
+#include <cstring>
+
+namespace {
+
+// V2 帧布局常量，详见 Message::ProtocolVersion 的说明
+const uchar kFrameMagicV2 = 0xB2;
+const int kHeaderSizeV2 = 24;
+const int kTopicLengthSizeV2 = 2;
+const int kMaxTopicSizeV2 = 0xFFFF;
+const uchar kFrameTypeMessage = 0;
+const uchar kFrameTypeBatch = 1;
+const uchar kFrameTypePing = 2;
+const uchar kFrameTypePong = 3;
+const uchar kFlagSequence = 0x01;
+const uchar kFlagTopicAlias = 0x02;
+const int kSequenceSizeV2 = 8;
+const int kTopicAliasSizeV2 = 4;
+const uchar kFlagHeaders = 0x04;
+const int kHeaderLengthSizeV2 = 2;
+const int kMaxHeaderBlockSizeV2 = 0xFFFF;
+
+// 头部值的类型标记
+const uchar kHeaderFalse = 1;
+const uchar kHeaderTrue = 2;
+const uchar kHeaderInt = 3;
+const uchar kHeaderDouble = 4;
+const uchar kHeaderString = 5;
+const uchar kHeaderBytes = 6;
+
+// V2 帧体的布局：主题部分（长度+主题，或4字节别名）、负载、可选的序号
+struct FrameLayoutV2 {
+    int topicPartSize;  ///< 主题部分的字节数
+    int headerPartSize; ///< 头部部分的字节数（长度+条目），没有头部时为0
+    int payloadSize;    ///< 负载的字节数
+    bool hasSequence;   ///< 帧尾是否带有序号
+    bool aliased;       ///< 是否使用主题别名
+};
+
+bool parseLayoutV2(const uchar* p, int frameSize, FrameLayoutV2& layout)
+{
+    if (frameSize < kHeaderSizeV2) {
+        return false;
+    }
+
+    const int bodySize = frameSize - kHeaderSizeV2;
+    layout.aliased = p[3] & kFlagTopicAlias;
+    layout.hasSequence = p[3] & kFlagSequence;
+    if (layout.aliased) {
+        layout.topicPartSize = kTopicAliasSizeV2;
+    } else {
+        if (bodySize < kTopicLengthSizeV2) {
+            return false;
+        }
+        layout.topicPartSize = kTopicLengthSizeV2 + qFromLittleEndian<quint16>(p + kHeaderSizeV2);
+    }
+
+    layout.headerPartSize = 0;
+    if (p[3] & kFlagHeaders) {
+        if (layout.topicPartSize + kHeaderLengthSizeV2 > bodySize) {
+            return false;
+        }
+        layout.headerPartSize = kHeaderLengthSizeV2
+                                + qFromLittleEndian<quint16>(p + kHeaderSizeV2 + layout.topicPartSize);
+    }
+
+    const int sequenceSize = layout.hasSequence ? kSequenceSizeV2 : 0;
+    if (layout.topicPartSize + layout.headerPartSize + sequenceSize > bodySize) {
+        return false;
+    }
+    layout.payloadSize = bodySize - layout.topicPartSize - layout.headerPartSize - sequenceSize;
+    return true;
+}
+
+// 复制一次 V2 帧，可以替换主题部分、写入序号；帧头中的ID和时间戳原样保留
+QByteArray rewriteV2(const uchar* p, const FrameLayoutV2& layout, const QByteArray* topicPart, bool topicAliased,
+                     bool stamp, qint64 sequence)
+{
+    // 头部和负载相邻，作为一段原样复制
+    const uchar* oldTopicPart = p + kHeaderSizeV2;
+    const uchar* content = oldTopicPart + layout.topicPartSize;
+    const int contentSize = layout.headerPartSize + layout.payloadSize;
+    const int topicPartSize = topicPart ? topicPart->size() : layout.topicPartSize;
+    const bool hasSequence = stamp || layout.hasSequence;
+    const int bodySize = topicPartSize + contentSize + (hasSequence ? kSequenceSizeV2 : 0);
+
+    QByteArray frame(kHeaderSizeV2 + bodySize, Qt::Uninitialized);
+    uchar* q = reinterpret_cast<uchar*>(frame.data());
+    memcpy(q, p, kHeaderSizeV2);
+
+    uchar flags = p[3] & ~(kFlagSequence | kFlagTopicAlias);
+    if (hasSequence) {
+        flags |= kFlagSequence;
+    }
+    if (topicPart ? topicAliased : layout.aliased) {
+        flags |= kFlagTopicAlias;
+    }
+    q[3] = flags;
+    qToLittleEndian<quint32>(bodySize, q + 4);
+
+    uchar* body = q + kHeaderSizeV2;
+    memcpy(body, topicPart ? reinterpret_cast<const uchar*>(topicPart->constData()) : oldTopicPart, topicPartSize);
+    memcpy(body + topicPartSize, content, contentSize);
+    if (hasSequence) {
+        const qint64 value = stamp ? sequence : qFromLittleEndian<qint64>(content + contentSize);
+        qToLittleEndian<qint64>(value, body + topicPartSize + contentSize);
+    }
+
+    return frame;
+}
+
+// 携带完整主题的主题部分：2字节长度 + UTF-8 主题；超过长度上限时返回空，截断会把消息发到另一个主题
+QByteArray topicPartV2(const QString& topic)
+{
+    const QByteArray utf8 = topic.toUtf8();
+    if (utf8.size() > kMaxTopicSizeV2) {
+        return QByteArray();
+    }
+
+    QByteArray part(kTopicLengthSizeV2 + utf8.size(), Qt::Uninitialized);
+    qToLittleEndian<quint16>(utf8.size(), part.data());
+    memcpy(part.data() + kTopicLengthSizeV2, utf8.constData(), utf8.size());
+    return part;
+}
+
+// 变长整数：每字节7位，低位在前，最高位表示后面还有字节
+void appendVarint(QByteArray& out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(char((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+bool readVarint(const uchar*& p, const uchar* end, quint64& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const uchar byte = *p++;
+        value |= quint64(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 编码头部条目（不含2字节长度）；有无法紧凑编码的键或值、或总长度超过上限时返回 false
+bool encodeHeaders(const QVariantMap& headers, QByteArray& block)
+{
+    block.clear();
+    for (QVariantMap::const_iterator it = headers.constBegin(); it != headers.constEnd(); ++it) {
+        const QByteArray key = it.key().toUtf8();
+        if (key.size() > Message::kMaxHeaderKeySize) {
+            return false;
+        }
+        block.append(char(key.size()));
+        block.append(key);
+
+        const QVariant& value = it.value();
+        switch (value.userType()) {
+        case QMetaType::Bool:
+            block.append(char(value.toBool() ? kHeaderTrue : kHeaderFalse));
+            break;
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong: {
+            // ZigZag：绝对值小的负数同样只占一两个字节
+            const qint64 number = value.toLongLong();
+            block.append(char(kHeaderInt));
+            appendVarint(block, (quint64(number) << 1) ^ quint64(number >> 63));
+            break;
+        }
+        case QMetaType::Double:
+        case QMetaType::Float: {
+            const double number = value.toDouble();
+            quint64 bits = 0;
+            memcpy(&bits, &number, sizeof(bits));
+            block.append(char(kHeaderDouble));
+            const int offset = block.size();
+            block.resize(offset + 8);
+            qToLittleEndian<quint64>(bits, block.data() + offset);
+            break;
+        }
+        case QMetaType::QString: {
+            const QByteArray utf8 = value.toString().toUtf8();
+            block.append(char(kHeaderString));
+            appendVarint(block, utf8.size());
+            block.append(utf8);
+            break;
+        }
+        case QMetaType::QByteArray: {
+            const QByteArray bytes = value.toByteArray();
+            block.append(char(kHeaderBytes));
+            appendVarint(block, bytes.size());
+            block.append(bytes);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+
+    return block.size() <= kMaxHeaderBlockSizeV2;
+}
+
+// 读取一个头部值；value 为空时只跳过
+bool readHeaderValue(const uchar*& p, const uchar* end, QVariant* value)
+{
+    if (p >= end) {
+        return false;
+    }
+
+    const uchar type = *p++;
+    switch (type) {
+    case kHeaderFalse:
+    case kHeaderTrue:
+        if (value) {
+            *value = QVariant(type == kHeaderTrue);
+        }
+        return true;
+    case kHeaderInt: {
+        quint64 raw = 0;
+        if (!readVarint(p, end, raw)) {
+            return false;
+        }
+        if (value) {
+            *value = QVariant(qlonglong(qint64(raw >> 1) ^ -qint64(raw & 1)));
+        }
+        return true;
+    }
+    case kHeaderDouble: {
+        if (end - p < 8) {
+            return false;
+        }
+        if (value) {
+            const quint64 bits = qFromLittleEndian<quint64>(p);
+            double number = 0;
+            memcpy(&number, &bits, sizeof(number));
+            *value = QVariant(number);
+        }
+        p += 8;
+        return true;
+    }
+    case kHeaderString:
+    case kHeaderBytes: {
+        quint64 length = 0;
+        if (!readVarint(p, end, length) || length > quint64(end - p)) {
+            return false;
+        }
+        if (value) {
+            const char* bytes = reinterpret_cast<const char*>(p);
+            *value = type == kHeaderString ? QVariant(QString::fromUtf8(bytes, int(length)))
+                                           : QVariant(QByteArray(bytes, int(length)));
+        }
+        p += length;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// 头部条目所在的区间；帧不带头部时区间为空
+bool headerBlockV2(const QByteArray& frame, const uchar*& begin, const uchar*& end)
+{
+    const int frameSize = Message::frameLength(frame);
+    const uchar* p = reinterpret_cast<const uchar*>(frame.constData());
+    FrameLayoutV2 layout;
+    if (frameSize <= 0 || p[2] != kFrameTypeMessage || !parseLayoutV2(p, frameSize, layout)) {
+        return false;
+    }
+
+    begin = p + kHeaderSizeV2 + layout.topicPartSize + (layout.headerPartSize ? kHeaderLengthSizeV2 : 0);
+    end = p + kHeaderSizeV2 + layout.topicPartSize + layout.headerPartSize;
+    return true;
+}
+
+// 逐个解码头部条目
+bool decodeHeaders(const uchar* p, const uchar* end, QVariantMap& headers)
+{
+    while (p < end) {
+        const int keySize = *p++;
+        if (keySize > end - p) {
+            return false;
+        }
+        const QString key = QString::fromUtf8(reinterpret_cast<const char*>(p), keySize);
+        p += keySize;
+
+        QVariant value;
+        if (!readHeaderValue(p, end, &value)) {
+            return false;
+        }
+        headers.insert(key, value);
+    }
+    return true;
+}
+
+// 单调时钟锚点：进程内第一次取时间时记录一次墙上时间，之后只累加单调时钟的流逝
+struct TimestampAnchor {
+    TimestampAnchor()
+        : epochNs(QDateTime::currentMSecsSinceEpoch() * 1000000)
+    {
+        clock.start();
+    }
+
+    qint64 epochNs;
+    QElapsedTimer clock;
+};
+
+} // namespace
+
+MessageIdGenerator::MessageIdGenerator()
+    : m_next(quint64(allocatePrefix()) << 32)
+{
+}
+
+void MessageIdGenerator::reset()
+{
+    m_next.storeRelaxed(quint64(allocatePrefix()) << 32);
+}
+
+quint64 MessageIdGenerator::next()
+{
+    return m_next.fetchAndAddRelaxed(1);
+}
+
+MessageIdGenerator* MessageIdGenerator::processDefault()
+{
+    static MessageIdGenerator generator;
+    return &generator;
+}
+
+quint32 MessageIdGenerator::allocatePrefix()
+{
+    // 高16位为进程随机数，低16位为进程内的前缀序号
+    static const quint32 processBits = QRandomGenerator::global()->generate() << 16;
+    static QAtomicInteger<quint32> sequence;
+    return processBits | (sequence.fetchAndAddRelaxed(1) & 0xFFFF);
+}
+
+/**
+ * @brief 消息的隐式共享数据块
+ */
+class MessageData : public QSharedData
+{
+public:
+    MessageData()
+        : id(0)
+        , timestampNs(0)
+        , sequence(-1)
+    {
+    }
+
+    MessageData(quint64 id, const QString& topic, const QByteArray& data, qint64 timestampNs, qint64 sequence = -1,
+                const QVariantMap& headers = QVariantMap())
+        : id(id)
+        , topic(topic)
+        , data(data)
+        , timestampNs(timestampNs)
+        , sequence(sequence)
+        , headers(headers)
+    {
+    }
+
+    quint64 id;           ///< 64位消息ID
+    QString idText;       ///< V1 线路上收到的无法转换为数字的ID文本（如旧客户端的UUID）
+    QString topic;        ///< 消息主题
+    QByteArray data;      ///< 消息数据
+    qint64 timestampNs;   ///< 消息时间戳（自纪元起的纳秒数）
+    qint64 sequence;      ///< 主题序号，-1 表示没有
+    QVariantMap headers;  ///< 消息头部
+};
+
+namespace {
+
+// 所有默认构造的消息共享同一个空数据块，默认构造只增加一次引用计数
+const QSharedDataPointer<MessageData>& sharedNullData()
+{
+    static const QSharedDataPointer<MessageData> nullData(new MessageData());
+    return nullData;
+}
+
+} // namespace
+
 Message::Message()
-    : m_id(QUuid::createUuid().toString(QUuid::WithoutBraces))
-    , m_timestamp(QDateTime::currentDateTime())
+    : m_d(sharedNullData())
 {
 }
 
 Message::Message(const QString& topic, const QByteArray& data)
-    : m_id(QUuid::createUuid().toString(QUuid::WithoutBraces))
-    , m_topic(topic)
-    , m_data(data)
-    , m_timestamp(QDateTime::currentDateTime())
+    : m_d(new MessageData(MessageIdGenerator::processDefault()->next(), topic, data, currentTimestampNs()))
 {
 }
 
+Message::Message(const QString& topic, const QByteArray& data, quint64 id)
+    : m_d(new MessageData(id, topic, data, currentTimestampNs()))
+{
+}
+
+Message::Message(const Message& other) = default;
+
+Message::Message(Message&& other) noexcept = default;
+
+Message::~Message() = default;
+
+Message& Message::operator=(const Message& other) = default;
+
+Message& Message::operator=(Message&& other) noexcept = default;
+
 QString Message::id() const
 {
-    return m_id;
+    if (!m_d->idText.isEmpty()) {
+        return m_d->idText;
+    }
+
+    return QString("%1").arg(m_d->id, 16, 16, QChar('0'));
+}
+
+quint64 Message::numericId() const
+{
+    return m_d->id;
 }
 
 QString Message::topic() const
 {
-    return m_topic;
+    return m_d->topic;
 }
 
 void Message::setTopic(const QString& topic)
 {
-    m_topic = topic;
+    m_d->topic = topic;
 }
 
 QByteArray Message::data() const
 {
-    return m_data;
+    return m_d->data;
 }
 
 void Message::setData(const QByteArray& data)
 {
-    m_data = data;
+    m_d->data = data;
+}
+
+QVariantMap Message::headers() const
+{
+    return m_d->headers;
+}
+
+void Message::setHeaders(const QVariantMap& headers)
+{
+    m_d->headers = headers;
+}
+
+QVariant Message::header(const QString& key) const
+{
+    return m_d->headers.value(key);
+}
+
+void Message::setHeader(const QString& key, const QVariant& value)
+{
+    if (value.isValid()) {
+        m_d->headers.insert(key, value);
+    } else {
+        m_d->headers.remove(key);
+    }
 }
 
 QDateTime Message::timestamp() const
 {
-    return m_timestamp;
+    return QDateTime::fromMSecsSinceEpoch(m_d->timestampNs / 1000000);
 }
 
-QByteArray Message::serialize() const
+qint64 Message::timestampNs() const
+{
+    return m_d->timestampNs;
+}
+
+qint64 Message::sequence() const
+{
+    return m_d->sequence;
+}
+
+void Message::setSequence(qint64 sequence)
+{
+    m_d->sequence = sequence;
+}
+
+qint64 Message::currentTimestampNs()
+{
+    static const TimestampAnchor anchor;
+    return anchor.epochNs + anchor.clock.nsecsElapsed();
+}
+
+QByteArray Message::serialize(ProtocolVersion version) const
+{
+    // 主题超过 V2 的长度上限、或头部无法紧凑编码时退回 V1 编码，接收方会按帧首字节自动识别
+    QByteArray headerBlock;
+    if (version == ProtocolV2 && m_d->topic.size() * 3 <= kMaxTopicSizeV2 && encodeHeaders(m_d->headers, headerBlock)) {
+        return serializeV2(0, headerBlock);
+    }
+
+    return serializeV1();
+}
+
+QByteArray Message::serializeV1() const
 {
     // 先序列化消息内容
     QByteArray messageContent;
@@ -54,10 +522,16 @@ QByteArray Message::serialize() const
     contentStream.setVersion(QDataStream::Qt_5_15);
 
     // 序列化消息属性
-    contentStream << m_id;
-    contentStream << m_topic;
-    contentStream << m_data;
-    contentStream << m_timestamp;
+    contentStream << id();
+    contentStream << m_d->topic;
+    contentStream << m_d->data;
+    contentStream << timestamp();
+    if (m_d->sequence >= 0 || !m_d->headers.isEmpty()) {
+        contentStream << m_d->sequence;
+    }
+    if (!m_d->headers.isEmpty()) {
+        contentStream << m_d->headers;
+    }
 
     // 创建包含消息长度前缀的完整消息
     QByteArray completeMessage;
@@ -73,52 +547,544 @@ QByteArray Message::serialize() const
 
 bool Message::deserialize(const QByteArray& data)
 {
-    // 注意：这个方法现在期望收到的是消息内容部分，不包含长度前缀
+    // 注意：这个方法期望收到的是消息内容部分，不包含长度前缀
     // 长度前缀的处理已经移到 MessageFrameHandler 类中
+    // V2 帧是自描述的，直接按完整帧解码
+    if (frameVersion(data) == ProtocolV2) {
+        return deserializeV2(data);
+    }
+
+    // 兼容完整的 V1 帧：消息内容以ID的长度开头，不可能恰好等于剩余数据的长度
+    if (frameLength(data) == data.size()) {
+        return deserializeFrame(data);
+    }
 
     QDataStream stream(data);
 
     // 设置数据流版本，确保跨平台兼容性
     stream.setVersion(QDataStream::Qt_5_15);
 
-    // 反序列化消息属性
-    stream >> m_id;
-    stream >> m_topic;
-    stream >> m_data;
-    stream >> m_timestamp;
+    // 反序列化消息属性，只分离一次共享数据
+    MessageData* messageData = m_d.data();
+    QString idText;
+    QDateTime dateTime;
+    stream >> idText;
+    stream >> messageData->topic;
+    stream >> messageData->data;
+    stream >> dateTime;
+
+    // 可选的主题序号和头部
+    qint64 sequence = -1;
+    if (!stream.atEnd()) {
+        stream >> sequence;
+    }
+    QVariantMap headers;
+    if (!stream.atEnd()) {
+        stream >> headers;
+    }
+
+    // 本系统生成的ID文本是16位十六进制数，旧客户端的UUID等文本原样保留
+    bool isNumeric = false;
+    messageData->id = idText.size() == 16 ? idText.toULongLong(&isNumeric, 16) : 0;
+    messageData->idText = isNumeric ? QString() : idText;
+    messageData->timestampNs = dateTime.toMSecsSinceEpoch() * 1000000;
+    messageData->sequence = sequence;
+    messageData->headers = headers;
 
     // 检查是否有错误发生
     return stream.status() == QDataStream::Ok;
 }
 
+QByteArray Message::serializeWithTopicAlias(quint32 topicAlias) const
+{
+    // 头部无法紧凑编码时只能使用携带完整主题的 V1 帧
+    QByteArray headerBlock;
+    if (!encodeHeaders(m_d->headers, headerBlock)) {
+        return serializeV1();
+    }
+
+    return serializeV2(topicAlias, headerBlock);
+}
+
+QByteArray Message::serializeV2(quint32 topicAlias, const QByteArray& headerBlock) const
+{
+    const QByteArray topic = topicAlias ? QByteArray() : m_d->topic.toUtf8();
+    const QByteArray& data = m_d->data;
+    const bool hasSequence = m_d->sequence >= 0;
+    const int topicPartSize = topicAlias ? kTopicAliasSizeV2 : kTopicLengthSizeV2 + topic.size();
+    const int headerPartSize = headerBlock.isEmpty() ? 0 : kHeaderLengthSizeV2 + headerBlock.size();
+    const int bodySize = topicPartSize + headerPartSize + data.size() + (hasSequence ? kSequenceSizeV2 : 0);
+
+    QByteArray frame(kHeaderSizeV2 + bodySize, Qt::Uninitialized);
+    uchar* p = reinterpret_cast<uchar*>(frame.data());
+
+    p[0] = kFrameMagicV2;
+    p[1] = ProtocolV2;
+    p[2] = kFrameTypeMessage;
+    p[3] = (hasSequence ? kFlagSequence : 0) | (topicAlias ? kFlagTopicAlias : 0) | (headerPartSize ? kFlagHeaders : 0);
+    qToLittleEndian<quint32>(bodySize, p + 4);
+    qToLittleEndian<quint64>(m_d->id, p + 8);
+    qToLittleEndian<qint64>(m_d->timestampNs, p + 16);
+
+    // 主题部分：别名，或者长度加主题
+    if (topicAlias) {
+        qToLittleEndian<quint32>(topicAlias, p + kHeaderSizeV2);
+    } else {
+        qToLittleEndian<quint16>(topic.size(), p + kHeaderSizeV2);
+        memcpy(p + kHeaderSizeV2 + kTopicLengthSizeV2, topic.constData(), topic.size());
+    }
+
+    // 头部在负载之前，接收方不需要越过负载就能读取
+    if (headerPartSize) {
+        uchar* headerPart = p + kHeaderSizeV2 + topicPartSize;
+        qToLittleEndian<quint16>(headerBlock.size(), headerPart);
+        memcpy(headerPart + kHeaderLengthSizeV2, headerBlock.constData(), headerBlock.size());
+    }
+
+    uchar* body = p + kHeaderSizeV2 + topicPartSize + headerPartSize;
+    memcpy(body, data.constData(), data.size());
+    if (hasSequence) {
+        qToLittleEndian<qint64>(m_d->sequence, body + data.size());
+    }
+
+    return frame;
+}
+
+bool Message::deserializeV2(const QByteArray& frame)
+{
+    const int frameSize = frameLength(frame);
+    if (frameSize <= 0) {
+        return false;
+    }
+
+    const uchar* p = reinterpret_cast<const uchar*>(frame.constData());
+    FrameLayoutV2 layout;
+    if (p[2] != kFrameTypeMessage || !parseLayoutV2(p, frameSize, layout)) {
+        return false;
+    }
+
+    // 使用别名的帧不携带主题，由帧处理器按连接的别名表填入
+    const char* topicPart = frame.constData() + kHeaderSizeV2;
+    const char* payload = topicPart + layout.topicPartSize + layout.headerPartSize;
+    const qint64 sequence = layout.hasSequence ? qFromLittleEndian<qint64>(p + frameSize - kSequenceSizeV2) : -1;
+
+    QVariantMap headers;
+    if (layout.headerPartSize) {
+        const uchar* headerBlock = p + kHeaderSizeV2 + layout.topicPartSize + kHeaderLengthSizeV2;
+        if (!decodeHeaders(headerBlock, headerBlock + layout.headerPartSize - kHeaderLengthSizeV2, headers)) {
+            return false;
+        }
+    }
+
+    // 整体替换数据块，不需要先分离再逐个字段赋值
+    m_d = new MessageData(qFromLittleEndian<quint64>(p + 8),
+                          layout.aliased ? QString()
+                                         : QString::fromUtf8(topicPart + kTopicLengthSizeV2,
+                                                             layout.topicPartSize - kTopicLengthSizeV2),
+                          QByteArray(payload, layout.payloadSize),
+                          qFromLittleEndian<qint64>(p + 16),
+                          sequence,
+                          headers);
+
+    return true;
+}
+
+bool Message::deserializeFrame(const QByteArray& frame)
+{
+    if (frameVersion(frame) == ProtocolV2) {
+        return deserializeV2(frame);
+    }
+
+    int frameSize = frameLength(frame);
+    if (frameSize <= 0) {
+        return false;
+    }
+
+    // 以只读视图交给 QDataStream，不复制消息内容
+    return deserialize(QByteArray::fromRawData(frame.constData() + sizeof(qint32),
+                                               frameSize - (int)sizeof(qint32)));
+}
+
+bool Message::peekTopic(const QByteArray& frame, QString& topic)
+{
+    // V2 的主题紧跟在固定帧头之后，直接读取UTF-8字节；使用别名的帧没有主题
+    if (frameVersion(frame) == ProtocolV2) {
+        if (frame.size() < kHeaderSizeV2 + kTopicLengthSizeV2 || ((uchar)frame.at(3) & kFlagTopicAlias)) {
+            return false;
+        }
+
+        const int topicSize = qFromLittleEndian<quint16>(frame.constData() + kHeaderSizeV2);
+        if (frame.size() < kHeaderSizeV2 + kTopicLengthSizeV2 + topicSize) {
+            return false;
+        }
+
+        topic = QString::fromUtf8(frame.constData() + kHeaderSizeV2 + kTopicLengthSizeV2, topicSize);
+        return true;
+    }
+
+    QDataStream stream(frame);
+    stream.setVersion(QDataStream::Qt_5_15);
+
+    // 跳过长度前缀
+    if (stream.skipRawData(sizeof(qint32)) != (int)sizeof(qint32)) {
+        return false;
+    }
+
+    // 跳过消息ID：QString 以 quint32 字节长度开头，0xFFFFFFFF 表示空字符串
+    quint32 idLength = 0;
+    stream >> idLength;
+    if (idLength != 0xFFFFFFFF && stream.skipRawData(idLength) != (int)idLength) {
+        return false;
+    }
+
+    // 只读取主题，负载和时间戳保持原样
+    stream >> topic;
+
+    return stream.status() == QDataStream::Ok;
+}
+
+qint64 Message::peekTimestampNs(const QByteArray& frame)
+{
+    if (frameVersion(frame) == ProtocolV2) {
+        if (frame.size() < kHeaderSizeV2) {
+            return -1;
+        }
+        return qFromLittleEndian<qint64>(frame.constData() + 16);
+    }
+
+    // V1 的时间戳在变长的主题和负载之后，只能完整解码
+    Message message;
+    return message.deserializeFrame(frame) ? message.timestampNs() : -1;
+}
+
+quint32 Message::peekTopicAlias(const QByteArray& frame)
+{
+    if (frameVersion(frame) != ProtocolV2 || frame.size() < kHeaderSizeV2 + kTopicAliasSizeV2
+        || !((uchar)frame.at(3) & kFlagTopicAlias)) {
+        return 0;
+    }
+
+    return qFromLittleEndian<quint32>(frame.constData() + kHeaderSizeV2);
+}
+
+bool Message::peekHeaders(const QByteArray& frame, QVariantMap& headers)
+{
+    headers.clear();
+    if (frameVersion(frame) == ProtocolV2) {
+        const uchar* begin = nullptr;
+        const uchar* end = nullptr;
+        return headerBlockV2(frame, begin, end) && decodeHeaders(begin, end, headers);
+    }
+
+    // V1 的头部在负载之后，只能完整解码
+    Message message;
+    if (!message.deserializeFrame(frame)) {
+        return false;
+    }
+    headers = message.headers();
+    return true;
+}
+
+QVariant Message::peekHeader(const QByteArray& frame, const QString& key)
+{
+    if (frameVersion(frame) != ProtocolV2) {
+        QVariantMap headers;
+        return peekHeaders(frame, headers) ? headers.value(key) : QVariant();
+    }
+
+    const uchar* p = nullptr;
+    const uchar* end = nullptr;
+    if (!headerBlockV2(frame, p, end)) {
+        return QVariant();
+    }
+
+    // 按字节比较键，不匹配的值直接跳过
+    const QByteArray utf8Key = key.toUtf8();
+    while (p < end) {
+        const int keySize = *p++;
+        if (keySize > end - p) {
+            return QVariant();
+        }
+        const bool match = keySize == utf8Key.size() && memcmp(p, utf8Key.constData(), keySize) == 0;
+        p += keySize;
+
+        QVariant value;
+        if (!readHeaderValue(p, end, match ? &value : nullptr)) {
+            return QVariant();
+        }
+        if (match) {
+            return value;
+        }
+    }
+    return QVariant();
+}
+
+bool Message::isBatchFrame(const QByteArray& frame)
+{
+    return frameVersion(frame) == ProtocolV2 && frame.size() >= kHeaderSizeV2
+           && (uchar)frame.at(2) == kFrameTypeBatch;
+}
+
+QByteArray Message::heartbeatFrame(HeartbeatType type, quint64 token)
+{
+    QByteArray frame(kHeaderSizeV2, '\0');
+    uchar* p = reinterpret_cast<uchar*>(frame.data());
+    p[0] = kFrameMagicV2;
+    p[1] = ProtocolV2;
+    p[2] = type == Pong ? kFrameTypePong : kFrameTypePing;
+    qToLittleEndian<quint64>(token, p + 8);
+    return frame;
+}
+
+Message::HeartbeatType Message::heartbeatType(const QByteArray& frame)
+{
+    if (frameVersion(frame) != ProtocolV2 || frame.size() < kHeaderSizeV2) {
+        return NoHeartbeat;
+    }
+
+    const uchar type = (uchar)frame.at(2);
+    return type == kFrameTypePing ? Ping : type == kFrameTypePong ? Pong : NoHeartbeat;
+}
+
+quint64 Message::heartbeatToken(const QByteArray& frame)
+{
+    if (heartbeatType(frame) == NoHeartbeat) {
+        return 0;
+    }
+
+    return qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(frame.constData()) + 8);
+}
+
+QByteArray Message::batchContents(const QByteArray& frame)
+{
+    const int frameSize = frameLength(frame);
+    if (frameSize <= 0 || !isBatchFrame(frame)) {
+        return QByteArray();
+    }
+
+    return QByteArray::fromRawData(frame.constData() + kHeaderSizeV2, frameSize - kHeaderSizeV2);
+}
+
+QByteArray Message::withSequence(const QByteArray& frame, qint64 sequence, const QString& topic)
+{
+    const int frameSize = frameLength(frame);
+    if (frameSize <= 0) {
+        return QByteArray(frame.constData(), frame.size());
+    }
+
+    if (frameVersion(frame) == ProtocolV1) {
+        Message message;
+        if (!message.deserializeFrame(frame)) {
+            return QByteArray(frame.constData(), frameSize);
+        }
+        message.setSequence(sequence);
+        return message.serialize(ProtocolV1);
+    }
+
+    // 已有序号时覆盖，否则在帧尾追加并更新帧体长度和标志位
+    const uchar* p = reinterpret_cast<const uchar*>(frame.constData());
+    FrameLayoutV2 layout;
+    if (!parseLayoutV2(p, frameSize, layout)) {
+        return QByteArray(frame.constData(), frameSize);
+    }
+
+    if (layout.aliased && !topic.isEmpty()) {
+        const QByteArray topicPart = topicPartV2(topic);
+        if (topicPart.isEmpty()) {
+            return QByteArray();
+        }
+        return rewriteV2(p, layout, &topicPart, false, true, sequence);
+    }
+    return rewriteV2(p, layout, nullptr, false, true, sequence);
+}
+
+QByteArray Message::withTopic(const QByteArray& frame, const QString& topic)
+{
+    const int frameSize = frameLength(frame);
+    if (frameSize <= 0) {
+        return QByteArray(frame.constData(), frame.size());
+    }
+
+    const uchar* p = reinterpret_cast<const uchar*>(frame.constData());
+    FrameLayoutV2 layout;
+    if (frameVersion(frame) != ProtocolV2 || !parseLayoutV2(p, frameSize, layout) || !layout.aliased) {
+        return QByteArray(frame.constData(), frameSize);
+    }
+
+    const QByteArray topicPart = topicPartV2(topic);
+    if (topicPart.isEmpty()) {
+        return QByteArray();
+    }
+    return rewriteV2(p, layout, &topicPart, false, false, 0);
+}
+
+QByteArray Message::withTopicAlias(const QByteArray& frame, quint32 topicAlias)
+{
+    const int frameSize = frameLength(frame);
+    const uchar* p = reinterpret_cast<const uchar*>(frame.constData());
+    FrameLayoutV2 layout;
+    if (topicAlias == 0 || frameSize <= 0 || frameVersion(frame) != ProtocolV2
+        || !parseLayoutV2(p, frameSize, layout)) {
+        return QByteArray();
+    }
+
+    QByteArray topicPart(kTopicAliasSizeV2, Qt::Uninitialized);
+    qToLittleEndian<quint32>(topicAlias, topicPart.data());
+    return rewriteV2(p, layout, &topicPart, true, false, 0);
+}
+
+bool Message::fitsTopicV2(const QString& topic)
+{
+    // 每个 UTF-16 单元最多编码为3字节，短主题不需要转换
+    return topic.size() * 3 <= kMaxTopicSizeV2 || topic.toUtf8().size() <= kMaxTopicSizeV2;
+}
+
+QByteArray Message::topicAliasPayload(quint32 topicAlias, const QString& topic)
+{
+    return QByteArray::number(topicAlias) + '\n' + topic.toUtf8();
+}
+
+bool Message::parseTopicAliasPayload(const QByteArray& payload, quint32& topicAlias, QString& topic)
+{
+    const int separator = payload.indexOf('\n');
+    if (separator <= 0) {
+        return false;
+    }
+
+    bool ok = false;
+    topicAlias = payload.left(separator).toUInt(&ok);
+    topic = QString::fromUtf8(payload.constData() + separator + 1, payload.size() - separator - 1);
+    return ok && topicAlias != 0 && !topic.isEmpty();
+}
+
+int Message::frameVersion(const QByteArray& frame)
+{
+    if (frame.isEmpty()) {
+        return 0;
+    }
+
+    return (uchar)frame.at(0) == kFrameMagicV2 ? ProtocolV2 : ProtocolV1;
+}
+
+int Message::frameLength(const QByteArray& buffer)
+{
+    if (frameVersion(buffer) == ProtocolV2) {
+        // 等待完整的固定帧头
+        if (buffer.size() < kHeaderSizeV2) {
+            return 0;
+        }
+
+        const uchar* p = reinterpret_cast<const uchar*>(buffer.constData());
+        const quint32 bodySize = qFromLittleEndian<quint32>(p + 4);
+        if (p[1] != ProtocolV2 || bodySize > (quint32)(INT_MAX - kHeaderSizeV2)) {
+            return -1;
+        }
+
+        if (buffer.size() - kHeaderSizeV2 < (int)bodySize) {
+            return 0;
+        }
+
+        return kHeaderSizeV2 + (int)bodySize;
+    }
+
+    // 检查数据长度是否足够包含消息长度前缀（4字节）
+    if (buffer.size() < (int)sizeof(qint32)) {
+        return 0;
+    }
+
+    // 长度前缀为大端序，与 QDataStream 的默认字节序一致
+    qint32 messageSize = qFromBigEndian<qint32>(buffer.constData());
+    if (messageSize < 0) {
+        return -1;
+    }
+
+    // 检查数据长度是否足够包含完整消息
+    if (buffer.size() - (int)sizeof(qint32) < messageSize) {
+        return 0;
+    }
+
+    return (int)sizeof(qint32) + messageSize;
+}
+
 // 从带有长度前缀的完整消息中提取消息内容
 // 返回值：如果成功，返回消息内容；如果失败，返回空字节数组
 // 参数 bytesRead：输出参数，表示从输入数据中读取的字节数
 // 如果数据不完整，返回空字节数组，并设置 bytesRead = 0
+// V2 帧是自描述的，返回的内容就是整个帧，可以直接交给 deserialize
 QByteArray Message::extractMessageContent(const QByteArray& frameData, int& bytesRead)
 {
     bytesRead = 0;
 
-    // 检查数据长度是否足够包含消息长度前缀（4字节）
-    if (frameData.size() < (int)sizeof(qint32)) {
+    int frameSize = frameLength(frameData);
+    if (frameSize <= 0) {
         return QByteArray();
     }
 
-    // 读取消息长度
-    QDataStream stream(frameData);
-    stream.setVersion(QDataStream::Qt_5_15);
-
-    qint32 messageSize;
-    stream >> messageSize;
-
-    // 检查数据长度是否足够包含完整消息
-    if (frameData.size() < (int)sizeof(qint32) + messageSize) {
-        return QByteArray();
+    if (frameVersion(frameData) == ProtocolV2) {
+        bytesRead = frameSize;
+        return frameData.left(frameSize);
     }
 
     // 提取消息内容
-    QByteArray messageContent = frameData.mid(sizeof(qint32), messageSize);
-    bytesRead = sizeof(qint32) + messageSize;
+    QByteArray messageContent = frameData.mid(sizeof(qint32), frameSize - (int)sizeof(qint32));
+    bytesRead = frameSize;
 
     return messageContent;
 }
+
+MessageBatch::MessageBatch()
+    : m_buffer(kHeaderSizeV2, '\0')
+    , m_count(0)
+{
+}
+
+void MessageBatch::append(const QByteArray& frame)
+{
+    m_buffer.append(frame);
+    ++m_count;
+}
+
+int MessageBatch::size() const
+{
+    return m_count;
+}
+
+int MessageBatch::bytes() const
+{
+    return m_buffer.size() - kHeaderSizeV2;
+}
+
+bool MessageBatch::isEmpty() const
+{
+    return m_count == 0;
+}
+
+QByteArray MessageBatch::takeFrame(Message::ProtocolVersion version)
+{
+    QByteArray frame;
+    frame.swap(m_buffer);
+    m_buffer = QByteArray(kHeaderSizeV2, '\0');
+    m_count = 0;
+
+    if (version != Message::ProtocolV2) {
+        frame.remove(0, kHeaderSizeV2);
+        return frame;
+    }
+
+    // 只填写预留的帧头，消息帧不再移动
+    uchar* p = reinterpret_cast<uchar*>(frame.data());
+    p[0] = kFrameMagicV2;
+    p[1] = Message::ProtocolV2;
+    p[2] = kFrameTypeBatch;
+    p[3] = 0;
+    qToLittleEndian<quint32>(frame.size() - kHeaderSizeV2, p + 4);
+    qToLittleEndian<quint64>(0, p + 8);
+    qToLittleEndian<qint64>(Message::currentTimestampNs(), p + 16);
+    return frame;
+}
+
+void MessageBatch::clear()
+{
+    m_buffer.resize(kHeaderSizeV2);
+    m_count = 0;
+}
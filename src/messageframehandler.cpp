@@ -3,42 +3,179 @@
 
 MessageFrameHandler::MessageFrameHandler(QObject* parent)
     : QObject(parent)
+    , m_readPos(0)
+    , m_routingMode(false)
+    , m_failed(false)
 {
 }
 
 void MessageFrameHandler::processIncomingData(const QByteArray& data)
 {
-    // 将接收到的数据添加到缓冲区
+    // 分帧失败之后无法再定位帧边界，丢弃后续数据直到连接关闭
+    if (m_failed) {
+        return;
+    }
+
+    // 快速路径：缓冲区中没有残留数据时，直接在收到的数据上解析，不复制到缓冲区
+    if (m_readPos >= m_buffer.size()) {
+        m_buffer.resize(0);
+        m_readPos = 0;
+
+        int consumed = processFrames(data.constData(), data.size());
+        if (consumed < 0) {
+            fail();
+            return;
+        }
+
+        // 只把末尾不完整的帧复制到缓冲区
+        if (consumed < data.size()) {
+            m_buffer.append(data.constData() + consumed, data.size() - consumed);
+        }
+        return;
+    }
+
+    // 将接收到的数据追加到未读数据之后
     m_buffer.append(data);
 
-    // 循环处理缓冲区中的所有完整消息
-    while (!m_buffer.isEmpty()) {
-        // 尝试从缓冲区中提取一个完整的消息
-        int bytesRead = 0;
-        QByteArray messageContent = Message::extractMessageContent(m_buffer, bytesRead);
+    int consumed = processFrames(m_buffer.constData() + m_readPos, m_buffer.size() - m_readPos);
+    if (consumed < 0) {
+        fail();
+        return;
+    }
+
+    // 只移动读游标，不搬移数据
+    m_readPos = qMin(m_readPos + consumed, (int)m_buffer.size());
+
+    if (m_readPos == m_buffer.size()) {
+        // 全部消费完，重置读游标并保留缓冲区容量
+        m_buffer.resize(0);
+        m_readPos = 0;
+    } else if (m_readPos >= m_buffer.size() / 2) {
+        // 已消费部分超过一半时才压缩，剩余数据比已消费的少，每个字节被搬移的次数有上限
+        m_buffer.remove(0, m_readPos);
+        m_readPos = 0;
+    }
+}
+
+int MessageFrameHandler::processFrames(const char* data, int size, bool insideBatch)
+{
+    int offset = 0;
+
+    // 循环处理数据中的所有完整消息
+    while (offset < size) {
+        // 以只读视图包装剩余数据，不复制
+        int frameSize = Message::frameLength(QByteArray::fromRawData(data + offset, size - offset));
+        if (frameSize < 0) {
+            return -1;
+        }
 
         // 如果没有足够的数据形成一个完整的消息，退出循环
-        if (bytesRead == 0) {
+        if (frameSize == 0) {
             break;
         }
 
-        // 从缓冲区中移除已处理的数据
-        m_buffer.remove(0, bytesRead);
+        const QByteArray frame = QByteArray::fromRawData(data + offset, frameSize);
+        offset += frameSize;
 
-        // 反序列化消息
+        // 心跳帧只有帧头，不进入消息解码和路由
+        const Message::HeartbeatType heartbeat = Message::heartbeatType(frame);
+        if (heartbeat != Message::NoHeartbeat) {
+            emit heartbeatReceived(heartbeat, Message::heartbeatToken(frame));
+            continue;
+        }
+
+        // 批量帧：其中的消息帧首尾相接，逐个处理，仍然是指向同一缓冲区的视图。
+        // MessageBatch 只产生一层，批量帧中的批量帧视为格式错误，不会递归下去
+        if (Message::isBatchFrame(frame)) {
+            if (insideBatch) {
+                return -1;
+            }
+
+            const QByteArray contents = Message::batchContents(frame);
+            if (processFrames(contents.constData(), contents.size(), true) != contents.size()) {
+                emit error("Malformed batch frame");
+                MYMQ_LOG_WARNING("Malformed batch frame");
+            }
+            continue;
+        }
+
+        // 路由模式：只解析主题，原样交出帧字节，不解码负载；别名帧由接收方解析
+        if (m_routingMode) {
+            QString topic;
+            if (Message::peekTopicAlias(frame) != 0 || Message::peekTopic(frame, topic)) {
+                emit frameReceived(topic, frame);
+            } else {
+                emit error("Failed to parse frame topic");
+                MYMQ_LOG_WARNING("Failed to parse frame topic");
+            }
+            continue;
+        }
+
+        // 反序列化消息，解码结果持有自己的数据，不引用接收缓冲区
         Message message;
-        if (message.deserialize(messageContent)) {
+        if (message.deserializeFrame(frame)) {
+            // 别名帧不携带主题，按登记的别名表填入
+            const quint32 topicAlias = Message::peekTopicAlias(frame);
+            if (topicAlias != 0) {
+                auto it = m_topicAliases.constFind(topicAlias);
+                if (it == m_topicAliases.constEnd()) {
+                    emit error(QString("Unknown topic alias %1").arg(topicAlias));
+                    MYMQ_LOG_WARNING(QString("Unknown topic alias %1").arg(topicAlias));
+                    continue;
+                }
+                message.setTopic(it.value());
+            }
+
             // 发出消息接收信号
             emit messageReceived(message);
         } else {
             // 发出错误信号
             emit error("Failed to deserialize message");
-            Logger::instance()->warning("Failed to deserialize message");
+            MYMQ_LOG_WARNING("Failed to deserialize message");
         }
     }
+
+    return offset;
+}
+
+void MessageFrameHandler::fail()
+{
+    // 长度前缀已经不可信，跳过任何字节数重新解析都只会把负载当作帧头，只能断开连接
+    m_buffer.clear();
+    m_readPos = 0;
+    m_failed = true;
+    MYMQ_LOG_WARNING("Invalid frame length, closing connection");
+    emit protocolError("Invalid frame length");
 }
 
 void MessageFrameHandler::clearBuffer()
 {
     m_buffer.clear();
+    m_readPos = 0;
+    m_failed = false;
+}
+
+bool MessageFrameHandler::hasFailed() const
+{
+    return m_failed;
+}
+
+void MessageFrameHandler::setRoutingMode(bool enabled)
+{
+    m_routingMode = enabled;
+}
+
+bool MessageFrameHandler::isRoutingMode() const
+{
+    return m_routingMode;
+}
+
+void MessageFrameHandler::setTopicAlias(quint32 topicAlias, const QString& topic)
+{
+    m_topicAliases.insert(topicAlias, topic);
+}
+
+void MessageFrameHandler::clearTopicAliases()
+{
+    m_topicAliases.clear();
 }
@@ -0,0 +1,814 @@
+#include "messagelog.h"
+#include "message.h"
+#include "logger.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QUrl>
+#include <QtEndian>
+
+#include <algorithm>
+#include <climits>
+#include <utility>
+
+#if defined(Q_OS_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+const int kIndexEntrySize = 8;                       ///< 索引项大小：相对偏移量 + 文件位置
+const qint64 kMaxSegmentBytes = 1024LL * 1024 * 1024; ///< 索引中的文件位置是32位的，段大小需要留出余量
+
+QString segmentFileName(qint64 baseOffset, const char* extension)
+{
+    return QString("%1.%2").arg(baseOffset, 20, 10, QChar('0')).arg(QLatin1String(extension));
+}
+
+QString topicDirectoryName(const QString& topic)
+{
+    // '/' 和 '.' 也要编码，保证每个主题对应一层目录且不会是 "." 或 ".."
+    return QString::fromLatin1(QUrl::toPercentEncoding(topic, QByteArray(), "."));
+}
+
+// fdatasync 在复制出的描述符上进行，期间不需要持有主题锁，原文件也可以被关闭
+int duplicateHandle(int handle)
+{
+#if defined(Q_OS_WIN)
+    return _dup(handle);
+#else
+    return ::dup(handle);
+#endif
+}
+
+bool syncHandle(int handle)
+{
+#if defined(Q_OS_WIN)
+    return _commit(handle) == 0;
+#elif defined(Q_OS_LINUX)
+    return ::fdatasync(handle) == 0;
+#else
+    return ::fsync(handle) == 0;
+#endif
+}
+
+void closeHandle(int handle)
+{
+#if defined(Q_OS_WIN)
+    _close(handle);
+#else
+    ::close(handle);
+#endif
+}
+
+// 丢弃写入失败后缓冲区里的残余，把文件截断回最后一条完整的记录，之后继续追加。
+// 关闭时先写出缓冲区，写出失败则文件比有效长度短，这时无法恢复
+bool truncateWriter(QFile* writer, qint64 size)
+{
+    const QString path = writer->fileName();
+    writer->close();
+    return QFile(path).size() >= size && QFile::resize(path, size)
+           && writer->open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+// 索引文件只保留完整的索引项，内存中的索引不变，文件中缺少的项只会让恢复后的读取多扫描一段
+bool truncateIndexWriter(QFile* writer)
+{
+    const QString path = writer->fileName();
+    writer->close();
+    return QFile::resize(path, QFile(path).size() / kIndexEntrySize * kIndexEntrySize)
+           && writer->open(QIODevice::WriteOnly | QIODevice::Append);
+}
+
+} // namespace
+
+/**
+ * @brief 段文件
+ */
+struct MessageLog::Segment {
+    qint64 baseOffset = 0;              ///< 段内第一条消息的偏移量
+    qint64 nextOffset = 0;              ///< 段内最后一条消息的偏移量 + 1
+    qint64 size = 0;                    ///< 有效数据的字节数
+    qint64 lastIndexedPosition = 0;     ///< 最后一个索引项的文件位置
+    QString logPath;                    ///< 段文件路径
+    QString indexPath;                  ///< 索引文件路径
+    QVector<IndexEntry> index;          ///< 稀疏索引
+    QFile* writer = nullptr;            ///< 段文件写入（只有活动段有）
+    QFile* indexWriter = nullptr;       ///< 索引文件写入（只有活动段有）
+    QFile* reader = nullptr;            ///< 读取映射使用的文件
+    uchar* map = nullptr;               ///< 段文件映射
+    qint64 mapSize = 0;                 ///< 映射的字节数
+};
+
+/**
+ * @brief 单个主题的日志
+ */
+struct MessageLog::TopicLog {
+    QString name;                       ///< 主题
+    QString path;                       ///< 主题目录
+    QMutex mutex;                       ///< 主题锁
+    QList<Segment*> segments;           ///< 段文件，按偏移量排列，最后一个是活动段
+    qint64 totalBytes = 0;              ///< 所有段的字节数
+    int unsynced = 0;                   ///< 上次落盘之后追加的消息数
+    bool failed = false;                ///< 写入失败且无法截断回完整的帧，不再追加
+};
+
+MessageLog::Options::Options()
+    : segmentBytes(64 * 1024 * 1024)
+    , retentionBytes(1024LL * 1024 * 1024)
+    , indexIntervalBytes(4096)
+    , syncPolicy(SyncInterval)
+    , syncBatchSize(256)
+    , syncIntervalMs(10)
+{
+}
+
+MessageLog::MessageLog(const QString& directory, const Options& options)
+    : m_directory(directory)
+    , m_options(options)
+    , m_open(false)
+    , m_syncThread(nullptr)
+    , m_stopSync(false)
+    , m_syncRequested(false)
+{
+    m_options.segmentBytes = qBound<qint64>(4096, m_options.segmentBytes, kMaxSegmentBytes);
+    m_options.indexIntervalBytes = qMax(1, m_options.indexIntervalBytes);
+    m_options.syncBatchSize = qMax(1, m_options.syncBatchSize);
+    m_options.syncIntervalMs = qMax(1, m_options.syncIntervalMs);
+}
+
+MessageLog::~MessageLog()
+{
+    close();
+}
+
+bool MessageLog::open()
+{
+    if (m_open) {
+        return true;
+    }
+
+    QDir root(m_directory);
+    if (!root.mkpath(".")) {
+        MYMQ_LOG_ERROR(QString("Failed to create message log directory: %1").arg(m_directory));
+        return false;
+    }
+
+    // 恢复已有的主题
+    const QStringList entries = root.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    {
+        QWriteLocker locker(&m_topicsLock);
+        for (const QString& entry : entries) {
+            const QString topic = QUrl::fromPercentEncoding(entry.toLatin1());
+            TopicLog* log = recoverTopic(topic, root.filePath(entry));
+            if (log) {
+                m_topics.insert(topic, log);
+            }
+        }
+    }
+
+    m_open = true;
+
+    if (m_options.syncPolicy != SyncNone) {
+        m_stopSync = false;
+        m_syncRequested.store(false, std::memory_order_relaxed);
+        m_syncThread = QThread::create([this]() { runSyncLoop(); });
+        m_syncThread->setObjectName("MessageLogSync");
+        m_syncThread->start();
+    }
+
+    MYMQ_LOG_INFO(QString("Message log opened: %1, %2 topics recovered").arg(m_directory).arg(m_topics.size()));
+    return true;
+}
+
+void MessageLog::close()
+{
+    if (!m_open) {
+        return;
+    }
+
+    // 先停止后台落盘线程，之后没有其他线程访问主题日志
+    if (m_syncThread) {
+        {
+            QMutexLocker locker(&m_syncMutex);
+            m_stopSync = true;
+            m_syncWakeup.wakeAll();
+        }
+        m_syncThread->wait();
+        delete m_syncThread;
+        m_syncThread = nullptr;
+    }
+
+    sync();
+
+    QWriteLocker locker(&m_topicsLock);
+    for (TopicLog* log : std::as_const(m_topics)) {
+        for (Segment* segment : std::as_const(log->segments)) {
+            closeSegment(segment);
+            delete segment;
+        }
+        delete log;
+    }
+    m_topics.clear();
+    m_open = false;
+}
+
+bool MessageLog::isOpen() const
+{
+    return m_open;
+}
+
+QString MessageLog::directory() const
+{
+    return m_directory;
+}
+
+MessageLog::Options MessageLog::options() const
+{
+    return m_options;
+}
+
+qint64 MessageLog::append(const QString& topic, const QByteArray& frame)
+{
+    if (!m_open || frame.isEmpty()) {
+        return -1;
+    }
+
+    TopicLog* log = topicLog(topic);
+    if (!log) {
+        return -1;
+    }
+
+    QMutexLocker locker(&log->mutex);
+    if (log->failed) {
+        return -1;
+    }
+
+    // 活动段写满时滚动到新段
+    Segment* segment = log->segments.last();
+    if (segment->size > 0 && segment->size + frame.size() > m_options.segmentBytes) {
+        if (!rollSegment(log, segment->nextOffset)) {
+            return -1;
+        }
+        applyRetention(log);
+        segment = log->segments.last();
+    }
+
+    // 先写消息帧，成功之后才记录索引和推进长度；部分写入的字节会打乱段内之后所有帧的边界，
+    // 截断回上一条完整的帧，截断不了时停止向该主题追加
+    if (segment->writer->write(frame) != frame.size()) {
+        MYMQ_LOG_ERROR(QString("Failed to append to message log %1: %2")
+                       .arg(segment->logPath).arg(segment->writer->errorString()));
+        if (!truncateWriter(segment->writer, segment->size)) {
+            MYMQ_LOG_ERROR(QString("Failed to truncate message log %1, topic %2 is read-only")
+                           .arg(segment->logPath).arg(topic));
+            log->failed = true;
+        }
+        return -1;
+    }
+
+    // 稀疏索引：段内第一条消息以及之后每隔 indexIntervalBytes 字节记录一项
+    if (segment->index.isEmpty() || segment->size - segment->lastIndexedPosition >= m_options.indexIntervalBytes) {
+        IndexEntry entry;
+        entry.relativeOffset = quint32(segment->nextOffset - segment->baseOffset);
+        entry.position = quint32(segment->size);
+        segment->index.append(entry);
+        segment->lastIndexedPosition = segment->size;
+
+        uchar buffer[kIndexEntrySize];
+        qToLittleEndian<quint32>(entry.relativeOffset, buffer);
+        qToLittleEndian<quint32>(entry.position, buffer + 4);
+        if (segment->indexWriter->write(reinterpret_cast<const char*>(buffer), kIndexEntrySize) != kIndexEntrySize) {
+            MYMQ_LOG_WARNING(QString("Failed to append to message log index %1").arg(segment->indexPath));
+            truncateIndexWriter(segment->indexWriter);
+        }
+    }
+
+    const qint64 offset = segment->nextOffset++;
+    segment->size += frame.size();
+    log->totalBytes += frame.size();
+
+    // 组提交：攒够一批之后唤醒后台线程落盘，追加的线程（Broker的I/O线程）不等待 fdatasync。
+    // 落盘完成之前的追加不再重复唤醒
+    ++log->unsynced;
+    if (m_options.syncPolicy == SyncBatch && log->unsynced >= m_options.syncBatchSize
+            && !m_syncRequested.exchange(true, std::memory_order_acq_rel)) {
+        locker.unlock();
+        QMutexLocker syncLocker(&m_syncMutex);
+        m_syncWakeup.wakeOne();
+    }
+
+    return offset;
+}
+
+QList<QByteArray> MessageLog::read(const QString& topic, qint64 fromOffset, int maxCount, qint64* startOffset)
+{
+    QList<QByteArray> frames;
+    if (startOffset) {
+        *startOffset = fromOffset;
+    }
+    if (maxCount <= 0) {
+        return frames;
+    }
+
+    TopicLog* log = findTopic(topic);
+    if (!log) {
+        return frames;
+    }
+
+    QMutexLocker locker(&log->mutex);
+
+    qint64 offset = qMax(fromOffset, log->segments.first()->baseOffset);
+    if (startOffset) {
+        *startOffset = offset;
+    }
+
+    // 找到包含起始偏移量的段
+    int i = log->segments.size() - 1;
+    while (i > 0 && log->segments.at(i)->baseOffset > offset) {
+        --i;
+    }
+
+    for (; i < log->segments.size() && frames.size() < maxCount; ++i) {
+        Segment* segment = log->segments.at(i);
+        if (offset >= segment->nextOffset || segment->index.isEmpty()) {
+            continue;
+        }
+
+        const uchar* data = mapSegment(segment);
+        if (!data) {
+            break;
+        }
+
+        // 二分查找不大于目标偏移量的最后一个索引项，再向后扫描
+        const quint32 relativeOffset = quint32(offset - segment->baseOffset);
+        auto it = std::upper_bound(segment->index.constBegin(), segment->index.constEnd(), relativeOffset,
+                                   [](quint32 value, const IndexEntry& entry) {
+                                       return value < entry.relativeOffset;
+                                   });
+        --it;
+
+        qint64 position = it->position;
+        qint64 current = segment->baseOffset + it->relativeOffset;
+        while (position < segment->size && frames.size() < maxCount) {
+            const QByteArray view = QByteArray::fromRawData(reinterpret_cast<const char*>(data) + position,
+                                                            int(qMin<qint64>(segment->size - position, INT_MAX)));
+            const int length = Message::frameLength(view);
+            if (length <= 0) {
+                MYMQ_LOG_WARNING(QString("Corrupt frame in message log %1 at %2").arg(segment->logPath).arg(position));
+                break;
+            }
+
+            if (current >= offset) {
+                frames.append(QByteArray(view.constData(), length));
+            }
+            position += length;
+            ++current;
+        }
+        offset = current;
+    }
+
+    return frames;
+}
+
+QList<QByteArray> MessageLog::readLast(const QString& topic, int count)
+{
+    return read(topic, qMax<qint64>(0, nextOffset(topic) - count), count);
+}
+
+qint64 MessageLog::firstOffset(const QString& topic) const
+{
+    TopicLog* log = findTopic(topic);
+    if (!log) {
+        return 0;
+    }
+
+    QMutexLocker locker(&log->mutex);
+    return log->segments.first()->baseOffset;
+}
+
+qint64 MessageLog::nextOffset(const QString& topic) const
+{
+    TopicLog* log = findTopic(topic);
+    if (!log) {
+        return 0;
+    }
+
+    QMutexLocker locker(&log->mutex);
+    return log->segments.last()->nextOffset;
+}
+
+qint64 MessageLog::offsetForTimestamp(const QString& topic, qint64 timestampNs)
+{
+    TopicLog* log = findTopic(topic);
+    if (!log) {
+        return 0;
+    }
+
+    QMutexLocker locker(&log->mutex);
+
+    // 最后一个第一条消息早于目标时间的段；第一段的第一条消息就不早于目标时间时直接返回
+    Segment* segment = nullptr;
+    const uchar* data = nullptr;
+    for (int i = log->segments.size() - 1; i >= 0; --i) {
+        Segment* candidate = log->segments.at(i);
+        const uchar* candidateData = mapSegment(candidate);
+        if (!candidateData) {
+            continue;
+        }
+        if (timestampAt(candidate, candidateData, 0) < timestampNs) {
+            segment = candidate;
+            data = candidateData;
+            break;
+        }
+        if (i == 0) {
+            return candidate->baseOffset;
+        }
+    }
+
+    if (!segment) {
+        return log->segments.first()->baseOffset;
+    }
+
+    // 二分查找最后一个早于目标时间的索引项，再向后扫描
+    auto it = std::partition_point(segment->index.constBegin(), segment->index.constEnd(),
+                                   [segment, data, timestampNs](const IndexEntry& entry) {
+                                       return timestampAt(segment, data, entry.position) < timestampNs;
+                                   });
+    --it;
+
+    qint64 position = it->position;
+    qint64 current = segment->baseOffset + it->relativeOffset;
+    while (position < segment->size) {
+        const QByteArray view = QByteArray::fromRawData(reinterpret_cast<const char*>(data) + position,
+                                                        int(qMin<qint64>(segment->size - position, INT_MAX)));
+        const int length = Message::frameLength(view);
+        if (length <= 0 || Message::peekTimestampNs(view) >= timestampNs) {
+            break;
+        }
+        position += length;
+        ++current;
+    }
+
+    return current;
+}
+
+QStringList MessageLog::topics() const
+{
+    QReadLocker locker(&m_topicsLock);
+    return m_topics.keys();
+}
+
+void MessageLog::sync()
+{
+    QList<TopicLog*> logs;
+    {
+        QReadLocker locker(&m_topicsLock);
+        logs = m_topics.values();
+    }
+
+    for (TopicLog* log : std::as_const(logs)) {
+        syncTopic(log);
+    }
+}
+
+MessageLog::TopicLog* MessageLog::findTopic(const QString& topic) const
+{
+    QReadLocker locker(&m_topicsLock);
+    return m_topics.value(topic);
+}
+
+MessageLog::TopicLog* MessageLog::topicLog(const QString& topic)
+{
+    TopicLog* log = findTopic(topic);
+    if (log) {
+        return log;
+    }
+
+    QWriteLocker locker(&m_topicsLock);
+    log = m_topics.value(topic);
+    if (log) {
+        return log;
+    }
+
+    const QString path = QDir(m_directory).filePath(topicDirectoryName(topic));
+    if (!QDir().mkpath(path)) {
+        MYMQ_LOG_ERROR(QString("Failed to create message log directory: %1").arg(path));
+        return nullptr;
+    }
+
+    log = new TopicLog();
+    log->name = topic;
+    log->path = path;
+    if (!rollSegment(log, 0)) {
+        delete log;
+        return nullptr;
+    }
+
+    m_topics.insert(topic, log);
+    return log;
+}
+
+MessageLog::TopicLog* MessageLog::recoverTopic(const QString& topic, const QString& path)
+{
+    TopicLog* log = new TopicLog();
+    log->name = topic;
+    log->path = path;
+
+    const QDir dir(path);
+    const QStringList files = dir.entryList(QStringList() << "*.log", QDir::Files, QDir::Name);
+    for (int i = 0; i < files.size(); ++i) {
+        bool ok = false;
+        const qint64 baseOffset = files.at(i).chopped(4).toLongLong(&ok);
+        if (!ok) {
+            continue;
+        }
+
+        Segment* segment = new Segment();
+        segment->baseOffset = baseOffset;
+        segment->nextOffset = baseOffset;
+        segment->logPath = dir.filePath(files.at(i));
+        segment->indexPath = dir.filePath(segmentFileName(baseOffset, "idx"));
+        segment->size = QFileInfo(segment->logPath).size();
+
+        // 已封存的段直接加载索引；活动段可能在写入中途崩溃，需要扫描并截断不完整的帧
+        const bool isActive = (i == files.size() - 1);
+        bool indexLoaded = false;
+        if (!isActive) {
+            QFile indexFile(segment->indexPath);
+            if (indexFile.open(QIODevice::ReadOnly)) {
+                const QByteArray data = indexFile.readAll();
+                const uchar* p = reinterpret_cast<const uchar*>(data.constData());
+                for (int pos = 0; pos + kIndexEntrySize <= data.size(); pos += kIndexEntrySize) {
+                    IndexEntry entry;
+                    entry.relativeOffset = qFromLittleEndian<quint32>(p + pos);
+                    entry.position = qFromLittleEndian<quint32>(p + pos + 4);
+                    segment->index.append(entry);
+                }
+                indexLoaded = !segment->index.isEmpty() || segment->size == 0;
+                if (!segment->index.isEmpty()) {
+                    segment->lastIndexedPosition = segment->index.last().position;
+                }
+            }
+        }
+
+        if (!indexLoaded) {
+            QFile file(segment->logPath);
+            qint64 validSize = 0;
+            if (file.open(QIODevice::ReadOnly) && segment->size > 0) {
+                const uchar* data = file.map(0, segment->size);
+                if (data) {
+                    validSize = scanSegment(segment, data, segment->size);
+                    file.unmap(const_cast<uchar*>(data));
+                }
+            }
+            file.close();
+
+            if (validSize < segment->size) {
+                MYMQ_LOG_WARNING(QString("Truncating message log %1 from %2 to %3 bytes")
+                                 .arg(segment->logPath).arg(segment->size).arg(validSize));
+                QFile::resize(segment->logPath, validSize);
+                segment->size = validSize;
+            }
+
+            // 重写索引文件
+            QFile indexFile(segment->indexPath);
+            if (indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                for (const IndexEntry& entry : std::as_const(segment->index)) {
+                    uchar buffer[kIndexEntrySize];
+                    qToLittleEndian<quint32>(entry.relativeOffset, buffer);
+                    qToLittleEndian<quint32>(entry.position, buffer + 4);
+                    indexFile.write(reinterpret_cast<const char*>(buffer), kIndexEntrySize);
+                }
+            }
+        }
+
+        log->segments.append(segment);
+        log->totalBytes += segment->size;
+    }
+
+    // 已封存段的结束偏移量就是下一段的起始偏移量
+    for (int i = 0; i + 1 < log->segments.size(); ++i) {
+        log->segments[i]->nextOffset = log->segments.at(i + 1)->baseOffset;
+    }
+
+    // 重新打开活动段用于追加
+    bool ok = false;
+    if (log->segments.isEmpty()) {
+        ok = rollSegment(log, 0);
+    } else {
+        Segment* active = log->segments.last();
+        active->writer = new QFile(active->logPath);
+        active->indexWriter = new QFile(active->indexPath);
+        ok = active->writer->open(QIODevice::WriteOnly | QIODevice::Append)
+             && active->indexWriter->open(QIODevice::WriteOnly | QIODevice::Append);
+    }
+
+    if (!ok) {
+        MYMQ_LOG_ERROR(QString("Failed to recover message log for topic %1").arg(topic));
+        for (Segment* segment : std::as_const(log->segments)) {
+            closeSegment(segment);
+            delete segment;
+        }
+        delete log;
+        return nullptr;
+    }
+
+    return log;
+}
+
+bool MessageLog::rollSegment(TopicLog* log, qint64 baseOffset)
+{
+    // 封存当前活动段：写出缓冲并落盘后关闭写入文件
+    if (!log->segments.isEmpty()) {
+        Segment* active = log->segments.last();
+        active->writer->flush();
+        active->indexWriter->flush();
+        if (m_options.syncPolicy != SyncNone) {
+            syncHandle(active->writer->handle());
+        }
+        delete active->writer;
+        delete active->indexWriter;
+        active->writer = nullptr;
+        active->indexWriter = nullptr;
+    }
+
+    Segment* segment = new Segment();
+    segment->baseOffset = baseOffset;
+    segment->nextOffset = baseOffset;
+    segment->logPath = QDir(log->path).filePath(segmentFileName(baseOffset, "log"));
+    segment->indexPath = QDir(log->path).filePath(segmentFileName(baseOffset, "idx"));
+    segment->writer = new QFile(segment->logPath);
+    segment->indexWriter = new QFile(segment->indexPath);
+
+    if (!segment->writer->open(QIODevice::WriteOnly | QIODevice::Truncate)
+            || !segment->indexWriter->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        MYMQ_LOG_ERROR(QString("Failed to create message log segment %1: %2")
+                       .arg(segment->logPath).arg(segment->writer->errorString()));
+        closeSegment(segment);
+        delete segment;
+        return false;
+    }
+
+    log->segments.append(segment);
+    return true;
+}
+
+void MessageLog::applyRetention(TopicLog* log)
+{
+    if (m_options.retentionBytes <= 0) {
+        return;
+    }
+
+    // 至少保留活动段
+    while (log->segments.size() > 1 && log->totalBytes > m_options.retentionBytes) {
+        Segment* oldest = log->segments.takeFirst();
+        log->totalBytes -= oldest->size;
+        closeSegment(oldest);
+        QFile::remove(oldest->logPath);
+        QFile::remove(oldest->indexPath);
+        delete oldest;
+    }
+}
+
+qint64 MessageLog::scanSegment(Segment* segment, const uchar* data, qint64 size)
+{
+    segment->index.clear();
+
+    qint64 position = 0;
+    qint64 count = 0;
+    while (position < size) {
+        const QByteArray view = QByteArray::fromRawData(reinterpret_cast<const char*>(data) + position,
+                                                        int(qMin<qint64>(size - position, INT_MAX)));
+        const int length = Message::frameLength(view);
+        if (length <= 0) {
+            break;
+        }
+
+        if (segment->index.isEmpty() || position - segment->lastIndexedPosition >= m_options.indexIntervalBytes) {
+            IndexEntry entry;
+            entry.relativeOffset = quint32(count);
+            entry.position = quint32(position);
+            segment->index.append(entry);
+            segment->lastIndexedPosition = position;
+        }
+
+        position += length;
+        ++count;
+    }
+
+    segment->nextOffset = segment->baseOffset + count;
+    return position;
+}
+
+const uchar* MessageLog::mapSegment(Segment* segment)
+{
+    if (segment->size == 0) {
+        return nullptr;
+    }
+
+    // 活动段先把缓冲写入文件，映射才能看到最新的数据
+    if (segment->writer) {
+        segment->writer->flush();
+    }
+
+    if (segment->map && segment->mapSize == segment->size) {
+        return segment->map;
+    }
+
+    if (!segment->reader) {
+        segment->reader = new QFile(segment->logPath);
+        if (!segment->reader->open(QIODevice::ReadOnly)) {
+            MYMQ_LOG_ERROR(QString("Failed to open message log %1: %2")
+                           .arg(segment->logPath).arg(segment->reader->errorString()));
+            delete segment->reader;
+            segment->reader = nullptr;
+            return nullptr;
+        }
+    }
+
+    // 活动段增长之后重新映射；封存段的映射一直保留到段被删除
+    if (segment->map) {
+        segment->reader->unmap(segment->map);
+    }
+    segment->map = segment->reader->map(0, segment->size);
+    segment->mapSize = segment->map ? segment->size : 0;
+    return segment->map;
+}
+
+qint64 MessageLog::timestampAt(Segment* segment, const uchar* data, qint64 position)
+{
+    const QByteArray view = QByteArray::fromRawData(reinterpret_cast<const char*>(data) + position,
+                                                    int(qMin<qint64>(segment->size - position, INT_MAX)));
+    const int length = Message::frameLength(view);
+    return length > 0 ? Message::peekTimestampNs(view) : -1;
+}
+
+void MessageLog::closeSegment(Segment* segment)
+{
+    if (segment->map) {
+        segment->reader->unmap(segment->map);
+        segment->map = nullptr;
+        segment->mapSize = 0;
+    }
+
+    delete segment->reader;
+    delete segment->writer;
+    delete segment->indexWriter;
+    segment->reader = nullptr;
+    segment->writer = nullptr;
+    segment->indexWriter = nullptr;
+}
+
+void MessageLog::syncTopic(TopicLog* log)
+{
+    int handle = -1;
+    {
+        QMutexLocker locker(&log->mutex);
+        Segment* active = log->segments.last();
+        if (log->unsynced == 0 || !active->writer) {
+            return;
+        }
+
+        active->writer->flush();
+        active->indexWriter->flush();
+        handle = duplicateHandle(active->writer->handle());
+        log->unsynced = 0;
+    }
+
+    // 落盘期间其他线程可以继续追加，这些追加由下一次落盘负责
+    if (handle >= 0) {
+        if (!syncHandle(handle)) {
+            MYMQ_LOG_WARNING(QString("Failed to sync message log for topic %1").arg(log->name));
+        }
+        closeHandle(handle);
+    }
+}
+
+void MessageLog::runSyncLoop()
+{
+    QMutexLocker locker(&m_syncMutex);
+    while (!m_stopSync) {
+        // SyncBatch 等追加攒够一批后唤醒，SyncInterval 按周期醒来
+        if (m_options.syncPolicy == SyncBatch) {
+            while (!m_syncRequested.load(std::memory_order_acquire) && !m_stopSync) {
+                m_syncWakeup.wait(&m_syncMutex);
+            }
+        } else {
+            m_syncWakeup.wait(&m_syncMutex, m_options.syncIntervalMs);
+        }
+        if (m_stopSync) {
+            break;
+        }
+
+        // 先清除请求再落盘，落盘期间攒够新一批的主题会再唤醒一次
+        m_syncRequested.store(false, std::memory_order_release);
+        locker.unlock();
+        sync();
+        locker.relock();
+    }
+}
@@ -0,0 +1,130 @@
+#include "nativesocket.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+NativeSocket::NativeSocket(int descriptor)
+    : m_descriptor(descriptor)
+    , m_pendingOffset(0)
+    , m_error(false)
+    , m_writeInterest(false)
+{
+#ifdef Q_OS_LINUX
+    const int flags = fcntl(m_descriptor, F_GETFL, 0);
+    m_error = flags < 0 || fcntl(m_descriptor, F_SETFL, flags | O_NONBLOCK) < 0;
+#else
+    m_error = true;
+#endif
+}
+
+NativeSocket::~NativeSocket()
+{
+#ifdef Q_OS_LINUX
+    ::close(m_descriptor);
+#endif
+}
+
+int NativeSocket::descriptor() const
+{
+    return m_descriptor;
+}
+
+qint64 NativeSocket::read(char* data, qint64 maxSize)
+{
+#ifdef Q_OS_LINUX
+    if (m_error) {
+        return -1;
+    }
+
+    ssize_t count;
+    do {
+        count = ::recv(m_descriptor, data, size_t(maxSize), 0);
+    } while (count < 0 && errno == EINTR);
+
+    if (count > 0) {
+        return count;
+    }
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+    }
+
+    // 0 表示对端关闭
+    m_error = true;
+    return -1;
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+#endif
+}
+
+bool NativeSocket::write(const QByteArray& data)
+{
+    if (m_error) {
+        return false;
+    }
+
+    m_pending.append(data);
+    return true;
+}
+
+qint64 NativeSocket::flush()
+{
+#ifdef Q_OS_LINUX
+    if (m_error) {
+        return -1;
+    }
+
+    qint64 total = 0;
+    while (m_pendingOffset < m_pending.size()) {
+        const ssize_t sent = ::send(m_descriptor, m_pending.constData() + m_pendingOffset,
+                                    size_t(m_pending.size() - m_pendingOffset), MSG_NOSIGNAL);
+        if (sent > 0) {
+            m_pendingOffset += sent;
+            total += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+
+        m_error = true;
+        return -1;
+    }
+
+    // 全部发出后清空；否则已发送部分超过一半时才压缩
+    if (m_pendingOffset == m_pending.size()) {
+        m_pending.clear();
+        m_pendingOffset = 0;
+    } else if (m_pendingOffset > m_pending.size() / 2) {
+        m_pending.remove(0, int(m_pendingOffset));
+        m_pendingOffset = 0;
+    }
+
+    return total;
+#else
+    return -1;
+#endif
+}
+
+qint64 NativeSocket::bytesToWrite() const
+{
+    return m_pending.size() - m_pendingOffset;
+}
+
+bool NativeSocket::writeInterest() const
+{
+    return m_writeInterest;
+}
+
+void NativeSocket::setWriteInterest(bool enabled)
+{
+    m_writeInterest = enabled;
+}
@@ -0,0 +1,124 @@
+#include "outboundqueue.h"
+
+OutboundQueue::OutboundQueue(int maxMessages, qint64 maxBytes)
+    : m_nextSequence(0)
+    , m_bytes(0)
+    , m_maxMessages(qMax(1, maxMessages))
+    , m_maxBytes(qMax<qint64>(1, maxBytes))
+{
+}
+
+OutboundQueue::PushResult OutboundQueue::push(const QString& topic, const QByteArray& frame,
+                                              SubscriptionOptions::OverflowPolicy policy, int* droppedOldest)
+{
+    if (droppedOldest) {
+        *droppedOldest = 0;
+    }
+
+    // 同主题还有未发送的消息时直接用新消息覆盖，位置不变
+    if (policy == SubscriptionOptions::ConflateLatest) {
+        Entry* existing = findConflatable(topic);
+        if (existing) {
+            m_bytes += frame.size() - existing->frame.size();
+            existing->frame = frame;
+            return Conflated;
+        }
+    }
+
+    if (wouldOverflow(frame.size())) {
+        if (policy == SubscriptionOptions::DropNewest) {
+            return DroppedNewest;
+        }
+        if (policy == SubscriptionOptions::Disconnect) {
+            return Overflowed;
+        }
+
+        // DropOldest 和 ConflateLatest：丢弃最旧的消息腾出空间
+        while (!m_entries.isEmpty() && wouldOverflow(frame.size())) {
+            pop();
+            if (droppedOldest) {
+                ++*droppedOldest;
+            }
+        }
+
+        // 单条消息就超过了字节限制
+        if (wouldOverflow(frame.size())) {
+            return DroppedNewest;
+        }
+    }
+
+    Entry entry;
+    entry.frame = frame;
+    entry.sequence = m_nextSequence++;
+    if (policy == SubscriptionOptions::ConflateLatest) {
+        entry.topic = topic;
+        m_conflatable.insert(topic, entry.sequence);
+    }
+
+    m_bytes += frame.size();
+    m_entries.enqueue(entry);
+    return Queued;
+}
+
+const QByteArray& OutboundQueue::front() const
+{
+    return m_entries.head().frame;
+}
+
+void OutboundQueue::pop()
+{
+    const Entry entry = m_entries.dequeue();
+    m_bytes -= entry.frame.size();
+
+    if (!entry.topic.isEmpty()) {
+        auto it = m_conflatable.find(entry.topic);
+        if (it != m_conflatable.end() && it.value() == entry.sequence) {
+            m_conflatable.erase(it);
+        }
+    }
+}
+
+bool OutboundQueue::isEmpty() const
+{
+    return m_entries.isEmpty();
+}
+
+int OutboundQueue::size() const
+{
+    return m_entries.size();
+}
+
+qint64 OutboundQueue::bytes() const
+{
+    return m_bytes;
+}
+
+int OutboundQueue::maxMessages() const
+{
+    return m_maxMessages;
+}
+
+qint64 OutboundQueue::maxBytes() const
+{
+    return m_maxBytes;
+}
+
+bool OutboundQueue::wouldOverflow(qint64 frameSize) const
+{
+    return m_entries.size() + 1 > m_maxMessages || m_bytes + frameSize > m_maxBytes;
+}
+
+OutboundQueue::Entry* OutboundQueue::findConflatable(const QString& topic)
+{
+    auto it = m_conflatable.constFind(topic);
+    if (it == m_conflatable.constEnd() || m_entries.isEmpty()) {
+        return nullptr;
+    }
+
+    // 只在队尾入队、队首出队，入队序号与位置一一对应
+    const quint64 index = it.value() - m_entries.head().sequence;
+    if (index >= quint64(m_entries.size()) || m_entries.at(int(index)).sequence != it.value()) {
+        return nullptr;
+    }
+    return &m_entries[int(index)];
+}
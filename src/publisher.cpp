@@ -1,6 +1,8 @@
 #include "publisher.h"
 #include "logger.h"
 
+#include <utility>
+
 Publisher::Publisher(QObject* parent)
     : QObject(parent)
     , m_tcpSocket(nullptr)
@@ -13,16 +15,63 @@ Publisher::Publisher(QObject* parent)
     , m_pendingMessagesMutex(new QMutex())
     , m_registered(false)
     , m_frameHandler(new MessageFrameHandler(this))
+    , m_protocolVersion(Message::ProtocolV1)
+    , m_topicAliasesEnabled(false)
+    , m_batchMaxMessages(0)
+    , m_batchMaxBytes(64 * 1024)
+    , m_lingerTimer(new QTimer(this))
+    , m_confirmsEnabled(false)
+    , m_maxInFlight(1024)
+    , m_publishIndex(0)
+    , m_sharedMemory(new SharedMemoryClient(m_frameHandler, [this](const Message& message) { return sendMessage(message); },
+                                            this))
+    , m_keepAliveMonitor(new KeepAliveMonitor([this](const QByteArray& frame) { return writeData(frame); }, this))
 {
     // 连接重连定时器信号
     connect(m_reconnectTimer, &QTimer::timeout, this, &Publisher::tryReconnect);
 
+    // 共享内存通道损坏时中断连接，和套接字错误一样报告
+    connect(m_sharedMemory, &SharedMemoryClient::error, this, &Publisher::error);
+
+    // 心跳没有回应时断开连接，之后按设置重连
+    connect(m_keepAliveMonitor, &KeepAliveMonitor::timeout, this, &Publisher::handleKeepAliveTimeout);
+
+    // 逗留到期时写出当前批次
+    m_lingerTimer->setSingleShot(true);
+    connect(m_lingerTimer, &QTimer::timeout, this, &Publisher::flushBatch);
+
     // 连接消息帧处理器的信号
+    connect(m_frameHandler, &MessageFrameHandler::messageReceived,
+            [this](const Message& message) {
+                // 协议协商回复，之后的消息使用协商的版本编码
+                if (message.topic() == "$SYS/HELLO") {
+                    m_protocolVersion = message.data().toInt() >= Message::ProtocolV2
+                                            ? Message::ProtocolV2 : Message::ProtocolV1;
+                    MYMQ_LOG_INFO(QString("Negotiated protocol version %1").arg(int(m_protocolVersion)));
+                } else if (message.topic() == "$SYS/KEEPALIVE") {
+                    m_keepAliveMonitor->handleReply(message.data().toInt());
+                } else if (message.topic() == "$SYS/ACK") {
+                    handleConfirm(message.data().toULongLong());
+                } else if (message.topic() == "$SYS/NACK") {
+                    handleNack(message.data());
+                } else if (message.topic() == "$SYS/SHM") {
+                    m_sharedMemory->handleReply(message);
+                }
+            });
+
+    // 心跳回复不经过消息解码
+    connect(m_frameHandler, &MessageFrameHandler::heartbeatReceived,
+            m_keepAliveMonitor, &KeepAliveMonitor::handleHeartbeat);
+
     connect(m_frameHandler, &MessageFrameHandler::error,
             [this](const QString& errorMessage) {
-                Logger::instance()->warning(QString("Frame handler error: %1").arg(errorMessage));
+                MYMQ_LOG_WARNING(QString("Frame handler error: %1").arg(errorMessage));
                 emit error(errorMessage);
             });
+
+    // 帧长度非法时连接上的数据已经无法分帧，和心跳超时一样中断连接，之后按设置重连
+    connect(m_frameHandler, &MessageFrameHandler::protocolError,
+            this, &Publisher::handleProtocolError, Qt::QueuedConnection);
 }
 
 Publisher::~Publisher()
@@ -42,12 +91,16 @@ bool Publisher::connectToBroker(const QString& host, int port)
     m_port = port;
     m_useLocalSocket = false;
 
+    // 每个连接使用新的ID前缀
+    m_idGenerator.reset();
+
     // 创建TCP套接字
     m_tcpSocket = new QTcpSocket(this);
 
     // 连接信号槽
     connect(m_tcpSocket, &QTcpSocket::connected, this, &Publisher::handleConnected);
     connect(m_tcpSocket, &QTcpSocket::disconnected, this, &Publisher::handleDisconnected);
+    connect(m_tcpSocket, &QTcpSocket::readyRead, this, &Publisher::handleTcpReadyRead);
     connect(m_tcpSocket, &QTcpSocket::errorOccurred,
             this, &Publisher::handleError);
 
@@ -56,7 +109,7 @@ bool Publisher::connectToBroker(const QString& host, int port)
 
     // 等待连接成功 - 使用更短的超时时间
     if (!m_tcpSocket->waitForConnected(1000)) {
-        Logger::instance()->error(QString("Failed to connect to broker: %1").arg(m_tcpSocket->errorString()));
+        MYMQ_LOG_ERROR(QString("Failed to connect to broker: %1").arg(m_tcpSocket->errorString()));
         emit error(QString("Failed to connect to broker: %1").arg(m_tcpSocket->errorString()));
 
         // 如果启用了自动重连，启动重连定时器
@@ -80,12 +133,16 @@ bool Publisher::connectToLocalBroker(const QString& serverName)
     m_serverName = serverName;
     m_useLocalSocket = true;
 
+    // 每个连接使用新的ID前缀
+    m_idGenerator.reset();
+
     // 创建本地套接字
     m_localSocket = new QLocalSocket(this);
 
     // 连接信号槽
     connect(m_localSocket, &QLocalSocket::connected, this, &Publisher::handleConnected);
     connect(m_localSocket, &QLocalSocket::disconnected, this, &Publisher::handleDisconnected);
+    connect(m_localSocket, &QLocalSocket::readyRead, this, &Publisher::handleLocalReadyRead);
     connect(m_localSocket, &QLocalSocket::errorOccurred,
             this, &Publisher::handleLocalError);
 
@@ -94,7 +151,7 @@ bool Publisher::connectToLocalBroker(const QString& serverName)
 
     // 等待连接成功 - 使用更短的超时时间
     if (!m_localSocket->waitForConnected(1000)) {
-        Logger::instance()->error(QString("Failed to connect to local broker: %1").arg(m_localSocket->errorString()));
+        MYMQ_LOG_ERROR(QString("Failed to connect to local broker: %1").arg(m_localSocket->errorString()));
         emit error(QString("Failed to connect to local broker: %1").arg(m_localSocket->errorString()));
 
         // 如果启用了自动重连，启动重连定时器
@@ -113,6 +170,10 @@ void Publisher::disconnectFromBroker()
     // 停止重连定时器
     m_reconnectTimer->stop();
 
+    // 逗留中的消息先写出，已经断开时放回待发送队列
+    flushBatch();
+    m_sharedMemory->close();
+
     // 断开TCP连接
     if (m_tcpSocket) {
         m_tcpSocket->disconnect();
@@ -135,6 +196,10 @@ void Publisher::disconnectFromBroker()
     }
 
     m_registered = false;
+    m_protocolVersion = Message::ProtocolV1;
+    m_keepAliveMonitor->stop();
+    m_topicAliases.clear();
+    failInFlight();
 }
 
 bool Publisher::isConnected() const
@@ -148,8 +213,8 @@ bool Publisher::isConnected() const
 
 bool Publisher::publish(const QString& topic, const QByteArray& data)
 {
-    // 创建消息
-    Message message(topic, data);
+    // 创建消息，ID只需要一次原子加法
+    Message message(topic, data, m_idGenerator.next());
 
     return publish(message);
 }
@@ -161,7 +226,7 @@ bool Publisher::publish(const Message& message)
         QMutexLocker locker(m_pendingMessagesMutex);
         m_pendingMessages.enqueue(message);
 
-        Logger::instance()->warning(QString("Not connected to broker, message queued: %1").arg(message.topic()));
+        MYMQ_LOG_WARNING(QString("Not connected to broker, message queued: %1").arg(message.topic()));
 
         // 如果启用了自动重连，启动重连定时器
         if (m_autoReconnect && !m_reconnectTimer->isActive()) {
@@ -176,8 +241,32 @@ bool Publisher::publish(const Message& message)
         registerAsPublisher();
     }
 
+    // 在途窗口已满，或者已有消息在排队（保持发布顺序）时，等确认腾出空位再发出
+    if (isWindowFull() || !m_windowQueue.isEmpty()) {
+        m_windowQueue.enqueue(message);
+        return true;
+    }
+
+    return transmit(message);
+}
+
+bool Publisher::transmit(const Message& message)
+{
+    // 逗留批量模式：追加到当前批次，满了立即写出，否则等逗留定时器
+    if (m_batchMaxMessages > 1) {
+        m_batch.append(encodeMessage(message));
+        m_batchMessages.append(message);
+        if (m_batch.size() >= m_batchMaxMessages || m_batch.bytes() >= m_batchMaxBytes) {
+            flushBatch();
+        } else if (!m_lingerTimer->isActive()) {
+            m_lingerTimer->start();
+        }
+        return true;
+    }
+
     // 发送消息
     if (sendMessage(message)) {
+        trackPublished(message);
         emit published(message.id());
         return true;
     }
@@ -185,6 +274,112 @@ bool Publisher::publish(const Message& message)
     return false;
 }
 
+bool Publisher::publishBatch(const QVector<Message>& messages)
+{
+    if (messages.isEmpty()) {
+        return true;
+    }
+
+    // 如果未连接，将消息添加到待发送队列
+    if (!isConnected()) {
+        QMutexLocker locker(m_pendingMessagesMutex);
+        for (const Message& message : messages) {
+            m_pendingMessages.enqueue(message);
+        }
+
+        MYMQ_LOG_WARNING(QString("Not connected to broker, %1 messages queued").arg(messages.size()));
+
+        // 如果启用了自动重连，启动重连定时器
+        if (m_autoReconnect && !m_reconnectTimer->isActive()) {
+            m_reconnectTimer->start(m_reconnectInterval);
+        }
+
+        return false;
+    }
+
+    // 如果未注册为发布者，先注册
+    if (!m_registered) {
+        registerAsPublisher();
+    }
+
+    // 整批放不进在途窗口时逐条排队，随确认陆续发出
+    if (m_confirmsEnabled
+        && (m_inFlight.size() + m_batchMessages.size() + messages.size() > m_maxInFlight || !m_windowQueue.isEmpty())) {
+        for (const Message& message : messages) {
+            m_windowQueue.enqueue(message);
+        }
+        drainWindowQueue();
+        return true;
+    }
+
+    // 逗留中的消息先于本批写出
+    flushBatch();
+
+    MessageBatch batch;
+    for (const Message& message : messages) {
+        batch.append(encodeMessage(message));
+    }
+
+    if (!writeData(batch.takeFrame(m_protocolVersion))) {
+        MYMQ_LOG_ERROR(QString("Failed to send batch of %1 messages").arg(messages.size()));
+        return false;
+    }
+
+    for (const Message& message : messages) {
+        trackPublished(message);
+        emit published(message.id());
+    }
+    return true;
+}
+
+void Publisher::setBatching(int maxMessages, int lingerMs, int maxBytes)
+{
+    m_batchMaxMessages = maxMessages;
+    m_batchMaxBytes = qMax(1, maxBytes);
+    m_lingerTimer->setInterval(qMax(0, lingerMs));
+
+    // 关闭批量模式时写出剩余的消息
+    if (m_batchMaxMessages <= 1) {
+        flushBatch();
+    }
+}
+
+int Publisher::batchMaxMessages() const
+{
+    return m_batchMaxMessages;
+}
+
+void Publisher::flushBatch()
+{
+    m_lingerTimer->stop();
+    if (m_batch.isEmpty()) {
+        return;
+    }
+
+    QVector<Message> messages;
+    messages.swap(m_batchMessages);
+
+    // 连接已经断开：丢弃按旧连接编码的批次，消息放回待发送队列
+    if (!isConnected()) {
+        m_batch.clear();
+        QMutexLocker locker(m_pendingMessagesMutex);
+        for (const Message& message : std::as_const(messages)) {
+            m_pendingMessages.enqueue(message);
+        }
+        return;
+    }
+
+    if (!writeData(m_batch.takeFrame(m_protocolVersion))) {
+        MYMQ_LOG_ERROR(QString("Failed to send batch of %1 messages").arg(messages.size()));
+        return;
+    }
+
+    for (const Message& message : std::as_const(messages)) {
+        trackPublished(message);
+        emit published(message.id());
+    }
+}
+
 void Publisher::setAutoReconnect(bool enable, int interval)
 {
     m_autoReconnect = enable;
@@ -195,13 +390,84 @@ void Publisher::setAutoReconnect(bool enable, int interval)
     }
 }
 
+void Publisher::setTopicAliasesEnabled(bool enabled)
+{
+    m_topicAliasesEnabled = enabled;
+}
+
+bool Publisher::topicAliasesEnabled() const
+{
+    return m_topicAliasesEnabled;
+}
+
+void Publisher::setConfirmsEnabled(bool enabled, int maxInFlight)
+{
+    const bool changed = enabled != m_confirmsEnabled;
+    m_confirmsEnabled = enabled;
+    m_maxInFlight = qMax(1, maxInFlight);
+
+    if (changed && isConnected()) {
+        sendConfirmsRequest();
+    }
+
+    // 关闭确认后不再跟踪在途消息，排队的消息直接发出
+    if (!m_confirmsEnabled) {
+        m_inFlight.clear();
+    }
+    drainWindowQueue();
+}
+
+void Publisher::setSharedMemoryEnabled(bool enabled, int spinMicroseconds)
+{
+    m_sharedMemory->setEnabled(enabled, spinMicroseconds);
+}
+
+bool Publisher::sharedMemoryEnabled() const
+{
+    return m_sharedMemory->isEnabled();
+}
+
+bool Publisher::isUsingSharedMemory() const
+{
+    return m_sharedMemory->isActive();
+}
+
+bool Publisher::confirmsEnabled() const
+{
+    return m_confirmsEnabled;
+}
+
+int Publisher::inFlightCount() const
+{
+    return m_inFlight.size();
+}
+
 void Publisher::handleConnected()
 {
-    Logger::instance()->info("Connected to broker");
+    MYMQ_LOG_INFO("Connected to broker");
+
+    // 协商线路协议版本
+    sendHello();
+
+    // 心跳帧是 V2 帧，协商请求排在协议协商之后，Broker处理它时已经知道协议版本
+    if (m_keepAliveMonitor->keepAlive() > 0) {
+        sendKeepAliveRequest();
+    }
 
     // 注册为发布者
     registerAsPublisher();
 
+    // 同主机的Broker可以改用共享内存收发
+    if (m_useLocalSocket && m_sharedMemory->isEnabled()) {
+        m_sharedMemory->request(m_localSocket);
+    }
+
+    // 数据消息从连接建立开始编号，确认开关要先于任何数据消息发出
+    m_publishIndex = 0;
+    if (m_confirmsEnabled) {
+        sendConfirmsRequest();
+    }
+
     emit connected();
 
     // 处理待发送消息
@@ -210,9 +476,18 @@ void Publisher::handleConnected()
 
 void Publisher::handleDisconnected()
 {
-    Logger::instance()->info("Disconnected from broker");
+    MYMQ_LOG_INFO("Disconnected from broker");
+
+    // 批次中的消息使用本连接的别名编码，放回待发送队列，重连后重新编码
+    flushBatch();
 
     m_registered = false;
+    m_protocolVersion = Message::ProtocolV1;
+    m_keepAliveMonitor->stop();
+    m_topicAliases.clear();
+    m_frameHandler->clearBuffer();
+    failInFlight();
+    m_sharedMemory->close();
 
     emit disconnected();
 
@@ -222,10 +497,28 @@ void Publisher::handleDisconnected()
     }
 }
 
+void Publisher::handleTcpReadyRead()
+{
+    // 收到Broker的任何数据都说明连接仍然有效
+    m_keepAliveMonitor->notifyReceived();
+
+    // 发布者只会收到Broker的控制消息（如协议协商回复）
+    m_frameHandler->processIncomingData(m_tcpSocket->readAll());
+}
+
+void Publisher::handleLocalReadyRead()
+{
+    // 收到Broker的任何数据（包括共享内存的门铃）都说明连接仍然有效
+    m_keepAliveMonitor->notifyReceived();
+
+    // 切换到共享内存之后套接字上只有门铃，帧从共享内存中读出
+    m_sharedMemory->readSocket(m_localSocket);
+}
+
 void Publisher::handleError(QAbstractSocket::SocketError socketError)
 {
     QString errorMessage = QString("Socket error: %1").arg(m_tcpSocket->errorString());
-    Logger::instance()->error(errorMessage);
+    MYMQ_LOG_ERROR(errorMessage);
 
     emit error(errorMessage);
 }
@@ -233,14 +526,56 @@ void Publisher::handleError(QAbstractSocket::SocketError socketError)
 void Publisher::handleLocalError(QLocalSocket::LocalSocketError socketError)
 {
     QString errorMessage = QString("Local socket error: %1").arg(m_localSocket->errorString());
-    Logger::instance()->error(errorMessage);
+    MYMQ_LOG_ERROR(errorMessage);
+
+    emit error(errorMessage);
+}
+
+void Publisher::setKeepAlive(int seconds)
+{
+    m_keepAliveMonitor->setKeepAlive(seconds);
+
+    if (isConnected()) {
+        sendKeepAliveRequest();
+    }
+}
+
+int Publisher::keepAlive() const
+{
+    return m_keepAliveMonitor->keepAlive();
+}
+
+int Publisher::negotiatedKeepAlive() const
+{
+    return m_keepAliveMonitor->negotiatedKeepAlive();
+}
+
+void Publisher::handleKeepAliveTimeout()
+{
+    emit error("Heartbeat timeout");
+    if (m_tcpSocket) {
+        m_tcpSocket->abort();
+    }
+    if (m_localSocket) {
+        m_localSocket->abort();
+    }
+}
 
+void Publisher::handleProtocolError(const QString& errorMessage)
+{
+    MYMQ_LOG_ERROR(QString("Protocol error: %1").arg(errorMessage));
     emit error(errorMessage);
+    if (m_tcpSocket) {
+        m_tcpSocket->abort();
+    }
+    if (m_localSocket) {
+        m_localSocket->abort();
+    }
 }
 
 void Publisher::tryReconnect()
 {
-    Logger::instance()->info("Trying to reconnect to broker...");
+    MYMQ_LOG_INFO("Trying to reconnect to broker...");
 
     if (m_useLocalSocket) {
         connectToLocalBroker(m_serverName);
@@ -263,6 +598,23 @@ void Publisher::processPendingMessages()
     }
 }
 
+void Publisher::sendHello()
+{
+    // 协商请求使用 V1 编码，旧版本的Broker也能识别并忽略
+    Message helloMessage("$SYS/HELLO", QByteArray::number(Message::ProtocolV2));
+
+    if (!sendMessage(helloMessage)) {
+        MYMQ_LOG_WARNING("Failed to send protocol negotiation request");
+    }
+}
+
+void Publisher::sendKeepAliveRequest()
+{
+    if (!sendMessage(m_keepAliveMonitor->requestMessage())) {
+        MYMQ_LOG_WARNING("Failed to send keepalive request");
+    }
+}
+
 void Publisher::registerAsPublisher()
 {
     // 创建注册消息
@@ -271,21 +623,126 @@ void Publisher::registerAsPublisher()
     // 发送注册消息
     if (sendMessage(registerMessage)) {
         m_registered = true;
-        Logger::instance()->info("Registered as publisher");
+        MYMQ_LOG_INFO("Registered as publisher");
     } else {
-        Logger::instance()->error("Failed to register as publisher");
+        MYMQ_LOG_ERROR("Failed to register as publisher");
     }
 }
 
 bool Publisher::sendMessage(const Message& message)
 {
-    // 序列化消息
-    QByteArray data = message.serialize();
+    if (!writeData(encodeMessage(message))) {
+        MYMQ_LOG_ERROR(QString("Failed to send message: %1").arg(message.topic()));
+        return false;
+    }
 
-    // 发送消息
+    MYMQ_LOG_DEBUG(QString("Message sent: %1").arg(message.topic()));
+    return true;
+}
+
+QByteArray Publisher::encodeMessage(const Message& message)
+{
+    // 按协商的协议版本序列化消息，已登记别名的主题只发送别名
+    const quint32 topicAlias = topicAliasFor(message.topic());
+    return topicAlias ? message.serializeWithTopicAlias(topicAlias) : message.serialize(m_protocolVersion);
+}
+
+void Publisher::trackPublished(const Message& message)
+{
+    // 关闭确认时也要计数，之后开启确认时编号仍与Broker一致
+    const quint64 index = m_publishIndex++;
+    if (m_confirmsEnabled) {
+        InFlightMessage entry;
+        entry.index = index;
+        entry.message = message;
+        m_inFlight.enqueue(entry);
+    }
+}
+
+bool Publisher::isWindowFull() const
+{
+    // 逗留批次中的消息写出后就会进入在途队列，一并计算
+    return m_confirmsEnabled && m_inFlight.size() + m_batchMessages.size() >= m_maxInFlight;
+}
+
+void Publisher::sendConfirmsRequest()
+{
+    if (!sendMessage(Message("$SYS/CONFIRMS", m_confirmsEnabled ? "1" : "0"))) {
+        MYMQ_LOG_WARNING("Failed to send publisher confirms request");
+    }
+}
+
+void Publisher::handleConfirm(quint64 count)
+{
+    // 累计确认：编号小于 count 的在途消息都已被接受（被拒绝的已经移出队列）
+    while (!m_inFlight.isEmpty() && m_inFlight.head().index < count) {
+        const Message message = m_inFlight.dequeue().message;
+        emit confirmed(message.id());
+    }
+
+    drainWindowQueue();
+}
+
+void Publisher::handleNack(const QByteArray& payload)
+{
+    const int newline = payload.indexOf('\n');
+    bool ok = false;
+    const quint64 index = payload.left(newline).toULongLong(&ok);
+    if (!ok) {
+        MYMQ_LOG_WARNING("Received malformed publisher nack");
+        return;
+    }
+
+    const QString reason = newline >= 0 ? QString::fromUtf8(payload.mid(newline + 1)) : QString();
+
+    // 拒绝很少发生，线性查找即可；被拒绝的消息通常就在队首附近
+    for (int i = 0; i < m_inFlight.size(); ++i) {
+        if (m_inFlight.at(i).index == index) {
+            const Message message = m_inFlight.takeAt(i).message;
+            MYMQ_LOG_WARNING(QString("Message %1 rejected by broker: %2").arg(message.id()).arg(reason));
+            emit nacked(message.id(), reason);
+            break;
+        }
+    }
+
+    drainWindowQueue();
+}
+
+void Publisher::drainWindowQueue()
+{
+    while (!m_windowQueue.isEmpty() && !isWindowFull() && isConnected()) {
+        transmit(m_windowQueue.dequeue());
+    }
+}
+
+void Publisher::failInFlight()
+{
+    // 这些消息可能已经被Broker接受，只是确认没能送达，由应用决定是否重发
+    QQueue<InFlightMessage> inFlight;
+    inFlight.swap(m_inFlight);
+    for (const InFlightMessage& entry : std::as_const(inFlight)) {
+        emit nacked(entry.message.id(), "Connection lost");
+    }
+
+    // 窗口中排队的消息从未发出，放回待发送队列，重连后发送
+    if (!m_windowQueue.isEmpty()) {
+        QMutexLocker locker(m_pendingMessagesMutex);
+        while (!m_windowQueue.isEmpty()) {
+            m_pendingMessages.enqueue(m_windowQueue.dequeue());
+        }
+    }
+
+    m_publishIndex = 0;
+}
+
+bool Publisher::writeData(const QByteArray& data)
+{
+    m_keepAliveMonitor->notifySent();
     qint64 bytesSent = 0;
 
-    if (m_useLocalSocket && m_localSocket) {
+    if (isUsingSharedMemory()) {
+        bytesSent = m_sharedMemory->write(data);
+    } else if (m_useLocalSocket && m_localSocket) {
         bytesSent = m_localSocket->write(data);
         m_localSocket->flush();
     } else if (m_tcpSocket) {
@@ -293,12 +750,34 @@ bool Publisher::sendMessage(const Message& message)
         m_tcpSocket->flush();
     }
 
-    if (bytesSent != data.size()) {
-        Logger::instance()->error(QString("Failed to send message: %1").arg(message.topic()));
-        return false;
+    return bytesSent == data.size();
+}
+
+
+quint32 Publisher::topicAliasFor(const QString& topic)
+{
+    // 别名只能用于 V2 帧，超过 V2 主题长度上限的主题无法展开；控制消息总是携带完整主题
+    if (!m_topicAliasesEnabled || m_protocolVersion != Message::ProtocolV2 || topic.startsWith("$SYS/")
+        || !Message::fitsTopicV2(topic)) {
+        return 0;
     }
 
-    Logger::instance()->debug(QString("Message sent: %1").arg(message.topic()));
-    return true;
-}
+    auto it = m_topicAliases.constFind(topic);
+    if (it != m_topicAliases.constEnd()) {
+        return it.value();
+    }
+
+    // 别名用完后新主题退回携带完整主题
+    if (m_topicAliases.size() >= Message::kMaxTopicAliases) {
+        return 0;
+    }
 
+    // 登记消息先于使用别名的消息写入同一连接，Broker按顺序处理
+    const quint32 topicAlias = quint32(m_topicAliases.size()) + 1;
+    if (!sendMessage(Message("$SYS/ALIAS", Message::topicAliasPayload(topicAlias, topic)))) {
+        return 0;
+    }
+
+    m_topicAliases.insert(topic, topicAlias);
+    return topicAlias;
+}
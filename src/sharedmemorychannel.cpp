@@ -0,0 +1,286 @@
+#include "sharedmemorychannel.h"
+#include "logger.h"
+
+#include <QElapsedTimer>
+#include <QUuid>
+
+namespace {
+
+// 两个环首尾相接：客户端到Broker在前，Broker到客户端在后
+const int kClientToBroker = 0;
+const int kBrokerToClient = 1;
+
+quint32 roundUpToPowerOfTwo(int size)
+{
+    quint32 capacity = 4096;
+    while (capacity < quint32(qMax(size, 1)) && capacity < (1u << 28)) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+}
+
+SharedMemoryChannel::SharedMemoryChannel(QLocalSocket* socket, QObject* parent)
+    : QIODevice(parent)
+    , m_socket(socket)
+    , m_pendingOffset(0)
+    , m_reading(false)
+    , m_broken(false)
+    , m_spinNs(0)
+{
+}
+
+SharedMemoryChannel::~SharedMemoryChannel()
+{
+    close();
+}
+
+bool SharedMemoryChannel::create(int ringSize)
+{
+    const quint32 capacity = roundUpToPowerOfTwo(ringSize);
+    m_memory.setKey(QString("mymq-shm-%1").arg(QUuid::createUuid().toString(QUuid::WithoutBraces)));
+    if (!m_memory.create(int(ShmRing::requiredSize(capacity) * 2))) {
+        MYMQ_LOG_WARNING(QString("Failed to create shared memory: %1").arg(m_memory.errorString()));
+        return false;
+    }
+
+    // 头部中记录了容量，对端据此找到第二个环
+    char* base = static_cast<char*>(m_memory.data());
+    ShmRing ring;
+    ring.initialize(base, capacity);
+    ring.initialize(base + ShmRing::requiredSize(capacity), capacity);
+    return setupRings(true);
+}
+
+bool SharedMemoryChannel::attach(const QString& key)
+{
+    m_memory.setKey(key);
+    if (!m_memory.attach()) {
+        MYMQ_LOG_WARNING(QString("Failed to attach shared memory %1: %2").arg(key).arg(m_memory.errorString()));
+        return false;
+    }
+
+    return setupRings(false);
+}
+
+bool SharedMemoryChannel::setupRings(bool clientSide)
+{
+    char* base = static_cast<char*>(m_memory.data());
+    const qint64 size = m_memory.size();
+
+    ShmRing rings[2];
+    if (!rings[kClientToBroker].attach(base, size)) {
+        m_memory.detach();
+        return false;
+    }
+    const qint64 secondOffset = ShmRing::requiredSize(rings[kClientToBroker].capacity());
+    if (!rings[kBrokerToClient].attach(base + secondOffset, size - secondOffset)) {
+        m_memory.detach();
+        return false;
+    }
+
+    m_tx = rings[clientSide ? kClientToBroker : kBrokerToClient];
+    m_rx = rings[clientSide ? kBrokerToClient : kClientToBroker];
+    return open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+}
+
+QString SharedMemoryChannel::key() const
+{
+    return m_memory.key();
+}
+
+void SharedMemoryChannel::startReading()
+{
+    m_reading = true;
+
+    // 切换之前积压的数据没有登记等待，现在可以登记了
+    const qint64 written = flushPending();
+    if (written > 0) {
+        emit bytesWritten(written);
+    }
+}
+
+bool SharedMemoryChannel::isReading() const
+{
+    return m_reading;
+}
+
+void SharedMemoryChannel::setSpinTime(int microseconds)
+{
+    m_spinNs = qint64(qMax(0, microseconds)) * 1000;
+}
+
+void SharedMemoryChannel::handleDoorbell()
+{
+    // 门铃字节本身没有内容，只表示环的状态发生了变化
+    m_socket->readAll();
+
+    const qint64 written = flushPending();
+    if (written > 0) {
+        emit bytesWritten(written);
+    }
+}
+
+bool SharedMemoryChannel::isBroken() const
+{
+    return m_broken;
+}
+
+bool SharedMemoryChannel::isSequential() const
+{
+    return true;
+}
+
+qint64 SharedMemoryChannel::bytesAvailable() const
+{
+    if (!m_reading) {
+        return QIODevice::bytesAvailable();
+    }
+    return m_rx.bytesAvailable() + QIODevice::bytesAvailable();
+}
+
+qint64 SharedMemoryChannel::bytesToWrite() const
+{
+    return m_pending.size() - m_pendingOffset;
+}
+
+void SharedMemoryChannel::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+
+    QIODevice::close();
+    m_pending.clear();
+    m_pendingOffset = 0;
+    m_reading = false;
+    m_memory.detach();
+}
+
+qint64 SharedMemoryChannel::readData(char* data, qint64 maxSize)
+{
+    if (!m_reading) {
+        return 0;
+    }
+
+    qint64 count = m_rx.read(data, maxSize);
+
+    // 环空时先自旋一会儿，对端很快写入的数据不需要门铃
+    if (count == 0 && m_spinNs > 0) {
+        QElapsedTimer timer;
+        timer.start();
+        while (m_rx.bytesAvailable() == 0 && !m_rx.isBroken() && timer.nsecsElapsed() < m_spinNs) {
+        }
+        count = m_rx.read(data, maxSize);
+    }
+
+    // 读空了：登记等待后再读一次，登记之后到达的数据一定会有门铃
+    if (count >= 0 && count < maxSize) {
+        m_rx.setConsumerWaiting();
+        const qint64 more = m_rx.read(data + count, maxSize - count);
+        count = more < 0 ? more : count + more;
+    }
+
+    if (count < 0) {
+        markBroken();
+        return -1;
+    }
+
+    if (count > 0 && m_rx.takeProducerWaiting()) {
+        ringDoorbell();
+    }
+
+    return count;
+}
+
+qint64 SharedMemoryChannel::writeData(const char* data, qint64 size)
+{
+    if (!m_memory.isAttached() || m_broken) {
+        return -1;
+    }
+
+    // 已有积压时追加到末尾，保持字节顺序
+    qint64 written = 0;
+    if (m_pendingOffset == m_pending.size()) {
+        written = m_tx.write(data, size);
+        if (written < 0) {
+            markBroken();
+            return -1;
+        }
+        if (written > 0 && m_tx.takeConsumerWaiting()) {
+            ringDoorbell();
+        }
+    }
+
+    if (written < size) {
+        m_pending.append(data + written, int(size - written));
+        flushPending();
+    }
+
+    return size;
+}
+
+qint64 SharedMemoryChannel::flushPending()
+{
+    qint64 total = 0;
+    bool waiting = false;
+    while (m_pendingOffset < m_pending.size()) {
+        const qint64 written = m_tx.write(m_pending.constData() + m_pendingOffset, m_pending.size() - m_pendingOffset);
+        if (written < 0) {
+            markBroken();
+            m_pending.clear();
+            m_pendingOffset = 0;
+            return total;
+        }
+        m_pendingOffset += written;
+        total += written;
+        if (written > 0) {
+            continue;
+        }
+
+        // 环满。切换接收之前不能登记等待，否则对端的门铃会和套接字上的帧混在一起，
+        // 积压的数据留到 startReading() 时再写
+        if (!m_reading || waiting) {
+            break;
+        }
+
+        // 登记等待空间后再试一次，登记之后对端腾出空间时一定会按门铃
+        m_tx.setProducerWaiting();
+        waiting = true;
+    }
+
+    if (m_pendingOffset == m_pending.size()) {
+        m_pending.clear();
+        m_pendingOffset = 0;
+    } else if (m_pendingOffset > m_pending.size() / 2) {
+        m_pending.remove(0, int(m_pendingOffset));
+        m_pendingOffset = 0;
+    }
+
+    if (total > 0 && m_tx.takeConsumerWaiting()) {
+        ringDoorbell();
+    }
+
+    return total;
+}
+
+void SharedMemoryChannel::markBroken()
+{
+    if (m_broken) {
+        return;
+    }
+
+    m_broken = true;
+    setErrorString("Shared memory ring indices are corrupted");
+    MYMQ_LOG_WARNING(QString("Shared memory %1: ring indices are corrupted").arg(m_memory.key()));
+
+    // 可能正处于读写调用中，接收方应通过排队连接断开对端
+    emit broken();
+}
+
+void SharedMemoryChannel::ringDoorbell()
+{
+    m_socket->write("\x01", 1);
+    m_socket->flush();
+}
@@ -0,0 +1,122 @@
+#include "sharedmemoryclient.h"
+#include "logger.h"
+
+SharedMemoryClient::SharedMemoryClient(MessageFrameHandler* frameHandler, const MessageSender& sender,
+                                       QObject* parent)
+    : QObject(parent)
+    , m_frameHandler(frameHandler)
+    , m_sender(sender)
+    , m_enabled(false)
+    , m_spin(0)
+    , m_socket(nullptr)
+    , m_channel(nullptr)
+{
+}
+
+SharedMemoryClient::~SharedMemoryClient()
+{
+    close();
+}
+
+void SharedMemoryClient::setEnabled(bool enabled, int spinMicroseconds)
+{
+    m_enabled = enabled;
+    m_spin = qMax(0, spinMicroseconds);
+}
+
+bool SharedMemoryClient::isEnabled() const
+{
+    return m_enabled;
+}
+
+bool SharedMemoryClient::isActive() const
+{
+    return m_channel && m_channel->isReading();
+}
+
+void SharedMemoryClient::request(QLocalSocket* socket)
+{
+    close();
+
+    m_socket = socket;
+    m_channel = new SharedMemoryChannel(socket, this);
+    m_channel->setSpinTime(m_spin);
+    if (!m_channel->create()) {
+        close();
+        return;
+    }
+
+    // 通道在读写调用中报告损坏，回到事件循环后再断开
+    connect(m_channel, &SharedMemoryChannel::broken, this, &SharedMemoryClient::handleBroken, Qt::QueuedConnection);
+
+    // 收到Broker回复之前仍然使用本地套接字收发
+    if (!m_sender(Message("$SYS/SHM", m_channel->key().toUtf8()))) {
+        MYMQ_LOG_WARNING("Failed to send shared memory request");
+        close();
+    }
+}
+
+void SharedMemoryClient::handleReply(const Message& reply)
+{
+    // Broker的回复是它在套接字上的最后一条消息；接受时回复 $SYS/SHMREADY
+    // 作为本端在套接字上的最后一条消息，然后收发都切换到共享内存
+    if (m_channel && reply.data() == "1") {
+        m_sender(Message("$SYS/SHMREADY", QByteArray()));
+        m_channel->startReading();
+        MYMQ_LOG_INFO("Switched to shared memory channel");
+    } else {
+        MYMQ_LOG_WARNING("Broker rejected shared memory channel, using local socket");
+        close();
+    }
+}
+
+void SharedMemoryClient::readSocket(QLocalSocket* socket)
+{
+    // 切换到共享内存之后套接字上只有门铃
+    if (isActive()) {
+        m_channel->handleDoorbell();
+    } else {
+        m_frameHandler->processIncomingData(socket->readAll());
+    }
+
+    // 刚收到Broker接受共享内存的回复时，切换前写入共享内存的帧也在这里读出
+    if (isActive()) {
+        readChannel();
+    }
+}
+
+qint64 SharedMemoryClient::write(const QByteArray& data)
+{
+    return isActive() ? m_channel->write(data) : -1;
+}
+
+void SharedMemoryClient::close()
+{
+    delete m_channel;
+    m_channel = nullptr;
+    m_socket = nullptr;
+}
+
+void SharedMemoryClient::readChannel()
+{
+    // 读空时通道登记等待，之后Broker写入的数据会按门铃；处理消息时通道可能被关闭
+    while (isActive()) {
+        const QByteArray data = m_channel->readAll();
+        if (data.isEmpty()) {
+            break;
+        }
+        m_frameHandler->processIncomingData(data);
+    }
+}
+
+void SharedMemoryClient::handleBroken()
+{
+    // 通道可能已经随连接断开而关闭
+    if (!m_channel || !m_channel->isBroken()) {
+        return;
+    }
+
+    MYMQ_LOG_ERROR("Shared memory channel is corrupted, dropping connection");
+    emit error("Shared memory channel corrupted");
+    m_socket->abort();
+}
@@ -0,0 +1,174 @@
+#include "shmring.h"
+
+#include <cstring>
+#include <new>
+
+namespace {
+
+const quint32 kRingMagic = 0x53484D52;  // "SHMR"
+const int kCacheLine = 64;
+
+}
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "shared memory rings need address-free lock-free atomics");
+
+// 生产者和消费者各自写的字段放在不同的缓存行，避免伪共享
+struct ShmRing::Header {
+    quint32 magic;
+    quint32 capacity;
+    alignas(kCacheLine) std::atomic<quint64> head;          ///< 写位置，只由生产者修改
+    alignas(kCacheLine) std::atomic<quint64> tail;          ///< 读位置，只由消费者修改
+    alignas(kCacheLine) std::atomic<quint32> consumerWaiting; ///< 消费者读空后等待唤醒
+    alignas(kCacheLine) std::atomic<quint32> producerWaiting; ///< 生产者写满后等待唤醒
+};
+
+qint64 ShmRing::requiredSize(quint32 capacity)
+{
+    return qint64(sizeof(Header)) + capacity;
+}
+
+ShmRing::ShmRing()
+    : m_header(nullptr)
+    , m_data(nullptr)
+    , m_mask(0)
+    , m_broken(false)
+{
+}
+
+void ShmRing::initialize(char* memory, quint32 capacity)
+{
+    Q_ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0);
+
+    m_header = new (memory) Header();
+    m_header->capacity = capacity;
+    m_header->head.store(0, std::memory_order_relaxed);
+    m_header->tail.store(0, std::memory_order_relaxed);
+    m_header->consumerWaiting.store(0, std::memory_order_relaxed);
+    m_header->producerWaiting.store(0, std::memory_order_relaxed);
+    m_header->magic = kRingMagic;
+    m_data = memory + sizeof(Header);
+    m_mask = capacity - 1;
+    m_broken = false;
+}
+
+bool ShmRing::attach(char* memory, qint64 size)
+{
+    if (size < qint64(sizeof(Header))) {
+        return false;
+    }
+
+    Header* header = reinterpret_cast<Header*>(memory);
+    const quint32 capacity = header->capacity;
+    if (header->magic != kRingMagic || capacity == 0 || (capacity & (capacity - 1)) != 0
+        || requiredSize(capacity) > size) {
+        return false;
+    }
+
+    m_header = header;
+    m_data = memory + sizeof(Header);
+    m_mask = capacity - 1;
+    m_broken = false;
+    return true;
+}
+
+quint32 ShmRing::capacity() const
+{
+    return quint32(m_mask + 1);
+}
+
+bool ShmRing::isBroken() const
+{
+    return m_broken;
+}
+
+bool ShmRing::checkUsed(quint64 head, quint64 tail, quint64* used)
+{
+    // 读写位置都在对端可写的内存中，差值超过容量说明被破坏，之后不再信任这个环
+    *used = head - tail;
+    if (*used > m_mask + 1) {
+        m_broken = true;
+    }
+    return !m_broken;
+}
+
+qint64 ShmRing::write(const char* data, qint64 size)
+{
+    const quint64 head = m_header->head.load(std::memory_order_relaxed);
+    const quint64 tail = m_header->tail.load(std::memory_order_acquire);
+    quint64 used = 0;
+    if (!checkUsed(head, tail, &used)) {
+        return -1;
+    }
+
+    const qint64 count = qMin<qint64>(size, qint64(m_mask + 1 - used));
+    if (count <= 0) {
+        return 0;
+    }
+
+    // 跨过数据区末尾时分两段复制
+    const quint64 offset = head & m_mask;
+    const qint64 first = qMin<qint64>(count, qint64(m_mask + 1 - offset));
+    memcpy(m_data + offset, data, size_t(first));
+    memcpy(m_data, data + first, size_t(count - first));
+
+    m_header->head.store(head + quint64(count), std::memory_order_release);
+    return count;
+}
+
+bool ShmRing::takeConsumerWaiting()
+{
+    // 与 setConsumerWaiting() 的栅栏配对：要么消费者看到新的写位置，要么这里看到等待标志
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return m_header->consumerWaiting.load(std::memory_order_relaxed) != 0
+           && m_header->consumerWaiting.exchange(0, std::memory_order_acq_rel) != 0;
+}
+
+void ShmRing::setProducerWaiting()
+{
+    m_header->producerWaiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+qint64 ShmRing::read(char* data, qint64 maxSize)
+{
+    const quint64 tail = m_header->tail.load(std::memory_order_relaxed);
+    const quint64 head = m_header->head.load(std::memory_order_acquire);
+    quint64 used = 0;
+    if (!checkUsed(head, tail, &used)) {
+        return -1;
+    }
+
+    const qint64 count = qMin<qint64>(maxSize, qint64(used));
+    if (count <= 0) {
+        return 0;
+    }
+
+    const quint64 offset = tail & m_mask;
+    const qint64 first = qMin<qint64>(count, qint64(m_mask + 1 - offset));
+    memcpy(data, m_data + offset, size_t(first));
+    memcpy(data + first, m_data, size_t(count - first));
+
+    m_header->tail.store(tail + quint64(count), std::memory_order_release);
+    return count;
+}
+
+qint64 ShmRing::bytesAvailable() const
+{
+    // 位置被破坏时报告为空，随后的 read() 会发现并返回 -1
+    const quint64 used = m_header->head.load(std::memory_order_acquire) - m_header->tail.load(std::memory_order_relaxed);
+    return used > m_mask + 1 ? 0 : qint64(used);
+}
+
+void ShmRing::setConsumerWaiting()
+{
+    m_header->consumerWaiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+bool ShmRing::takeProducerWaiting()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return m_header->producerWaiting.load(std::memory_order_relaxed) != 0
+           && m_header->producerWaiting.exchange(0, std::memory_order_acq_rel) != 0;
+}
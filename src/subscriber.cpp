@@ -12,30 +12,91 @@ Subscriber::Subscriber(QObject* parent)
     , m_reconnectTimer(new QTimer(this))
     , m_registered(false)
     , m_frameHandler(new MessageFrameHandler(this))
+    , m_protocolVersion(Message::ProtocolV1)
+    , m_topicAliasesEnabled(false)
+    , m_sharedMemory(new SharedMemoryClient(m_frameHandler, [this](const Message& message) { return sendMessage(message); },
+                                            this))
+    , m_keepAliveMonitor(new KeepAliveMonitor([this](const QByteArray& frame) { return writeData(frame); }, this))
 {
     // 连接重连定时器信号
     connect(m_reconnectTimer, &QTimer::timeout, this, &Subscriber::tryReconnect);
 
+    // 共享内存通道损坏时中断连接，和套接字错误一样报告
+    connect(m_sharedMemory, &SharedMemoryClient::error, this, &Subscriber::error);
+
+    // 心跳没有回应时断开连接，之后按设置重连
+    connect(m_keepAliveMonitor, &KeepAliveMonitor::timeout, this, &Subscriber::handleKeepAliveTimeout);
+
     // 连接消息帧处理器的信号
     connect(m_frameHandler, &MessageFrameHandler::messageReceived,
             [this](const Message& message) {
-                // 如果是系统消息，不发送给用户
-                if (message.topic().startsWith("$SYS/")) {
+                // 协议协商回复，之后的消息使用协商的版本编码
+                if (message.topic() == "$SYS/HELLO") {
+                    m_protocolVersion = message.data().toInt() >= Message::ProtocolV2
+                                            ? Message::ProtocolV2 : Message::ProtocolV1;
+                    MYMQ_LOG_INFO(QString("Negotiated protocol version %1").arg(int(m_protocolVersion)));
+                    return;
+                }
+
+                if (message.topic() == "$SYS/KEEPALIVE") {
+                    m_keepAliveMonitor->handleReply(message.data().toInt());
+                    return;
+                }
+
+                // Broker通知的主题别名，之后的别名帧由帧处理器解码为完整主题
+                if (message.topic() == "$SYS/ALIAS") {
+                    quint32 topicAlias = 0;
+                    QString topic;
+                    if (Message::parseTopicAliasPayload(message.data(), topicAlias, topic)) {
+                        m_frameHandler->setTopicAlias(topicAlias, topic);
+                    }
                     return;
                 }
 
-                // 检查是否订阅了该主题
-                if (m_subscribedTopics.contains(message.topic())) {
-                    Logger::instance()->debug(QString("Received message on topic: %1").arg(message.topic()));
+                if (message.topic() == "$SYS/SHM") {
+                    m_sharedMemory->handleReply(message);
+                    return;
+                }
+
+                // 如果是系统消息，不发送给用户；Broker发布的统计和普通消息一样按订阅过滤
+                if (message.topic().startsWith("$SYS/") && !message.topic().startsWith("$SYS/STATS/")) {
+                    return;
+                }
+
+                // 检查是否订阅了该主题（含通配符模式）
+                if (m_topicFilter.matches(message.topic())) {
+                    MYMQ_LOG_DEBUG(QString("Received message on topic: %1").arg(message.topic()));
+                    // 同一连接上每个主题的序号递增，不大于已收到序号的帧是重复的，丢弃。
+                    // 续传位置只前进不后退，恢复订阅时不会从更早的位置重复回放
+                    if (message.sequence() >= 0) {
+                        auto received = m_receivedSequences.find(message.topic());
+                        if (received != m_receivedSequences.end() && message.sequence() <= received.value()) {
+                            MYMQ_LOG_DEBUG(QString("Dropped duplicate message on topic %1, sequence %2")
+                                           .arg(message.topic()).arg(message.sequence()));
+                            return;
+                        }
+                        m_receivedSequences.insert(message.topic(), message.sequence());
+
+                        qint64& lastSequence = m_lastSequences[message.topic()];
+                        lastSequence = qMax(lastSequence, message.sequence());
+                    }
                     emit messageReceived(message);
                 }
             });
 
+    // 心跳回复不经过消息解码
+    connect(m_frameHandler, &MessageFrameHandler::heartbeatReceived,
+            m_keepAliveMonitor, &KeepAliveMonitor::handleHeartbeat);
+
     connect(m_frameHandler, &MessageFrameHandler::error,
             [this](const QString& errorMessage) {
-                Logger::instance()->warning(QString("Frame handler error: %1").arg(errorMessage));
+                MYMQ_LOG_WARNING(QString("Frame handler error: %1").arg(errorMessage));
                 emit error(errorMessage);
             });
+
+    // 帧长度非法时连接上的数据已经无法分帧，和心跳超时一样中断连接，之后按设置重连
+    connect(m_frameHandler, &MessageFrameHandler::protocolError,
+            this, &Subscriber::handleProtocolError, Qt::QueuedConnection);
 }
 
 Subscriber::~Subscriber()
@@ -69,7 +130,7 @@ bool Subscriber::connectToBroker(const QString& host, int port)
 
     // 等待连接成功 - 使用更短的超时时间
     if (!m_tcpSocket->waitForConnected(1000)) {
-        Logger::instance()->error(QString("Failed to connect to broker: %1").arg(m_tcpSocket->errorString()));
+        MYMQ_LOG_ERROR(QString("Failed to connect to broker: %1").arg(m_tcpSocket->errorString()));
         emit error(QString("Failed to connect to broker: %1").arg(m_tcpSocket->errorString()));
 
         // 如果启用了自动重连，启动重连定时器
@@ -108,7 +169,7 @@ bool Subscriber::connectToLocalBroker(const QString& serverName)
 
     // 等待连接成功 - 使用更短的超时时间
     if (!m_localSocket->waitForConnected(1000)) {
-        Logger::instance()->error(QString("Failed to connect to local broker: %1").arg(m_localSocket->errorString()));
+        MYMQ_LOG_ERROR(QString("Failed to connect to local broker: %1").arg(m_localSocket->errorString()));
         emit error(QString("Failed to connect to local broker: %1").arg(m_localSocket->errorString()));
 
         // 如果启用了自动重连，启动重连定时器
@@ -127,6 +188,8 @@ void Subscriber::disconnectFromBroker()
     // 停止重连定时器
     m_reconnectTimer->stop();
 
+    m_sharedMemory->close();
+
     // 断开TCP连接
     if (m_tcpSocket) {
         m_tcpSocket->disconnect();
@@ -143,12 +206,15 @@ void Subscriber::disconnectFromBroker()
         m_localSocket = nullptr;
     }
 
-    // 清除消息帧处理器的缓冲区
+    // 清除消息帧处理器的缓冲区和本连接的主题别名
     if (m_frameHandler) {
         m_frameHandler->clearBuffer();
+        m_frameHandler->clearTopicAliases();
     }
 
     m_registered = false;
+    m_protocolVersion = Message::ProtocolV1;
+    m_keepAliveMonitor->stop();
 }
 
 bool Subscriber::isConnected() const
@@ -161,10 +227,20 @@ bool Subscriber::isConnected() const
 }
 
 bool Subscriber::subscribe(const QString& topic)
+{
+    return subscribe(topic, SubscriptionOptions());
+}
+
+bool Subscriber::subscribe(const QString& topic, const SubscriptionOptions& options)
 {
     // 如果未连接，返回失败
     if (!isConnected()) {
-        Logger::instance()->warning(QString("Not connected to broker, cannot subscribe to topic: %1").arg(topic));
+        MYMQ_LOG_WARNING(QString("Not connected to broker, cannot subscribe to topic: %1").arg(topic));
+        return false;
+    }
+
+    if (!Topic::isValidPattern(topic)) {
+        MYMQ_LOG_WARNING(QString("Invalid topic pattern, cannot subscribe: %1").arg(topic));
         return false;
     }
 
@@ -174,12 +250,14 @@ bool Subscriber::subscribe(const QString& topic)
     }
 
     // 创建订阅消息
-    Message subscribeMessage("$SYS/SUBSCRIBE", topic.toUtf8());
+    Message subscribeMessage("$SYS/SUBSCRIBE", options.toPayload(topic));
 
     // 发送订阅消息
     if (sendMessage(subscribeMessage)) {
         m_subscribedTopics.insert(topic);
-        Logger::instance()->info(QString("Subscribed to topic: %1").arg(topic));
+        m_topicFilter.insert(topic) = true;
+        m_subscriptionOptions.insert(topic, options);
+        MYMQ_LOG_INFO(QString("Subscribed to topic: %1").arg(topic));
         emit subscribed(topic);
         return true;
     }
@@ -191,7 +269,7 @@ bool Subscriber::unsubscribe(const QString& topic)
 {
     // 如果未连接，返回失败
     if (!isConnected()) {
-        Logger::instance()->warning(QString("Not connected to broker, cannot unsubscribe from topic: %1").arg(topic));
+        MYMQ_LOG_WARNING(QString("Not connected to broker, cannot unsubscribe from topic: %1").arg(topic));
         return false;
     }
 
@@ -206,7 +284,20 @@ bool Subscriber::unsubscribe(const QString& topic)
     // 发送取消订阅消息
     if (sendMessage(unsubscribeMessage)) {
         m_subscribedTopics.remove(topic);
-        Logger::instance()->info(QString("Unsubscribed from topic: %1").arg(topic));
+        m_topicFilter.remove(topic);
+        m_subscriptionOptions.remove(topic);
+
+        // 不再被任何订阅匹配的主题不需要续传，重新订阅时从头计算重复
+        for (auto it = m_lastSequences.begin(); it != m_lastSequences.end();) {
+            if (m_topicFilter.matches(it.key())) {
+                ++it;
+            } else {
+                m_receivedSequences.remove(it.key());
+                it = m_lastSequences.erase(it);
+            }
+        }
+
+        MYMQ_LOG_INFO(QString("Unsubscribed from topic: %1").arg(topic));
         emit unsubscribed(topic);
         return true;
     }
@@ -219,6 +310,11 @@ QSet<QString> Subscriber::subscribedTopics() const
     return m_subscribedTopics;
 }
 
+qint64 Subscriber::lastSequence(const QString& topic) const
+{
+    return m_lastSequences.value(topic, -1);
+}
+
 void Subscriber::setAutoReconnect(bool enable, int interval)
 {
     m_autoReconnect = enable;
@@ -229,13 +325,66 @@ void Subscriber::setAutoReconnect(bool enable, int interval)
     }
 }
 
+void Subscriber::setTopicAliasesEnabled(bool enabled)
+{
+    if (m_topicAliasesEnabled == enabled) {
+        return;
+    }
+
+    m_topicAliasesEnabled = enabled;
+    if (isConnected()) {
+        sendTopicAliasesRequest();
+    }
+}
+
+bool Subscriber::topicAliasesEnabled() const
+{
+    return m_topicAliasesEnabled;
+}
+
+void Subscriber::setSharedMemoryEnabled(bool enabled, int spinMicroseconds)
+{
+    m_sharedMemory->setEnabled(enabled, spinMicroseconds);
+}
+
+bool Subscriber::sharedMemoryEnabled() const
+{
+    return m_sharedMemory->isEnabled();
+}
+
+bool Subscriber::isUsingSharedMemory() const
+{
+    return m_sharedMemory->isActive();
+}
+
 void Subscriber::handleConnected()
 {
-    Logger::instance()->info("Connected to broker");
+    MYMQ_LOG_INFO("Connected to broker");
+
+    // Broker重启后序号从0重新开始，重复只在同一连接内判断
+    m_receivedSequences.clear();
+
+    // 协商线路协议版本
+    sendHello();
+
+    // 心跳帧是 V2 帧，协商请求排在协议协商之后，Broker处理它时已经知道协议版本
+    if (m_keepAliveMonitor->keepAlive() > 0) {
+        sendKeepAliveRequest();
+    }
 
     // 注册为订阅者
     registerAsSubscriber();
 
+    // 别名通知和别名帧只会在协商到 V2 之后出现
+    if (m_topicAliasesEnabled) {
+        sendTopicAliasesRequest();
+    }
+
+    // 同主机的Broker可以改用共享内存收发
+    if (m_useLocalSocket && m_sharedMemory->isEnabled()) {
+        m_sharedMemory->request(m_localSocket);
+    }
+
     emit connected();
 
     // 重新订阅所有主题
@@ -244,9 +393,14 @@ void Subscriber::handleConnected()
 
 void Subscriber::handleDisconnected()
 {
-    Logger::instance()->info("Disconnected from broker");
+    MYMQ_LOG_INFO("Disconnected from broker");
 
     m_registered = false;
+    m_protocolVersion = Message::ProtocolV1;
+    m_keepAliveMonitor->stop();
+    m_frameHandler->clearBuffer();
+    m_frameHandler->clearTopicAliases();
+    m_sharedMemory->close();
 
     emit disconnected();
 
@@ -258,6 +412,9 @@ void Subscriber::handleDisconnected()
 
 void Subscriber::handleTcpReadyRead()
 {
+    // 收到Broker的任何数据都说明连接仍然有效
+    m_keepAliveMonitor->notifyReceived();
+
     // 读取数据
     QByteArray data = m_tcpSocket->readAll();
 
@@ -269,19 +426,17 @@ void Subscriber::handleTcpReadyRead()
 
 void Subscriber::handleLocalReadyRead()
 {
-    // 读取数据
-    QByteArray data = m_localSocket->readAll();
+    // 收到Broker的任何数据（包括共享内存的门铃）都说明连接仍然有效
+    m_keepAliveMonitor->notifyReceived();
 
-    // 使用消息帧处理器处理数据
-    // 当收到完整消息时，帧处理器会发出 messageReceived 信号
-    // 该信号已在构造函数中连接到处理函数
-    m_frameHandler->processIncomingData(data);
+    // 切换到共享内存之后套接字上只有门铃，帧从共享内存中读出
+    m_sharedMemory->readSocket(m_localSocket);
 }
 
 void Subscriber::handleError(QAbstractSocket::SocketError socketError)
 {
     QString errorMessage = QString("Socket error: %1").arg(m_tcpSocket->errorString());
-    Logger::instance()->error(errorMessage);
+    MYMQ_LOG_ERROR(errorMessage);
 
     emit error(errorMessage);
 }
@@ -289,14 +444,56 @@ void Subscriber::handleError(QAbstractSocket::SocketError socketError)
 void Subscriber::handleLocalError(QLocalSocket::LocalSocketError socketError)
 {
     QString errorMessage = QString("Local socket error: %1").arg(m_localSocket->errorString());
-    Logger::instance()->error(errorMessage);
+    MYMQ_LOG_ERROR(errorMessage);
 
     emit error(errorMessage);
 }
 
+void Subscriber::setKeepAlive(int seconds)
+{
+    m_keepAliveMonitor->setKeepAlive(seconds);
+
+    if (isConnected()) {
+        sendKeepAliveRequest();
+    }
+}
+
+int Subscriber::keepAlive() const
+{
+    return m_keepAliveMonitor->keepAlive();
+}
+
+int Subscriber::negotiatedKeepAlive() const
+{
+    return m_keepAliveMonitor->negotiatedKeepAlive();
+}
+
+void Subscriber::handleKeepAliveTimeout()
+{
+    emit error("Heartbeat timeout");
+    if (m_tcpSocket) {
+        m_tcpSocket->abort();
+    }
+    if (m_localSocket) {
+        m_localSocket->abort();
+    }
+}
+
+void Subscriber::handleProtocolError(const QString& errorMessage)
+{
+    MYMQ_LOG_ERROR(QString("Protocol error: %1").arg(errorMessage));
+    emit error(errorMessage);
+    if (m_tcpSocket) {
+        m_tcpSocket->abort();
+    }
+    if (m_localSocket) {
+        m_localSocket->abort();
+    }
+}
+
 void Subscriber::tryReconnect()
 {
-    Logger::instance()->info("Trying to reconnect to broker...");
+    MYMQ_LOG_INFO("Trying to reconnect to broker...");
 
     if (m_useLocalSocket) {
         connectToLocalBroker(m_serverName);
@@ -305,6 +502,16 @@ void Subscriber::tryReconnect()
     }
 }
 
+void Subscriber::sendHello()
+{
+    // 协商请求使用 V1 编码，旧版本的Broker也能识别并忽略
+    Message helloMessage("$SYS/HELLO", QByteArray::number(Message::ProtocolV2));
+
+    if (!sendMessage(helloMessage)) {
+        MYMQ_LOG_WARNING("Failed to send protocol negotiation request");
+    }
+}
+
 void Subscriber::registerAsSubscriber()
 {
     // 创建注册消息
@@ -313,35 +520,76 @@ void Subscriber::registerAsSubscriber()
     // 发送注册消息
     if (sendMessage(registerMessage)) {
         m_registered = true;
-        Logger::instance()->info("Registered as subscriber");
+        MYMQ_LOG_INFO("Registered as subscriber");
     } else {
-        Logger::instance()->error("Failed to register as subscriber");
+        MYMQ_LOG_ERROR("Failed to register as subscriber");
     }
 }
 
 void Subscriber::resubscribeAll()
 {
-    // 获取已订阅的主题
+    // 获取已订阅的主题及其选项
     QSet<QString> topics = m_subscribedTopics;
+    QHash<QString, SubscriptionOptions> options = m_subscriptionOptions;
 
     // 清空已订阅的主题
     m_subscribedTopics.clear();
+    m_topicFilter.clear();
+    m_subscriptionOptions.clear();
 
-    // 重新订阅所有主题
+    // 重新订阅所有主题，收到过消息的主题从最后的序号之后续传，断线期间的消息只回放一次
     for (const QString& topic : topics) {
-        subscribe(topic);
+        const SubscriptionOptions original = options.value(topic);
+        SubscriptionOptions resumed = original;
+        for (auto it = m_lastSequences.constBegin(); it != m_lastSequences.constEnd(); ++it) {
+            if (it.key() == topic || Topic::matches(topic, it.key())) {
+                resumed.resumeOffsets.insert(it.key(), it.value() + 1);
+            }
+        }
+
+        // 保存原始选项，续传位置每次重连时重新计算
+        if (subscribe(topic, resumed)) {
+            m_subscriptionOptions.insert(topic, original);
+        }
+    }
+}
+
+void Subscriber::sendKeepAliveRequest()
+{
+    if (!sendMessage(m_keepAliveMonitor->requestMessage())) {
+        MYMQ_LOG_WARNING("Failed to send keepalive request");
+    }
+}
+
+void Subscriber::sendTopicAliasesRequest()
+{
+    Message aliasesMessage("$SYS/ALIASES", m_topicAliasesEnabled ? "1" : "0");
+
+    if (!sendMessage(aliasesMessage)) {
+        MYMQ_LOG_WARNING("Failed to send topic alias request");
     }
 }
 
 bool Subscriber::sendMessage(const Message& message)
 {
-    // 序列化消息
-    QByteArray data = message.serialize();
+    // 按协商的协议版本序列化消息并发送
+    if (!writeData(message.serialize(m_protocolVersion))) {
+        MYMQ_LOG_ERROR(QString("Failed to send message: %1").arg(message.topic()));
+        return false;
+    }
+
+    MYMQ_LOG_DEBUG(QString("Message sent: %1").arg(message.topic()));
+    return true;
+}
 
-    // 发送消息
+bool Subscriber::writeData(const QByteArray& data)
+{
+    m_keepAliveMonitor->notifySent();
     qint64 bytesSent = 0;
 
-    if (m_useLocalSocket && m_localSocket) {
+    if (isUsingSharedMemory()) {
+        bytesSent = m_sharedMemory->write(data);
+    } else if (m_useLocalSocket && m_localSocket) {
         bytesSent = m_localSocket->write(data);
         m_localSocket->flush();
     } else if (m_tcpSocket) {
@@ -349,13 +597,7 @@ bool Subscriber::sendMessage(const Message& message)
         m_tcpSocket->flush();
     }
 
-    if (bytesSent != data.size()) {
-        Logger::instance()->error(QString("Failed to send message: %1").arg(message.topic()));
-        return false;
-    }
-
-    Logger::instance()->debug(QString("Message sent: %1").arg(message.topic()));
-    return true;
+    return bytesSent == data.size();
 }
 
 // processReceivedData 方法已经被 MessageFrameHandler 替代
@@ -0,0 +1,158 @@
+#include "subscriptionoptions.h"
+
+#include <QList>
+
+SubscriptionOptions::SubscriptionOptions(OverflowPolicy policy)
+    : overflowPolicy(policy)
+    , startPosition(StartFromCache)
+    , startValue(0)
+{
+}
+
+SubscriptionOptions SubscriptionOptions::newOnly()
+{
+    SubscriptionOptions options;
+    options.startPosition = StartNewOnly;
+    return options;
+}
+
+SubscriptionOptions SubscriptionOptions::fromOffset(qint64 offset)
+{
+    SubscriptionOptions options;
+    options.startPosition = StartFromOffset;
+    options.startValue = qMax<qint64>(0, offset);
+    return options;
+}
+
+SubscriptionOptions SubscriptionOptions::fromTimestamp(qint64 timestampNs)
+{
+    SubscriptionOptions options;
+    options.startPosition = StartFromTime;
+    options.startValue = timestampNs;
+    return options;
+}
+
+SubscriptionOptions SubscriptionOptions::lastN(int count)
+{
+    SubscriptionOptions options;
+    options.startPosition = StartLastN;
+    options.startValue = qMax(0, count);
+    return options;
+}
+
+QByteArray SubscriptionOptions::toPayload(const QString& topic) const
+{
+    QByteArray payload = topic.toUtf8();
+
+    // 默认选项不写入负载，保持与旧版本Broker兼容
+    if (overflowPolicy != DefaultPolicy) {
+        payload += "\noverflow=" + policyName(overflowPolicy).toUtf8();
+    }
+
+    switch (startPosition) {
+    case StartNewOnly:
+        payload += "\nstart=new";
+        break;
+    case StartFromOffset:
+        payload += "\nstart=offset:" + QByteArray::number(startValue);
+        break;
+    case StartFromTime:
+        payload += "\nstart=time:" + QByteArray::number(startValue);
+        break;
+    case StartLastN:
+        payload += "\nstart=last:" + QByteArray::number(startValue);
+        break;
+    case StartFromCache:
+        break;
+    }
+
+    // 主题放在最后，不受其中的 ':' 影响
+    for (auto it = resumeOffsets.constBegin(); it != resumeOffsets.constEnd(); ++it) {
+        payload += "\nresume=" + QByteArray::number(it.value()) + ':' + it.key().toUtf8();
+    }
+
+    return payload;
+}
+
+SubscriptionOptions SubscriptionOptions::fromPayload(const QByteArray& payload, QString* topic)
+{
+    SubscriptionOptions options;
+
+    const QList<QByteArray> lines = payload.split('\n');
+    if (topic) {
+        *topic = QString::fromUtf8(lines.first());
+    }
+
+    for (int i = 1; i < lines.size(); ++i) {
+        const QByteArray& line = lines.at(i);
+        const int separator = line.indexOf('=');
+        if (separator < 0) {
+            continue;
+        }
+
+        const QByteArray key = line.left(separator).trimmed();
+        const QByteArray value = line.mid(separator + 1).trimmed();
+        if (key == "overflow") {
+            options.overflowPolicy = policyFromName(QString::fromUtf8(value));
+        } else if (key == "start") {
+            const int colon = value.indexOf(':');
+            const QByteArray kind = colon < 0 ? value : value.left(colon);
+            bool ok = false;
+            const qint64 number = colon < 0 ? 0 : value.mid(colon + 1).toLongLong(&ok);
+            if (kind == "new") {
+                options.startPosition = StartNewOnly;
+            } else if (ok && kind == "offset") {
+                options.startPosition = StartFromOffset;
+                options.startValue = qMax<qint64>(0, number);
+            } else if (ok && kind == "time") {
+                options.startPosition = StartFromTime;
+                options.startValue = number;
+            } else if (ok && kind == "last") {
+                options.startPosition = StartLastN;
+                options.startValue = qMax<qint64>(0, number);
+            }
+        } else if (key == "resume") {
+            // 主题原样保留，不去除首尾空白
+            const QByteArray raw = line.mid(separator + 1);
+            const int colon = raw.indexOf(':');
+            bool ok = false;
+            const qint64 offset = colon > 0 ? raw.left(colon).toLongLong(&ok) : 0;
+            if (ok && offset >= 0) {
+                options.resumeOffsets.insert(QString::fromUtf8(raw.mid(colon + 1)), offset);
+            }
+        }
+    }
+
+    return options;
+}
+
+QString SubscriptionOptions::policyName(OverflowPolicy policy)
+{
+    switch (policy) {
+    case DropOldest:
+        return "drop-oldest";
+    case DropNewest:
+        return "drop-newest";
+    case ConflateLatest:
+        return "conflate";
+    case Disconnect:
+        return "disconnect";
+    case DefaultPolicy:
+        break;
+    }
+    return "default";
+}
+
+SubscriptionOptions::OverflowPolicy SubscriptionOptions::policyFromName(const QString& name)
+{
+    if (name == "drop-oldest") {
+        return DropOldest;
+    } else if (name == "drop-newest") {
+        return DropNewest;
+    } else if (name == "conflate") {
+        return ConflateLatest;
+    } else if (name == "disconnect") {
+        return Disconnect;
+    }
+    return DefaultPolicy;
+}
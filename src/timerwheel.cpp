@@ -0,0 +1,174 @@
+#include "timerwheel.h"
+
+TimerWheel::TimerWheel(quint64 now)
+    : m_slots(kLevels * kSlots, -1)
+    , m_now(now)
+    , m_size(0)
+{
+}
+
+void TimerWheel::schedule(ClientHandle handle, quint64 expiry)
+{
+    if (handle == ClientTable::InvalidHandle) {
+        return;
+    }
+
+    const int index = int(handle & kIndexMask);
+    if (index >= m_nodes.size()) {
+        Node empty;
+        empty.handle = ClientTable::InvalidHandle;
+        empty.expiry = 0;
+        empty.slot = -1;
+        empty.prev = -1;
+        empty.next = -1;
+        const int oldSize = m_nodes.size();
+        m_nodes.resize(qMax(index + 1, oldSize * 2));
+        for (int i = oldSize; i < m_nodes.size(); ++i) {
+            m_nodes[i] = empty;
+        }
+    }
+
+    // 槽位被新句柄复用时，旧句柄的条目直接被替换
+    Node& node = m_nodes[index];
+    if (node.handle != ClientTable::InvalidHandle) {
+        unlink(index);
+        --m_size;
+    }
+
+    // 当前节拍的槽已经处理过，最早只能在下一个节拍到期
+    node.handle = handle;
+    node.expiry = qBound(m_now + 1, expiry, m_now + kMaxDelay);
+    link(index);
+    ++m_size;
+}
+
+bool TimerWheel::cancel(ClientHandle handle)
+{
+    const int index = find(handle);
+    if (index < 0) {
+        return false;
+    }
+
+    unlink(index);
+    m_nodes[index].handle = ClientTable::InvalidHandle;
+    --m_size;
+    return true;
+}
+
+bool TimerWheel::contains(ClientHandle handle) const
+{
+    return find(handle) >= 0;
+}
+
+quint64 TimerWheel::expiry(ClientHandle handle) const
+{
+    const int index = find(handle);
+    return index < 0 ? 0 : m_nodes.at(index).expiry;
+}
+
+void TimerWheel::advance(quint64 now, QVector<ClientHandle>* expired)
+{
+    while (m_now < now) {
+        // 没有登记的条目时直接跳到目标节拍，空闲的时间轮推进没有开销
+        if (m_size == 0) {
+            m_now = now;
+            return;
+        }
+
+        ++m_now;
+
+        // 进入第 n 层的一个新槽时，把它的条目放入低层；低位回绕到0时才需要检查更高一层
+        for (int level = 1; level < kLevels; ++level) {
+            if ((m_now >> (kSlotBits * (level - 1))) & kSlotMask) {
+                break;
+            }
+            cascade(level, int((m_now >> (kSlotBits * level)) & kSlotMask));
+        }
+
+        // 第0层当前槽中的条目都在这个节拍到期
+        int& head = m_slots[int(m_now & kSlotMask)];
+        while (head >= 0) {
+            const int index = head;
+            Node& node = m_nodes[index];
+            head = node.next;
+            expired->append(node.handle);
+            node.handle = ClientTable::InvalidHandle;
+            node.slot = -1;
+            --m_size;
+        }
+    }
+}
+
+quint64 TimerWheel::now() const
+{
+    return m_now;
+}
+
+int TimerWheel::size() const
+{
+    return m_size;
+}
+
+bool TimerWheel::isEmpty() const
+{
+    return m_size == 0;
+}
+
+void TimerWheel::link(int index)
+{
+    Node& node = m_nodes[index];
+
+    // 距离到期不足 64^(n+1) 个节拍的条目放在第 n 层，槽号是到期节拍在该层的位
+    const quint64 delta = node.expiry > m_now ? node.expiry - m_now : 0;
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (quint64(1) << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+
+    const int slot = level * kSlots + int((node.expiry >> (kSlotBits * level)) & kSlotMask);
+    node.slot = slot;
+    node.prev = -1;
+    node.next = m_slots.at(slot);
+    if (node.next >= 0) {
+        m_nodes[node.next].prev = index;
+    }
+    m_slots[slot] = index;
+}
+
+void TimerWheel::unlink(int index)
+{
+    Node& node = m_nodes[index];
+    if (node.prev >= 0) {
+        m_nodes[node.prev].next = node.next;
+    } else {
+        m_slots[node.slot] = node.next;
+    }
+    if (node.next >= 0) {
+        m_nodes[node.next].prev = node.prev;
+    }
+    node.slot = -1;
+    node.prev = -1;
+    node.next = -1;
+}
+
+void TimerWheel::cascade(int level, int slot)
+{
+    // 先摘下整个槽，条目到期的节拍不晚于本层一个槽的跨度，都会进入更低的层
+    int index = m_slots.at(level * kSlots + slot);
+    m_slots[level * kSlots + slot] = -1;
+    while (index >= 0) {
+        const int next = m_nodes.at(index).next;
+        link(index);
+        index = next;
+    }
+}
+
+int TimerWheel::find(ClientHandle handle) const
+{
+    if (handle == ClientTable::InvalidHandle) {
+        return -1;
+    }
+
+    const int index = int(handle & kIndexMask);
+    return index < m_nodes.size() && m_nodes.at(index).handle == handle ? index : -1;
+}
@@ -1,5 +1,7 @@
 #include "topic.h"
 
+#include <QStringList>
+
 Topic::Topic()
 {
 }
@@ -59,3 +61,53 @@ bool Topic::operator!=(const Topic& other) const
 {
     return !(*this == other);
 }
+
+bool Topic::isWildcard(const QString& pattern)
+{
+    return pattern.contains(QLatin1Char('+')) || pattern.contains(QLatin1Char('#'));
+}
+
+bool Topic::isValidPattern(const QString& pattern)
+{
+    if (pattern.isEmpty()) {
+        return false;
+    }
+
+    const QStringList levels = pattern.split(QLatin1Char('/'));
+    for (int i = 0; i < levels.size(); ++i) {
+        const QString& level = levels.at(i);
+        if (level.size() > 1 && (level.contains(QLatin1Char('+')) || level.contains(QLatin1Char('#')))) {
+            return false;
+        }
+        if (level == QLatin1String("#") && i != levels.size() - 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Topic::matches(const QString& pattern, const QString& topicName)
+{
+    const QStringList patternLevels = pattern.split(QLatin1Char('/'));
+    const QStringList topicLevels = topicName.split(QLatin1Char('/'));
+
+    // 以 '$' 开头的主题不会被首层通配符匹配
+    if (topicName.startsWith(QLatin1Char('$'))
+            && (patternLevels.first() == QLatin1String("+") || patternLevels.first() == QLatin1String("#"))) {
+        return false;
+    }
+
+    for (int i = 0; i < patternLevels.size(); ++i) {
+        const QString& level = patternLevels.at(i);
+        if (level == QLatin1String("#")) {
+            return true;
+        }
+        if (i >= topicLevels.size()) {
+            return false;
+        }
+        if (level != QLatin1String("+") && level != topicLevels.at(i)) {
+            return false;
+        }
+    }
+    return patternLevels.size() == topicLevels.size();
+}
@@ -0,0 +1,73 @@
+#include "topicregistry.h"
+
+TopicRegistry::TopicRegistry()
+    : m_maxSize(0)
+{
+}
+
+TopicId TopicRegistry::intern(const QString& topic)
+{
+    if (topic.isEmpty()) {
+        return InvalidTopic;
+    }
+
+    {
+        QReadLocker locker(&m_lock);
+        auto it = m_ids.constFind(topic);
+        if (it != m_ids.constEnd()) {
+            return it.value();
+        }
+    }
+
+    // 加写锁后再查一次，其他线程可能已经驻留了同一主题
+    QWriteLocker locker(&m_lock);
+    auto it = m_ids.constFind(topic);
+    if (it != m_ids.constEnd()) {
+        return it.value();
+    }
+
+    // 驻留表已满：编号不回收，继续分配会让按编号索引的表无限增长
+    if (m_maxSize > 0 && m_names.size() >= m_maxSize) {
+        return InvalidTopic;
+    }
+
+    // 深拷贝一份，不引用调用方（可能是接收缓冲区解码出的临时字符串）的数据
+    const QString key(topic.constData(), topic.size());
+    m_names.append(key);
+    const TopicId id = TopicId(m_names.size());
+    m_ids.insert(key, id);
+    return id;
+}
+
+TopicId TopicRegistry::find(const QString& topic) const
+{
+    QReadLocker locker(&m_lock);
+    return m_ids.value(topic, TopicId(InvalidTopic));
+}
+
+QString TopicRegistry::name(TopicId id) const
+{
+    QReadLocker locker(&m_lock);
+    if (id == InvalidTopic || id > TopicId(m_names.size())) {
+        return QString();
+    }
+    return m_names.at(int(id) - 1);
+}
+
+int TopicRegistry::size() const
+{
+    QReadLocker locker(&m_lock);
+    return m_names.size();
+}
+
+void TopicRegistry::setMaxSize(int maxSize)
+{
+    QWriteLocker locker(&m_lock);
+    m_maxSize = qMax(0, maxSize);
+}
+
+int TopicRegistry::maxSize() const
+{
+    QReadLocker locker(&m_lock);
+    return m_maxSize;
+}
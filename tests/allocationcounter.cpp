@@ -0,0 +1,67 @@
+#include "allocationcounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// 计数分配器：替换全局 operator new，只在统计期间计数
+std::atomic<bool> g_countAllocations(false);
+std::atomic<qint64> g_allocationCount(0);
+
+} // namespace
+
+AllocationCounter::AllocationCounter()
+{
+    g_allocationCount.store(0);
+    g_countAllocations.store(true);
+}
+
+AllocationCounter::~AllocationCounter()
+{
+    g_countAllocations.store(false);
+}
+
+qint64 AllocationCounter::count() const
+{
+    return g_allocationCount.load();
+}
+
+void* operator new(std::size_t size)
+{
+    if (g_countAllocations.load(std::memory_order_relaxed)) {
+        g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
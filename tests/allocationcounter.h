@@ -0,0 +1,32 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+/**
+ * @brief 在作用域内统计堆分配次数
+ *
+ * 链接 allocationcounter.cpp 的程序使用替换后的全局 operator new，
+ * 只有存在 AllocationCounter 对象期间才计数，同一时间只能有一个。
+ */
+class AllocationCounter
+{
+public:
+    /**
+     * @brief 构造函数，清零并开始计数
+     */
+    AllocationCounter();
+
+    /**
+     * @brief 析构函数，停止计数
+     */
+    ~AllocationCounter();
+
+    /**
+     * @brief 获取开始计数以来的分配次数
+     * @return 次数
+     */
+    qint64 count() const;
+};
+
+#endif // ALLOCATIONCOUNTER_H
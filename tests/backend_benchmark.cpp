@@ -0,0 +1,368 @@
+#include <QtTest>
+#include "broker.h"
+#include "epollpoller.h"
+#include "nativesocket.h"
+#include "message.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+/**
+ * @brief Qt 后端与 epoll 后端在大量连接下的对比基准测试（仅 Linux）
+ *
+ * 客户端线程用非阻塞套接字和 epoll 模拟大量订阅者，Broker 的监听套接字在主线程接受连接。
+ * 每行报告两项：
+ * - 延迟：其余连接都空闲时，一个发布者经过Broker到一个订阅者的往返分位数，
+ *   反映每次I/O事件的固定开销（Qt 事件分发器每轮事件循环都要遍历所有套接字通知器）；
+ * - 扇出：每条消息发给所有订阅者，报告每秒投递的消息数。
+ */
+class BackendBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void reportBackends_data();
+    void reportBackends();
+
+private:
+    /**
+     * @brief 客户端线程的测量结果
+     */
+    struct LoadResult {
+        QString error;                  ///< 出错原因，成功时为空
+        std::vector<qint64> latencies;  ///< 每次往返的纳秒数
+        qint64 deliveries = 0;          ///< 扇出阶段投递的消息数
+        qint64 fanoutNs = 0;            ///< 扇出阶段用时（纳秒）
+    };
+
+    /**
+     * @brief 把打开文件数的软限制提高到需要的数量
+     * @param required 需要的描述符数量
+     * @return 是否满足
+     */
+    static bool raiseDescriptorLimit(int required);
+
+    /**
+     * @brief 客户端线程：建立连接并依次测量延迟和扇出
+     * @param connections 扇出订阅者的连接数
+     * @param result 测量结果
+     */
+    static void runClients(int connections, LoadResult* result);
+};
+
+static const int kBenchmarkPort = 5562;
+static const char* const kServerName = "BackendBenchmark";
+static const char* const kFanoutTopic = "bench/backend/fanout";
+static const char* const kLatencyTopic = "bench/backend/latency";
+
+namespace {
+
+int connectSocket()
+{
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(kBenchmarkPort);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool sendAll(int fd, const QByteArray& data)
+{
+    qint64 offset = 0;
+    while (offset < data.size()) {
+        const ssize_t sent = ::send(fd, data.constData() + offset, size_t(data.size() - offset), MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        offset += sent;
+    }
+    return true;
+}
+
+bool waitForClients(int count)
+{
+    // 监听套接字在主线程接受连接，这里只等待
+    QElapsedTimer timer;
+    timer.start();
+    while (Broker::instance()->clientCount() < count) {
+        if (timer.elapsed() > 10000) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+}
+
+void BackendBenchmark::initTestCase()
+{
+    Logger::instance()->init("backend_benchmark.log", Logger::WARNING);
+}
+
+void BackendBenchmark::cleanupTestCase()
+{
+    Broker::forceCleanup();
+}
+
+bool BackendBenchmark::raiseDescriptorLimit(int required)
+{
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return false;
+    }
+    if (limit.rlim_cur >= rlim_t(required)) {
+        return true;
+    }
+    if (limit.rlim_max < rlim_t(required)) {
+        return false;
+    }
+    limit.rlim_cur = rlim_t(required);
+    return setrlimit(RLIMIT_NOFILE, &limit) == 0;
+}
+
+void BackendBenchmark::runClients(int connections, LoadResult* result)
+{
+    EpollPoller poller;
+    std::vector<NativeSocket*> subscribers;
+    int publisher = -1;
+    NativeSocket* latencySocket = nullptr;
+    auto cleanup = [&]() {
+        for (NativeSocket* socket : subscribers) {
+            delete socket;
+        }
+        delete latencySocket;
+        if (publisher >= 0) {
+            ::close(publisher);
+        }
+    };
+
+    // 分批连接，每批等Broker接受后再继续，避免监听队列溢出后客户端等待SYN重传
+    const QByteArray subscribe = Message("$SYS/REGISTER", "SUBSCRIBER").serialize()
+                                 + Message("$SYS/SUBSCRIBE", kFanoutTopic).serialize();
+    for (int i = 0; i < connections; ++i) {
+        const int fd = connectSocket();
+        if (fd < 0 || !sendAll(fd, subscribe)) {
+            result->error = QString("Failed to connect subscriber %1").arg(i);
+            cleanup();
+            return;
+        }
+        subscribers.push_back(new NativeSocket(fd));
+        poller.add(fd, quint64(i));
+        if ((i + 1) % 32 == 0 && !waitForClients(i + 1)) {
+            result->error = "Broker did not accept connections";
+            cleanup();
+            return;
+        }
+    }
+
+    publisher = connectSocket();
+    const int latencyFd = connectSocket();
+    if (publisher < 0 || latencyFd < 0
+        || !sendAll(publisher, Message("$SYS/REGISTER", "PUBLISHER").serialize())
+        || !sendAll(latencyFd, Message("$SYS/REGISTER", "SUBSCRIBER").serialize()
+                                   + Message("$SYS/SUBSCRIBE", kLatencyTopic).serialize())) {
+        result->error = "Failed to connect publisher";
+        cleanup();
+        return;
+    }
+    latencySocket = new NativeSocket(latencyFd);
+    if (!waitForClients(connections + 2)) {
+        result->error = "Broker did not accept connections";
+        cleanup();
+        return;
+    }
+
+    // 读出所有就绪订阅者的数据，只统计字节数
+    std::vector<qint64> received(connections, 0);
+    char buffer[64 * 1024];
+    auto drain = [&](int timeoutMs) -> qint64 {
+        pollfd ready = { poller.descriptor(), POLLIN, 0 };
+        qint64 total = 0;
+        if (::poll(&ready, 1, timeoutMs) <= 0) {
+            return total;
+        }
+        EpollPoller::Event events[256];
+        const int count = poller.poll(events, 256);
+        for (int i = 0; i < count; ++i) {
+            const int index = int(events[i].token);
+            for (qint64 bytes = subscribers[index]->read(buffer, sizeof(buffer)); bytes > 0;
+                 bytes = subscribers[index]->read(buffer, sizeof(buffer))) {
+                received[index] += bytes;
+                total += bytes;
+            }
+        }
+        return total;
+    };
+    auto allReceived = [&](qint64 target) {
+        return std::all_of(received.begin(), received.end(), [target](qint64 bytes) { return bytes >= target; });
+    };
+
+    // 订阅请求可能还没处理完：每隔一段时间发一条预热消息，直到所有订阅者都收到
+    const QByteArray fanoutFrame = Message(kFanoutTopic, QByteArray(64, 'x')).serialize();
+    QElapsedTimer timer;
+    QElapsedTimer sinceSend;
+    timer.start();
+    while (!allReceived(1)) {
+        if (timer.elapsed() > 20000) {
+            result->error = "Subscriptions were not established";
+            cleanup();
+            return;
+        }
+        if (!sinceSend.isValid() || sinceSend.elapsed() > 100) {
+            sendAll(publisher, fanoutFrame);
+            sinceSend.start();
+        }
+        drain(10);
+    }
+    while (drain(200) > 0) {
+    }
+
+    // 再发一条，得到投递给订阅者的帧长度（Broker会写入序号）
+    std::fill(received.begin(), received.end(), 0);
+    sendAll(publisher, fanoutFrame);
+    timer.restart();
+    while (!allReceived(1) && timer.elapsed() < 10000) {
+        drain(50);
+    }
+    while (drain(100) > 0) {
+    }
+    const qint64 frameSize = received[0];
+    if (frameSize == 0) {
+        result->error = "Fan-out message was not delivered";
+        cleanup();
+        return;
+    }
+
+    // 延迟：其余连接空闲，只有一个订阅者收消息
+    const QByteArray latencyFrame = Message(kLatencyTopic, QByteArray(64, 'x')).serialize();
+    const int warmup = 200;
+    const int rounds = 2000;
+    qint64 latencyFrameSize = 0;
+    result->latencies.reserve(rounds);
+    for (int i = 0; i < warmup + rounds; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        sendAll(publisher, latencyFrame);
+        qint64 bytes = 0;
+        do {
+            pollfd ready = { latencySocket->descriptor(), POLLIN, 0 };
+            if (::poll(&ready, 1, 5000) <= 0) {
+                result->error = "Latency message was not delivered";
+                cleanup();
+                return;
+            }
+            bytes += qMax<qint64>(0, latencySocket->read(buffer, sizeof(buffer)));
+        } while (bytes < latencyFrameSize || bytes == 0);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        // 第一轮得到帧长度，回环上一个小帧总是一次到达
+        if (latencyFrameSize == 0) {
+            latencyFrameSize = bytes;
+        }
+        if (i >= warmup) {
+            result->latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+    // 扇出：一次写出所有消息，等每个订阅者都收齐
+    const int messages = 20;
+    QByteArray batch;
+    for (int i = 0; i < messages; ++i) {
+        batch.append(fanoutFrame);
+    }
+    std::fill(received.begin(), received.end(), 0);
+    const auto start = std::chrono::steady_clock::now();
+    sendAll(publisher, batch);
+    timer.restart();
+    while (!allReceived(messages * frameSize) && timer.elapsed() < 30000) {
+        drain(100);
+    }
+    result->fanoutNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start).count();
+    for (qint64 bytes : received) {
+        result->deliveries += bytes / frameSize;
+    }
+    if (result->deliveries != qint64(messages) * connections) {
+        result->error = QString("Delivered %1 of %2 messages").arg(result->deliveries).arg(qint64(messages) * connections);
+    }
+
+    cleanup();
+}
+
+void BackendBenchmark::reportBackends_data()
+{
+    QTest::addColumn<int>("backend");
+    QTest::addColumn<int>("connections");
+
+    QTest::newRow("Qt, 1000 connections") << int(Broker::QtBackend) << 1000;
+    QTest::newRow("epoll, 1000 connections") << int(Broker::EpollBackend) << 1000;
+    QTest::newRow("Qt, 10000 connections") << int(Broker::QtBackend) << 10000;
+    QTest::newRow("epoll, 10000 connections") << int(Broker::EpollBackend) << 10000;
+}
+
+void BackendBenchmark::reportBackends()
+{
+    QFETCH(int, backend);
+    QFETCH(int, connections);
+
+    // 客户端和Broker在同一进程，每个连接占用两个描述符
+    if (!raiseDescriptorLimit(2 * connections + 256)) {
+        QSKIP("Open file limit is too low for this many connections");
+    }
+
+    Broker::forceCleanup();
+    QVERIFY(Broker::instance()->start(kBenchmarkPort, kServerName, Broker::IoBackend(backend)));
+    QCOMPARE(int(Broker::instance()->ioBackend()), backend);
+    Broker::instance()->setCacheSize(0);
+
+    // 客户端线程负责全部测量，主线程运行事件循环接受连接
+    LoadResult result;
+    std::atomic<bool> done(false);
+    std::thread clients([&result, &done, connections]() {
+        runClients(connections, &result);
+        done.store(true);
+    });
+    while (!done.load()) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    clients.join();
+
+    QVERIFY2(result.error.isEmpty(), qPrintable(result.error));
+
+    std::vector<qint64>& samples = result.latencies;
+    std::sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+    qInfo("%s: idle-connection round trip p50 %.1f us, p99 %.1f us; fan-out %.0f deliveries/s",
+          QTest::currentDataTag(), samples[n / 2] / 1000.0, samples[n * 99 / 100] / 1000.0,
+          result.deliveries * 1e9 / qMax<qint64>(1, result.fanoutNs));
+
+    Broker::forceCleanup();
+}
+
+QTEST_MAIN(BackendBenchmark)
+#include "backend_benchmark.moc"
@@ -0,0 +1,386 @@
+#include <QtTest>
+#include <QTcpSocket>
+#include "broker.h"
+#include "publisher.h"
+#include "logger.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Broker扇出基准测试
+ *
+ * 使用原始TCP套接字作为订阅者，只统计收到的字节数，
+ * 这样测得的时间主要是Broker编码和写套接字的开销，而不包含订阅端的解码。
+ * reportThreadScaling 在不同I/O线程数下运行相同的负载，输出每秒送达的消息数。
+ * reportPublishThroughput 比较逐条发布、批量发布和逗留批量模式下小消息的端到端吞吐量，
+ * 以及开启发布确认（流水线在途窗口）后的吞吐量。
+ */
+class BrokerBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void benchmarkFanOut_data();
+    void benchmarkFanOut();
+    void reportPublishThroughput_data();
+    void reportPublishThroughput();
+    void reportThreadScaling_data();
+    void reportThreadScaling();
+
+private:
+    /**
+     * @brief 等待直到所有订阅者累计收到指定字节数
+     * @param target 目标字节数
+     * @param timeout 超时时间（毫秒）
+     * @return 是否在超时前收到
+     */
+    bool waitForBytes(qint64 target, int timeout = 5000);
+
+    /**
+     * @brief 客户端负载线程：一个发布者和若干订阅者，使用阻塞套接字，不依赖事件循环
+     * @param topic 发布和订阅的主题
+     * @param subscriberCount 订阅者数量
+     * @param messageCount 发布的消息数量
+     * @param ready 连接和订阅完成后加一
+     * @param go 为 true 后开始发布
+     * @param delivered 累计送达的消息数量
+     */
+    static void runClientLoad(const QString& topic, int subscriberCount, int messageCount,
+                              std::atomic<int>* ready, std::atomic<bool>* go,
+                              std::atomic<qint64>* delivered);
+
+private:
+    qint64 m_bytesReceived;
+};
+
+static const int kBenchmarkPort = 5560;
+
+void BrokerBenchmark::initTestCase()
+{
+    // 基准测试只关心吞吐，不输出调试日志
+    Logger::instance()->init("broker_benchmark.log", Logger::WARNING);
+
+    QVERIFY(Broker::instance()->start(kBenchmarkPort, "BrokerBenchmark"));
+    Broker::instance()->setCacheSize(0);
+}
+
+void BrokerBenchmark::cleanupTestCase()
+{
+    Broker::forceCleanup();
+}
+
+bool BrokerBenchmark::waitForBytes(qint64 target, int timeout)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (m_bytesReceived < target) {
+        if (timer.elapsed() > timeout) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    return true;
+}
+
+void BrokerBenchmark::benchmarkFanOut_data()
+{
+    QTest::addColumn<int>("subscriberCount");
+    QTest::addColumn<int>("payloadSize");
+
+    QTest::newRow("10 subscribers, 16B") << 10 << 16;
+    QTest::newRow("100 subscribers, 16B") << 100 << 16;
+    QTest::newRow("400 subscribers, 16B") << 400 << 16;
+    QTest::newRow("400 subscribers, 4KB") << 400 << 4096;
+}
+
+void BrokerBenchmark::benchmarkFanOut()
+{
+    QFETCH(int, subscriberCount);
+    QFETCH(int, payloadSize);
+
+    const QString topic = QString("bench/fanout/%1/%2").arg(subscriberCount).arg(payloadSize);
+    m_bytesReceived = 0;
+
+    // 建立原始TCP订阅者
+    QList<QTcpSocket*> subscribers;
+    for (int i = 0; i < subscriberCount; ++i) {
+        QTcpSocket* socket = new QTcpSocket(this);
+        connect(socket, &QTcpSocket::readyRead, [this, socket]() {
+            m_bytesReceived += socket->readAll().size();
+        });
+        socket->connectToHost("localhost", kBenchmarkPort);
+        QVERIFY(socket->waitForConnected(1000));
+
+        socket->write(Message("$SYS/REGISTER", "SUBSCRIBER").serialize());
+        socket->write(Message("$SYS/SUBSCRIBE", topic.toUtf8()).serialize());
+        socket->flush();
+        subscribers.append(socket);
+    }
+
+    // 等待Broker处理完所有订阅请求
+    QTest::qWait(200);
+
+    Publisher publisher;
+    QVERIFY(publisher.connectToBroker("localhost", kBenchmarkPort));
+    QTest::qWait(100);
+
+    const QByteArray payload(payloadSize, 'x');
+
+    // 预热一次，同时得到每条消息扇出后的总字节数
+    QVERIFY(publisher.publish(topic, payload));
+    QVERIFY(waitForBytes(1));
+    QTest::qWait(100);
+    const qint64 bytesPerFanOut = m_bytesReceived;
+    QVERIFY(bytesPerFanOut > 0);
+
+    QBENCHMARK {
+        const qint64 target = m_bytesReceived + bytesPerFanOut;
+        publisher.publish(topic, payload);
+        QVERIFY(waitForBytes(target));
+    }
+
+    publisher.disconnectFromBroker();
+    qDeleteAll(subscribers);
+    QTest::qWait(100);
+}
+
+void BrokerBenchmark::reportPublishThroughput_data()
+{
+    QTest::addColumn<int>("batchSize");
+    QTest::addColumn<bool>("linger");
+    QTest::addColumn<int>("maxInFlight");
+
+    QTest::newRow("publish(), one write per message") << 1 << false << 0;
+    QTest::newRow("publishBatch(), 64 messages") << 64 << false << 0;
+    QTest::newRow("publishBatch(), 512 messages") << 512 << false << 0;
+    QTest::newRow("linger 1 ms, up to 256 messages") << 256 << true << 0;
+    QTest::newRow("publish(), confirms, window 1024") << 1 << false << 1024;
+    QTest::newRow("linger 1 ms, up to 256 messages, confirms, window 4096") << 256 << true << 4096;
+}
+
+void BrokerBenchmark::reportPublishThroughput()
+{
+    QFETCH(int, batchSize);
+    QFETCH(bool, linger);
+    QFETCH(int, maxInFlight);
+
+    const QString topic = QString("bench/publish/%1/%2/%3").arg(batchSize).arg(linger).arg(maxInFlight);
+    const int messageCount = 100000;
+    const QByteArray payload(16, 'x');
+    m_bytesReceived = 0;
+
+    // 订阅者读取跟不上发布时不丢消息，吞吐量只取决于发布路径
+    Broker::instance()->setOutboundQueueLimits(messageCount * 2, 256 * 1024 * 1024);
+
+    // 一个原始TCP订阅者，只统计字节数
+    QTcpSocket subscriber;
+    connect(&subscriber, &QTcpSocket::readyRead, [this, &subscriber]() {
+        m_bytesReceived += subscriber.readAll().size();
+    });
+    subscriber.connectToHost("localhost", kBenchmarkPort);
+    QVERIFY(subscriber.waitForConnected(1000));
+    subscriber.write(Message("$SYS/HELLO", QByteArray::number(Message::ProtocolV2)).serialize());
+    subscriber.write(Message("$SYS/REGISTER", "SUBSCRIBER").serialize());
+    subscriber.write(Message("$SYS/SUBSCRIBE", topic.toUtf8()).serialize());
+    subscriber.flush();
+
+    Publisher publisher;
+    publisher.setConfirmsEnabled(maxInFlight > 0, qMax(1, maxInFlight));
+    QVERIFY(publisher.connectToBroker("localhost", kBenchmarkPort));
+    QTest::qWait(200);
+
+    // 预热一条，得到每条消息送达的字节数（帧大小固定）
+    const qint64 baseline = m_bytesReceived;
+    QVERIFY(publisher.publish(topic, payload));
+    QVERIFY(waitForBytes(baseline + 1));
+    QTest::qWait(100);
+    const qint64 bytesPerMessage = m_bytesReceived - baseline;
+    QVERIFY(bytesPerMessage > 0);
+
+    const qint64 target = m_bytesReceived + bytesPerMessage * messageCount;
+    QElapsedTimer timer;
+    timer.start();
+
+    // 发布期间定期运行事件循环，让订阅者边收边读
+    if (linger) {
+        publisher.setBatching(batchSize, 1);
+        for (int i = 0; i < messageCount; ++i) {
+            publisher.publish(topic, payload);
+            if (i % batchSize == 0) {
+                QCoreApplication::processEvents();
+            }
+        }
+        publisher.flushBatch();
+    } else if (batchSize > 1) {
+        QVector<Message> batch;
+        batch.reserve(batchSize);
+        for (int sent = 0; sent < messageCount; sent += batchSize) {
+            batch.clear();
+            for (int i = 0; i < batchSize && sent + i < messageCount; ++i) {
+                batch.append(Message(topic, payload));
+            }
+            publisher.publishBatch(batch);
+            QCoreApplication::processEvents();
+        }
+    } else {
+        for (int i = 0; i < messageCount; ++i) {
+            publisher.publish(topic, payload);
+            if (i % 64 == 0) {
+                QCoreApplication::processEvents();
+            }
+        }
+    }
+
+    QVERIFY(waitForBytes(target, 30000));
+    if (maxInFlight > 0) {
+        QTRY_COMPARE_WITH_TIMEOUT(publisher.inFlightCount(), 0, 5000);
+    }
+    const qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+    qInfo("%s: %.0f msgs/s end to end, %d B payload",
+          QTest::currentDataTag(), messageCount * 1000.0 / elapsed, int(payload.size()));
+
+    publisher.disconnectFromBroker();
+    Broker::instance()->setOutboundQueueLimits(10000, 16 * 1024 * 1024);
+    QTest::qWait(100);
+}
+
+void BrokerBenchmark::runClientLoad(const QString& topic, int subscriberCount, int messageCount,
+                                    std::atomic<int>* ready, std::atomic<bool>* go,
+                                    std::atomic<qint64>* delivered)
+{
+    QTcpSocket publisher;
+    QList<QTcpSocket*> subscribers;
+
+    publisher.connectToHost("localhost", kBenchmarkPort);
+    publisher.waitForConnected(2000);
+    publisher.write(Message("$SYS/REGISTER", "PUBLISHER").serialize());
+    publisher.waitForBytesWritten(1000);
+
+    for (int i = 0; i < subscriberCount; ++i) {
+        QTcpSocket* socket = new QTcpSocket();
+        socket->connectToHost("localhost", kBenchmarkPort);
+        socket->waitForConnected(2000);
+        socket->write(Message("$SYS/REGISTER", "SUBSCRIBER").serialize());
+        socket->write(Message("$SYS/SUBSCRIBE", topic.toUtf8()).serialize());
+        socket->waitForBytesWritten(1000);
+        subscribers.append(socket);
+    }
+
+    // 每次写出一批预先编码好的帧
+    const QByteArray frame = Message(topic, QByteArray(64, 'x')).serialize();
+    const int batchSize = 64;
+    QByteArray batch;
+    for (int i = 0; i < batchSize; ++i) {
+        batch.append(frame);
+    }
+
+    ready->fetch_add(1);
+    while (!go->load()) {
+        QThread::msleep(1);
+    }
+
+    // 订阅者只统计字节数，边发边读，避免套接字缓冲区写满
+    const qint64 target = qint64(messageCount) * frame.size();
+    QVector<qint64> received(subscriberCount, 0);
+    auto drain = [&](int timeout) {
+        for (int i = 0; i < subscriberCount; ++i) {
+            if (received[i] < target && subscribers[i]->waitForReadyRead(timeout)) {
+                const qint64 bytes = subscribers[i]->readAll().size();
+                received[i] += bytes;
+                delivered->fetch_add(bytes / frame.size());
+            }
+        }
+    };
+
+    for (int sent = 0; sent < messageCount; sent += batchSize) {
+        publisher.write(batch);
+        publisher.waitForBytesWritten(1000);
+        drain(0);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < 10000) {
+        bool done = true;
+        for (qint64 bytes : received) {
+            done = done && bytes >= target;
+        }
+        if (done) {
+            break;
+        }
+        drain(5);
+    }
+
+    qDeleteAll(subscribers);
+}
+
+void BrokerBenchmark::reportThreadScaling_data()
+{
+    QTest::addColumn<int>("ioThreads");
+
+    QTest::newRow("1 I/O thread") << 1;
+    QTest::newRow("2 I/O threads") << 2;
+    QTest::newRow("4 I/O threads") << 4;
+    QTest::newRow("8 I/O threads") << 8;
+}
+
+void BrokerBenchmark::reportThreadScaling()
+{
+    QFETCH(int, ioThreads);
+
+    // 每行使用新的I/O线程数重启Broker
+    Broker::forceCleanup();
+    Broker::instance()->setIoThreadCount(ioThreads);
+    QVERIFY(Broker::instance()->start(kBenchmarkPort, "BrokerBenchmark"));
+    Broker::instance()->setCacheSize(0);
+
+    // 固定负载：16个客户端线程，每个线程一个主题、1个发布者和4个订阅者
+    const int clientThreads = 16;
+    const int subscribersPerTopic = 4;
+    const int messagesPerPublisher = 64 * 320; // 发布者每批写64条
+
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::atomic<qint64> delivered(0);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clientThreads; ++i) {
+        const QString topic = QString("bench/scaling/%1").arg(i);
+        threads.emplace_back(&BrokerBenchmark::runClientLoad, topic, subscribersPerTopic,
+                             messagesPerPublisher, &ready, &go, &delivered);
+    }
+
+    // 监听套接字在主线程接受连接，等待期间需要运行事件循环
+    QElapsedTimer setupTimer;
+    setupTimer.start();
+    while (ready.load() < clientThreads && setupTimer.elapsed() < 10000) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    QTest::qWait(200);
+
+    const qint64 expected = qint64(clientThreads) * subscribersPerTopic * messagesPerPublisher;
+    QElapsedTimer timer;
+    timer.start();
+    go.store(true);
+
+    while (delivered.load() < expected && timer.elapsed() < 20000) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    const qint64 elapsed = qMax<qint64>(1, timer.elapsed());
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    qInfo("%d I/O threads: %lld/%lld messages delivered in %lld ms, %.0f msgs/s",
+          ioThreads, (long long)delivered.load(), (long long)expected, (long long)elapsed,
+          delivered.load() * 1000.0 / elapsed);
+    QCOMPARE(delivered.load(), expected);
+}
+
+QTEST_MAIN(BrokerBenchmark)
+#include "broker_benchmark.moc"
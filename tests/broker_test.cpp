@@ -1,5 +1,7 @@
 #include <QtTest>
 #include "broker.h"
+#include "publisher.h"
+#include "subscriber.h"
 #include "logger.h"
 
 class BrokerTest : public QObject
@@ -12,6 +14,13 @@ private slots:
     void testSingleton();
     void testStartStop();
     void testCacheSize();
+    void testIdleTimeout();
+    void testMultipleIoThreads();
+    void testSubscribeWhilePublishing();
+    void testReplayBeyondOutboundQueue();
+    void testEpollPublishSubscribe();
+    void testEpollSlowConsumer();
+    void testEpollDisconnect();
 };
 
 void BrokerTest::initTestCase()
@@ -71,5 +80,309 @@ void BrokerTest::testCacheSize()
     broker->clearCache();
 }
 
+void BrokerTest::testIdleTimeout()
+{
+    Broker* broker = Broker::instance();
+    QCOMPARE(broker->idleTimeout(), 60);
+    QVERIFY(broker->start(5556, "TestBroker"));
+
+    // 一个连接把自己的空闲超时设为1秒，另一个使用默认的60秒
+    QTcpSocket idle;
+    QTcpSocket active;
+    idle.connectToHost("127.0.0.1", 5556);
+    active.connectToHost("127.0.0.1", 5556);
+    QVERIFY(idle.waitForConnected(3000));
+    QVERIFY(active.waitForConnected(3000));
+    idle.write(Message("$SYS/IDLETIMEOUT", "1").serialize());
+    QVERIFY(idle.waitForBytesWritten(3000));
+
+    // 节拍每秒推进一次，1秒的超时最迟在3秒内断开
+    QTRY_COMPARE_WITH_TIMEOUT(idle.state(), QAbstractSocket::UnconnectedState, 5000);
+    QCOMPARE(active.state(), QAbstractSocket::ConnectedState);
+    QTRY_COMPARE(broker->clientCount(), 1);
+
+    active.disconnectFromHost();
+    broker->stop();
+    QTest::qWait(100);
+}
+
+void BrokerTest::testMultipleIoThreads()
+{
+    Broker* broker = Broker::instance();
+    const int threads = broker->ioThreadCount();
+    const Broker::DispatchPolicy policy = broker->dispatchPolicy();
+    broker->setIoThreadCount(4);
+    broker->setDispatchPolicy(Broker::RoundRobin);
+    QVERIFY(broker->start(5556, "TestBroker"));
+    QCOMPARE(broker->ioThreadCount(), 4);
+
+    // 轮询分配下前四个连接各在一个I/O线程：三个订阅者和发布者互不同线程
+    Subscriber subscribers[3];
+    for (Subscriber& subscriber : subscribers) {
+        QVERIFY(subscriber.connectToBroker("localhost", 5556));
+        QVERIFY(subscriber.subscribe("test/threads"));
+    }
+    Publisher publisher;
+    QVERIFY(publisher.connectToBroker("localhost", 5556));
+    QTRY_COMPARE(broker->clientCount(), 4);
+    QTest::qWait(100);
+
+    QSignalSpy spy0(&subscribers[0], &Subscriber::messageReceived);
+    QSignalSpy spy1(&subscribers[1], &Subscriber::messageReceived);
+    QSignalSpy spy2(&subscribers[2], &Subscriber::messageReceived);
+    QSignalSpy* spies[] = { &spy0, &spy1, &spy2 };
+    const int messageCount = 1000;
+    for (int i = 0; i < messageCount; ++i) {
+        QVERIFY(publisher.publish("test/threads", QByteArray::number(i)));
+    }
+
+    // 跨线程投递后每个订阅者恰好收到每条消息一次，并保持发布顺序
+    for (QSignalSpy* spy : spies) {
+        QTRY_COMPARE_WITH_TIMEOUT(spy->count(), messageCount, 5000);
+    }
+    QTest::qWait(200);
+    for (QSignalSpy* spy : spies) {
+        QCOMPARE(spy->count(), messageCount);
+        for (int i = 0; i < messageCount; ++i) {
+            QCOMPARE(qvariant_cast<Message>(spy->at(i).at(0)).data(), QByteArray::number(i));
+        }
+    }
+
+    for (Subscriber& subscriber : subscribers) {
+        subscriber.disconnectFromBroker();
+    }
+    publisher.disconnectFromBroker();
+    broker->stop();
+    broker->setIoThreadCount(threads);
+    broker->setDispatchPolicy(policy);
+    QTest::qWait(100);
+}
+
+void BrokerTest::testSubscribeWhilePublishing()
+{
+    Broker* broker = Broker::instance();
+    const int threads = broker->ioThreadCount();
+    const Broker::DispatchPolicy policy = broker->dispatchPolicy();
+    const int cacheSize = broker->getCacheSize();
+    broker->setIoThreadCount(2);
+    broker->setDispatchPolicy(Broker::RoundRobin);
+    QVERIFY(broker->start(5556, "TestBroker"));
+
+    // 缓存能容纳全部消息，回放加上实时投递应当恰好是完整的序列
+    const int messageCount = 10000;
+    broker->setCacheSize(messageCount);
+
+    // 发布者和订阅者在不同的I/O线程
+    Publisher publisher;
+    Subscriber subscriber;
+    QVERIFY(publisher.connectToBroker("localhost", 5556));
+    QVERIFY(subscriber.connectToBroker("localhost", 5556));
+    QTRY_COMPARE(broker->clientCount(), 2);
+
+    // 发布者的I/O线程还在路由前一半消息时订阅，回放和实时投递在某个序号处衔接
+    QSignalSpy receivedSpy(&subscriber, &Subscriber::messageReceived);
+    for (int i = 0; i < messageCount / 2; ++i) {
+        QVERIFY(publisher.publish("test/subscribe/race", QByteArray::number(i)));
+    }
+    QVERIFY(subscriber.subscribe("test/subscribe/race"));
+    for (int i = messageCount / 2; i < messageCount; ++i) {
+        QVERIFY(publisher.publish("test/subscribe/race", QByteArray::number(i)));
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(receivedSpy.count(), messageCount, 5000);
+    QTest::qWait(200);
+    QCOMPARE(receivedSpy.count(), messageCount);
+    for (int i = 0; i < messageCount; ++i) {
+        const Message received = qvariant_cast<Message>(receivedSpy.at(i).at(0));
+        QCOMPARE(received.sequence(), qint64(i));
+        QCOMPARE(received.data(), QByteArray::number(i));
+    }
+
+    subscriber.disconnectFromBroker();
+    publisher.disconnectFromBroker();
+    broker->stop();
+    broker->setCacheSize(cacheSize);
+    broker->setIoThreadCount(threads);
+    broker->setDispatchPolicy(policy);
+    QTest::qWait(100);
+}
+
+void BrokerTest::testReplayBeyondOutboundQueue()
+{
+    Broker* broker = Broker::instance();
+    const int maxMessages = broker->outboundQueueMaxMessages();
+    const qint64 maxBytes = broker->outboundQueueMaxBytes();
+    const SubscriptionOptions::OverflowPolicy policy = broker->defaultOverflowPolicy();
+    const int cacheSize = broker->getCacheSize();
+    broker->setOutboundQueueLimits(16, 1024 * 1024);
+    broker->setDefaultOverflowPolicy(SubscriptionOptions::Disconnect);
+    QVERIFY(broker->start(5556, "TestBroker"));
+
+    // 要回放的消息远多于发送队列的容量
+    const int messageCount = 2000;
+    broker->setCacheSize(messageCount);
+
+    Publisher publisher;
+    QVERIFY(publisher.connectToBroker("localhost", 5556));
+    for (int i = 0; i < messageCount; ++i) {
+        QVERIFY(publisher.publish("test/replay/paged", QByteArray::number(i)));
+    }
+    QTest::qWait(200);
+
+    // 回放按页经过发送队列，从请求的起点开始一条不少，也不会按溢出策略断开订阅者
+    Subscriber subscriber;
+    QVERIFY(subscriber.connectToBroker("localhost", 5556));
+    QSignalSpy receivedSpy(&subscriber, &Subscriber::messageReceived);
+    SubscriptionOptions options;
+    options.startPosition = SubscriptionOptions::StartFromOffset;
+    options.startValue = 0;
+    const qint64 disconnects = broker->outboundQueueStats().slowConsumerDisconnects;
+    QVERIFY(subscriber.subscribe("test/replay/paged", options));
+
+    QTRY_COMPARE_WITH_TIMEOUT(receivedSpy.count(), messageCount, 5000);
+    for (int i = 0; i < messageCount; ++i) {
+        const Message received = qvariant_cast<Message>(receivedSpy.at(i).at(0));
+        QCOMPARE(received.sequence(), qint64(i));
+        QCOMPARE(received.data(), QByteArray::number(i));
+    }
+    QCOMPARE(broker->outboundQueueStats().slowConsumerDisconnects, disconnects);
+
+    // 追上之后转为实时投递
+    QVERIFY(publisher.publish("test/replay/paged", "live"));
+    QTRY_COMPARE(receivedSpy.count(), messageCount + 1);
+    QCOMPARE(qvariant_cast<Message>(receivedSpy.last().at(0)).sequence(), qint64(messageCount));
+
+    subscriber.disconnectFromBroker();
+    publisher.disconnectFromBroker();
+    broker->stop();
+    broker->setCacheSize(cacheSize);
+    broker->setOutboundQueueLimits(maxMessages, maxBytes);
+    broker->setDefaultOverflowPolicy(policy);
+    QTest::qWait(100);
+}
+
+void BrokerTest::testEpollPublishSubscribe()
+{
+    Broker* broker = Broker::instance();
+    QVERIFY(broker->start(5556, "TestBroker", Broker::EpollBackend));
+    if (broker->ioBackend() != Broker::EpollBackend) {
+        broker->stop();
+        QSKIP("epoll backend is not available on this platform");
+    }
+
+    Publisher publisher;
+    Subscriber subscriber;
+    QVERIFY(subscriber.connectToBroker("localhost", 5556));
+    QVERIFY(publisher.connectToBroker("localhost", 5556));
+    QVERIFY(subscriber.subscribe("test/epoll/pubsub"));
+    QTRY_COMPARE(broker->clientCount(), 2);
+    QTest::qWait(100);
+
+    // 经过 epoll 后端的消息按发布顺序送达，一条不少
+    QSignalSpy receivedSpy(&subscriber, &Subscriber::messageReceived);
+    for (int i = 0; i < 100; ++i) {
+        QVERIFY(publisher.publish("test/epoll/pubsub", QByteArray::number(i)));
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(receivedSpy.count(), 100, 3000);
+    for (int i = 0; i < 100; ++i) {
+        const Message received = qvariant_cast<Message>(receivedSpy.at(i).at(0));
+        QCOMPARE(received.topic(), QString("test/epoll/pubsub"));
+        QCOMPARE(received.data(), QByteArray::number(i));
+    }
+
+    subscriber.disconnectFromBroker();
+    publisher.disconnectFromBroker();
+    broker->stop();
+    QTest::qWait(100);
+}
+
+void BrokerTest::testEpollSlowConsumer()
+{
+    Broker* broker = Broker::instance();
+    const int maxMessages = broker->outboundQueueMaxMessages();
+    const qint64 maxBytes = broker->outboundQueueMaxBytes();
+    const SubscriptionOptions::OverflowPolicy policy = broker->defaultOverflowPolicy();
+    broker->setOutboundQueueLimits(16, 1024 * 1024);
+    broker->setDefaultOverflowPolicy(SubscriptionOptions::Disconnect);
+    QVERIFY(broker->start(5556, "TestBroker", Broker::EpollBackend));
+    if (broker->ioBackend() != Broker::EpollBackend) {
+        broker->stop();
+        broker->setOutboundQueueLimits(maxMessages, maxBytes);
+        broker->setDefaultOverflowPolicy(policy);
+        QSKIP("epoll backend is not available on this platform");
+    }
+
+    // 订阅者只读满一个很小的缓冲区就不再读，内核缓冲区写满后消息在Broker的发送队列中堆积
+    QTcpSocket slow;
+    slow.setReadBufferSize(64 * 1024);
+    slow.connectToHost("127.0.0.1", 5556);
+    QVERIFY(slow.waitForConnected(3000));
+    slow.write(Message("$SYS/REGISTER", "SUBSCRIBER").serialize());
+    slow.write(Message("$SYS/SUBSCRIBE", "test/epoll/slow").serialize());
+    QVERIFY(slow.waitForBytesWritten(3000));
+
+    Publisher publisher;
+    QVERIFY(publisher.connectToBroker("localhost", 5556));
+    QTRY_COMPARE(broker->clientCount(), 2);
+    QTest::qWait(100);
+
+    // 队列超过上限时按 Disconnect 策略断开订阅者，发布者不受影响
+    const qint64 disconnects = broker->outboundQueueStats().slowConsumerDisconnects;
+    const QByteArray payload(64 * 1024, 'x');
+    for (int i = 0; i < 1024 && broker->outboundQueueStats().slowConsumerDisconnects == disconnects; ++i) {
+        QVERIFY(publisher.publish("test/epoll/slow", payload));
+        QCoreApplication::processEvents();
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(broker->outboundQueueStats().slowConsumerDisconnects, disconnects + 1, 5000);
+    QTRY_COMPARE(broker->clientCount(), 1);
+    QVERIFY(publisher.isConnected());
+
+    publisher.disconnectFromBroker();
+    broker->stop();
+    broker->setOutboundQueueLimits(maxMessages, maxBytes);
+    broker->setDefaultOverflowPolicy(policy);
+    QTest::qWait(100);
+}
+
+void BrokerTest::testEpollDisconnect()
+{
+    Broker* broker = Broker::instance();
+    QVERIFY(broker->start(5556, "TestBroker", Broker::EpollBackend));
+    if (broker->ioBackend() != Broker::EpollBackend) {
+        broker->stop();
+        QSKIP("epoll backend is not available on this platform");
+    }
+
+    Publisher publisher;
+    Subscriber leaving;
+    Subscriber staying;
+    QVERIFY(leaving.connectToBroker("localhost", 5556));
+    QVERIFY(staying.connectToBroker("localhost", 5556));
+    QVERIFY(publisher.connectToBroker("localhost", 5556));
+    QVERIFY(leaving.subscribe("test/epoll/disconnect"));
+    QVERIFY(staying.subscribe("test/epoll/disconnect"));
+    QTRY_COMPARE(broker->clientCount(), 3);
+    QTest::qWait(100);
+
+    // 一个订阅者断开后从描述符表和订阅中移除，其余连接继续收发
+    leaving.disconnectFromBroker();
+    QTRY_COMPARE(broker->clientCount(), 2);
+
+    QSignalSpy receivedSpy(&staying, &Subscriber::messageReceived);
+    for (int i = 0; i < 10; ++i) {
+        QVERIFY(publisher.publish("test/epoll/disconnect", QByteArray::number(i)));
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(receivedSpy.count(), 10, 3000);
+    QCOMPARE(qvariant_cast<Message>(receivedSpy.at(9).at(0)).data(), QByteArray("9"));
+
+    // 客户端全部断开后Broker仍可正常停止
+    staying.disconnectFromBroker();
+    publisher.disconnectFromBroker();
+    QTRY_COMPARE(broker->clientCount(), 0);
+    broker->stop();
+    QVERIFY(!broker->isRunning());
+    QTest::qWait(100);
+}
+
 QTEST_MAIN(BrokerTest)
 #include "broker_test.moc"
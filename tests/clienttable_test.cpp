@@ -0,0 +1,125 @@
+#include <QtTest>
+#include <QRandomGenerator>
+#include "clienttable.h"
+#include "broker.h"
+
+#include <utility>
+#include <vector>
+
+class ClientTableTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testInsertAndLookup();
+    void testStaleHandle();
+    void testHandles();
+    void benchmarkLookup_data();
+    void benchmarkLookup();
+};
+
+void ClientTableTest::testInsertAndLookup()
+{
+    ClientTable table;
+    ClientInfo a;
+    ClientInfo b;
+
+    QVERIFY(table.isEmpty());
+    QVERIFY(!table.value(ClientTable::InvalidHandle));
+
+    const ClientHandle handleA = table.insert(&a);
+    const ClientHandle handleB = table.insert(&b);
+    QVERIFY(handleA != ClientTable::InvalidHandle);
+    QVERIFY(handleA != handleB);
+    QCOMPARE(table.size(), 2);
+    QCOMPARE(table.value(handleA), &a);
+    QCOMPARE(table.value(handleB), &b);
+
+    QCOMPARE(table.take(handleA), &a);
+    QCOMPARE(table.size(), 1);
+    QVERIFY(!table.contains(handleA));
+    QVERIFY(!table.take(handleA));
+    QCOMPARE(table.value(handleB), &b);
+}
+
+void ClientTableTest::testStaleHandle()
+{
+    ClientTable table;
+    ClientInfo first;
+    ClientInfo second;
+
+    // 槽位被复用后，旧句柄不会指向新客户端
+    const ClientHandle oldHandle = table.insert(&first);
+    table.take(oldHandle);
+    const ClientHandle newHandle = table.insert(&second);
+
+    QCOMPARE(newHandle & ((1u << ClientTable::kIndexBits) - 1), oldHandle & ((1u << ClientTable::kIndexBits) - 1));
+    QVERIFY(newHandle != oldHandle);
+    QVERIFY(!table.value(oldHandle));
+    QCOMPARE(table.value(newHandle), &second);
+
+    // 代数回绕时跳过0，句柄永远不等于 InvalidHandle
+    for (int i = 0; i < 5000; ++i) {
+        const ClientHandle handle = table.insert(&first);
+        QVERIFY(handle != ClientTable::InvalidHandle);
+        table.take(handle);
+    }
+}
+
+void ClientTableTest::testHandles()
+{
+    ClientTable table;
+    std::vector<ClientInfo> clients(10);
+    QVector<ClientHandle> inserted;
+    for (ClientInfo& client : clients) {
+        inserted.append(table.insert(&client));
+    }
+
+    table.take(inserted.at(3));
+    table.take(inserted.at(7));
+
+    const QVector<ClientHandle> handles = table.handles();
+    QCOMPARE(handles.size(), 8);
+    for (ClientHandle handle : handles) {
+        QVERIFY(table.contains(handle));
+    }
+    QVERIFY(!handles.contains(inserted.at(3)));
+}
+
+void ClientTableTest::benchmarkLookup_data()
+{
+    QTest::addColumn<int>("connections");
+
+    QTest::newRow("10 connections") << 10;
+    QTest::newRow("1000 connections") << 1000;
+    QTest::newRow("50000 connections") << 50000;
+}
+
+void ClientTableTest::benchmarkLookup()
+{
+    QFETCH(int, connections);
+
+    // 每次读事件的开销：按句柄找到客户端，应与连接数无关
+    ClientTable table;
+    std::vector<ClientInfo> clients(connections);
+    QVector<ClientHandle> handles;
+    for (ClientInfo& client : clients) {
+        handles.append(table.insert(&client));
+    }
+
+    QVector<ClientHandle> order;
+    for (int i = 0; i < 1024; ++i) {
+        order.append(handles.at(QRandomGenerator::global()->bounded(connections)));
+    }
+
+    QBENCHMARK {
+        int found = 0;
+        for (ClientHandle handle : std::as_const(order)) {
+            found += table.value(handle) != nullptr;
+        }
+        QCOMPARE(found, order.size());
+    }
+}
+
+QTEST_MAIN(ClientTableTest)
+#include "clienttable_test.moc"
@@ -0,0 +1,310 @@
+#include <QtTest>
+#include <QRandomGenerator>
+#include "message.h"
+#include "messageframehandler.h"
+#include "allocationcounter.h"
+
+namespace {
+
+/**
+ * @brief 运行若干次操作，报告平均每次的堆分配次数
+ * @param runs 运行次数
+ * @param operationsPerRun 每次运行包含的操作数（例如一次读入的帧数）
+ * @param operation 被统计的操作
+ */
+template <typename Operation>
+void reportAllocations(int runs, int operationsPerRun, Operation operation)
+{
+    // 先运行一次，排除首次调用时的缓冲区增长
+    operation();
+
+    qint64 allocations = 0;
+    {
+        AllocationCounter counter;
+        for (int i = 0; i < runs; ++i) {
+            operation();
+        }
+        allocations = counter.count();
+    }
+
+    qInfo("%s(%s): %.2f allocations/op", QTest::currentTestFunction(), QTest::currentDataTag(),
+          double(allocations) / (double(runs) * operationsPerRun));
+}
+
+/**
+ * @brief 生成指定长度的分层主题，例如 "level/level/lev"
+ */
+QString makeTopic(int length)
+{
+    QString topic;
+    while (topic.size() < length) {
+        topic += "level/";
+    }
+    topic.truncate(length);
+    return topic;
+}
+
+} // namespace
+
+/**
+ * @brief 编解码和分帧的微基准测试
+ *
+ * 不经过套接字，单独测量 Message::serialize、Message::deserialize、
+ * Message::extractMessageContent、MessageFrameHandler::processIncomingData 和 Message::peekHeader，
+ * 覆盖不同的主题长度、负载大小和数据切块方式，并报告每次操作的堆分配次数。
+ */
+class CodecBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void benchmarkSerialize_data();
+    void benchmarkSerialize();
+    void benchmarkExtractMessageContent_data();
+    void benchmarkExtractMessageContent();
+    void benchmarkDeserialize_data();
+    void benchmarkDeserialize();
+    void benchmarkProcessIncomingData_data();
+    void benchmarkProcessIncomingData();
+    void benchmarkPeekHeader_data();
+    void benchmarkPeekHeader();
+
+private:
+    /**
+     * @brief 添加协议版本、主题长度和负载大小的数据行
+     */
+    void addCodecRows();
+};
+
+void CodecBenchmark::addCodecRows()
+{
+    QTest::addColumn<int>("version");
+    QTest::addColumn<int>("topicLength");
+    QTest::addColumn<int>("payloadSize");
+
+    const int topicLengths[] = { 8, 64, 256 };
+    const int payloadSizes[] = { 16, 1024, 65536 };
+    for (int topicLength : topicLengths) {
+        for (int payloadSize : payloadSizes) {
+            QTest::addRow("v1, topic %d, %dB", topicLength, payloadSize)
+                << (int)Message::ProtocolV1 << topicLength << payloadSize;
+            QTest::addRow("v2, topic %d, %dB", topicLength, payloadSize)
+                << (int)Message::ProtocolV2 << topicLength << payloadSize;
+        }
+    }
+}
+
+void CodecBenchmark::benchmarkSerialize_data()
+{
+    addCodecRows();
+}
+
+void CodecBenchmark::benchmarkSerialize()
+{
+    QFETCH(int, version);
+    QFETCH(int, topicLength);
+    QFETCH(int, payloadSize);
+
+    const Message message(makeTopic(topicLength), QByteArray(payloadSize, 'x'));
+    const Message::ProtocolVersion protocol = static_cast<Message::ProtocolVersion>(version);
+
+    QBENCHMARK {
+        QByteArray frame = message.serialize(protocol);
+        Q_UNUSED(frame);
+    }
+
+    reportAllocations(1000, 1, [&message, protocol]() {
+        QByteArray frame = message.serialize(protocol);
+        Q_UNUSED(frame);
+    });
+}
+
+void CodecBenchmark::benchmarkExtractMessageContent_data()
+{
+    addCodecRows();
+}
+
+void CodecBenchmark::benchmarkExtractMessageContent()
+{
+    QFETCH(int, version);
+    QFETCH(int, topicLength);
+    QFETCH(int, payloadSize);
+
+    const QByteArray frame = Message(makeTopic(topicLength), QByteArray(payloadSize, 'x'))
+                                 .serialize(static_cast<Message::ProtocolVersion>(version));
+
+    int bytesRead = 0;
+    QVERIFY(!Message::extractMessageContent(frame, bytesRead).isEmpty());
+    QCOMPARE(bytesRead, frame.size());
+
+    QBENCHMARK {
+        QByteArray content = Message::extractMessageContent(frame, bytesRead);
+        Q_UNUSED(content);
+    }
+
+    reportAllocations(1000, 1, [&frame, &bytesRead]() {
+        QByteArray content = Message::extractMessageContent(frame, bytesRead);
+        Q_UNUSED(content);
+    });
+}
+
+void CodecBenchmark::benchmarkDeserialize_data()
+{
+    addCodecRows();
+}
+
+void CodecBenchmark::benchmarkDeserialize()
+{
+    QFETCH(int, version);
+    QFETCH(int, topicLength);
+    QFETCH(int, payloadSize);
+
+    // 输入是 extractMessageContent() 的结果：V1 为不含长度前缀的内容，V2 为完整帧
+    const QString topic = makeTopic(topicLength);
+    const QByteArray frame = Message(topic, QByteArray(payloadSize, 'x'))
+                                 .serialize(static_cast<Message::ProtocolVersion>(version));
+    int bytesRead = 0;
+    const QByteArray content = Message::extractMessageContent(frame, bytesRead);
+
+    Message decoded;
+    QVERIFY(decoded.deserialize(content));
+    QCOMPARE(decoded.topic(), topic);
+    QCOMPARE(decoded.data().size(), payloadSize);
+
+    QBENCHMARK {
+        Message message;
+        bool ok = message.deserialize(content);
+        Q_UNUSED(ok);
+    }
+
+    reportAllocations(1000, 1, [&content]() {
+        Message message;
+        bool ok = message.deserialize(content);
+        Q_UNUSED(ok);
+    });
+}
+
+void CodecBenchmark::benchmarkProcessIncomingData_data()
+{
+    QTest::addColumn<int>("payloadSize");
+    QTest::addColumn<QString>("split");
+    QTest::addColumn<bool>("routingMode");
+
+    // whole：每次读到恰好一帧；coalesced：每次读 64 KB，包含多帧和半帧；
+    // random：1~4096 字节的随机切块；dribble：每次7字节，帧头也会被切开
+    const int payloadSizes[] = { 16, 1024 };
+    const char* splits[] = { "whole", "coalesced", "random", "dribble" };
+    for (int payloadSize : payloadSizes) {
+        for (const char* split : splits) {
+            QTest::addRow("%dB, %s, decode", payloadSize, split) << payloadSize << QString(split) << false;
+            QTest::addRow("%dB, %s, routing", payloadSize, split) << payloadSize << QString(split) << true;
+        }
+    }
+}
+
+void CodecBenchmark::benchmarkProcessIncomingData()
+{
+    QFETCH(int, payloadSize);
+    QFETCH(QString, split);
+    QFETCH(bool, routingMode);
+
+    // 256 KB 的 V2 帧流
+    const QByteArray frame = Message("sensors/line3/temp", QByteArray(payloadSize, 'x')).serialize(Message::ProtocolV2);
+    const int frameCount = qMax(1, (256 * 1024) / frame.size());
+    QByteArray stream;
+    stream.reserve(frameCount * frame.size());
+    for (int i = 0; i < frameCount; ++i) {
+        stream.append(frame);
+    }
+
+    QRandomGenerator random(42);
+    QList<QByteArray> chunks;
+    for (int offset = 0; offset < stream.size();) {
+        int chunkSize = frame.size();
+        if (split == "coalesced") {
+            chunkSize = 64 * 1024;
+        } else if (split == "random") {
+            chunkSize = random.bounded(1, 4096);
+        } else if (split == "dribble") {
+            chunkSize = 7;
+        }
+        chunkSize = qMin(chunkSize, (int)stream.size() - offset);
+        chunks.append(stream.mid(offset, chunkSize));
+        offset += chunkSize;
+    }
+
+    MessageFrameHandler handler;
+    handler.setRoutingMode(routingMode);
+
+    int framesReceived = 0;
+    connect(&handler, &MessageFrameHandler::frameReceived, [&framesReceived]() { ++framesReceived; });
+    connect(&handler, &MessageFrameHandler::messageReceived, [&framesReceived]() { ++framesReceived; });
+
+    QBENCHMARK {
+        framesReceived = 0;
+        for (const QByteArray& chunk : chunks) {
+            handler.processIncomingData(chunk);
+        }
+    }
+    QCOMPARE(framesReceived, frameCount);
+
+    // 按帧计算分配次数
+    reportAllocations(10, frameCount, [&handler, &chunks]() {
+        for (const QByteArray& chunk : chunks) {
+            handler.processIncomingData(chunk);
+        }
+    });
+}
+
+void CodecBenchmark::benchmarkPeekHeader_data()
+{
+    QTest::addColumn<int>("payloadSize");
+    QTest::addColumn<bool>("decodeAll");
+
+    // peek：只读取负载之前的头部；decode：完整解码消息后取头部，作为对照
+    const int payloadSizes[] = { 16, 1024, 65536 };
+    for (int payloadSize : payloadSizes) {
+        QTest::addRow("%dB, peek", payloadSize) << payloadSize << false;
+        QTest::addRow("%dB, decode", payloadSize) << payloadSize << true;
+    }
+}
+
+void CodecBenchmark::benchmarkPeekHeader()
+{
+    QFETCH(int, payloadSize);
+    QFETCH(bool, decodeAll);
+
+    Message message("orders/eu/created", QByteArray(payloadSize, 'x'));
+    message.setHeader("region", QString("eu-west"));
+    message.setHeader("priority", 3);
+    message.setHeader("key", QByteArray("customer-1042"));
+    const QByteArray frame = message.serialize(Message::ProtocolV2);
+    QCOMPARE(Message::peekHeader(frame, "priority").toInt(), 3);
+
+    QBENCHMARK {
+        QVariant value;
+        if (decodeAll) {
+            Message decoded;
+            decoded.deserializeFrame(frame);
+            value = decoded.header("priority");
+        } else {
+            value = Message::peekHeader(frame, "priority");
+        }
+        Q_UNUSED(value);
+    }
+
+    reportAllocations(1000, 1, [&frame, decodeAll]() {
+        QVariant value;
+        if (decodeAll) {
+            Message decoded;
+            decoded.deserializeFrame(frame);
+            value = decoded.header("priority");
+        } else {
+            value = Message::peekHeader(frame, "priority");
+        }
+        Q_UNUSED(value);
+    });
+}
+
+QTEST_MAIN(CodecBenchmark)
+#include "codec_benchmark.moc"
@@ -0,0 +1,100 @@
+#include <QtTest>
+#include "logger.h"
+#include "allocationcounter.h"
+
+/**
+ * @brief 日志开销基准测试
+ *
+ * reportDisabledDebugCost 以 INFO 级别运行Broker转发一条消息时的三条调试日志
+ * （收到、路由、投递），比较直接调用 Logger::debug() 和 MYMQ_LOG_DEBUG 宏的每条消息开销。
+ * reportEnqueueCost 测量一条会被记录的日志放入队列的开销。
+ */
+class LoggerBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void reportDisabledDebugCost_data();
+    void reportDisabledDebugCost();
+    void reportEnqueueCost();
+};
+
+void LoggerBenchmark::initTestCase()
+{
+    QVERIFY(Logger::instance()->init("logger_benchmark.log", Logger::INFO));
+    Logger::instance()->setConsoleOutput(false);
+}
+
+void LoggerBenchmark::reportDisabledDebugCost_data()
+{
+    QTest::addColumn<bool>("lazy");
+
+    QTest::newRow("Logger::debug()") << false;
+    QTest::newRow("MYMQ_LOG_DEBUG") << true;
+}
+
+void LoggerBenchmark::reportDisabledDebugCost()
+{
+    QFETCH(bool, lazy);
+
+    // 与Broker转发路径上的日志语句相同的参数
+    const QString clientId("3f1c6a52-8a7e-4d7e-9b8e-5f0d2a6c9e11");
+    const QString topic("sensors/line3/temp");
+    const int threadCount = 2;
+
+    const int messageCount = 200000;
+    qint64 allocations = 0;
+    QElapsedTimer timer;
+    timer.start();
+    {
+        AllocationCounter counter;
+        for (int i = 0; i < messageCount; ++i) {
+            if (lazy) {
+                MYMQ_LOG_DEBUG(QString("Processing message from client %1, topic: %2").arg(clientId).arg(topic));
+                MYMQ_LOG_DEBUG(QString("Routed message on topic %1 to %2 I/O threads").arg(topic).arg(threadCount));
+                MYMQ_LOG_DEBUG(QString("Sent message to client %1: %2").arg(clientId).arg(topic));
+            } else {
+                Logger::instance()->debug(QString("Processing message from client %1, topic: %2").arg(clientId).arg(topic));
+                Logger::instance()->debug(QString("Routed message on topic %1 to %2 I/O threads").arg(topic).arg(threadCount));
+                Logger::instance()->debug(QString("Sent message to client %1: %2").arg(clientId).arg(topic));
+            }
+        }
+        allocations = counter.count();
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    qInfo("%s at INFO level: %.1f ns and %.2f allocations per routed message",
+          QTest::currentDataTag(), double(elapsed) / messageCount, double(allocations) / messageCount);
+    if (lazy) {
+        QCOMPARE(allocations, qint64(0));
+    }
+}
+
+void LoggerBenchmark::reportEnqueueCost()
+{
+    Logger::instance()->setOverflowPolicy(Logger::DropNewest);
+    const QString message("enqueue cost sample message");
+
+    // 每轮放入不超过半个队列的记录，测量的是放入队列本身而不是写出或丢弃
+    const int rounds = 200;
+    const int perRound = Logger::kDefaultQueueCapacity / 4;
+    qint64 enqueueNs = 0;
+    QElapsedTimer timer;
+    for (int round = 0; round < rounds; ++round) {
+        Logger::instance()->flush();
+
+        timer.start();
+        for (int i = 0; i < perRound; ++i) {
+            Logger::instance()->info(message);
+        }
+        enqueueNs += timer.nsecsElapsed();
+    }
+    Logger::instance()->flush();
+
+    qInfo("enqueue: %.1f ns/record, dropped: %llu",
+          double(enqueueNs) / (double(rounds) * perRound), (unsigned long long)Logger::instance()->droppedCount());
+}
+
+QTEST_MAIN(LoggerBenchmark)
+#include "logger_benchmark.moc"
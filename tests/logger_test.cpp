@@ -0,0 +1,154 @@
+#include <QtTest>
+#include "logger.h"
+
+#include <thread>
+#include <vector>
+
+class LoggerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void testWritesInOrder();
+    void testConcurrentProducers();
+    void testDropNewest();
+    void testLazyMacros();
+
+private:
+    /**
+     * @brief 读取日志文件中包含指定标记的行
+     * @param marker 标记
+     * @return 行
+     */
+    static QStringList linesWith(const QString& marker);
+};
+
+static const char* const kLogFile = "logger_test.log";
+
+void LoggerTest::initTestCase()
+{
+    QFile::remove(kLogFile);
+
+    // 队列容量较小，容易覆盖队列满的情况
+    QVERIFY(Logger::instance()->init(kLogFile, Logger::INFO, 1024));
+    Logger::instance()->setConsoleOutput(false);
+}
+
+QStringList LoggerTest::linesWith(const QString& marker)
+{
+    QFile file(kLogFile);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return QStringList();
+    }
+
+    QStringList lines;
+    while (!file.atEnd()) {
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (line.contains(marker)) {
+            lines.append(line);
+        }
+    }
+    return lines;
+}
+
+void LoggerTest::testWritesInOrder()
+{
+    Logger::instance()->setOverflowPolicy(Logger::Block);
+
+    const int count = 3000;
+    for (int i = 0; i < count; ++i) {
+        Logger::instance()->info(QString("order %1").arg(i));
+    }
+    Logger::instance()->debug("order filtered");
+    Logger::instance()->flush();
+
+    // 低于日志级别的记录不进入队列；格式与同步写入时相同
+    const QStringList lines = linesWith("order ");
+    QCOMPARE(lines.size(), count);
+    QRegularExpression format("^\\[\\d{4}-\\d{2}-\\d{2} \\d{2}:\\d{2}:\\d{2}\\.\\d{3}\\] \\[INFO\\] order (\\d+)$");
+    for (int i = 0; i < count; ++i) {
+        const QRegularExpressionMatch match = format.match(lines[i]);
+        QVERIFY2(match.hasMatch(), qPrintable(lines[i]));
+        QCOMPARE(match.captured(1).toInt(), i);
+    }
+}
+
+void LoggerTest::testConcurrentProducers()
+{
+    Logger::instance()->setOverflowPolicy(Logger::Block);
+
+    // Block 策略下多个线程同时写满队列也不丢日志，每个线程的记录保持顺序
+    const int threadCount = 4;
+    const int perThread = 5000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([t, perThread]() {
+            for (int i = 0; i < perThread; ++i) {
+                Logger::instance()->warning(QString("producer %1 line %2").arg(t).arg(i));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    Logger::instance()->flush();
+
+    QVector<int> next(threadCount, 0);
+    const QStringList lines = linesWith("producer ");
+    QCOMPARE(lines.size(), threadCount * perThread);
+    for (const QString& line : lines) {
+        const QStringList parts = line.section("producer ", 1).split(" line ");
+        QCOMPARE(parts.size(), 2);
+        const int t = parts[0].toInt();
+        QCOMPARE(parts[1].toInt(), next[t]);
+        ++next[t];
+    }
+}
+
+void LoggerTest::testDropNewest()
+{
+    Logger::instance()->setOverflowPolicy(Logger::DropNewest);
+    const quint64 droppedBefore = Logger::instance()->droppedCount();
+
+    // 突发写入远超队列容量：调用线程从不等待，写出的和丢弃的加起来等于总数
+    const int count = 100000;
+    for (int i = 0; i < count; ++i) {
+        Logger::instance()->info(QString("burst %1").arg(i));
+    }
+    Logger::instance()->flush();
+
+    const int written = linesWith("burst ").size();
+    const quint64 dropped = Logger::instance()->droppedCount() - droppedBefore;
+    QVERIFY(written > 0);
+    QCOMPARE(quint64(written) + dropped, quint64(count));
+}
+
+void LoggerTest::testLazyMacros()
+{
+    Logger::instance()->setOverflowPolicy(Logger::Block);
+
+    // 低于日志级别时不求值消息表达式
+    int evaluations = 0;
+    auto message = [&evaluations](const char* text) -> QString {
+        ++evaluations;
+        return QString("macro %1").arg(text);
+    };
+
+    MYMQ_LOG_DEBUG(message("debug"));
+    QCOMPARE(evaluations, 0);
+    QVERIFY(!Logger::instance()->isEnabled(Logger::DEBUG));
+
+    MYMQ_LOG_INFO(message("info"));
+    MYMQ_LOG_WARNING(message("warning"));
+    QCOMPARE(evaluations, 2);
+    Logger::instance()->flush();
+
+    const QStringList lines = linesWith("macro ");
+    QCOMPARE(lines.size(), 2);
+    QVERIFY(lines[0].endsWith("[INFO] macro info"));
+    QVERIFY(lines[1].endsWith("[WARNING] macro warning"));
+}
+
+QTEST_MAIN(LoggerTest)
+#include "logger_test.moc"
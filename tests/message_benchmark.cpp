@@ -0,0 +1,216 @@
+#include <QtTest>
+#include <QQueue>
+#include <QRandomGenerator>
+#include "message.h"
+#include "messageframehandler.h"
+#include "allocationcounter.h"
+
+/**
+ * @brief 消息编解码基准测试，对比 V1（QDataStream）与 V2（紧凑二进制）协议
+ */
+class MessageBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void reportFrameOverhead_data();
+    void reportFrameOverhead();
+    void reportTopicAliasSavings_data();
+    void reportTopicAliasSavings();
+    void benchmarkEncode_data();
+    void benchmarkEncode();
+    void benchmarkDecode_data();
+    void benchmarkDecode();
+    void reportAllocationsPerRoutedMessage();
+    void benchmarkChunkedFraming_data();
+    void benchmarkChunkedFraming();
+
+private:
+    /**
+     * @brief 添加协议版本和负载大小的数据行
+     */
+    void addCodecRows();
+};
+
+void MessageBenchmark::addCodecRows()
+{
+    QTest::addColumn<int>("version");
+    QTest::addColumn<int>("payloadSize");
+
+    const int payloadSizes[] = { 16, 256, 4096 };
+    for (int payloadSize : payloadSizes) {
+        QTest::addRow("v1, %dB", payloadSize) << (int)Message::ProtocolV1 << payloadSize;
+        QTest::addRow("v2, %dB", payloadSize) << (int)Message::ProtocolV2 << payloadSize;
+    }
+}
+
+void MessageBenchmark::reportFrameOverhead_data()
+{
+    addCodecRows();
+}
+
+void MessageBenchmark::reportFrameOverhead()
+{
+    QFETCH(int, version);
+    QFETCH(int, payloadSize);
+
+    Message message("sensors/line3/temp", QByteArray(payloadSize, 'x'));
+    QByteArray frame = message.serialize(static_cast<Message::ProtocolVersion>(version));
+
+    // 每条消息在线路上的总字节数和除负载之外的开销
+    qInfo("protocol v%d, payload %d B: %d bytes/message, %d bytes overhead",
+          version, payloadSize, frame.size(), frame.size() - payloadSize);
+    QVERIFY(frame.size() > payloadSize);
+}
+
+void MessageBenchmark::reportTopicAliasSavings_data()
+{
+    QTest::addColumn<int>("payloadSize");
+
+    QTest::newRow("16B payload") << 16;
+    QTest::newRow("256B payload") << 256;
+}
+
+void MessageBenchmark::reportTopicAliasSavings()
+{
+    QFETCH(int, payloadSize);
+
+    // 约80字节的深层主题，接近现场设备的实际命名
+    const QString topic = "enterprise/site-07/area-north/line-03/cell-12/robot-arm-4/joint-2/temperature";
+    Message message(topic, QByteArray(payloadSize, 'x'));
+    const QByteArray full = message.serialize(Message::ProtocolV2);
+    const QByteArray aliased = message.serializeWithTopicAlias(1);
+
+    qInfo("topic %d B, payload %d B: %d bytes/message with topic, %d bytes/message with alias (%.0f%% smaller)",
+          int(topic.toUtf8().size()), payloadSize, int(full.size()), int(aliased.size()),
+          100.0 * (full.size() - aliased.size()) / full.size());
+    QVERIFY(aliased.size() < full.size());
+}
+
+void MessageBenchmark::benchmarkEncode_data()
+{
+    addCodecRows();
+}
+
+void MessageBenchmark::benchmarkEncode()
+{
+    QFETCH(int, version);
+    QFETCH(int, payloadSize);
+
+    Message message("sensors/line3/temp", QByteArray(payloadSize, 'x'));
+    const Message::ProtocolVersion protocol = static_cast<Message::ProtocolVersion>(version);
+
+    QBENCHMARK {
+        QByteArray frame = message.serialize(protocol);
+        Q_UNUSED(frame);
+    }
+}
+
+void MessageBenchmark::benchmarkDecode_data()
+{
+    addCodecRows();
+}
+
+void MessageBenchmark::benchmarkDecode()
+{
+    QFETCH(int, version);
+    QFETCH(int, payloadSize);
+
+    const QByteArray frame = Message("sensors/line3/temp", QByteArray(payloadSize, 'x'))
+                                 .serialize(static_cast<Message::ProtocolVersion>(version));
+
+    QBENCHMARK {
+        Message message;
+        bool ok = message.deserializeFrame(frame);
+        Q_UNUSED(ok);
+    }
+}
+
+void MessageBenchmark::reportAllocationsPerRoutedMessage()
+{
+    const int messageCount = 10000;
+    const QByteArray frame = Message("sensors/line3/temp", QByteArray(64, 'x')).serialize(Message::ProtocolV2);
+
+    // 模拟一条消息的典型路径：解码 -> 信号槽 -> 放入缓存 -> 放入待发送队列 -> 交给使用者
+    QQueue<Message> cache;
+    QQueue<Message> pending;
+    QList<Message> delivered;
+    cache.reserve(messageCount + 1);
+    pending.reserve(messageCount + 1);
+    delivered.reserve(messageCount + 1);
+
+    MessageFrameHandler handler;
+    connect(&handler, &MessageFrameHandler::messageReceived, [&](const Message& message) {
+        cache.enqueue(message);
+        pending.enqueue(message);
+        Message copy = pending.last();
+        delivered.append(std::move(copy));
+    });
+
+    // 预热，让接收缓冲区达到稳定容量
+    handler.processIncomingData(frame);
+
+    qint64 allocations = 0;
+    {
+        AllocationCounter counter;
+        for (int i = 0; i < messageCount; ++i) {
+            handler.processIncomingData(frame);
+        }
+        allocations = counter.count();
+    }
+
+    qInfo("%.2f allocations per routed message", double(allocations) / messageCount);
+    QCOMPARE(delivered.size(), messageCount + 1);
+}
+
+void MessageBenchmark::benchmarkChunkedFraming_data()
+{
+    QTest::addColumn<bool>("routingMode");
+
+    QTest::newRow("routing") << true;
+    QTest::newRow("decode") << false;
+}
+
+void MessageBenchmark::benchmarkChunkedFraming()
+{
+    QFETCH(bool, routingMode);
+
+    // 1 MB 的64字节 V2 帧：26字节帧头 + 7字节主题 + 31字节负载
+    const QByteArray frame = Message("bench/t", QByteArray(31, 'x')).serialize(Message::ProtocolV2);
+    QCOMPARE(frame.size(), 64);
+
+    const int frameCount = (1024 * 1024) / frame.size();
+    QByteArray stream;
+    stream.reserve(frameCount * frame.size());
+    for (int i = 0; i < frameCount; ++i) {
+        stream.append(frame);
+    }
+
+    // 按随机大小切块，模拟一次 readAll() 返回任意数量的帧和半帧
+    QRandomGenerator random(42);
+    QList<QByteArray> chunks;
+    for (int offset = 0; offset < stream.size();) {
+        int chunkSize = qMin(random.bounded(1, 4096), (int)stream.size() - offset);
+        chunks.append(stream.mid(offset, chunkSize));
+        offset += chunkSize;
+    }
+
+    MessageFrameHandler handler;
+    handler.setRoutingMode(routingMode);
+
+    int framesReceived = 0;
+    connect(&handler, &MessageFrameHandler::frameReceived, [&framesReceived]() { ++framesReceived; });
+    connect(&handler, &MessageFrameHandler::messageReceived, [&framesReceived]() { ++framesReceived; });
+
+    QBENCHMARK {
+        framesReceived = 0;
+        for (const QByteArray& chunk : chunks) {
+            handler.processIncomingData(chunk);
+        }
+    }
+
+    QCOMPARE(framesReceived, frameCount);
+}
+
+QTEST_MAIN(MessageBenchmark)
+#include "message_benchmark.moc"
@@ -1,5 +1,6 @@
 #include <QtTest>
 #include "message.h"
+#include "messageframehandler.h"
 
 class MessageTest : public QObject
 {
@@ -9,6 +10,17 @@ private slots:
     void testConstructor();
     void testSettersAndGetters();
     void testSerializeDeserialize();
+    void testSerializeDeserializeV2();
+    void testMessageIds();
+    void testPeekTopic();
+    void testRoutingModeForwardsFrame();
+    void testSequence();
+    void testTopicAlias();
+    void testBatchFrame();
+    void testNestedBatchFrame();
+    void testInvalidFrameLength();
+    void testHeartbeatFrame();
+    void testHeaders();
 };
 
 void MessageTest::testConstructor()
@@ -68,5 +80,453 @@ void MessageTest::testSerializeDeserialize()
     QCOMPARE(deserializedMessage.timestamp(), originalMessage.timestamp());
 }
 
+void MessageTest::testSerializeDeserializeV2()
+{
+    Message originalMessage("test/主题", QByteArray("\x00\x01payload", 9));
+
+    QByteArray frame = originalMessage.serialize(Message::ProtocolV2);
+    QCOMPARE(Message::frameVersion(frame), (int)Message::ProtocolV2);
+    QCOMPARE(Message::frameLength(frame), frame.size());
+    QCOMPARE(Message::frameLength(frame.left(10)), 0);
+
+    // V2 帧比 V1 帧小得多
+    QVERIFY(frame.size() < originalMessage.serialize(Message::ProtocolV1).size());
+
+    QString topic;
+    QVERIFY(Message::peekTopic(frame, topic));
+    QCOMPARE(topic, originalMessage.topic());
+
+    Message decodedMessage;
+    QVERIFY(decodedMessage.deserializeFrame(frame));
+    QCOMPARE(decodedMessage.numericId(), originalMessage.numericId());
+    QCOMPARE(decodedMessage.topic(), originalMessage.topic());
+    QCOMPARE(decodedMessage.data(), originalMessage.data());
+    QCOMPARE(decodedMessage.timestamp().toMSecsSinceEpoch(), originalMessage.timestamp().toMSecsSinceEpoch());
+
+    // V1 和 V2 帧可以在同一个流中混合出现
+    MessageFrameHandler handler;
+    QSignalSpy spy(&handler, &MessageFrameHandler::messageReceived);
+    handler.processIncomingData(frame + Message("v1/topic", "v1").serialize(Message::ProtocolV1));
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(qvariant_cast<Message>(spy.at(0).at(0)).topic(), originalMessage.topic());
+    QCOMPARE(qvariant_cast<Message>(spy.at(1).at(0)).topic(), QString("v1/topic"));
+}
+
+void MessageTest::testMessageIds()
+{
+    // 同一个生成器生成的ID连续递增
+    MessageIdGenerator generator;
+    quint64 first = generator.next();
+    QCOMPARE(generator.next(), first + 1);
+
+    // 新连接使用新的前缀，不会与之前的ID冲突
+    generator.reset();
+    QVERIFY((generator.next() >> 32) != (first >> 32));
+
+    // 时间戳单调不减
+    Message message1("test/topic", "1");
+    Message message2("test/topic", "2");
+    QVERIFY(message2.timestampNs() >= message1.timestampNs());
+    QVERIFY(message1.numericId() != message2.numericId());
+
+    // ID文本按需生成，并能经过 V1 线路还原为同一个数字ID
+    Message decoded;
+    QVERIFY(decoded.deserializeFrame(message1.serialize(Message::ProtocolV1)));
+    QCOMPARE(decoded.numericId(), message1.numericId());
+    QCOMPARE(decoded.id(), message1.id());
+}
+
+void MessageTest::testPeekTopic()
+{
+    Message message("test/topic", "Hello, World!");
+    QByteArray frame = message.serialize();
+
+    // 完整帧的长度可以直接从前缀得到
+    QCOMPARE(Message::frameLength(frame), frame.size());
+    QCOMPARE(Message::frameLength(frame.left(frame.size() - 1)), 0);
+
+    // 只解析主题
+    QString topic;
+    QVERIFY(Message::peekTopic(frame, topic));
+    QCOMPARE(topic, message.topic());
+
+    // 截断的帧无法解析主题
+    QVERIFY(!Message::peekTopic(frame.left(8), topic));
+}
+
+void MessageTest::testRoutingModeForwardsFrame()
+{
+    MessageFrameHandler handler;
+    handler.setRoutingMode(true);
+
+    // 帧是接收缓冲区的视图，只在信号处理期间有效，需要复制后保存
+    QStringList topics;
+    QList<QByteArray> frames;
+    connect(&handler, &MessageFrameHandler::frameReceived,
+            [&](const QString& topic, const QByteArray& frame) {
+                topics.append(topic);
+                frames.append(QByteArray(frame.constData(), frame.size()));
+            });
+    QSignalSpy messageSpy(&handler, &MessageFrameHandler::messageReceived);
+
+    QByteArray frame1 = Message("a/b", "first").serialize();
+    QByteArray frame2 = Message("c/d", "second").serialize(Message::ProtocolV2);
+    QByteArray frame3 = Message("e/f", "third").serialize();
+
+    // 三帧粘包，第二帧拆成两次到达，第三帧逐字节到达
+    QByteArray stream = frame1 + frame2;
+    handler.processIncomingData(stream.left(frame1.size() + 3));
+    handler.processIncomingData(stream.mid(frame1.size() + 3));
+    for (int i = 0; i < frame3.size(); ++i) {
+        handler.processIncomingData(frame3.mid(i, 1));
+    }
+
+    QCOMPARE(messageSpy.count(), 0);
+    QCOMPARE(frames.size(), 3);
+    QCOMPARE(topics.at(0), QString("a/b"));
+    QCOMPARE(frames.at(0), frame1);
+    QCOMPARE(topics.at(1), QString("c/d"));
+    QCOMPARE(frames.at(1), frame2);
+    QCOMPARE(topics.at(2), QString("e/f"));
+    QCOMPARE(frames.at(2), frame3);
+}
+
+void MessageTest::testSequence()
+{
+    Message message("test/topic", "payload");
+    QCOMPARE(message.sequence(), qint64(-1));
+
+    // 没有序号的帧与之前的编码完全相同
+    const QByteArray plainV2 = message.serialize(Message::ProtocolV2);
+    Message decoded;
+    QVERIFY(decoded.deserializeFrame(plainV2));
+    QCOMPARE(decoded.sequence(), qint64(-1));
+
+    // 写入序号只追加帧尾，负载保持不变；再次写入时原地覆盖
+    const QByteArray stamped = Message::withSequence(plainV2, 42);
+    QCOMPARE(stamped.size(), plainV2.size() + 8);
+    QCOMPARE(Message::frameLength(stamped), stamped.size());
+    QVERIFY(decoded.deserializeFrame(stamped));
+    QCOMPARE(decoded.sequence(), qint64(42));
+    QCOMPARE(decoded.data(), message.data());
+
+    const QByteArray restamped = Message::withSequence(stamped, 43);
+    QCOMPARE(restamped.size(), stamped.size());
+    QVERIFY(decoded.deserializeFrame(restamped));
+    QCOMPARE(decoded.sequence(), qint64(43));
+    QCOMPARE(decoded.data(), message.data());
+
+    // V1 帧的序号在时间戳之后
+    const QByteArray stampedV1 = Message::withSequence(message.serialize(Message::ProtocolV1), 7);
+    QCOMPARE(Message::frameVersion(stampedV1), (int)Message::ProtocolV1);
+    QVERIFY(decoded.deserializeFrame(stampedV1));
+    QCOMPARE(decoded.sequence(), qint64(7));
+    QCOMPARE(decoded.topic(), message.topic());
+    QCOMPARE(decoded.data(), message.data());
+
+    // 转码时保留序号
+    QVERIFY(decoded.deserializeFrame(Message::withSequence(plainV2, 9)));
+    Message transcoded;
+    QVERIFY(transcoded.deserializeFrame(decoded.serialize(Message::ProtocolV1)));
+    QCOMPARE(transcoded.sequence(), qint64(9));
+
+    // 只读取时间戳
+    QCOMPARE(Message::peekTimestampNs(stamped), message.timestampNs());
+    QCOMPARE(Message::peekTimestampNs(stampedV1) / 1000000, message.timestampNs() / 1000000);
+}
+
+void MessageTest::testTopicAlias()
+{
+    const QString topic = "plant/building-a/line-3/station-12/sensors/temperature";
+    Message message(topic, "21.5");
+
+    // 别名帧只携带4字节别名，解码后主题为空
+    const QByteArray full = message.serialize(Message::ProtocolV2);
+    const QByteArray aliased = message.serializeWithTopicAlias(7);
+    QCOMPARE(aliased.size(), full.size() - 2 - topic.toUtf8().size() + 4);
+    QCOMPARE(Message::frameLength(aliased), aliased.size());
+    QCOMPARE(Message::peekTopicAlias(aliased), quint32(7));
+    QCOMPARE(Message::peekTopicAlias(full), quint32(0));
+    QCOMPARE(Message::peekTopicAlias(message.serialize(Message::ProtocolV1)), quint32(0));
+
+    QString peeked;
+    QVERIFY(!Message::peekTopic(aliased, peeked));
+
+    Message decoded;
+    QVERIFY(decoded.deserializeFrame(aliased));
+    QVERIFY(decoded.topic().isEmpty());
+    QCOMPARE(decoded.data(), message.data());
+    QCOMPARE(decoded.numericId(), message.numericId());
+
+    // 写入序号时展开为完整主题，与直接编码带序号的消息完全相同
+    Message sequenced = message;
+    sequenced.setSequence(5);
+    QCOMPARE(Message::withSequence(aliased, 5, topic), sequenced.serialize(Message::ProtocolV2));
+    QCOMPARE(Message::withTopic(aliased, topic), full);
+
+    // 完整主题的帧改为别名，序号保留
+    const QByteArray realiased = Message::withTopicAlias(Message::withSequence(full, 5), 9);
+    QCOMPARE(Message::peekTopicAlias(realiased), quint32(9));
+    QVERIFY(decoded.deserializeFrame(realiased));
+    QCOMPARE(decoded.sequence(), qint64(5));
+    QCOMPARE(decoded.data(), message.data());
+    QVERIFY(Message::withTopicAlias(message.serialize(Message::ProtocolV1), 9).isEmpty());
+
+    // 帧处理器按登记的别名填入主题，未登记的别名报错
+    MessageFrameHandler handler;
+    QSignalSpy messageSpy(&handler, &MessageFrameHandler::messageReceived);
+    QSignalSpy errorSpy(&handler, &MessageFrameHandler::error);
+    handler.processIncomingData(aliased);
+    QCOMPARE(messageSpy.count(), 0);
+    QCOMPARE(errorSpy.count(), 1);
+
+    handler.setTopicAlias(7, topic);
+    handler.processIncomingData(aliased);
+    QCOMPARE(messageSpy.count(), 1);
+    QCOMPARE(qvariant_cast<Message>(messageSpy.at(0).at(0)).topic(), topic);
+
+    // 超过 V2 主题长度上限的主题不截断，无法展开时返回空帧
+    const QString longTopic(0x10000, QLatin1Char('t'));
+    QVERIFY(Message::fitsTopicV2(topic));
+    QVERIFY(Message::fitsTopicV2(QString(0xFFFF, QLatin1Char('t'))));
+    QVERIFY(!Message::fitsTopicV2(longTopic));
+    QVERIFY(!Message::fitsTopicV2(QString(0x8000, QChar(0x4E2D))));
+    QVERIFY(Message::withTopic(aliased, longTopic).isEmpty());
+    QVERIFY(Message::withSequence(aliased, 1, longTopic).isEmpty());
+    QCOMPARE(Message::frameVersion(Message(longTopic, "x").serialize(Message::ProtocolV2)), int(Message::ProtocolV1));
+
+    // 控制消息负载
+    quint32 topicAlias = 0;
+    QString parsedTopic;
+    QVERIFY(Message::parseTopicAliasPayload(Message::topicAliasPayload(42, topic), topicAlias, parsedTopic));
+    QCOMPARE(topicAlias, quint32(42));
+    QCOMPARE(parsedTopic, topic);
+    QVERIFY(!Message::parseTopicAliasPayload("0\na/b", topicAlias, parsedTopic));
+    QVERIFY(!Message::parseTopicAliasPayload("a/b", topicAlias, parsedTopic));
+}
+
+void MessageTest::testBatchFrame()
+{
+    MessageBatch batch;
+    QVERIFY(batch.isEmpty());
+
+    QList<QByteArray> frames;
+    for (int i = 0; i < 5; ++i) {
+        // 批量帧中可以混合不同协议版本的消息帧
+        const Message::ProtocolVersion version = i % 2 ? Message::ProtocolV1 : Message::ProtocolV2;
+        frames.append(Message(QString("batch/%1").arg(i), QByteArray::number(i)).serialize(version));
+        batch.append(frames.last());
+    }
+    QCOMPARE(batch.size(), 5);
+
+    const QByteArray batchFrame = batch.takeFrame(Message::ProtocolV2);
+    QVERIFY(batch.isEmpty());
+    QVERIFY(Message::isBatchFrame(batchFrame));
+    QVERIFY(!Message::isBatchFrame(frames.first()));
+    QCOMPARE(Message::frameLength(batchFrame), batchFrame.size());
+    QCOMPARE(Message::batchContents(batchFrame), frames.join());
+
+    // 路由模式逐个交出原始消息帧，分段到达时同样有效
+    MessageFrameHandler router;
+    router.setRoutingMode(true);
+    QList<QByteArray> routed;
+    connect(&router, &MessageFrameHandler::frameReceived, [&routed](const QString&, const QByteArray& frame) {
+        routed.append(QByteArray(frame.constData(), frame.size()));
+    });
+    router.processIncomingData(batchFrame.left(30));
+    QVERIFY(routed.isEmpty());
+    router.processIncomingData(batchFrame.mid(30));
+    QCOMPARE(routed, frames);
+
+    // 解码模式得到每条消息
+    MessageFrameHandler decoder;
+    QSignalSpy spy(&decoder, &MessageFrameHandler::messageReceived);
+    decoder.processIncomingData(batchFrame);
+    QCOMPARE(spy.count(), 5);
+    QCOMPARE(qvariant_cast<Message>(spy.at(3).at(0)).topic(), QString("batch/3"));
+
+    // V1 连接得到首尾相接的消息帧
+    batch.append(frames.at(0));
+    batch.append(frames.at(1));
+    QCOMPARE(batch.takeFrame(Message::ProtocolV1), frames.at(0) + frames.at(1));
+}
+
+void MessageTest::testNestedBatchFrame()
+{
+    const QByteArray frame = Message("batch/nested", "x").serialize(Message::ProtocolV2);
+
+    // 一层层嵌套的批量帧，每层只多一个帧头
+    MessageBatch batch;
+    QByteArray nested = frame;
+    for (int i = 0; i < 1000; ++i) {
+        batch.append(nested);
+        nested = batch.takeFrame(Message::ProtocolV2);
+    }
+
+    MessageFrameHandler router;
+    router.setRoutingMode(true);
+    QSignalSpy frames(&router, &MessageFrameHandler::frameReceived);
+    QSignalSpy errors(&router, &MessageFrameHandler::error);
+
+    // 只展开一层，发现嵌套即报告格式错误
+    router.processIncomingData(nested);
+    QCOMPARE(frames.count(), 0);
+    QCOMPARE(errors.count(), 1);
+    QCOMPARE(errors.at(0).at(0).toString(), QString("Malformed batch frame"));
+
+    // 之后的帧照常处理
+    batch.append(frame);
+    router.processIncomingData(batch.takeFrame(Message::ProtocolV2));
+    QCOMPARE(frames.count(), 1);
+}
+
+void MessageTest::testInvalidFrameLength()
+{
+    const QByteArray frame = Message("frame/invalid", "x").serialize(Message::ProtocolV2);
+    const QByteArray invalid("\x80\x00\x00\x00", 4);
+    QCOMPARE(Message::frameLength(invalid), -1);
+
+    MessageFrameHandler router;
+    router.setRoutingMode(true);
+    QSignalSpy frames(&router, &MessageFrameHandler::frameReceived);
+    QSignalSpy protocolErrors(&router, &MessageFrameHandler::protocolError);
+
+    // 非法长度之前的帧照常交出，之后的字节无法分帧，包括看起来完整的帧都被丢弃
+    router.processIncomingData(frame + invalid + frame);
+    QCOMPARE(frames.count(), 1);
+    QCOMPARE(protocolErrors.count(), 1);
+    QVERIFY(router.hasFailed());
+
+    router.processIncomingData(frame);
+    QCOMPARE(frames.count(), 1);
+    QCOMPARE(protocolErrors.count(), 1);
+
+    // 缓冲区中有残留数据时同样失败
+    MessageFrameHandler decoder;
+    QSignalSpy messages(&decoder, &MessageFrameHandler::messageReceived);
+    QSignalSpy decoderErrors(&decoder, &MessageFrameHandler::protocolError);
+    decoder.processIncomingData(frame.left(3));
+    decoder.processIncomingData(frame.mid(3) + invalid);
+    QCOMPARE(messages.count(), 1);
+    QCOMPARE(decoderErrors.count(), 1);
+
+    // 重新连接时清除失败状态
+    decoder.clearBuffer();
+    QVERIFY(!decoder.hasFailed());
+    decoder.processIncomingData(frame);
+    QCOMPARE(messages.count(), 2);
+}
+
+void MessageTest::testHeartbeatFrame()
+{
+    const quint64 token = Q_UINT64_C(0x0123456789ABCDEF);
+    const QByteArray ping = Message::heartbeatFrame(Message::Ping, token);
+    QCOMPARE(ping.size(), 24);
+    QCOMPARE(Message::frameLength(ping), 24);
+    QCOMPARE(Message::heartbeatType(ping), Message::Ping);
+    QCOMPARE(Message::heartbeatToken(ping), token);
+    QVERIFY(!Message::isBatchFrame(ping));
+
+    const QByteArray pong = Message::heartbeatFrame(Message::Pong, token);
+    QCOMPARE(Message::heartbeatType(pong), Message::Pong);
+    QCOMPARE(Message::heartbeatToken(pong), token);
+
+    // 普通消息帧不是心跳帧
+    const QByteArray frame = Message("heartbeat/topic", "data").serialize(Message::ProtocolV2);
+    QCOMPARE(Message::heartbeatType(frame), Message::NoHeartbeat);
+    QCOMPARE(Message::heartbeatToken(frame), quint64(0));
+    QCOMPARE(Message::heartbeatType(Message("heartbeat/topic", "data").serialize(Message::ProtocolV1)), Message::NoHeartbeat);
+
+    // 心跳帧夹在消息帧之间：两种模式都只发出心跳信号，不当作消息
+    const QByteArray stream = frame + ping + frame + pong;
+    for (int routing = 0; routing < 2; ++routing) {
+        MessageFrameHandler handler;
+        handler.setRoutingMode(routing);
+        QList<QPair<int, quint64> > heartbeats;
+        connect(&handler, &MessageFrameHandler::heartbeatReceived,
+                [&heartbeats](Message::HeartbeatType type, quint64 value) {
+            heartbeats.append(qMakePair(int(type), value));
+        });
+        QSignalSpy frames(&handler, &MessageFrameHandler::frameReceived);
+        QSignalSpy messages(&handler, &MessageFrameHandler::messageReceived);
+
+        handler.processIncomingData(stream.left(40));
+        handler.processIncomingData(stream.mid(40));
+        QCOMPARE(heartbeats.size(), 2);
+        QCOMPARE(heartbeats.at(0).first, int(Message::Ping));
+        QCOMPARE(heartbeats.at(1).first, int(Message::Pong));
+        QCOMPARE(heartbeats.at(1).second, token);
+        QCOMPARE(frames.count() + messages.count(), 2);
+    }
+}
+
+void MessageTest::testHeaders()
+{
+    Message message("orders/eu", "payload");
+    QVERIFY(message.headers().isEmpty());
+    message.setHeader("region", QString("eu-west"));
+    message.setHeader("priority", 7);
+    message.setHeader("offset", qlonglong(-1234567890123LL));
+    message.setHeader("ratio", 0.25);
+    message.setHeader("urgent", true);
+    message.setHeader("key", QByteArray("\x00\x01\xFF", 3));
+    message.setHeader("removed", 1);
+    message.setHeader("removed", QVariant());
+    QCOMPARE(message.headers().size(), 6);
+    QCOMPARE(message.header("priority").toInt(), 7);
+    QVERIFY(!message.header("removed").isValid());
+
+    // V2：头部在负载之前，只读取头部即可得到全部或单个值
+    const QByteArray frame = message.serialize(Message::ProtocolV2);
+    QCOMPARE(Message::frameVersion(frame), (int)Message::ProtocolV2);
+    QVariantMap headers;
+    QVERIFY(Message::peekHeaders(frame, headers));
+    QCOMPARE(headers.size(), 6);
+    QCOMPARE(headers.value("region").toString(), QString("eu-west"));
+    QCOMPARE(headers.value("offset").toLongLong(), -1234567890123LL);
+    QCOMPARE(headers.value("ratio").toDouble(), 0.25);
+    QCOMPARE(headers.value("urgent").toBool(), true);
+    QCOMPARE(headers.value("key").toByteArray(), QByteArray("\x00\x01\xFF", 3));
+    QCOMPARE(Message::peekHeader(frame, "priority").toLongLong(), 7LL);
+    QCOMPARE(Message::peekHeader(frame, "region").toString(), QString("eu-west"));
+    QVERIFY(!Message::peekHeader(frame, "missing").isValid());
+
+    Message decoded;
+    QVERIFY(decoded.deserializeFrame(frame));
+    QCOMPARE(decoded.topic(), QString("orders/eu"));
+    QCOMPARE(decoded.data(), QByteArray("payload"));
+    QCOMPARE(decoded.headers(), headers);
+
+    // Broker改写帧（写入序号、别名与完整主题互换）时头部原样保留
+    const QByteArray aliased = Message::withTopicAlias(Message::withSequence(frame, 42), 9);
+    QCOMPARE(Message::peekHeader(aliased, "region").toString(), QString("eu-west"));
+    QVERIFY(decoded.deserializeFrame(Message::withTopic(aliased, "orders/eu")));
+    QCOMPARE(decoded.sequence(), qint64(42));
+    QCOMPARE(decoded.data(), QByteArray("payload"));
+    QCOMPARE(decoded.headers(), headers);
+
+    // 没有头部的消息不带头部标志，查询得到空映射
+    const QByteArray plain = Message("orders/eu", "payload").serialize(Message::ProtocolV2);
+    QVERIFY(Message::peekHeaders(plain, headers));
+    QVERIFY(headers.isEmpty());
+    QVERIFY(!Message::peekHeader(plain, "region").isValid());
+
+    // V1 以 QVariantMap 形式携带头部
+    const QByteArray frameV1 = message.serialize(Message::ProtocolV1);
+    QVERIFY(Message::peekHeaders(frameV1, headers));
+    QCOMPARE(headers.value("region").toString(), QString("eu-west"));
+    QCOMPARE(Message::peekHeader(frameV1, "priority").toInt(), 7);
+    QVERIFY(decoded.deserializeFrame(frameV1));
+    QCOMPARE(decoded.sequence(), qint64(-1));
+    QCOMPARE(decoded.header("urgent").toBool(), true);
+
+    // 无法紧凑编码的值退回 V1
+    Message dated("orders/eu", "payload");
+    dated.setHeader("deadline", QDateTime::fromMSecsSinceEpoch(1000));
+    const QByteArray fallback = dated.serialize(Message::ProtocolV2);
+    QCOMPARE(Message::frameVersion(fallback), (int)Message::ProtocolV1);
+    QCOMPARE(Message::peekHeader(fallback, "deadline").toDateTime(), QDateTime::fromMSecsSinceEpoch(1000));
+}
+
 QTEST_MAIN(MessageTest)
 #include "message_test.moc"
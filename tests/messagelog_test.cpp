@@ -0,0 +1,283 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include "messagelog.h"
+#include "message.h"
+
+#include <algorithm>
+
+class MessageLogTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testAppendAndRead();
+    void testSegmentRoll();
+    void testRecovery();
+    void testTruncatePartialFrame();
+    void testRetention();
+    void testReadLast();
+    void testOffsetForTimestamp();
+
+private:
+    /**
+     * @brief 生成消息帧，负载中带有序号便于校验
+     */
+    static QByteArray frameFor(const QString& topic, int sequence, int payloadSize = 32);
+
+    /**
+     * @brief 解码消息帧中的负载
+     */
+    static QByteArray payloadOf(const QByteArray& frame);
+};
+
+QByteArray MessageLogTest::frameFor(const QString& topic, int sequence, int payloadSize)
+{
+    QByteArray payload = QByteArray::number(sequence);
+    payload.append(QByteArray(qMax(0, payloadSize - payload.size()), '.'));
+    return Message(topic, payload).serialize(Message::ProtocolV2);
+}
+
+QByteArray MessageLogTest::payloadOf(const QByteArray& frame)
+{
+    Message message;
+    if (!message.deserializeFrame(frame)) {
+        return QByteArray();
+    }
+    const QByteArray payload = message.data();
+    const int end = payload.indexOf('.');
+    return end < 0 ? payload : payload.left(end);
+}
+
+void MessageLogTest::testAppendAndRead()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    MessageLog log(dir.path());
+    QVERIFY(log.open());
+
+    for (int i = 0; i < 10; ++i) {
+        QCOMPARE(log.append("sensors/temp", frameFor("sensors/temp", i)), qint64(i));
+    }
+    QCOMPARE(log.append("sensors/humidity", frameFor("sensors/humidity", 0)), qint64(0));
+
+    QCOMPARE(log.nextOffset("sensors/temp"), qint64(10));
+    QCOMPARE(log.firstOffset("sensors/temp"), qint64(0));
+    QCOMPARE(log.topics().size(), 2);
+
+    qint64 start = -1;
+    const QList<QByteArray> frames = log.read("sensors/temp", 3, 4, &start);
+    QCOMPARE(start, qint64(3));
+    QCOMPARE(frames.size(), 4);
+    for (int i = 0; i < frames.size(); ++i) {
+        QCOMPARE(frames.at(i), frameFor("sensors/temp", 3 + i));
+    }
+
+    // 超出末尾和不存在的主题返回空
+    QVERIFY(log.read("sensors/temp", 10, 5).isEmpty());
+    QVERIFY(log.read("unknown", 0, 5).isEmpty());
+}
+
+void MessageLogTest::testSegmentRoll()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    MessageLog::Options options;
+    options.segmentBytes = 4096;
+    options.indexIntervalBytes = 256;
+    options.syncPolicy = MessageLog::SyncNone;
+
+    MessageLog log(dir.path(), options);
+    QVERIFY(log.open());
+
+    const int count = 500;
+    for (int i = 0; i < count; ++i) {
+        QCOMPARE(log.append("a/b", frameFor("a/b", i, 100)), qint64(i));
+    }
+
+    // 主题目录下应该有多个段文件
+    const QStringList topicDirs = QDir(dir.path()).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    QCOMPARE(topicDirs.size(), 1);
+    const QStringList segments = QDir(dir.filePath(topicDirs.first())).entryList(QStringList() << "*.log", QDir::Files);
+    QVERIFY(segments.size() > 1);
+
+    // 从任意偏移量开始读取，跨越段边界
+    const QList<int> starts = { 0, 1, 37, 38, 250, 499 };
+    for (int start : starts) {
+        const QList<QByteArray> frames = log.read("a/b", start, 60);
+        QCOMPARE(frames.size(), qMin(60, count - start));
+        for (int i = 0; i < frames.size(); ++i) {
+            QCOMPARE(payloadOf(frames.at(i)), QByteArray::number(start + i));
+        }
+    }
+}
+
+void MessageLogTest::testRecovery()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    MessageLog::Options options;
+    options.segmentBytes = 4096;
+
+    {
+        MessageLog log(dir.path(), options);
+        QVERIFY(log.open());
+        for (int i = 0; i < 200; ++i) {
+            log.append("plant/line1", frameFor("plant/line1", i, 100));
+        }
+        log.append("plant/line2", frameFor("plant/line2", 0));
+    }
+
+    MessageLog log(dir.path(), options);
+    QVERIFY(log.open());
+    QCOMPARE(log.topics().size(), 2);
+    QVERIFY(log.topics().contains("plant/line1"));
+    QCOMPARE(log.nextOffset("plant/line1"), qint64(200));
+    QCOMPARE(log.nextOffset("plant/line2"), qint64(1));
+
+    // 恢复之后继续追加，偏移量接着原来的编号
+    QCOMPARE(log.append("plant/line1", frameFor("plant/line1", 200, 100)), qint64(200));
+
+    const QList<QByteArray> frames = log.read("plant/line1", 190, 20);
+    QCOMPARE(frames.size(), 11);
+    for (int i = 0; i < frames.size(); ++i) {
+        QCOMPARE(payloadOf(frames.at(i)), QByteArray::number(190 + i));
+    }
+}
+
+void MessageLogTest::testTruncatePartialFrame()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QString segmentPath;
+    {
+        MessageLog log(dir.path());
+        QVERIFY(log.open());
+        for (int i = 0; i < 5; ++i) {
+            log.append("crash", frameFor("crash", i));
+        }
+    }
+
+    const QStringList topicDirs = QDir(dir.path()).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    QCOMPARE(topicDirs.size(), 1);
+    segmentPath = QDir(dir.filePath(topicDirs.first())).filePath("00000000000000000000.log");
+
+    // 模拟写入中途崩溃：末尾追加半个消息帧
+    {
+        QFile file(segmentPath);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Append));
+        const QByteArray partial = frameFor("crash", 5);
+        file.write(partial.left(partial.size() / 2));
+    }
+    const qint64 damagedSize = QFileInfo(segmentPath).size();
+
+    MessageLog log(dir.path());
+    QVERIFY(log.open());
+    QCOMPARE(log.nextOffset("crash"), qint64(5));
+    QVERIFY(QFileInfo(segmentPath).size() < damagedSize);
+
+    // 截断之后追加的消息可以正常读取
+    QCOMPARE(log.append("crash", frameFor("crash", 5)), qint64(5));
+    const QList<QByteArray> frames = log.read("crash", 0, 10);
+    QCOMPARE(frames.size(), 6);
+    QCOMPARE(payloadOf(frames.last()), QByteArray("5"));
+}
+
+void MessageLogTest::testRetention()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    MessageLog::Options options;
+    options.segmentBytes = 4096;
+    options.retentionBytes = 3 * 4096;
+    options.syncPolicy = MessageLog::SyncNone;
+
+    MessageLog log(dir.path(), options);
+    QVERIFY(log.open());
+
+    for (int i = 0; i < 1000; ++i) {
+        log.append("retained", frameFor("retained", i, 100));
+    }
+
+    // 旧段被删除，剩余的消息仍然连续
+    const qint64 first = log.firstOffset("retained");
+    QVERIFY(first > 0);
+    QCOMPARE(log.nextOffset("retained"), qint64(1000));
+
+    // 起点早于保留范围时报告实际读取的起点
+    qint64 start = -1;
+    const QList<QByteArray> frames = log.read("retained", 0, 2000, &start);
+    QCOMPARE(start, first);
+    QCOMPARE(qint64(frames.size()), 1000 - first);
+    QCOMPARE(payloadOf(frames.first()), QByteArray::number(first));
+    QCOMPARE(payloadOf(frames.last()), QByteArray("999"));
+}
+
+void MessageLogTest::testReadLast()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    MessageLog log(dir.path());
+    QVERIFY(log.open());
+
+    QVERIFY(log.readLast("empty", 5).isEmpty());
+
+    for (int i = 0; i < 3; ++i) {
+        log.append("last", frameFor("last", i));
+    }
+
+    QList<QByteArray> frames = log.readLast("last", 5);
+    QCOMPARE(frames.size(), 3);
+    QCOMPARE(payloadOf(frames.first()), QByteArray("0"));
+
+    for (int i = 3; i < 10; ++i) {
+        log.append("last", frameFor("last", i));
+    }
+
+    frames = log.readLast("last", 2);
+    QCOMPARE(frames.size(), 2);
+    QCOMPARE(payloadOf(frames.at(0)), QByteArray("8"));
+    QCOMPARE(payloadOf(frames.at(1)), QByteArray("9"));
+}
+
+void MessageLogTest::testOffsetForTimestamp()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    MessageLog::Options options;
+    options.segmentBytes = 4096;
+    options.indexIntervalBytes = 256;
+    options.syncPolicy = MessageLog::SyncNone;
+
+    MessageLog log(dir.path(), options);
+    QVERIFY(log.open());
+    QCOMPARE(log.offsetForTimestamp("timed", 0), qint64(0));
+
+    // 记录每条消息的时间戳，跨越多个段
+    QList<qint64> timestamps;
+    for (int i = 0; i < 300; ++i) {
+        const QByteArray frame = frameFor("timed", i, 100);
+        timestamps.append(Message::peekTimestampNs(frame));
+        log.append("timed", frame);
+    }
+
+    QCOMPARE(log.offsetForTimestamp("timed", timestamps.first() - 1), qint64(0));
+    QCOMPARE(log.offsetForTimestamp("timed", timestamps.last() + 1), qint64(300));
+
+    const QList<int> targets = { 1, 37, 38, 150, 299 };
+    for (int target : targets) {
+        // 时间戳相同的消息取第一条
+        const int expected = int(std::lower_bound(timestamps.begin(), timestamps.end(), timestamps.at(target))
+                                 - timestamps.begin());
+        QCOMPARE(log.offsetForTimestamp("timed", timestamps.at(target)), qint64(expected));
+    }
+}
+
+QTEST_MAIN(MessageLogTest)
+#include "messagelog_test.moc"
@@ -0,0 +1,96 @@
+#include <QtTest>
+#include "brokermetrics.h"
+
+#include <utility>
+
+/**
+ * @brief 指标记录开销基准测试
+ *
+ * 按 BrokerWorker 的转发路径记录每条消息的指标：发布者和主题的接收计数、路由缓存和扇出、
+ * 每个订阅者和主题的发送计数，以及每个读事件读一次时钟、按批记录停留时间。
+ * 报告每条消息的开销及其在 1M 条/秒（每条 1 微秒）预算中的占比。
+ */
+class MetricsBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void reportRecordingCost_data();
+    void reportRecordingCost();
+};
+
+void MetricsBenchmark::reportRecordingCost_data()
+{
+    QTest::addColumn<int>("subscribers");
+    QTest::addColumn<int>("topicCount");
+
+    QTest::newRow("1 subscriber, 1 topic") << 1 << 1;
+    QTest::newRow("1 subscriber, 10000 topics") << 1 << 10000;
+    QTest::newRow("10 subscribers, 1000 topics") << 10 << 1000;
+}
+
+void MetricsBenchmark::reportRecordingCost()
+{
+    QFETCH(int, subscribers);
+    QFETCH(int, topicCount);
+
+    MetricsShard metrics;
+    MetricsShard::ClientCounters* publisher = metrics.addClient(1, "publisher");
+    QVector<MetricsShard::ClientCounters*> clients;
+    for (int i = 0; i < subscribers; ++i) {
+        clients.append(metrics.addClient(ClientHandle(i + 2), QString("subscriber-%1").arg(i)));
+    }
+
+    // 一个读事件读入一批消息，停留时间在这一批写出后统一记录
+    const int messageCount = 2000000;
+    const int batchSize = 64;
+    const quint64 frameSize = 128;
+    QVector<qint64> pendingResidence;
+    pendingResidence.reserve(batchSize);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int sent = 0; sent < messageCount; sent += batchSize) {
+        const qint64 receivedAt = MetricsShard::now();
+        for (int i = 0; i < batchSize; ++i) {
+            const TopicId topicId = TopicId((sent + i) % topicCount + 1);
+
+            publisher->messagesIn.add(1);
+            publisher->bytesIn.add(frameSize);
+            MetricsShard::TrafficCounters* topic = metrics.topic(topicId);
+            topic->messagesIn.add(1);
+            topic->bytesIn.add(frameSize);
+            metrics.recordRouteCache(true);
+            metrics.recordRoute(subscribers);
+
+            for (MetricsShard::ClientCounters* client : std::as_const(clients)) {
+                client->messagesOut.add(1);
+                client->bytesOut.add(frameSize);
+            }
+            topic = metrics.topic(topicId);
+            topic->messagesOut.add(quint64(subscribers));
+            topic->bytesOut.add(frameSize * quint64(subscribers));
+            pendingResidence.append(receivedAt);
+        }
+
+        const qint64 now = MetricsShard::now();
+        for (qint64 receivedAt : std::as_const(pendingResidence)) {
+            metrics.recordResidence(now - receivedAt);
+        }
+        pendingResidence.clear();
+    }
+    const double nsPerMessage = double(timer.nsecsElapsed()) / messageCount;
+
+    BrokerStats stats;
+    QHash<TopicId, TrafficStats> topics;
+    metrics.collect(&stats, &topics);
+    QCOMPARE(stats.total.messagesIn, quint64(messageCount));
+    QCOMPARE(stats.residence.count(), quint64(messageCount));
+    QCOMPARE(topics.size(), topicCount);
+
+    qInfo("%s: %.1f ns/message, %.2f%% of the budget at 1M msgs/s",
+          QTest::currentDataTag(), nsPerMessage, nsPerMessage / 1000.0 * 100.0);
+}
+
+QTEST_MAIN(MetricsBenchmark)
+#include "metrics_benchmark.moc"
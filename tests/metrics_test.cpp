@@ -0,0 +1,145 @@
+#include <QtTest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include "brokermetrics.h"
+
+class MetricsTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testBucketBoundaries();
+    void testPercentiles();
+    void testMerge();
+    void testShardCollect();
+};
+
+void MetricsTest::testBucketBoundaries()
+{
+    // 桶首尾相接，上下界都落在自己的桶中
+    QCOMPARE(LatencyHistogram::bucketLowerBound(0), quint64(0));
+    for (int i = 0; i < LatencyHistogram::kBucketCount; ++i) {
+        const quint64 lower = LatencyHistogram::bucketLowerBound(i);
+        const quint64 upper = LatencyHistogram::bucketUpperBound(i);
+        QCOMPARE(LatencyHistogram::bucketIndex(lower), i);
+        QCOMPARE(LatencyHistogram::bucketIndex(upper), i);
+        if (i > 0) {
+            QCOMPARE(lower, LatencyHistogram::bucketUpperBound(i - 1) + 1);
+        }
+
+        // 相对误差不超过 1/16
+        QVERIFY((upper - lower) * 16 <= qMax<quint64>(lower, 1));
+    }
+
+    // 超出范围的值记入最后一个桶
+    QCOMPARE(LatencyHistogram::bucketUpperBound(LatencyHistogram::kBucketCount - 1), quint64(LatencyHistogram::kMaxValue));
+    QCOMPARE(LatencyHistogram::bucketIndex(quint64(1) << 50), LatencyHistogram::kBucketCount - 1);
+}
+
+void MetricsTest::testPercentiles()
+{
+    LatencyHistogram histogram;
+    QCOMPARE(histogram.percentile(99), quint64(0));
+
+    for (quint64 value = 1; value <= 10000; ++value) {
+        histogram.record(value);
+    }
+
+    QCOMPARE(histogram.count(), quint64(10000));
+    QCOMPARE(histogram.min(), quint64(1));
+    QCOMPARE(histogram.max(), quint64(10000));
+    QCOMPARE(histogram.mean(), 5000.5);
+
+    // 百分位数是所在桶的上界：不小于真实值，误差不超过 1/16
+    const double percentiles[] = { 50, 90, 99, 99.9 };
+    for (double percentile : percentiles) {
+        const quint64 exact = quint64(percentile * 100);
+        const quint64 reported = histogram.percentile(percentile);
+        QVERIFY2(reported >= exact && reported <= exact + exact / 16, qPrintable(QString::number(percentile)));
+    }
+    QCOMPARE(histogram.percentile(100), quint64(10000));
+}
+
+void MetricsTest::testMerge()
+{
+    LatencyHistogram first;
+    LatencyHistogram second;
+    first.record(100, 3);
+    second.record(5000);
+    second.record(20);
+
+    first.add(second);
+    QCOMPARE(first.count(), quint64(5));
+    QCOMPARE(first.min(), quint64(20));
+    QCOMPARE(first.max(), quint64(5000));
+    QCOMPARE(first.bucketCount(LatencyHistogram::bucketIndex(100)), quint64(3));
+    QCOMPARE(first.percentile(10), quint64(20));
+}
+
+void MetricsTest::testShardCollect()
+{
+    MetricsShard origin;
+    MetricsShard target;
+
+    // 同一主题在一个线程收、在另一个线程发，快照按主题编号合并
+    MetricsShard::TrafficCounters* in = origin.topic(3);
+    QVERIFY(in);
+    QCOMPARE(origin.topic(3), in);
+    QVERIFY(!origin.topic(TopicRegistry::InvalidTopic));
+    in->messagesIn.add(2);
+    in->bytesIn.add(200);
+    target.topic(3)->messagesOut.add(4);
+    target.topic(3)->bytesOut.add(400);
+    target.topic(70)->messagesOut.add(1);
+
+    MetricsShard::ClientCounters* publisher = origin.addClient(1, "publisher");
+    publisher->messagesIn.add(2);
+    MetricsShard::ClientCounters* subscriber = target.addClient(1, "subscriber");
+    subscriber->messagesOut.add(4);
+    subscriber->queuedMessages.set(7);
+    target.addClient(2, "gone");
+    target.removeClient(2);
+
+    origin.recordRouteCache(false);
+    origin.recordRouteCache(true);
+    origin.recordRoute(4);
+    target.recordResidence(1500);
+    target.recordResidence(-5);
+
+    BrokerStats stats;
+    QHash<TopicId, TrafficStats> topics;
+    origin.collect(&stats, &topics);
+    target.collect(&stats, &topics);
+
+    QCOMPARE(topics.size(), 2);
+    QCOMPARE(topics.value(3).messagesIn, quint64(2));
+    QCOMPARE(topics.value(3).bytesIn, quint64(200));
+    QCOMPARE(topics.value(3).messagesOut, quint64(4));
+    QCOMPARE(topics.value(3).bytesOut, quint64(400));
+    QCOMPARE(stats.total.messagesIn, quint64(2));
+    QCOMPARE(stats.total.messagesOut, quint64(5));
+
+    QCOMPARE(stats.clients.size(), 2);
+    QCOMPARE(stats.clients.value("publisher").messagesIn, quint64(2));
+    QCOMPARE(stats.clients.value("subscriber").messagesOut, quint64(4));
+    QCOMPARE(stats.clients.value("subscriber").queuedMessages, quint64(7));
+
+    QCOMPARE(stats.routeCacheHits, quint64(1));
+    QCOMPARE(stats.routeCacheMisses, quint64(1));
+    QCOMPARE(stats.matchedSubscribers, quint64(4));
+
+    // 负数（时钟读数的先后颠倒）按0记录；其他值落在原来的桶中
+    QCOMPARE(stats.residence.count(), quint64(2));
+    QCOMPARE(stats.residence.min(), quint64(0));
+    QCOMPARE(LatencyHistogram::bucketIndex(stats.residence.max()), LatencyHistogram::bucketIndex(1500));
+
+    // JSON 摘要可以被解析，停留时间以微秒为单位
+    const QJsonObject broker = QJsonDocument::fromJson(stats.brokerJson()).object();
+    QCOMPARE(broker.value("messagesOut").toDouble(), 5.0);
+    QVERIFY(qAbs(broker.value("residenceUs").toObject().value("max").toDouble() - 1.5) < 0.1);
+    const QJsonObject clients = QJsonDocument::fromJson(stats.clientsJson()).object().value("clients").toObject();
+    QCOMPARE(clients.value("subscriber").toObject().value("queuedMessages").toDouble(), 7.0);
+}
+
+QTEST_MAIN(MetricsTest)
+#include "metrics_test.moc"
@@ -0,0 +1,182 @@
+#include <QtTest>
+#include "outboundqueue.h"
+#include "subscriptionoptions.h"
+
+class OutboundQueueTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testFifo();
+    void testDropOldest();
+    void testDropNewest();
+    void testConflateLatest();
+    void testDisconnect();
+    void testByteLimit();
+    void testSubscriptionOptionsPayload();
+    void testStartPositionPayload();
+};
+
+void OutboundQueueTest::testFifo()
+{
+    OutboundQueue queue(10, 1024);
+    int dropped = 0;
+
+    QCOMPARE(queue.push("a", "1", SubscriptionOptions::DropOldest, &dropped), OutboundQueue::Queued);
+    QCOMPARE(queue.push("a", "22", SubscriptionOptions::DropOldest, &dropped), OutboundQueue::Queued);
+    QCOMPARE(queue.size(), 2);
+    QCOMPARE(queue.bytes(), qint64(3));
+
+    QCOMPARE(queue.front(), QByteArray("1"));
+    queue.pop();
+    QCOMPARE(queue.front(), QByteArray("22"));
+    queue.pop();
+    QVERIFY(queue.isEmpty());
+    QCOMPARE(queue.bytes(), qint64(0));
+}
+
+void OutboundQueueTest::testDropOldest()
+{
+    OutboundQueue queue(2, 1024);
+    int dropped = 0;
+
+    queue.push("a", "1", SubscriptionOptions::DropOldest, &dropped);
+    queue.push("a", "2", SubscriptionOptions::DropOldest, &dropped);
+    QCOMPARE(queue.push("a", "3", SubscriptionOptions::DropOldest, &dropped), OutboundQueue::Queued);
+    QCOMPARE(dropped, 1);
+
+    // 最旧的消息被丢弃
+    QCOMPARE(queue.size(), 2);
+    QCOMPARE(queue.front(), QByteArray("2"));
+}
+
+void OutboundQueueTest::testDropNewest()
+{
+    OutboundQueue queue(2, 1024);
+    int dropped = 0;
+
+    queue.push("a", "1", SubscriptionOptions::DropNewest, &dropped);
+    queue.push("a", "2", SubscriptionOptions::DropNewest, &dropped);
+    QCOMPARE(queue.push("a", "3", SubscriptionOptions::DropNewest, &dropped), OutboundQueue::DroppedNewest);
+    QCOMPARE(dropped, 0);
+
+    QCOMPARE(queue.size(), 2);
+    QCOMPARE(queue.front(), QByteArray("1"));
+}
+
+void OutboundQueueTest::testConflateLatest()
+{
+    OutboundQueue queue(10, 1024);
+    int dropped = 0;
+
+    queue.push("a", "a1", SubscriptionOptions::ConflateLatest, &dropped);
+    queue.push("b", "b1", SubscriptionOptions::ConflateLatest, &dropped);
+    QCOMPARE(queue.push("a", "a22", SubscriptionOptions::ConflateLatest, &dropped), OutboundQueue::Conflated);
+
+    // 每个主题只保留最新的一条，位置不变
+    QCOMPARE(queue.size(), 2);
+    QCOMPARE(queue.bytes(), qint64(5));
+    QCOMPARE(queue.front(), QByteArray("a22"));
+    queue.pop();
+
+    // 已发送的消息不再被合并
+    QCOMPARE(queue.push("a", "a3", SubscriptionOptions::ConflateLatest, &dropped), OutboundQueue::Queued);
+    QCOMPARE(queue.push("b", "b2", SubscriptionOptions::ConflateLatest, &dropped), OutboundQueue::Conflated);
+    QCOMPARE(queue.front(), QByteArray("b2"));
+    queue.pop();
+    QCOMPARE(queue.front(), QByteArray("a3"));
+}
+
+void OutboundQueueTest::testDisconnect()
+{
+    OutboundQueue queue(1, 1024);
+    int dropped = 0;
+
+    queue.push("a", "1", SubscriptionOptions::Disconnect, &dropped);
+    QCOMPARE(queue.push("a", "2", SubscriptionOptions::Disconnect, &dropped), OutboundQueue::Overflowed);
+
+    // 队列不被修改，由调用者断开连接
+    QCOMPARE(queue.size(), 1);
+    QCOMPARE(queue.front(), QByteArray("1"));
+}
+
+void OutboundQueueTest::testByteLimit()
+{
+    OutboundQueue queue(100, 10);
+    int dropped = 0;
+
+    queue.push("a", QByteArray(4, 'x'), SubscriptionOptions::DropOldest, &dropped);
+    queue.push("a", QByteArray(4, 'y'), SubscriptionOptions::DropOldest, &dropped);
+    QCOMPARE(queue.push("a", QByteArray(4, 'z'), SubscriptionOptions::DropOldest, &dropped), OutboundQueue::Queued);
+    QCOMPARE(dropped, 1);
+    QCOMPARE(queue.bytes(), qint64(8));
+
+    // 单条消息超过字节上限时无法放入
+    QCOMPARE(queue.push("a", QByteArray(11, 'w'), SubscriptionOptions::DropOldest, &dropped), OutboundQueue::DroppedNewest);
+}
+
+void OutboundQueueTest::testSubscriptionOptionsPayload()
+{
+    // 默认选项的负载与旧版本订阅请求相同
+    QCOMPARE(SubscriptionOptions().toPayload("sensors/#"), QByteArray("sensors/#"));
+
+    QString topic;
+    SubscriptionOptions options = SubscriptionOptions::fromPayload("sensors/#", &topic);
+    QCOMPARE(topic, QString("sensors/#"));
+    QCOMPARE(options.overflowPolicy, SubscriptionOptions::DefaultPolicy);
+
+    const QByteArray payload = SubscriptionOptions(SubscriptionOptions::ConflateLatest).toPayload("sensors/+/temp");
+    options = SubscriptionOptions::fromPayload(payload, &topic);
+    QCOMPARE(topic, QString("sensors/+/temp"));
+    QCOMPARE(options.overflowPolicy, SubscriptionOptions::ConflateLatest);
+
+    // 未知选项被忽略
+    options = SubscriptionOptions::fromPayload("a/b\nunknown=1\noverflow=disconnect", &topic);
+    QCOMPARE(topic, QString("a/b"));
+    QCOMPARE(options.overflowPolicy, SubscriptionOptions::Disconnect);
+}
+
+void OutboundQueueTest::testStartPositionPayload()
+{
+    QString topic;
+    SubscriptionOptions options = SubscriptionOptions::fromPayload("sensors/#", &topic);
+    QCOMPARE(options.startPosition, SubscriptionOptions::StartFromCache);
+    QVERIFY(options.resumeOffsets.isEmpty());
+
+    options = SubscriptionOptions::fromPayload(SubscriptionOptions::newOnly().toPayload("a"), &topic);
+    QCOMPARE(options.startPosition, SubscriptionOptions::StartNewOnly);
+
+    options = SubscriptionOptions::fromPayload(SubscriptionOptions::fromOffset(1043).toPayload("a"), &topic);
+    QCOMPARE(options.startPosition, SubscriptionOptions::StartFromOffset);
+    QCOMPARE(options.startValue, qint64(1043));
+
+    const qint64 timestampNs = Q_INT64_C(1700000000123456789);
+    options = SubscriptionOptions::fromPayload(SubscriptionOptions::fromTimestamp(timestampNs).toPayload("a"), &topic);
+    QCOMPARE(options.startPosition, SubscriptionOptions::StartFromTime);
+    QCOMPARE(options.startValue, timestampNs);
+
+    SubscriptionOptions lastN = SubscriptionOptions::lastN(10);
+    lastN.overflowPolicy = SubscriptionOptions::DropNewest;
+    options = SubscriptionOptions::fromPayload(lastN.toPayload("a"), &topic);
+    QCOMPARE(options.startPosition, SubscriptionOptions::StartLastN);
+    QCOMPARE(options.startValue, qint64(10));
+    QCOMPARE(options.overflowPolicy, SubscriptionOptions::DropNewest);
+
+    // 续传位置中的主题可以包含 ':' 和空格
+    SubscriptionOptions resumed;
+    resumed.resumeOffsets.insert("plant/line:1", 5);
+    resumed.resumeOffsets.insert("plant/line 2 ", 17);
+    options = SubscriptionOptions::fromPayload(resumed.toPayload("plant/#"), &topic);
+    QCOMPARE(topic, QString("plant/#"));
+    QCOMPARE(options.resumeOffsets.size(), 2);
+    QCOMPARE(options.resumeOffsets.value("plant/line:1"), qint64(5));
+    QCOMPARE(options.resumeOffsets.value("plant/line 2 "), qint64(17));
+
+    // 格式错误的起始位置被忽略
+    options = SubscriptionOptions::fromPayload("a\nstart=offset:abc\nresume=x:a", &topic);
+    QCOMPARE(options.startPosition, SubscriptionOptions::StartFromCache);
+    QVERIFY(options.resumeOffsets.isEmpty());
+}
+
+QTEST_MAIN(OutboundQueueTest)
+#include "outboundqueue_test.moc"
@@ -1,5 +1,6 @@
 #include <QtTest>
 #include "publisher.h"
+#include "subscriber.h"
 #include "broker.h"
 #include "logger.h"
 
@@ -13,6 +14,10 @@ private slots:
     void testConstructor();
     void testAutoReconnect();
     void testPublish();
+    void testPublishBatch();
+    void testLingerBatching();
+    void testConfirms();
+    void testKeepAlive();
 };
 
 void PublisherTest::initTestCase()
@@ -99,5 +104,169 @@ void PublisherTest::testPublish()
     QTest::qWait(100);
 }
 
+void PublisherTest::testPublishBatch()
+{
+    Broker* broker = Broker::instance();
+    if (!broker->isRunning()) {
+        broker->start(5557, "PublisherTestBroker");
+        QTest::qWait(100);
+    }
+
+    Publisher publisher;
+    Subscriber subscriber;
+    if (!publisher.connectToBroker("localhost", 5557) || !subscriber.connectToBroker("localhost", 5557)) {
+        QSKIP("Could not connect to broker, skipping test");
+    }
+    QTest::qWait(100);
+
+    const QString topic = "test/batch";
+    QVERIFY(subscriber.subscribe(topic));
+    QTest::qWait(100);
+
+    // 一个批量帧中的消息按顺序路由，每条都有自己的序号
+    QSignalSpy receivedSpy(&subscriber, &Subscriber::messageReceived);
+    QSignalSpy publishedSpy(&publisher, &Publisher::published);
+    QVector<Message> batch;
+    for (int i = 0; i < 50; ++i) {
+        batch.append(Message(topic, QByteArray::number(i)));
+    }
+    QVERIFY(publisher.publishBatch(batch));
+    QCOMPARE(publishedSpy.count(), 50);
+
+    QTRY_COMPARE_WITH_TIMEOUT(receivedSpy.count(), 50, 2000);
+    for (int i = 0; i < 50; ++i) {
+        const Message received = qvariant_cast<Message>(receivedSpy.at(i).at(0));
+        QCOMPARE(received.data(), QByteArray::number(i));
+        QCOMPARE(received.sequence(), qint64(i));
+    }
+
+    subscriber.disconnectFromBroker();
+    publisher.disconnectFromBroker();
+    QTest::qWait(100);
+}
+
+void PublisherTest::testLingerBatching()
+{
+    Broker* broker = Broker::instance();
+    if (!broker->isRunning()) {
+        broker->start(5557, "PublisherTestBroker");
+        QTest::qWait(100);
+    }
+
+    Publisher publisher;
+    Subscriber subscriber;
+    if (!publisher.connectToBroker("localhost", 5557) || !subscriber.connectToBroker("localhost", 5557)) {
+        QSKIP("Could not connect to broker, skipping test");
+    }
+    QTest::qWait(100);
+
+    const QString topic = "test/linger";
+    QVERIFY(subscriber.subscribe(topic));
+    QTest::qWait(100);
+
+    // 批次满了立即写出，剩余的消息在逗留定时器到期后写出
+    QSignalSpy receivedSpy(&subscriber, &Subscriber::messageReceived);
+    QSignalSpy publishedSpy(&publisher, &Publisher::published);
+    publisher.setBatching(4, 20);
+    for (int i = 0; i < 6; ++i) {
+        QVERIFY(publisher.publish(topic, QByteArray::number(i)));
+    }
+    QCOMPARE(publishedSpy.count(), 4);
+
+    QTRY_COMPARE_WITH_TIMEOUT(receivedSpy.count(), 6, 2000);
+    QCOMPARE(publishedSpy.count(), 6);
+    QCOMPARE(qvariant_cast<Message>(receivedSpy.at(5).at(0)).data(), QByteArray("5"));
+
+    subscriber.disconnectFromBroker();
+    publisher.disconnectFromBroker();
+    QTest::qWait(100);
+}
+
+void PublisherTest::testConfirms()
+{
+    Broker* broker = Broker::instance();
+    if (!broker->isRunning()) {
+        broker->start(5557, "PublisherTestBroker");
+        QTest::qWait(100);
+    }
+
+    Publisher publisher;
+    publisher.setConfirmsEnabled(true, 8);
+    if (!publisher.connectToBroker("localhost", 5557)) {
+        QSKIP("Could not connect to broker, skipping test");
+    }
+    QTest::qWait(100);
+
+    // 发布不等待确认，超出窗口的消息在本地排队，随确认陆续发出
+    QSignalSpy confirmedSpy(&publisher, &Publisher::confirmed);
+    QSignalSpy nackedSpy(&publisher, &Publisher::nacked);
+    QSignalSpy publishedSpy(&publisher, &Publisher::published);
+    QStringList ids;
+    for (int i = 0; i < 100; ++i) {
+        Message message("test/confirms", QByteArray::number(i));
+        ids.append(message.id());
+        QVERIFY(publisher.publish(message));
+    }
+    QCOMPARE(publishedSpy.count(), 8);
+    QCOMPARE(publisher.inFlightCount(), 8);
+
+    QTRY_COMPARE_WITH_TIMEOUT(confirmedSpy.count(), 100, 5000);
+    QCOMPARE(publishedSpy.count(), 100);
+    QCOMPARE(publisher.inFlightCount(), 0);
+    QCOMPARE(nackedSpy.count(), 0);
+    for (int i = 0; i < 100; ++i) {
+        QCOMPARE(confirmedSpy.at(i).at(0).toString(), ids.at(i));
+    }
+
+    // 批量帧中的消息同样按条确认
+    QVector<Message> batch;
+    for (int i = 0; i < 5; ++i) {
+        batch.append(Message("test/confirms", QByteArray::number(i)));
+    }
+    QVERIFY(publisher.publishBatch(batch));
+    QTRY_COMPARE_WITH_TIMEOUT(confirmedSpy.count(), 105, 2000);
+
+    publisher.disconnectFromBroker();
+    QTest::qWait(100);
+}
+
+void PublisherTest::testKeepAlive()
+{
+    Broker* broker = Broker::instance();
+    if (!broker->isRunning()) {
+        broker->start(5557, "PublisherTestBroker");
+        QTest::qWait(100);
+    }
+
+    // Broker默认的空闲超时缩短为2秒，只在建立连接时生效
+    broker->setIdleTimeout(2);
+
+    // 协商1秒的心跳：空闲超时变为1.5秒（向上取整为2秒），安静的连接靠心跳保持
+    Publisher alive;
+    alive.setKeepAlive(1);
+    Publisher silent;
+    silent.setKeepAlive(0);
+    const bool aliveConnected = alive.connectToBroker("localhost", 5557);
+    const bool silentConnected = silent.connectToBroker("localhost", 5557);
+    broker->setIdleTimeout(60);
+    if (!aliveConnected || !silentConnected) {
+        QSKIP("Could not connect to broker, skipping test");
+    }
+    QCOMPARE(alive.keepAlive(), 1);
+    QTRY_COMPARE_WITH_TIMEOUT(alive.negotiatedKeepAlive(), 1, 2000);
+    QCOMPARE(silent.negotiatedKeepAlive(), 0);
+
+    // 不发心跳的连接在空闲超时后被断开，发心跳的连接保持
+    QSignalSpy aliveDisconnected(&alive, &Publisher::disconnected);
+    QTRY_VERIFY_WITH_TIMEOUT(!silent.isConnected(), 5000);
+    QTest::qWait(2000);
+    QVERIFY(alive.isConnected());
+    QCOMPARE(aliveDisconnected.count(), 0);
+
+    alive.disconnectFromBroker();
+    QCOMPARE(alive.negotiatedKeepAlive(), 0);
+    QTest::qWait(100);
+}
+
 QTEST_MAIN(PublisherTest)
 #include "publisher_test.moc"
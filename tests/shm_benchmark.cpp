@@ -0,0 +1,176 @@
+#include <QtTest>
+#include "shmring.h"
+#include "broker.h"
+#include "publisher.h"
+#include "subscriber.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 共享内存传输的往返延迟基准测试
+ *
+ * reportRingPingPong 在两个线程之间经过一对 ShmRing 来回传递64字节的消息，双方都忙等，
+ * 测得的是共享内存传输本身的往返延迟。
+ * reportEndToEndLatency 经过Broker测量发布者到订阅者的延迟，比较本地套接字和共享内存通道；
+ * Broker和客户端都由事件循环驱动，空闲时由门铃唤醒，包含了线程唤醒的开销。
+ */
+class ShmBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void reportRingPingPong();
+    void reportEndToEndLatency_data();
+    void reportEndToEndLatency();
+
+private:
+    /**
+     * @brief 输出延迟分位数
+     * @param label 标签
+     * @param samples 每次往返的纳秒数，会被排序
+     */
+    static void reportPercentiles(const char* label, std::vector<qint64>& samples);
+};
+
+static const int kBenchmarkPort = 5561;
+static const char* const kServerName = "ShmBenchmark";
+
+static const quint32 kRingCapacity = 64 * 1024;
+alignas(64) static char s_pingMemory[kRingCapacity + 4096];
+alignas(64) static char s_pongMemory[kRingCapacity + 4096];
+
+void ShmBenchmark::initTestCase()
+{
+    Logger::instance()->init("shm_benchmark.log", Logger::WARNING);
+
+    QVERIFY(Broker::instance()->start(kBenchmarkPort, kServerName));
+    Broker::instance()->setCacheSize(0);
+}
+
+void ShmBenchmark::cleanupTestCase()
+{
+    Broker::forceCleanup();
+}
+
+void ShmBenchmark::reportPercentiles(const char* label, std::vector<qint64>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+    qInfo("%s: round trip p50 %.2f us, p99 %.2f us, p99.9 %.2f us (%d samples)", label,
+          samples[n / 2] / 1000.0, samples[n * 99 / 100] / 1000.0, samples[n * 999 / 1000] / 1000.0, int(n));
+}
+
+void ShmBenchmark::reportRingPingPong()
+{
+    ShmRing ping;
+    ShmRing pong;
+    ping.initialize(s_pingMemory, kRingCapacity);
+    pong.initialize(s_pongMemory, kRingCapacity);
+
+    const int warmup = 10000;
+    const int rounds = 200000;
+    const int messageSize = 64;
+
+    // 对端线程把收到的消息原样写回
+    std::atomic<bool> done(false);
+    std::thread echo([&ping, &pong, &done, messageSize]() {
+        char buffer[64];
+        while (!done.load(std::memory_order_relaxed)) {
+            if (ping.bytesAvailable() >= messageSize) {
+                ping.read(buffer, messageSize);
+                while (pong.write(buffer, messageSize) == 0) {
+                }
+            }
+        }
+    });
+
+    std::vector<qint64> samples;
+    samples.reserve(rounds);
+    char message[64] = {};
+    char reply[64];
+    for (int i = 0; i < warmup + rounds; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        while (ping.write(message, messageSize) == 0) {
+        }
+        while (pong.bytesAvailable() < messageSize) {
+        }
+        pong.read(reply, messageSize);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        if (i >= warmup) {
+            samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+    done.store(true);
+    echo.join();
+
+    reportPercentiles("ShmRing ping-pong, 64 B, busy polling", samples);
+}
+
+void ShmBenchmark::reportEndToEndLatency_data()
+{
+    QTest::addColumn<bool>("sharedMemory");
+
+    QTest::newRow("local socket") << false;
+    QTest::newRow("shared memory") << true;
+}
+
+void ShmBenchmark::reportEndToEndLatency()
+{
+    QFETCH(bool, sharedMemory);
+
+    const QString topic = QString("bench/shm/%1").arg(sharedMemory);
+
+    Publisher publisher;
+    Subscriber subscriber;
+    publisher.setSharedMemoryEnabled(sharedMemory);
+    subscriber.setSharedMemoryEnabled(sharedMemory);
+    QVERIFY(publisher.connectToLocalBroker(kServerName));
+    QVERIFY(subscriber.connectToLocalBroker(kServerName));
+    QTRY_COMPARE_WITH_TIMEOUT(publisher.isUsingSharedMemory() && subscriber.isUsingSharedMemory(), sharedMemory, 2000);
+    QVERIFY(subscriber.subscribe(topic));
+    QTest::qWait(200);
+
+    int received = 0;
+    connect(&subscriber, &Subscriber::messageReceived, this, [&received]() { ++received; });
+
+    // 每次发布一条，忙着处理事件直到订阅者收到，测得发布者到订阅者再回到调用方的时间
+    const int warmup = 500;
+    const int rounds = 5000;
+    const QByteArray payload(64, 'x');
+    std::vector<qint64> samples;
+    samples.reserve(rounds);
+    for (int i = 0; i < warmup + rounds; ++i) {
+        const int expected = received + 1;
+        const auto start = std::chrono::steady_clock::now();
+        publisher.publish(topic, payload);
+        QElapsedTimer timeout;
+        timeout.start();
+        while (received < expected) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents);
+            if (timeout.elapsed() > 5000) {
+                QFAIL("Message was not delivered");
+            }
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        if (i >= warmup) {
+            samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+    reportPercentiles(QTest::currentDataTag(), samples);
+
+    subscriber.disconnectFromBroker();
+    publisher.disconnectFromBroker();
+    QTest::qWait(100);
+}
+
+QTEST_MAIN(ShmBenchmark)
+#include "shm_benchmark.moc"
@@ -0,0 +1,173 @@
+#include <QtTest>
+#include "shmring.h"
+
+#include <thread>
+
+class ShmRingTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testWrapAround();
+    void testAttach();
+    void testWaitingFlags();
+    void testCorruptedIndices();
+    void testConcurrentStream();
+};
+
+static const quint32 kCapacity = 4096;
+alignas(64) static char s_memory[8192 + 4096];
+
+void ShmRingTest::testWrapAround()
+{
+    ShmRing ring;
+    ring.initialize(s_memory, kCapacity);
+    QCOMPARE(ring.capacity(), kCapacity);
+
+    // 空间不足时只写入一部分
+    const QByteArray big(kCapacity + 100, 'x');
+    QCOMPARE(ring.write(big.constData(), big.size()), qint64(kCapacity));
+    QCOMPARE(ring.write("y", 1), qint64(0));
+
+    QByteArray out(kCapacity, '\0');
+    QCOMPARE(ring.read(out.data(), 3000), qint64(3000));
+
+    // 跨过数据区末尾的写和读
+    const QByteArray tail = QByteArray("0123456789").repeated(200);
+    QCOMPARE(ring.write(tail.constData(), tail.size()), qint64(tail.size()));
+    QCOMPARE(ring.bytesAvailable(), qint64(kCapacity - 3000 + tail.size()));
+    QCOMPARE(ring.read(out.data(), kCapacity - 3000), qint64(kCapacity - 3000));
+    QCOMPARE(ring.read(out.data(), out.size()), qint64(tail.size()));
+    QCOMPARE(out.left(tail.size()), tail);
+    QCOMPARE(ring.read(out.data(), out.size()), qint64(0));
+}
+
+void ShmRingTest::testAttach()
+{
+    ShmRing creator;
+    creator.initialize(s_memory, kCapacity);
+    creator.write("hello", 5);
+
+    // 另一方按头部中的容量使用同一段内存
+    ShmRing other;
+    QVERIFY(other.attach(s_memory, ShmRing::requiredSize(kCapacity)));
+    QCOMPARE(other.capacity(), kCapacity);
+    char out[5];
+    QCOMPARE(other.read(out, 5), qint64(5));
+    QCOMPARE(QByteArray(out, 5), QByteArray("hello"));
+
+    // 内存不够大或头部无效时拒绝
+    QVERIFY(!other.attach(s_memory, ShmRing::requiredSize(kCapacity) - 1));
+    memset(s_memory, 0, 8);
+    QVERIFY(!other.attach(s_memory, sizeof(s_memory)));
+}
+
+void ShmRingTest::testWaitingFlags()
+{
+    ShmRing ring;
+    ring.initialize(s_memory, kCapacity);
+
+    // 消费者没有登记时写入不需要唤醒
+    ring.write("a", 1);
+    QVERIFY(!ring.takeConsumerWaiting());
+
+    // 登记只被取走一次
+    char out[1];
+    ring.read(out, 1);
+    ring.setConsumerWaiting();
+    ring.write("b", 1);
+    QVERIFY(ring.takeConsumerWaiting());
+    QVERIFY(!ring.takeConsumerWaiting());
+
+    ring.setProducerWaiting();
+    QVERIFY(ring.takeProducerWaiting());
+    QVERIFY(!ring.takeProducerWaiting());
+}
+
+// 头部布局：魔数和容量之后，写位置和读位置各占一个缓存行
+static void storeIndices(quint64 head, quint64 tail)
+{
+    memcpy(s_memory + 64, &head, sizeof(head));
+    memcpy(s_memory + 128, &tail, sizeof(tail));
+}
+
+void ShmRingTest::testCorruptedIndices()
+{
+    ShmRing producer;
+    producer.initialize(s_memory, kCapacity);
+    ShmRing consumer;
+    QVERIFY(consumer.attach(s_memory, ShmRing::requiredSize(kCapacity)));
+
+    // 对端把写位置推到超过容量：读取不能越过数据区，环标记为损坏
+    storeIndices(100 + kCapacity + 1, 100);
+    QCOMPARE(consumer.bytesAvailable(), qint64(0));
+    QByteArray out(kCapacity * 2, '\0');
+    QCOMPARE(consumer.read(out.data(), out.size()), qint64(-1));
+    QVERIFY(consumer.isBroken());
+
+    // 损坏是持久的，恢复位置之后也不再读写
+    storeIndices(0, 0);
+    QCOMPARE(consumer.read(out.data(), out.size()), qint64(-1));
+
+    // 对端把读位置推到写位置之前：可用空间不能回绕成巨大的值
+    storeIndices(10, 20);
+    QVERIFY(!producer.isBroken());
+    QCOMPARE(producer.write("abc", 3), qint64(-1));
+    QVERIFY(producer.isBroken());
+
+    // 重新初始化后恢复正常
+    producer.initialize(s_memory, kCapacity);
+    QVERIFY(!producer.isBroken());
+    QCOMPARE(producer.write("abc", 3), qint64(3));
+}
+
+void ShmRingTest::testConcurrentStream()
+{
+    ShmRing producer;
+    producer.initialize(s_memory, kCapacity);
+    ShmRing consumer;
+    QVERIFY(consumer.attach(s_memory, sizeof(s_memory)));
+
+    // 两个线程经过小容量的环传输递增字节流，内容和顺序都不能出错
+    const qint64 total = 8 * 1024 * 1024;
+    std::thread writer([&producer, total]() {
+        char chunk[1000];
+        qint64 sent = 0;
+        while (sent < total) {
+            const int size = int(qMin<qint64>(sizeof(chunk), total - sent));
+            for (int i = 0; i < size; ++i) {
+                chunk[i] = char((sent + i) & 0xFF);
+            }
+            int offset = 0;
+            while (offset < size) {
+                const qint64 written = producer.write(chunk + offset, size - offset);
+                offset += int(written);
+                if (written == 0) {
+                    std::this_thread::yield();
+                }
+            }
+            sent += size;
+        }
+    });
+
+    char buffer[1500];
+    qint64 received = 0;
+    bool ordered = true;
+    while (received < total) {
+        const qint64 count = consumer.read(buffer, sizeof(buffer));
+        for (qint64 i = 0; i < count; ++i) {
+            ordered = ordered && buffer[i] == char((received + i) & 0xFF);
+        }
+        received += count;
+        if (count == 0) {
+            std::this_thread::yield();
+        }
+    }
+    writer.join();
+
+    QVERIFY(ordered);
+    QCOMPARE(consumer.bytesAvailable(), qint64(0));
+}
+
+QTEST_MAIN(ShmRingTest)
+#include "shmring_test.moc"
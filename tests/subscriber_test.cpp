@@ -1,9 +1,13 @@
 #include <QtTest>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include "subscriber.h"
 #include "publisher.h"
 #include "broker.h"
 #include "logger.h"
 
+#include <utility>
+
 class SubscriberTest : public QObject
 {
     Q_OBJECT
@@ -14,6 +18,11 @@ private slots:
     void testConstructor();
     void testSubscribe();
     void testReceiveMessage();
+    void testResumeAfterReconnect();
+    void testNewOnly();
+    void testTopicAliases();
+    void testSharedMemory();
+    void testStats();
 };
 
 void SubscriberTest::initTestCase()
@@ -150,5 +159,248 @@ void SubscriberTest::testReceiveMessage()
     QTest::qWait(100);
 }
 
+void SubscriberTest::testResumeAfterReconnect()
+{
+    Broker* broker = Broker::instance();
+    if (!broker->isRunning()) {
+        broker->start(5558, "SubscriberTestBroker");
+        QTest::qWait(100);
+    }
+
+    Subscriber subscriber;
+    Publisher publisher;
+    if (!subscriber.connectToBroker("localhost", 5558) || !publisher.connectToBroker("localhost", 5558)) {
+        QSKIP("Could not connect to broker, skipping test");
+    }
+    QTest::qWait(100);
+
+    const QString topic = "test/resume";
+    QVERIFY(subscriber.subscribe(topic));
+    QTest::qWait(100);
+
+    QSignalSpy spy(&subscriber, &Subscriber::messageReceived);
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(publisher.publish(topic, QByteArray::number(i)));
+    }
+
+    // 每条消息都带有主题序号
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 3, 2000);
+    QCOMPARE(qvariant_cast<Message>(spy.at(0).at(0)).sequence(), qint64(0));
+    QCOMPARE(subscriber.lastSequence(topic), qint64(2));
+
+    // 断线期间发布的消息在重连后补发，已经收到的消息不会重复回放
+    subscriber.disconnectFromBroker();
+    QTest::qWait(100);
+    for (int i = 3; i < 5; ++i) {
+        QVERIFY(publisher.publish(topic, QByteArray::number(i)));
+    }
+    QTest::qWait(100);
+
+    spy.clear();
+    QVERIFY(subscriber.connectToBroker("localhost", 5558));
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 2, 2000);
+    QTest::qWait(200);
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(qvariant_cast<Message>(spy.at(0).at(0)).data(), QByteArray("3"));
+    QCOMPARE(qvariant_cast<Message>(spy.at(1).at(0)).sequence(), qint64(4));
+    QCOMPARE(subscriber.lastSequence(topic), qint64(4));
+
+    subscriber.disconnectFromBroker();
+    publisher.disconnectFromBroker();
+    QTest::qWait(100);
+}
+
+void SubscriberTest::testNewOnly()
+{
+    Broker* broker = Broker::instance();
+    if (!broker->isRunning()) {
+        broker->start(5558, "SubscriberTestBroker");
+        QTest::qWait(100);
+    }
+
+    Subscriber subscriber;
+    Publisher publisher;
+    if (!subscriber.connectToBroker("localhost", 5558) || !publisher.connectToBroker("localhost", 5558)) {
+        QSKIP("Could not connect to broker, skipping test");
+    }
+    QTest::qWait(100);
+
+    // 缓存中已有消息，只接收新消息的订阅不回放
+    const QString topic = "test/new-only";
+    QVERIFY(publisher.publish(topic, "old"));
+    QTest::qWait(100);
+
+    QSignalSpy spy(&subscriber, &Subscriber::messageReceived);
+    QVERIFY(subscriber.subscribe(topic, SubscriptionOptions::newOnly()));
+    QTest::qWait(200);
+    QCOMPARE(spy.count(), 0);
+
+    QVERIFY(publisher.publish(topic, "new"));
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 1, 2000);
+    QCOMPARE(qvariant_cast<Message>(spy.at(0).at(0)).data(), QByteArray("new"));
+    QCOMPARE(qvariant_cast<Message>(spy.at(0).at(0)).sequence(), qint64(1));
+
+    subscriber.disconnectFromBroker();
+    publisher.disconnectFromBroker();
+    QTest::qWait(100);
+}
+
+void SubscriberTest::testTopicAliases()
+{
+    Broker* broker = Broker::instance();
+    if (!broker->isRunning()) {
+        broker->start(5558, "SubscriberTestBroker");
+        QTest::qWait(100);
+    }
+
+    Subscriber subscriber;
+    Subscriber plainSubscriber;
+    Publisher publisher;
+    subscriber.setTopicAliasesEnabled(true);
+    publisher.setTopicAliasesEnabled(true);
+    if (!subscriber.connectToBroker("localhost", 5558) || !plainSubscriber.connectToBroker("localhost", 5558)
+        || !publisher.connectToBroker("localhost", 5558)) {
+        QSKIP("Could not connect to broker, skipping test");
+    }
+    QTest::qWait(100);
+
+    // 两端都使用别名时，收到的消息仍然带有完整主题；不使用别名的订阅者不受影响
+    const QString topic = "test/aliases/site-07/area-north/line-03/cell-12/temperature";
+    QVERIFY(subscriber.subscribe("test/aliases/#"));
+    QVERIFY(plainSubscriber.subscribe(topic));
+    QTest::qWait(100);
+
+    QSignalSpy spy(&subscriber, &Subscriber::messageReceived);
+    QSignalSpy plainSpy(&plainSubscriber, &Subscriber::messageReceived);
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(publisher.publish(topic, QByteArray::number(i)));
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 3, 2000);
+    QTRY_COMPARE_WITH_TIMEOUT(plainSpy.count(), 3, 2000);
+    for (int i = 0; i < 3; ++i) {
+        const Message received = qvariant_cast<Message>(spy.at(i).at(0));
+        QCOMPARE(received.topic(), topic);
+        QCOMPARE(received.data(), QByteArray::number(i));
+        QCOMPARE(received.sequence(), qint64(i));
+        QCOMPARE(qvariant_cast<Message>(plainSpy.at(i).at(0)).topic(), topic);
+    }
+
+    // Broker内部按驻留的主题编号路由
+    QVERIFY(broker->topicRegistry()->find(topic) != TopicRegistry::InvalidTopic);
+
+    subscriber.disconnectFromBroker();
+    plainSubscriber.disconnectFromBroker();
+    publisher.disconnectFromBroker();
+    QTest::qWait(100);
+}
+
+void SubscriberTest::testSharedMemory()
+{
+    Broker* broker = Broker::instance();
+    if (!broker->isRunning()) {
+        broker->start(5558, "SubscriberTestBroker");
+        QTest::qWait(100);
+    }
+
+    Subscriber subscriber;
+    Publisher publisher;
+    subscriber.setSharedMemoryEnabled(true);
+    publisher.setSharedMemoryEnabled(true);
+    if (!subscriber.connectToLocalBroker("SubscriberTestBroker") || !publisher.connectToLocalBroker("SubscriberTestBroker")) {
+        QSKIP("Could not connect to local broker, skipping test");
+    }
+    QTRY_VERIFY_WITH_TIMEOUT(subscriber.isUsingSharedMemory() && publisher.isUsingSharedMemory(), 2000);
+
+    const QString topic = "test/shm";
+    QVERIFY(subscriber.subscribe(topic));
+    QTest::qWait(100);
+
+    // 总量超过环的容量，覆盖环满后积压、按门铃继续写出的路径
+    QSignalSpy spy(&subscriber, &Subscriber::messageReceived);
+    const int count = 200;
+    for (int i = 0; i < count; ++i) {
+        QVERIFY(publisher.publish(topic, QByteArray(16 * 1024, char('a' + i % 26)) + QByteArray::number(i)));
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), count, 5000);
+    for (int i = 0; i < count; ++i) {
+        const Message received = qvariant_cast<Message>(spy.at(i).at(0));
+        QVERIFY(received.data().endsWith(QByteArray::number(i)));
+        QCOMPARE(received.data().at(0), char('a' + i % 26));
+        QCOMPARE(received.sequence(), qint64(i));
+    }
+
+    subscriber.disconnectFromBroker();
+    publisher.disconnectFromBroker();
+    QTest::qWait(100);
+}
+
+void SubscriberTest::testStats()
+{
+    Broker* broker = Broker::instance();
+    if (!broker->isRunning()) {
+        broker->start(5558, "SubscriberTestBroker");
+        QTest::qWait(100);
+    }
+
+    Subscriber subscriber;
+    Subscriber statsSubscriber;
+    Publisher publisher;
+    if (!subscriber.connectToBroker("localhost", 5558) || !statsSubscriber.connectToBroker("localhost", 5558)
+        || !publisher.connectToBroker("localhost", 5558)) {
+        QSKIP("Could not connect to broker, skipping test");
+    }
+    QTest::qWait(100);
+
+    const QString topic = "test/stats";
+    QVERIFY(subscriber.subscribe(topic));
+    QVERIFY(statsSubscriber.subscribe("$SYS/STATS/#"));
+    QTest::qWait(100);
+
+    QSignalSpy spy(&subscriber, &Subscriber::messageReceived);
+    const int count = 20;
+    for (int i = 0; i < count; ++i) {
+        QVERIFY(publisher.publish(topic, QByteArray(100, 'x')));
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), count, 2000);
+
+    // 快照中的主题计数只包含本测试的消息；停留时间每条实时投递记录一次
+    const BrokerStats stats = broker->stats();
+    QVERIFY(stats.topics.contains(topic));
+    QCOMPARE(stats.topics.value(topic).messagesIn, quint64(count));
+    QCOMPARE(stats.topics.value(topic).messagesOut, quint64(count));
+    QVERIFY(stats.topics.value(topic).bytesOut >= quint64(count * 100));
+    QVERIFY(stats.total.messagesOut >= quint64(count));
+    QVERIFY(stats.residence.count() >= quint64(count));
+    QVERIFY(stats.clientCount >= 3);
+
+    // 客户端不能发布到统计主题
+    QVERIFY(publisher.publish("$SYS/STATS/broker", "forged"));
+
+    // 周期发布：通配符订阅收到三个统计主题，内容与快照一致
+    QSignalSpy statsSpy(&statsSubscriber, &Subscriber::messageReceived);
+    broker->setStatsInterval(100);
+    QTRY_VERIFY_WITH_TIMEOUT(statsSpy.count() >= 3, 2000);
+    broker->setStatsInterval(0);
+
+    QSet<QString> statsTopics;
+    for (const QList<QVariant>& arguments : std::as_const(statsSpy)) {
+        const Message received = qvariant_cast<Message>(arguments.at(0));
+        statsTopics.insert(received.topic());
+        QVERIFY(received.data() != "forged");
+        if (received.topic() == "$SYS/STATS/topics") {
+            const QJsonObject topics = QJsonDocument::fromJson(received.data()).object().value("topics").toObject();
+            QCOMPARE(topics.value(topic).toObject().value("messagesIn").toDouble(), double(count));
+        }
+    }
+    QCOMPARE(statsTopics, QSet<QString>() << "$SYS/STATS/broker" << "$SYS/STATS/topics" << "$SYS/STATS/clients");
+
+    subscriber.disconnectFromBroker();
+    statsSubscriber.disconnectFromBroker();
+    publisher.disconnectFromBroker();
+    QTest::qWait(100);
+}
+
 QTEST_MAIN(SubscriberTest)
 #include "subscriber_test.moc"
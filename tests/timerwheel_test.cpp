@@ -0,0 +1,165 @@
+#include <QtTest>
+#include "timerwheel.h"
+
+#include <utility>
+
+class TimerWheelTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testExpiry();
+    void testCascade();
+    void testRescheduleAndCancel();
+    void testReusedSlot();
+    void testClamp();
+    void benchmarkTick_data();
+    void benchmarkTick();
+};
+
+void TimerWheelTest::testExpiry()
+{
+    TimerWheel wheel(100);
+    wheel.schedule(1, 103);
+    wheel.schedule(2, 101);
+    wheel.schedule(3, 103);
+    QCOMPARE(wheel.size(), 3);
+    QCOMPARE(wheel.expiry(2), quint64(101));
+
+    // 推进时按节拍取出到期的句柄，取出后不再登记
+    QVector<ClientHandle> expired;
+    wheel.advance(102, &expired);
+    QCOMPARE(expired, QVector<ClientHandle>() << 2);
+    QVERIFY(!wheel.contains(2));
+
+    expired.clear();
+    wheel.advance(110, &expired);
+    QCOMPARE(expired.size(), 2);
+    QVERIFY(expired.contains(1));
+    QVERIFY(expired.contains(3));
+    QVERIFY(wheel.isEmpty());
+    QCOMPARE(wheel.now(), quint64(110));
+
+    // 节拍倒退时不做任何事
+    expired.clear();
+    wheel.advance(50, &expired);
+    QVERIFY(expired.isEmpty());
+    QCOMPARE(wheel.now(), quint64(110));
+}
+
+void TimerWheelTest::testCascade()
+{
+    // 每层各放一个条目，并跨过各层的槽边界：都要恰好在到期的节拍取出
+    const quint64 start = 4000;
+    const quint64 delays[] = { 1, 63, 64, 65, 4095, 4096, 4097, 262143, 262144, 300000, 5000000 };
+    TimerWheel wheel(start);
+    ClientHandle handle = 1;
+    for (quint64 delay : delays) {
+        wheel.schedule(handle++, start + delay);
+    }
+
+    int index = 0;
+    QVector<ClientHandle> expired;
+    for (quint64 tick = start + 1; !wheel.isEmpty(); ++tick) {
+        wheel.advance(tick, &expired);
+        while (index < expired.size()) {
+            const ClientHandle expiredHandle = expired.at(index++);
+            QCOMPARE(tick, start + delays[expiredHandle - 1]);
+        }
+    }
+    QCOMPARE(expired.size(), int(sizeof(delays) / sizeof(delays[0])));
+}
+
+void TimerWheelTest::testRescheduleAndCancel()
+{
+    TimerWheel wheel;
+    wheel.schedule(7, 10);
+    wheel.schedule(8, 10);
+
+    // 重新登记替换原来的超时
+    wheel.schedule(7, 20);
+    QCOMPARE(wheel.size(), 2);
+    QCOMPARE(wheel.expiry(7), quint64(20));
+
+    QVERIFY(wheel.cancel(8));
+    QVERIFY(!wheel.cancel(8));
+    QCOMPARE(wheel.size(), 1);
+
+    QVector<ClientHandle> expired;
+    wheel.advance(19, &expired);
+    QVERIFY(expired.isEmpty());
+    wheel.advance(20, &expired);
+    QCOMPARE(expired, QVector<ClientHandle>() << 7);
+}
+
+void TimerWheelTest::testReusedSlot()
+{
+    // 同一槽位下标、不同代数的句柄：新句柄替换旧句柄的条目，旧句柄不能取消它
+    const ClientHandle oldHandle = (1u << ClientTable::kIndexBits) | 5u;
+    const ClientHandle newHandle = (2u << ClientTable::kIndexBits) | 5u;
+
+    TimerWheel wheel;
+    wheel.schedule(oldHandle, 10);
+    wheel.schedule(newHandle, 30);
+    QCOMPARE(wheel.size(), 1);
+    QVERIFY(!wheel.contains(oldHandle));
+    QVERIFY(!wheel.cancel(oldHandle));
+    QVERIFY(wheel.contains(newHandle));
+
+    QVector<ClientHandle> expired;
+    wheel.advance(30, &expired);
+    QCOMPARE(expired, QVector<ClientHandle>() << newHandle);
+
+    wheel.schedule(ClientTable::InvalidHandle, 40);
+    QVERIFY(wheel.isEmpty());
+}
+
+void TimerWheelTest::testClamp()
+{
+    TimerWheel wheel(1000);
+
+    // 已经过去的节拍在下一个节拍到期，太远的按最远的超时登记
+    wheel.schedule(1, 10);
+    wheel.schedule(2, quint64(1) << 40);
+    QCOMPARE(wheel.expiry(1), quint64(1001));
+    QCOMPARE(wheel.expiry(2), 1000 + quint64(TimerWheel::kMaxDelay));
+
+    QVector<ClientHandle> expired;
+    wheel.advance(1001, &expired);
+    QCOMPARE(expired, QVector<ClientHandle>() << 1);
+}
+
+void TimerWheelTest::benchmarkTick_data()
+{
+    QTest::addColumn<int>("connections");
+
+    QTest::newRow("1000 connections") << 1000;
+    QTest::newRow("50000 connections") << 50000;
+}
+
+void TimerWheelTest::benchmarkTick()
+{
+    QFETCH(int, connections);
+
+    // 每秒一次的节拍：空闲超时60秒，连接均匀分布，每个节拍约 1/60 的条目到期并重新登记。
+    // 开销应与到期的条目数成正比，而不是扫描全部连接
+    TimerWheel wheel;
+    for (int i = 0; i < connections; ++i) {
+        wheel.schedule(ClientHandle(i + 1), quint64(i % 60 + 1));
+    }
+
+    QVector<ClientHandle> expired;
+    expired.reserve(connections);
+    quint64 tick = 0;
+    QBENCHMARK {
+        expired.clear();
+        wheel.advance(++tick, &expired);
+        for (ClientHandle handle : std::as_const(expired)) {
+            wheel.schedule(handle, tick + 60);
+        }
+    }
+    QCOMPARE(wheel.size(), connections);
+}
+
+QTEST_MAIN(TimerWheelTest)
+#include "timerwheel_test.moc"
@@ -1,5 +1,6 @@
 #include <QtTest>
 #include "topic.h"
+#include "topictrie.h"
 
 class TopicTest : public QObject
 {
@@ -11,6 +12,10 @@ private slots:
     void testProperties();
     void testValidity();
     void testEquality();
+    void testPatternMatching_data();
+    void testPatternMatching();
+    void testPatternValidity();
+    void testTopicTrie();
 };
 
 void TopicTest::testConstructor()
@@ -97,5 +102,94 @@ void TopicTest::testEquality()
     QVERIFY(!(topic1 == topic3));
 }
 
+void TopicTest::testPatternMatching_data()
+{
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<QString>("topic");
+    QTest::addColumn<bool>("expected");
+
+    QTest::newRow("exact") << "sensors/line3/temp" << "sensors/line3/temp" << true;
+    QTest::newRow("exact mismatch") << "sensors/line3/temp" << "sensors/line3/hum" << false;
+    QTest::newRow("single level") << "sensors/+/temp" << "sensors/line3/temp" << true;
+    QTest::newRow("single level too deep") << "sensors/+/temp" << "sensors/a/b/temp" << false;
+    QTest::newRow("single level needs a level") << "sensors/+" << "sensors" << false;
+    QTest::newRow("multi level") << "sensors/#" << "sensors/line3/temp" << true;
+    QTest::newRow("multi level matches parent") << "sensors/#" << "sensors" << true;
+    QTest::newRow("multi level other branch") << "sensors/#" << "alarms/line3" << false;
+    QTest::newRow("root multi level") << "#" << "a/b/c" << true;
+    QTest::newRow("mixed") << "+/line3/#" << "sensors/line3/temp/max" << true;
+    QTest::newRow("system topic hidden from #") << "#" << "$SYS/STATS" << false;
+    QTest::newRow("system topic hidden from +") << "+/STATS" << "$SYS/STATS" << false;
+    QTest::newRow("system topic explicit") << "$SYS/#" << "$SYS/STATS" << true;
+}
+
+void TopicTest::testPatternMatching()
+{
+    QFETCH(QString, pattern);
+    QFETCH(QString, topic);
+    QFETCH(bool, expected);
+
+    // Topic::matches 与前缀树的语义必须一致
+    QCOMPARE(Topic::matches(pattern, topic), expected);
+
+    TopicTrie<bool> trie;
+    trie.insert(pattern) = true;
+    QCOMPARE(trie.matches(topic), expected);
+}
+
+void TopicTest::testPatternValidity()
+{
+    QVERIFY(Topic::isValidPattern("sensors/line3/temp"));
+    QVERIFY(Topic::isValidPattern("sensors/+/temp"));
+    QVERIFY(Topic::isValidPattern("sensors/#"));
+    QVERIFY(Topic::isValidPattern("#"));
+
+    QVERIFY(!Topic::isValidPattern(""));
+    QVERIFY(!Topic::isValidPattern("sensors/#/temp"));
+    QVERIFY(!Topic::isValidPattern("sensors/line+/temp"));
+    QVERIFY(!Topic::isValidPattern("sensors/temp#"));
+
+    QVERIFY(Topic::isWildcard("sensors/+/temp"));
+    QVERIFY(!Topic::isWildcard("sensors/line3/temp"));
+}
+
+void TopicTest::testTopicTrie()
+{
+    TopicTrie<QSet<QString>> trie;
+    trie.insert("sensors/line3/temp").insert("exact");
+    trie.insert("sensors/+/temp").insert("single");
+    trie.insert("sensors/#").insert("multi");
+    trie.insert("alarms/#").insert("other");
+    QCOMPARE(trie.size(), 4);
+
+    // 一次匹配收集所有命中的模式
+    QSet<QString> matched;
+    trie.match("sensors/line3/temp", [&matched](const QSet<QString>& values) {
+        matched.unite(values);
+    });
+    QCOMPARE(matched, QSet<QString>({ "exact", "single", "multi" }));
+
+    // 删除模式后不再匹配，空分支被回收
+    QVERIFY(trie.remove("sensors/+/temp"));
+    QVERIFY(!trie.remove("sensors/+/temp"));
+    QCOMPARE(trie.size(), 3);
+    QVERIFY(trie.find("sensors/+/temp") == nullptr);
+
+    matched.clear();
+    trie.match("sensors/line3/temp", [&matched](const QSet<QString>& values) {
+        matched.unite(values);
+    });
+    QCOMPARE(matched, QSet<QString>({ "exact", "multi" }));
+
+    // 删除父模式不影响子模式
+    QVERIFY(trie.remove("sensors/#"));
+    QVERIFY(trie.matches("sensors/line3/temp"));
+    QVERIFY(!trie.matches("sensors/line4/temp"));
+
+    trie.clear();
+    QVERIFY(trie.isEmpty());
+    QVERIFY(!trie.matches("alarms/fire"));
+}
+
 QTEST_MAIN(TopicTest)
 #include "topic_test.moc"
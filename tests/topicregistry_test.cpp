@@ -0,0 +1,94 @@
+#include <QtTest>
+#include <QThread>
+#include "topicregistry.h"
+
+#include <utility>
+#include <vector>
+
+class TopicRegistryTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testIntern();
+    void testConcurrentIntern();
+    void testMaxSize();
+};
+
+void TopicRegistryTest::testIntern()
+{
+    TopicRegistry registry;
+    QCOMPARE(registry.size(), 0);
+    QVERIFY(registry.intern(QString()) == TopicRegistry::InvalidTopic);
+    QVERIFY(registry.find("a/b") == TopicRegistry::InvalidTopic);
+
+    // 编号从1开始连续分配，同一主题只分配一次
+    const TopicId first = registry.intern("a/b");
+    const TopicId second = registry.intern("a/c");
+    QCOMPARE(first, TopicId(1));
+    QCOMPARE(second, TopicId(2));
+    QCOMPARE(registry.intern("a/b"), first);
+    QCOMPARE(registry.find("a/c"), second);
+    QCOMPARE(registry.size(), 2);
+
+    QCOMPARE(registry.name(first), QString("a/b"));
+    QVERIFY(registry.name(TopicRegistry::InvalidTopic).isEmpty());
+    QVERIFY(registry.name(3).isEmpty());
+}
+
+void TopicRegistryTest::testConcurrentIntern()
+{
+    TopicRegistry registry;
+    const int threadCount = 4;
+    const int topicCount = 1000;
+
+    // 多个I/O线程同时驻留相同的主题，每个主题只得到一个编号
+    std::vector<QVector<TopicId>> results(threadCount);
+    QVector<QThread*> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        QVector<TopicId>* ids = &results[t];
+        threads.append(QThread::create([&registry, ids, topicCount]() {
+            for (int i = 0; i < topicCount; ++i) {
+                ids->append(registry.intern(QString("plant/line%1/sensor").arg(i)));
+            }
+        }));
+        threads.last()->start();
+    }
+    for (QThread* thread : std::as_const(threads)) {
+        thread->wait();
+    }
+    qDeleteAll(threads);
+
+    QCOMPARE(registry.size(), topicCount);
+    for (int t = 1; t < threadCount; ++t) {
+        QCOMPARE(results[t], results[0]);
+    }
+    for (int i = 0; i < topicCount; ++i) {
+        QCOMPARE(registry.name(results[0].at(i)), QString("plant/line%1/sensor").arg(i));
+    }
+}
+
+void TopicRegistryTest::testMaxSize()
+{
+    TopicRegistry registry;
+    QCOMPARE(registry.maxSize(), 0);
+    registry.setMaxSize(2);
+    QCOMPARE(registry.maxSize(), 2);
+
+    // 达到上限后新主题不再分配编号，已驻留的主题照常查到
+    const TopicId first = registry.intern("a/b");
+    const TopicId second = registry.intern("a/c");
+    QVERIFY(first != TopicRegistry::InvalidTopic);
+    QVERIFY(second != TopicRegistry::InvalidTopic);
+    QVERIFY(registry.intern("a/d") == TopicRegistry::InvalidTopic);
+    QVERIFY(registry.find("a/d") == TopicRegistry::InvalidTopic);
+    QCOMPARE(registry.intern("a/b"), first);
+    QCOMPARE(registry.size(), 2);
+
+    // 放宽上限后可以继续驻留
+    registry.setMaxSize(0);
+    QCOMPARE(registry.intern("a/d"), TopicId(3));
+}
+
+QTEST_MAIN(TopicRegistryTest)
+#include "topicregistry_test.moc"